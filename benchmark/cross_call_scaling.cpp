@@ -0,0 +1,345 @@
+// Cross-language call throughput as the number of host threads grows.
+// Every host thread enters Python the way exported methods are called (GilEnterScope) and runs
+// cross_call_worker style signatures: 'callback' calls a Python function with converted arguments,
+// 'call' runs a reverse_* function that calls back into native code through a stand-in
+// cross_call_master module, which releases the GIL around the native body like ExternalCall.
+// Each run is done twice: with 'transient' thread states, where every call creates and destroys the
+// Python thread state of a host thread unknown to Python, and with 'kept' ones registered up front.
+// Prints one JSON line per signature, thread state mode and thread count with throughput, call
+// latency percentiles and GIL wait time taken from GilStats.
+// Usage: py3lm-cross-call-scaling [thread counts, comma separated] [milliseconds per run]
+//        (PYTHONHOME must point to the stdlib)
+
+#include <gil.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+	constexpr const char* kWorkerScript = R"(
+from cross_call_master import NoParamReturnVoidCallback, Param4Callback, NoParamReturnArrayDoubleCallback
+
+class Vector4:
+    __slots__ = ('x', 'y', 'z', 'w')
+    def __init__(self, x, y, z, w):
+        self.x, self.y, self.z, self.w = x, y, z, w
+
+def no_param_return_void():
+    pass
+
+def param4(a, b, c, d):
+    buffer = f'{a}{b}{c}{d.x}'
+
+def no_param_return_array_double():
+    return [-12.345, 0.0, 12.345]
+
+def reverse_no_param_return_void():
+    NoParamReturnVoidCallback()
+
+def reverse_param4():
+    Param4Callback(666, 7.7, 8.7659, Vector4(100.1, 200.2, 300.3, 400.4))
+
+def reverse_no_param_return_array_double():
+    result = NoParamReturnArrayDoubleCallback()
+    return len(result)
+)";
+
+	// Native side of the reverse calls, arguments are converted under the GIL and the body runs without it
+
+	py3lm::GilStats* s_stats = nullptr;
+	std::atomic<uint64_t> s_sink;
+
+	void NativeBody(double value) {
+		s_sink.fetch_add(static_cast<uint64_t>(value), std::memory_order_relaxed);
+	}
+
+	PyObject* NoParamReturnVoidCallback(PyObject*, PyObject* const*, Py_ssize_t) {
+		{
+			py3lm::GilReleaseScope gil(*s_stats);
+			NativeBody(0.0);
+		}
+		Py_RETURN_NONE;
+	}
+
+	PyObject* Param4Callback(PyObject*, PyObject* const* args, Py_ssize_t nargs) {
+		if (nargs != 4) {
+			PyErr_SetString(PyExc_TypeError, "Param4Callback takes 4 arguments");
+			return nullptr;
+		}
+		const long a = PyLong_AsLong(args[0]);
+		const double b = PyFloat_AsDouble(args[1]);
+		const double c = PyFloat_AsDouble(args[2]);
+		double d[4];
+		static constexpr const char* kFields[] = { "x", "y", "z", "w" };
+		for (size_t i = 0; i < std::size(d); ++i) {
+			PyObject* const field = PyObject_GetAttrString(args[3], kFields[i]);
+			d[i] = field ? PyFloat_AsDouble(field) : -1.0;
+			Py_XDECREF(field);
+		}
+		if (PyErr_Occurred()) {
+			return nullptr;
+		}
+		{
+			py3lm::GilReleaseScope gil(*s_stats);
+			NativeBody(static_cast<double>(a) + b + c + d[0] + d[1] + d[2] + d[3]);
+		}
+		Py_RETURN_NONE;
+	}
+
+	PyObject* NoParamReturnArrayDoubleCallback(PyObject*, PyObject* const*, Py_ssize_t) {
+		std::vector<double> values;
+		{
+			py3lm::GilReleaseScope gil(*s_stats);
+			values = { -12.345, 0.0, 12.345 };
+			NativeBody(values.back());
+		}
+		PyObject* const list = PyList_New(static_cast<Py_ssize_t>(values.size()));
+		if (!list) {
+			return nullptr;
+		}
+		for (size_t i = 0; i < values.size(); ++i) {
+			PyObject* const value = PyFloat_FromDouble(values[i]);
+			if (!value) {
+				Py_DECREF(list);
+				return nullptr;
+			}
+			PyList_SET_ITEM(list, static_cast<Py_ssize_t>(i), value);
+		}
+		return list;
+	}
+
+	PyMethodDef s_masterMethods[] = {
+		{ "NoParamReturnVoidCallback", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(NoParamReturnVoidCallback)), METH_FASTCALL, nullptr },
+		{ "Param4Callback", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(Param4Callback)), METH_FASTCALL, nullptr },
+		{ "NoParamReturnArrayDoubleCallback", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(NoParamReturnArrayDoubleCallback)), METH_FASTCALL, nullptr },
+		{ nullptr, nullptr, 0, nullptr }
+	};
+
+	PyModuleDef s_masterModule = {
+		PyModuleDef_HEAD_INIT,
+		"cross_call_master",
+		nullptr,
+		-1,
+		s_masterMethods,
+		nullptr,
+		nullptr,
+		nullptr,
+		nullptr
+	};
+
+	PyObject* InitMasterModule() {
+		return PyModule_Create(&s_masterModule);
+	}
+
+	// Native -> Python side, argument and return conversion done per call like InternalCall
+
+	using CallFunc = bool (*)(PyObject* function, PyObject* vector4);
+
+	bool CallVoid(PyObject* function, PyObject*) {
+		PyObject* const result = PyObject_CallNoArgs(function);
+		Py_XDECREF(result);
+		return result != nullptr;
+	}
+
+	bool CallParam4(PyObject* function, PyObject* vector4Type) {
+		PyObject* const args[] = {
+			PyLong_FromLong(666),
+			PyFloat_FromDouble(7.7),
+			PyFloat_FromDouble(8.7659),
+			PyObject_CallFunction(vector4Type, "dddd", 100.1, 200.2, 300.3, 400.4),
+		};
+		PyObject* const result = std::all_of(std::begin(args), std::end(args), [](PyObject* arg) { return arg != nullptr; }) ? PyObject_Vectorcall(function, args, std::size(args), nullptr) : nullptr;
+		for (PyObject* const arg : args) {
+			Py_XDECREF(arg);
+		}
+		Py_XDECREF(result);
+		return result != nullptr;
+	}
+
+	bool CallArrayDouble(PyObject* function, PyObject*) {
+		PyObject* const result = PyObject_CallNoArgs(function);
+		if (!result) {
+			return false;
+		}
+		std::vector<double> values;
+		if (PyList_Check(result)) {
+			const Py_ssize_t size = PyList_GET_SIZE(result);
+			values.reserve(static_cast<size_t>(size));
+			for (Py_ssize_t i = 0; i < size; ++i) {
+				values.push_back(PyFloat_AsDouble(PyList_GET_ITEM(result, i)));
+			}
+		}
+		else {
+			values.push_back(PyFloat_AsDouble(result));
+		}
+		Py_DECREF(result);
+		return !PyErr_Occurred();
+	}
+
+	struct Signature {
+		const char* direction;
+		const char* function;
+		CallFunc call;
+	};
+
+	constexpr Signature kSignatures[] = {
+		{ "callback", "no_param_return_void", CallVoid },
+		{ "callback", "param4", CallParam4 },
+		{ "callback", "no_param_return_array_double", CallArrayDouble },
+		{ "call", "reverse_no_param_return_void", CallVoid },
+		{ "call", "reverse_param4", CallVoid },
+		{ "call", "reverse_no_param_return_array_double", CallArrayDouble },
+	};
+
+	double Percentile(std::vector<uint64_t>& samples, double percentile) {
+		if (samples.empty()) {
+			return 0.0;
+		}
+		const size_t index = std::min(samples.size() - 1, static_cast<size_t>(percentile * static_cast<double>(samples.size())));
+		std::nth_element(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(index), samples.end());
+		return static_cast<double>(samples[index]) / 1000.0;
+	}
+
+	void Run(py3lm::GilStats& stats, uint32_t tag, PyObject* globals, const Signature& signature, bool keepState, int threadCount, int durationMs) {
+		PyObject* function;
+		PyObject* vector4Type;
+		{
+			py3lm::GilEnterScope gil(stats, py3lm::GilStats::kModuleTag);
+			function = PyDict_GetItemString(globals, signature.function);
+			vector4Type = PyDict_GetItemString(globals, "Vector4");
+		}
+		if (!function || !vector4Type) {
+			std::fprintf(stderr, "missing worker function %s\n", signature.function);
+			return;
+		}
+
+		stats.Clear();
+		std::atomic<bool> go{};
+		std::atomic<bool> stop{};
+		std::atomic<int> ready{};
+		std::atomic<bool> failed{};
+		std::vector<std::vector<uint64_t>> latencies(static_cast<size_t>(threadCount));
+		std::vector<std::thread> threads;
+		threads.reserve(static_cast<size_t>(threadCount));
+		for (int i = 0; i < threadCount; ++i) {
+			threads.emplace_back([&, i] {
+				std::vector<uint64_t>& samples = latencies[static_cast<size_t>(i)];
+				samples.reserve(1 << 16);
+				PyGILState_STATE outerState{};
+				PyThreadState* threadState = nullptr;
+				if (keepState) {
+					outerState = PyGILState_Ensure();
+					threadState = PyEval_SaveThread();
+				}
+				ready.fetch_add(1);
+				while (!go.load()) {
+					std::this_thread::yield();
+				}
+				while (!stop.load(std::memory_order_relaxed)) {
+					const auto start = py3lm::GilClock::now();
+					{
+						py3lm::GilEnterScope gil(stats, tag);
+						if (!signature.call(function, vector4Type)) {
+							PyErr_Print();
+							failed.store(true);
+							stop.store(true);
+						}
+					}
+					samples.push_back(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(py3lm::GilClock::now() - start).count()));
+				}
+				if (keepState) {
+					PyEval_RestoreThread(threadState);
+					PyGILState_Release(outerState);
+				}
+			});
+		}
+		while (ready.load() != threadCount) {
+			std::this_thread::yield();
+		}
+		// Threads that keep a thread state take the GIL once on registration, not part of the measurement
+		stats.Reset();
+		const auto start = py3lm::GilClock::now();
+		go.store(true);
+		std::this_thread::sleep_for(std::chrono::milliseconds(durationMs));
+		stop.store(true);
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		const double elapsedNs = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(py3lm::GilClock::now() - start).count());
+		if (failed.load()) {
+			return;
+		}
+
+		std::vector<uint64_t> samples;
+		for (const std::vector<uint64_t>& thread : latencies) {
+			samples.insert(samples.end(), thread.begin(), thread.end());
+		}
+		std::vector<Py3lmGilStats> slots(stats.Snapshot(nullptr, 0));
+		slots.resize(stats.Snapshot(slots.data(), slots.size()));
+		uint64_t waitNs = 0;
+		uint64_t holdNs = 0;
+		uint64_t waitMaxNs = 0;
+		for (const Py3lmGilStats& slot : slots) {
+			waitNs += slot.wait.totalNs;
+			holdNs += slot.hold.totalNs;
+			waitMaxNs = std::max(waitMaxNs, slot.wait.maxNs);
+		}
+
+		const double calls = static_cast<double>(samples.size());
+		const double p50 = Percentile(samples, 0.50);
+		const double p99 = Percentile(samples, 0.99);
+		const double max = Percentile(samples, 1.0);
+		std::printf("{\"direction\": \"%s\", \"function\": \"%s\", \"thread_state\": \"%s\", \"threads\": %d, \"calls\": %zu, \"calls_per_s\": %.0f, "
+					"\"p50_us\": %.2f, \"p99_us\": %.2f, \"max_us\": %.1f, \"gil_wait_share\": %.3f, \"gil_wait_avg_us\": %.2f, "
+					"\"gil_wait_max_us\": %.1f, \"gil_hold_share\": %.3f}\n",
+					signature.direction, signature.function, keepState ? "kept" : "transient", threadCount, samples.size(), calls * 1e9 / elapsedNs,
+					p50, p99, max, static_cast<double>(waitNs) / (elapsedNs * threadCount), calls > 0 ? static_cast<double>(waitNs) / calls / 1000.0 : 0.0,
+					static_cast<double>(waitMaxNs) / 1000.0, static_cast<double>(holdNs) / elapsedNs);
+		std::fflush(stdout);
+	}
+}
+
+int main(int argc, char** argv) {
+	const std::string counts = argc > 1 ? argv[1] : "1,2,4,8,16,32,64";
+	const int durationMs = argc > 2 ? std::atoi(argv[2]) : 500;
+
+	std::vector<int> threadCounts;
+	for (size_t begin = 0; begin < counts.size();) {
+		const size_t end = std::min(counts.find(',', begin), counts.size());
+		if (const int count = std::atoi(counts.substr(begin, end - begin).c_str()); count > 0) {
+			threadCounts.push_back(count);
+		}
+		begin = end + 1;
+	}
+
+	py3lm::GilStats stats;
+	s_stats = &stats;
+	PyImport_AppendInittab("cross_call_master", InitMasterModule);
+	Py_Initialize();
+	PyObject* const globals = PyDict_New();
+	PyDict_SetItemString(globals, "__builtins__", PyEval_GetBuiltins());
+	PyObject* const result = PyRun_String(kWorkerScript, Py_file_input, globals, globals);
+	if (!result) {
+		PyErr_Print();
+		return 1;
+	}
+	Py_DECREF(result);
+	const uint32_t tag = stats.RegisterTag("cross_call_worker");
+
+	PyThreadState* const state = PyEval_SaveThread();
+	for (const Signature& signature : kSignatures) {
+		for (const bool keepState : { false, true }) {
+			for (const int threadCount : threadCounts) {
+				Run(stats, tag, globals, signature, keepState, threadCount, durationMs);
+			}
+		}
+	}
+	PyEval_RestoreThread(state);
+
+	Py_DECREF(globals);
+	return Py_FinalizeEx() < 0 ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+"""Compares plugify.ffi calls with the equivalent ctypes.CFUNCTYPE calls of the same native functions.
+
+A plugin loaded by the startup host times both from plugin_start and prints one JSON line per case:
+  scalar      int64(int64, int64)
+  string_ref  bool(string, int32&), ctypes passes bytes and a c_int32 by reference
+Times are per call and include the loop; loop_ns is the same loop around an empty lambda.
+
+Usage: ffi_call.py --host <py3lm-startup-benchmark> --module <packaged module dir>
+                   --targets <libpy3lm-ffi-targets.so> [--calls 200000] [--work <dir>]
+"""
+import argparse
+import json
+import os
+import subprocess
+import sys
+
+from generate_plugins import generate
+
+COLUMNS = ['case', 'release_gil', 'loop_ns', 'ffi_ns', 'ctypes_ns', 'ratio', 'net_ratio']
+
+PLUGIN_SOURCE = '''import ctypes
+import json
+import os
+import time
+from plugify import ffi
+from plugify.plugin import Plugin
+
+CALLS = int(os.environ['PY3LM_FFI_CALLS'])
+REPEATS = 5
+
+
+def per_call_ns(call):
+    for _ in range(1000):
+        call()
+    best = None
+    for _ in range(REPEATS):
+        start = time.perf_counter_ns()
+        for _ in range(CALLS):
+            call()
+        elapsed = time.perf_counter_ns() - start
+        best = elapsed if best is None else min(best, elapsed)
+    return best / CALLS
+
+
+def report(case, release_gil, loop_ns, ffi_call, ctypes_call):
+    ffi_ns = per_call_ns(ffi_call)
+    ctypes_ns = per_call_ns(ctypes_call)
+    print(json.dumps({
+        'case': case,
+        'release_gil': release_gil,
+        'loop_ns': round(loop_ns, 1),
+        'ffi_ns': round(ffi_ns, 1),
+        'ctypes_ns': round(ctypes_ns, 1),
+        'ratio': round(ctypes_ns / ffi_ns, 2),
+        'net_ratio': round((ctypes_ns - loop_ns) / max(ffi_ns - loop_ns, 1.0), 2),
+    }), flush=True)
+
+
+class FfiBench(Plugin):
+    def plugin_start(self):
+        lib = ctypes.CDLL(os.environ['PY3LM_FFI_TARGETS'])
+        address = lambda function: ctypes.cast(function, ctypes.c_void_p).value
+        loop_ns = per_call_ns(lambda: None)
+
+        # ctypes function pointers release the GIL, ffi does by default
+        add_c = ctypes.CFUNCTYPE(ctypes.c_int64, ctypes.c_int64, ctypes.c_int64)(address(lib.FfiBenchAdd))
+        parse_c = ctypes.CFUNCTYPE(ctypes.c_bool, ctypes.c_char_p, ctypes.POINTER(ctypes.c_int32))(address(lib.FfiBenchParseC))
+
+        def parse_ctypes():
+            value = ctypes.c_int32()
+            return parse_c('42'.encode(), ctypes.byref(value)), value.value
+
+        for release_gil in (True, False):
+            add = ffi.function(address(lib.FfiBenchAdd), 'int64(int64, int64)', release_gil=release_gil)
+            parse = ffi.function(address(lib.FfiBenchParse), 'bool(string, int32&)', release_gil=release_gil)
+            assert add(1, 2) == add_c(1, 2) == 3
+            assert parse('42') == parse_ctypes() == (True, 42)
+            report('scalar', release_gil, loop_ns, lambda: add(1, 2), lambda: add_c(1, 2))
+            report('string_ref', release_gil, loop_ns, lambda: parse('42'), parse_ctypes)
+'''
+
+
+def write_plugin(root):
+    plugin_dir = os.path.join(root, 'res', 'plugins', 'ffi_bench')
+    os.makedirs(plugin_dir)
+    descriptor = {
+        'fileVersion': 1,
+        'version': 1,
+        'versionName': '1.0',
+        'friendlyName': 'FfiBench',
+        'description': 'plugify.ffi against ctypes',
+        'createdBy': 'py3lm benchmark',
+        'createdByURL': '',
+        'docsURL': '',
+        'downloadURL': '',
+        'updateURL': '',
+        'entryPoint': 'ffi_bench.FfiBench',
+        'supportedPlatforms': [],
+        'languageModule': {'name': 'python3'},
+        'dependencies': [],
+        'exportedMethods': [],
+    }
+    with open(os.path.join(plugin_dir, 'ffi_bench.pplugin'), 'w') as f:
+        json.dump(descriptor, f, indent='\t')
+    with open(os.path.join(plugin_dir, 'ffi_bench.py'), 'w') as f:
+        f.write(PLUGIN_SOURCE)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--host', required=True)
+    parser.add_argument('--module', required=True)
+    parser.add_argument('--targets', required=True)
+    parser.add_argument('--calls', type=int, default=200000)
+    parser.add_argument('--work', default='py3lm-ffi-bench')
+    args = parser.parse_args()
+
+    generate(args.work, 0, 0, args.module)
+    write_plugin(args.work)
+    library = os.path.join(os.path.abspath(args.module), 'bin', 'libpy3-12-lang-module.so')
+    env = dict(os.environ, PY3LM_FFI_TARGETS=os.path.abspath(args.targets), PY3LM_FFI_CALLS=str(args.calls))
+    result = subprocess.run([args.host, os.path.abspath(args.work), library], capture_output=True, text=True, env=env)
+    sys.stderr.write(result.stderr)
+    rows = [json.loads(line) for line in result.stdout.splitlines() if line.startswith('{"case"')]
+    if result.returncode != 0 or not rows:
+        sys.exit(1)
+    print('\t'.join(COLUMNS))
+    for row in rows:
+        print('\t'.join(str(row[c]) for c in COLUMNS))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,27 @@
+// Native functions for ffi_call.py, each is called through plugify.ffi and through ctypes.
+// ffi passes a string parameter as std::string*, ctypes as const char*, both parse the same way.
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace {
+	bool Parse(const char* begin, const char* end, int32_t* value) {
+		return std::from_chars(begin, end, *value).ec == std::errc{};
+	}
+}
+
+extern "C" {
+	__attribute__((visibility("default"))) int64_t FfiBenchAdd(int64_t a, int64_t b) {
+		return a + b;
+	}
+
+	__attribute__((visibility("default"))) bool FfiBenchParse(const std::string* text, int32_t* value) {
+		return Parse(text->data(), text->data() + text->size(), value);
+	}
+
+	__attribute__((visibility("default"))) bool FfiBenchParseC(const char* text, int32_t* value) {
+		return Parse(text, text + std::strlen(text), value);
+	}
+}
@@ -0,0 +1,116 @@
+"""Generates a plugify root with N synthetic Python plugins exporting M methods each.
+
+Usage: generate_plugins.py <output root> <plugins> <methods> [--module <packaged module dir>]
+"""
+import argparse
+import json
+import os
+import shutil
+
+# (return type, [(param type, ref)], python body)
+SIGNATURES = [
+    ('void', [], 'pass'),
+    ('int32', [('int32', False)], 'return a0 + 1'),
+    ('double', [('double', False), ('double', False)], 'return a0 * a1'),
+    ('bool', [('bool', False), ('int64', False), ('float', False)], 'return a0'),
+    ('string', [('string', False)], 'return a0'),
+    ('int32*', [('int32*', False)], 'return a0'),
+    ('vec3', [('vec3', False)], 'return a0'),
+    ('void', [('int32', True), ('string', True)], 'return None, a0, a1'),
+    ('uint64', [('ptr64', False), ('uint8', False), ('char16', False), ('int16', False)], 'return a0'),
+    ('mat4x4', [], 'return Matrix4x4()'),
+    ('function', [], 'return None'),
+    ('string*', [('string*', False), ('double*', False)], 'return a0'),
+]
+
+FUNCTION_PROTOTYPE = {
+    'name': 'SyntheticCallback',
+    'paramTypes': [{'name': 'a', 'type': 'int32', 'ref': False}],
+    'retType': {'type': 'void'},
+}
+
+
+def make_method(plugin_index, method_index):
+    ret_type, params, body = SIGNATURES[(plugin_index + method_index) % len(SIGNATURES)]
+    func_name = f'method_{method_index}'
+    ret = {'type': ret_type}
+    if ret_type == 'function':
+        ret['prototype'] = FUNCTION_PROTOTYPE
+    manifest = {
+        'name': f'Method{method_index}',
+        'funcName': func_name,
+        'paramTypes': [{'name': f'a{i}', 'type': t, 'ref': ref} for i, (t, ref) in enumerate(params)],
+        'retType': ret,
+    }
+    args = ', '.join(f'a{i}' for i in range(len(params)))
+    source = f'def {func_name}({args}):\n    {body}\n'
+    return manifest, source
+
+
+def write_plugin(plugins_dir, plugin_index, methods):
+    name = f'synthetic_{plugin_index:04}'
+    class_name = f'Synthetic{plugin_index:04}'
+    plugin_dir = os.path.join(plugins_dir, name)
+    os.makedirs(plugin_dir, exist_ok=True)
+
+    exported = []
+    sources = ['from plugify.plugin import Plugin, Matrix4x4\n', f'class {class_name}(Plugin):\n    def plugin_start(self):\n        pass\n']
+    for method_index in range(methods):
+        manifest, source = make_method(plugin_index, method_index)
+        exported.append(manifest)
+        sources.append(source)
+
+    descriptor = {
+        'fileVersion': 1,
+        'version': 1,
+        'versionName': '1.0',
+        'friendlyName': class_name,
+        'description': 'Synthetic benchmark plugin',
+        'createdBy': 'py3lm benchmark',
+        'createdByURL': '',
+        'docsURL': '',
+        'downloadURL': '',
+        'updateURL': '',
+        'entryPoint': f'{name}.{class_name}',
+        'supportedPlatforms': [],
+        'languageModule': {'name': 'python3'},
+        'dependencies': [],
+        'exportedMethods': exported,
+    }
+    with open(os.path.join(plugin_dir, f'{name}.pplugin'), 'w') as f:
+        json.dump(descriptor, f, indent='\t')
+    with open(os.path.join(plugin_dir, f'{name}.py'), 'w') as f:
+        f.write('\n\n'.join(sources))
+
+
+def generate(root, plugins, methods, module_dir=None):
+    if os.path.exists(root):
+        shutil.rmtree(root)
+    base_dir = os.path.join(root, 'res')
+    plugins_dir = os.path.join(base_dir, 'plugins')
+    os.makedirs(plugins_dir)
+
+    with open(os.path.join(root, 'plugify.pconfig'), 'w') as f:
+        json.dump({'baseDir': 'res', 'logSeverity': 'error', 'repositories': []}, f, indent='\t')
+
+    if module_dir:
+        modules_dir = os.path.join(base_dir, 'modules')
+        os.makedirs(modules_dir)
+        os.symlink(os.path.abspath(module_dir), os.path.join(modules_dir, 'py3-12-lang-module'))
+
+    for plugin_index in range(plugins):
+        write_plugin(plugins_dir, plugin_index, methods)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('root')
+    parser.add_argument('plugins', type=int)
+    parser.add_argument('methods', type=int)
+    parser.add_argument('--module', help='packaged language module directory (bin/, lib/, python3.12/, .pmodule)')
+    args = parser.parse_args()
+    generate(args.root, args.plugins, args.methods, args.module)
+
+
+if __name__ == '__main__':
+    main()
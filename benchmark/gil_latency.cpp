@@ -0,0 +1,80 @@
+// GIL wait of a latency-critical thread while background Python threads are CPU bound.
+// The main thread enters Python every millisecond, once as a regular thread and once registered
+// through GilPriority, and prints wait percentiles of both runs as JSON lines.
+// Usage: py3lm-gil-latency [background threads] [samples]  (PYTHONHOME must point to the stdlib)
+// Priority is off by default, set PY3LM_GIL_SWITCH_INTERVAL_US (e.g. 100) to enable it for the critical run.
+
+#include <gil.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+	constexpr const char* kBackgroundScript =
+		"import threading\n"
+		"stop = False\n"
+		"def spin():\n"
+		"    n = 0\n"
+		"    while not stop:\n"
+		"        n += 1\n"
+		"threads = [threading.Thread(target=spin) for _ in range(count)]\n"
+		"for thread in threads:\n"
+		"    thread.start()\n";
+
+	double Percentile(std::vector<uint64_t>& samples, double percentile) {
+		const size_t index = std::min(samples.size() - 1, static_cast<size_t>(percentile * static_cast<double>(samples.size())));
+		std::nth_element(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(index), samples.end());
+		return static_cast<double>(samples[index]) / 1000.0;
+	}
+
+	void Measure(py3lm::GilStats& stats, const char* mode, int samples) {
+		std::vector<uint64_t> waits;
+		waits.reserve(static_cast<size_t>(samples));
+		for (int i = 0; i < samples; ++i) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			const auto start = py3lm::GilClock::now();
+			py3lm::GilEnterScope gil(stats, py3lm::GilStats::kModuleTag);
+			waits.push_back(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(py3lm::GilClock::now() - start).count()));
+		}
+		const double p50 = Percentile(waits, 0.50);
+		const double p99 = Percentile(waits, 0.99);
+		const double max = Percentile(waits, 1.0);
+		std::printf("{\"mode\": \"%s\", \"samples\": %d, \"p50_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f}\n", mode, samples, p50, p99, max);
+	}
+}
+
+int main(int argc, char** argv) {
+	const int threads = argc > 1 ? std::atoi(argv[1]) : 2;
+	const int samples = argc > 2 ? std::atoi(argv[2]) : 2000;
+
+	Py_Initialize();
+	PyObject* const globals = PyDict_New();
+	PyDict_SetItemString(globals, "__builtins__", PyEval_GetBuiltins());
+	PyObject* const count = PyLong_FromLong(threads);
+	PyDict_SetItemString(globals, "count", count);
+	Py_DECREF(count);
+	PyObject* const result = PyRun_String(kBackgroundScript, Py_file_input, globals, globals);
+	if (!result) {
+		PyErr_Print();
+		return 1;
+	}
+	Py_DECREF(result);
+
+	py3lm::GilStats stats;
+	PyThreadState* state = PyEval_SaveThread();
+	Measure(stats, "regular", samples);
+
+	PyEval_RestoreThread(state);
+	stats.Priority().SetCritical(true);
+	state = PyEval_SaveThread();
+	Measure(stats, "critical", samples);
+
+	PyEval_RestoreThread(state);
+	stats.Priority().SetCritical(false);
+	PyDict_SetItemString(globals, "stop", Py_True);
+	PyRun_String("for thread in threads:\n    thread.join()\n", Py_file_input, globals, globals);
+	Py_DECREF(globals);
+	return Py_FinalizeEx() < 0 ? 1 : 0;
+}
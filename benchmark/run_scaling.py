@@ -0,0 +1,46 @@
+"""Runs startup benchmark for a grid of plugin and method counts, one host process per point.
+
+Usage: run_scaling.py --host <py3lm-startup-benchmark> --module <packaged module dir>
+                      [--plugins 1,10,100] [--methods 1,10,100] [--work <dir>]
+"""
+import argparse
+import json
+import os
+import subprocess
+import sys
+
+from generate_plugins import generate
+
+COLUMNS = ['plugins', 'methods', 'wall_ms', 'initialize_ms', 'load_ms', 'export_ms', 'start_ms', 'jit_ms', 'jit_count', 'exec_kb', 'rss_kb']
+
+
+def parse_counts(value):
+    return [int(v) for v in value.split(',') if v]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--host', required=True)
+    parser.add_argument('--module', required=True)
+    parser.add_argument('--plugins', type=parse_counts, default=[1, 10, 100])
+    parser.add_argument('--methods', type=parse_counts, default=[1, 10, 100])
+    parser.add_argument('--work', default='py3lm-bench')
+    args = parser.parse_args()
+
+    library = os.path.join(os.path.abspath(args.module), 'bin', 'libpy3-12-lang-module.so')
+
+    print('\t'.join(COLUMNS))
+    for plugins in args.plugins:
+        for methods in args.methods:
+            generate(args.work, plugins, methods, args.module)
+            result = subprocess.run([args.host, os.path.abspath(args.work), library], capture_output=True, text=True)
+            if result.returncode != 0:
+                sys.stderr.write(result.stderr)
+                continue
+            row = json.loads(result.stdout.strip().splitlines()[-1])
+            row.update(plugins=plugins, methods=methods)
+            print('\t'.join(str(row[c]) for c in COLUMNS), flush=True)
+
+
+if __name__ == '__main__':
+    main()
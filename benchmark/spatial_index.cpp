@@ -0,0 +1,100 @@
+// Radius and k-nearest queries through plugify.spatial against the pure Python loop over Vector3 objects.
+// Points are uniform with constant density, so every radius query returns a similar number of ids.
+// Prints one JSON line per point count.
+// Usage: py3lm-spatial-index [point counts, comma separated]  (PYTHONHOME must point to the stdlib)
+
+#include <spatial.h>
+#include <cstdio>
+#include <string>
+
+namespace {
+	constexpr const char* kBenchmarkScript = R"(
+import array, json, random, time
+from plugify import spatial
+
+class Vector3:
+    __slots__ = ('x', 'y', 'z')
+    def __init__(self, x, y, z):
+        self.x, self.y, self.z = x, y, z
+
+RADIUS = 10.0
+K = 16
+
+def timed(fn, repeat):
+    start = time.perf_counter()
+    for _ in range(repeat):
+        result = fn()
+    return (time.perf_counter() - start) / repeat * 1e6, result
+
+def python_radius(points, c, r):
+    r2 = r * r
+    return [i for i, p in enumerate(points) if (p.x - c.x) ** 2 + (p.y - c.y) ** 2 + (p.z - c.z) ** 2 <= r2]
+
+def python_nearest(points, c, k):
+    return sorted(range(len(points)), key=lambda i: (points[i].x - c.x) ** 2 + (points[i].y - c.y) ** 2 + (points[i].z - c.z) ** 2)[:k]
+
+for n in counts:
+    rng = random.Random(n)
+    # About 4 points per query sphere
+    side = n ** (1.0 / 3.0) * RADIUS
+    coords = [rng.uniform(0.0, side) for _ in range(n * 3)]
+    points = [Vector3(*coords[i * 3:i * 3 + 3]) for i in range(n)]
+    ids = array.array('i', range(n))
+    positions = array.array('f', coords)
+    center = Vector3(side / 2, side / 2, side / 2)
+    queries = array.array('f', [rng.uniform(0.0, side) for _ in range(1000 * 3)])
+
+    grid = spatial.Grid(RADIUS)
+    build_us, _ = timed(lambda: grid.update(ids, positions), 1)
+    python_repeat = max(1, 200000 // n)
+    py_radius_us, expected = timed(lambda: python_radius(points, center, RADIUS), python_repeat)
+    radius_us, found = timed(lambda: grid.radius((center.x, center.y, center.z), RADIUS), 1000)
+    assert sorted(found.tolist()) == expected
+    py_nearest_us, _ = timed(lambda: python_nearest(points, center, K), python_repeat)
+    nearest_us, _ = timed(lambda: grid.nearest((center.x, center.y, center.z), K), 1000)
+    batch_us, _ = timed(lambda: grid.radius_batch(queries, RADIUS), 10)
+    print(json.dumps({
+        'points': n,
+        'hits': len(expected),
+        'build_us': round(build_us, 1),
+        'python_radius_us': round(py_radius_us, 1),
+        'radius_us': round(radius_us, 2),
+        'python_nearest_us': round(py_nearest_us, 1),
+        'nearest_us': round(nearest_us, 2),
+        'radius_batch_per_query_us': round(batch_us / 1000, 2),
+    }), flush=True)
+)";
+}
+
+int main(int argc, char** argv) {
+	const std::string counts = argc > 1 ? argv[1] : "10000,100000,1000000";
+
+	Py_Initialize();
+	py3lm::GilStats stats;
+	PyObject* const module = py3lm::CreateSpatialModule(stats);
+	PyObject* const package = module ? PyImport_AddModule("plugify") : nullptr;
+	if (!package || PyDict_SetItemString(PyImport_GetModuleDict(), "plugify.spatial", module) != 0 || PyObject_SetAttrString(package, "spatial", module) != 0) {
+		PyErr_Print();
+		return 1;
+	}
+	Py_DECREF(module);
+
+	PyObject* const globals = PyDict_New();
+	PyDict_SetItemString(globals, "__builtins__", PyEval_GetBuiltins());
+	const std::string countsExpression = "[" + counts + "]";
+	PyObject* const countsList = PyRun_String(countsExpression.c_str(), Py_eval_input, globals, globals);
+	if (!countsList) {
+		PyErr_Print();
+		return 1;
+	}
+	PyDict_SetItemString(globals, "counts", countsList);
+	Py_DECREF(countsList);
+	PyObject* const result = PyRun_String(kBenchmarkScript, Py_file_input, globals, globals);
+	if (!result) {
+		PyErr_Print();
+		return 1;
+	}
+	Py_DECREF(result);
+	Py_DECREF(globals);
+	return Py_FinalizeEx() < 0 ? 1 : 0;
+}
@@ -0,0 +1,126 @@
+// Stand-in host: loads one generated plugin set through plugify and prints a JSON line with load costs.
+// Usage: py3lm-startup-benchmark <plugify root> <path to language module library>
+
+#include <plugify/plugify.h>
+#include <plugify/log.h>
+#include <plugify/package_manager.h>
+#include <plugify/plugin_manager.h>
+#include <load_stats.h>
+#include <dlfcn.h>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+	class StderrLogger final : public plugify::ILogger {
+	public:
+		void Log(std::string_view message, plugify::Severity severity) override {
+			if (severity <= plugify::Severity::Error) {
+				std::cerr << message << std::endl;
+			}
+		}
+	};
+
+	uint64_t ReadRssKb() {
+		std::ifstream status("/proc/self/status");
+		std::string line;
+		while (std::getline(status, line)) {
+			if (line.starts_with("VmRSS:")) {
+				return std::stoull(line.substr(6));
+			}
+		}
+		return 0;
+	}
+
+	// Anonymous executable mappings, this is where asmjit places generated code
+	uint64_t ReadExecKb() {
+		std::ifstream maps("/proc/self/maps");
+		std::string line;
+		uint64_t total = 0;
+		while (std::getline(maps, line)) {
+			std::istringstream fields(line);
+			std::string range, perms, offset, dev, inode, path;
+			fields >> range >> perms >> offset >> dev >> inode >> path;
+			if (perms.size() < 3 || perms[2] != 'x') {
+				continue;
+			}
+			if (!path.empty() && !path.starts_with("/memfd:") && !path.starts_with("[anon")) {
+				continue;
+			}
+			const auto dash = range.find('-');
+			const uint64_t begin = std::stoull(range.substr(0, dash), nullptr, 16);
+			const uint64_t end = std::stoull(range.substr(dash + 1), nullptr, 16);
+			total += (end - begin) / 1024;
+		}
+		return total;
+	}
+
+	double ToMs(uint64_t ns) {
+		return static_cast<double>(ns) / 1e6;
+	}
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		std::cerr << "usage: " << argv[0] << " <plugify root> <language module library>" << std::endl;
+		return 1;
+	}
+
+	const std::filesystem::path rootDir = argv[1];
+	const char* const modulePath = argv[2];
+
+	const uint64_t rssBase = ReadRssKb();
+	const uint64_t execBase = ReadExecKb();
+
+	std::shared_ptr<plugify::IPlugify> plug = plugify::MakePlugify();
+	plug->SetLogger(std::make_shared<StderrLogger>());
+
+	const auto start = std::chrono::steady_clock::now();
+
+	if (!plug->Initialize(rootDir)) {
+		std::cerr << "plugify initialization failed" << std::endl;
+		return 1;
+	}
+
+	auto packageManager = plug->GetPackageManager().lock();
+	auto pluginManager = plug->GetPluginManager().lock();
+	if (!packageManager || !pluginManager) {
+		std::cerr << "plugify managers not available" << std::endl;
+		return 1;
+	}
+
+	packageManager->Initialize();
+	pluginManager->Initialize();
+
+	const auto wallNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+
+	Py3lmLoadStats stats{};
+	if (void* const handle = dlopen(modulePath, RTLD_LAZY | RTLD_NOLOAD)) {
+		using GetLoadStatsFn = void (*)(Py3lmLoadStats*);
+		if (auto const getLoadStats = reinterpret_cast<GetLoadStatsFn>(dlsym(handle, "GetLoadStats"))) {
+			getLoadStats(&stats);
+		}
+		dlclose(handle);
+	}
+	else {
+		std::cerr << "language module was not loaded: " << modulePath << std::endl;
+	}
+
+	std::printf("{\"wall_ms\": %.3f, \"initialize_ms\": %.3f, \"load_ms\": %.3f, \"export_ms\": %.3f, \"start_ms\": %.3f, "
+				"\"jit_ms\": %.3f, \"jit_count\": %llu, \"exec_kb\": %llu, \"rss_kb\": %llu, \"rss_base_kb\": %llu}\n",
+				ToMs(wallNs), ToMs(stats.initializeNs), ToMs(stats.pluginLoadNs), ToMs(stats.methodExportNs), ToMs(stats.pluginStartNs),
+				ToMs(stats.jitNs), static_cast<unsigned long long>(stats.jitCount),
+				static_cast<unsigned long long>(ReadExecKb() - execBase), static_cast<unsigned long long>(ReadRssKb()),
+				static_cast<unsigned long long>(rssBase));
+	std::fflush(stdout);
+
+	pluginManager->Terminate();
+	packageManager->Terminate();
+	plug->Terminate();
+
+	return 0;
+}
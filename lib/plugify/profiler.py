@@ -0,0 +1,297 @@
+"""Per-plugin call and line statistics on top of sys.monitoring (PEP 669).
+
+Call, return and line events are enabled only for code objects of the
+selected plugin packages. PY_UNWIND and PY_THROW cannot be local events, so
+they are enabled globally while profiling: other code pays a short callback
+only when an exception leaves one of its frames or is thrown into one of its
+generators. Profiling can be started and stopped at any time while plugins
+are running.
+"""
+import gc
+import marshal
+import sys
+import threading
+import types
+from time import perf_counter_ns
+
+TOOL_NAME = "plugify.profiler"
+
+_monitoring = sys.monitoring
+_events = _monitoring.events
+_LOCAL_EVENTS = _events.PY_START | _events.PY_RESUME | _events.PY_RETURN | _events.PY_YIELD
+# Not available as local events, they only pop frames of monitored code
+_GLOBAL_EVENTS = _events.PY_UNWIND | _events.PY_THROW
+# Tried in order when no tool id is given. 3 and 4 have no assigned role, PROFILER_ID is also used by cProfile
+_TOOL_IDS = (3, 4, _monitoring.PROFILER_ID)
+
+
+def _claim_tool_id(tool_id):
+    candidates = _TOOL_IDS if tool_id is None else (tool_id,)
+    for candidate in candidates:
+        try:
+            _monitoring.use_tool_id(candidate, TOOL_NAME)
+            return candidate
+        except ValueError:
+            continue
+    holders = ", ".join(f"{candidate}: {_monitoring.get_tool(candidate)!r}" for candidate in candidates)
+    raise RuntimeError(f"{TOOL_NAME}: no free sys.monitoring tool id ({holders})")
+
+
+class _ThreadData:
+    __slots__ = ("stack", "active", "calls", "lines")
+
+    def __init__(self):
+        self.stack = []  # [code, start_ns, child_ns, is_call]
+        self.active = {}  # code -> frames on stack, for recursion
+        self.calls = {}  # code -> [cc, nc, tt_ns, ct_ns, {caller code: [cc, nc, tt_ns, ct_ns]}]
+        self.lines = {}  # (code, line) -> hits
+
+
+def _matches(module, packages):
+    if not module:
+        return False
+    for package in packages:
+        if module == package or module.startswith(package + "."):
+            return True
+    return False
+
+
+def _add_code(code, codes):
+    # Keyed by identity, equal code objects of a reloaded module are distinct for sys.monitoring
+    if id(code) in codes:
+        return
+    codes[id(code)] = code
+    for const in code.co_consts:
+        if isinstance(const, types.CodeType):
+            _add_code(const, codes)
+
+
+def _label(code):
+    return code.co_filename, code.co_firstlineno, code.co_qualname
+
+
+class Profiler:
+    """Deterministic profiler for code of the given plugin packages (plugin folder names).
+
+    tool_id picks the sys.monitoring tool id, by default the first free one of 3, 4 and PROFILER_ID.
+    start() raises RuntimeError when it is taken, e.g. by cProfile or another profiler.
+    """
+
+    def __init__(self, *packages, lines=False, tool_id=None):
+        if not packages:
+            raise ValueError("at least one plugin package is required")
+        self.packages = tuple(packages)
+        self.lines = lines
+        self.stats = {}
+        self.tool_id = tool_id
+        self._tool = None
+        self._codes = {}  # id -> code object with local events set
+        self._local = threading.local()
+        self._threads = []
+        self._lock = threading.Lock()
+        self._running = False
+
+    @property
+    def running(self):
+        return self._running
+
+    def start(self):
+        if self._running:
+            return
+        self._tool = _claim_tool_id(self.tool_id)
+        callbacks = {
+            _events.PY_START: self._on_start,
+            _events.PY_RESUME: self._on_resume,
+            _events.PY_THROW: self._on_resume,
+            _events.PY_RETURN: self._on_exit,
+            _events.PY_YIELD: self._on_exit,
+            _events.PY_UNWIND: self._on_exit,
+        }
+        if self.lines:
+            callbacks[_events.LINE] = self._on_line
+        for event, callback in callbacks.items():
+            _monitoring.register_callback(self._tool, event, callback)
+        self._running = True
+        _monitoring.set_events(self._tool, _GLOBAL_EVENTS)
+        self.refresh()
+
+    def refresh(self):
+        """Picks up code objects created since start, e.g. by lazily imported plugin modules."""
+        if not self._running:
+            return
+        codes = {}
+        for obj in gc.get_objects():
+            if isinstance(obj, types.FunctionType) and _matches(obj.__module__, self.packages):
+                _add_code(obj.__code__, codes)
+        events = _LOCAL_EVENTS | (_events.LINE if self.lines else 0)
+        for key, code in codes.items():
+            if key not in self._codes:
+                _monitoring.set_local_events(self._tool, code, events)
+        self._codes.update(codes)
+
+    def stop(self):
+        if not self._running:
+            return
+        self._running = False
+        _monitoring.set_events(self._tool, 0)
+        for code in self._codes.values():
+            _monitoring.set_local_events(self._tool, code, 0)
+        self._codes.clear()
+        for event in (_events.PY_START, _events.PY_RESUME, _events.PY_THROW, _events.PY_RETURN,
+                      _events.PY_YIELD, _events.PY_UNWIND, _events.LINE):
+            _monitoring.register_callback(self._tool, event, None)
+        _monitoring.free_tool_id(self._tool)
+        self._tool = None
+        # Frames still running will never report their exit
+        with self._lock:
+            for data in self._threads:
+                data.stack.clear()
+                data.active.clear()
+
+    def clear(self):
+        with self._lock:
+            for data in self._threads:
+                data.calls.clear()
+                data.lines.clear()
+        self.stats = {}
+
+    def __enter__(self):
+        self.start()
+        return self
+
+    def __exit__(self, *exc):
+        self.stop()
+
+    def _data(self):
+        try:
+            return self._local.data
+        except AttributeError:
+            data = self._local.data = _ThreadData()
+            with self._lock:
+                self._threads.append(data)
+            return data
+
+    def _push(self, code, is_call):
+        data = self._data()
+        data.stack.append([code, perf_counter_ns(), 0, is_call])
+        data.active[code] = data.active.get(code, 0) + 1
+
+    def _on_start(self, code, offset):
+        self._push(code, True)
+
+    def _on_resume(self, code, offset, *args):
+        if id(code) in self._codes:
+            self._push(code, False)
+
+    def _on_exit(self, code, offset, value):
+        end = perf_counter_ns()
+        data = self._data()
+        stack = data.stack
+        if not stack or stack[-1][0] is not code:
+            return
+        _, start, child, is_call = stack.pop()
+        elapsed = end - start
+        depth = data.active[code] - 1
+        data.active[code] = depth
+        outermost = depth == 0
+
+        stat = data.calls.get(code)
+        if stat is None:
+            stat = data.calls[code] = [0, 0, 0, 0, {}]
+        if is_call:
+            stat[1] += 1
+            if outermost:
+                stat[0] += 1
+        stat[2] += elapsed - child
+        if outermost:
+            stat[3] += elapsed
+
+        if stack:
+            parent = stack[-1]
+            parent[2] += elapsed
+            edge = stat[4].get(parent[0])
+            if edge is None:
+                edge = stat[4][parent[0]] = [0, 0, 0, 0]
+            if is_call:
+                edge[1] += 1
+                if outermost:
+                    edge[0] += 1
+            edge[2] += elapsed - child
+            if outermost:
+                edge[3] += elapsed
+
+    def _on_line(self, code, line):
+        lines = self._data().lines
+        key = (code, line)
+        lines[key] = lines.get(key, 0) + 1
+
+    # pstats.Stats(profiler) calls create_stats() and reads .stats
+
+    def create_stats(self):
+        merged = {}
+        with self._lock:
+            threads = list(self._threads)
+        for data in threads:
+            for code, (cc, nc, tt, ct, callers) in list(data.calls.items()):
+                entry = merged.setdefault(code, [0, 0, 0, 0, {}])
+                entry[0] += cc
+                entry[1] += nc
+                entry[2] += tt
+                entry[3] += ct
+                for caller, edge in list(callers.items()):
+                    total = entry[4].setdefault(caller, [0, 0, 0, 0])
+                    for i in range(4):
+                        total[i] += edge[i]
+        self.stats = {
+            _label(code): (cc, nc, tt / 1e9, ct / 1e9, {
+                _label(caller): (ecc, enc, ett / 1e9, ect / 1e9) for caller, (ecc, enc, ett, ect) in callers.items()
+            })
+            for code, (cc, nc, tt, ct, callers) in merged.items()
+        }
+
+    def dump_stats(self, path):
+        """Writes marshal file readable by pstats.Stats(path) and snakeviz-like tools."""
+        self.create_stats()
+        with open(path, "wb") as file:
+            marshal.dump(self.stats, file)
+
+    def print_stats(self, sort=-1):
+        import pstats
+        pstats.Stats(self).strip_dirs().sort_stats(sort).print_stats()
+
+    def line_stats(self):
+        """Returns {(filename, line): hits}, empty unless created with lines=True."""
+        result = {}
+        with self._lock:
+            threads = list(self._threads)
+        for data in threads:
+            for (code, line), hits in list(data.lines.items()):
+                key = (code.co_filename, line)
+                result[key] = result.get(key, 0) + hits
+        return result
+
+
+_active = None
+
+
+def enable(*packages, lines=False, tool_id=None):
+    """Starts profiling the given plugin packages, replacing previous session. Returns the profiler."""
+    global _active
+    disable()
+    profiler = Profiler(*packages, lines=lines, tool_id=tool_id)
+    profiler.start()
+    _active = profiler
+    return profiler
+
+
+def disable():
+    """Stops current session and returns its profiler (None when not profiling), results stay readable."""
+    global _active
+    profiler, _active = _active, None
+    if profiler is not None:
+        profiler.stop()
+    return profiler
+
+
+def current():
+    return _active
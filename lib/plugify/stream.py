@@ -0,0 +1,38 @@
+"""Chunked exchange of large sequences with native functions.
+
+Arrays cross the language boundary as whole native vectors. These helpers
+split the exchange into fixed-size chunks, so only one chunk is alive on
+either side at a time.
+"""
+from itertools import islice
+
+DEFAULT_CHUNK_SIZE = 4096
+
+
+def feed(consumer, iterable, *args, chunk_size=DEFAULT_CHUNK_SIZE):
+    """Calls consumer(chunk, *args) for consecutive chunks of iterable. Returns number of items sent."""
+    if chunk_size <= 0:
+        raise ValueError("chunk_size must be positive")
+    iterator = iter(iterable)
+    total = 0
+    while True:
+        chunk = tuple(islice(iterator, chunk_size))
+        if not chunk:
+            return total
+        consumer(chunk, *args)
+        total += len(chunk)
+
+
+def chunks(producer, *args):
+    """Yields arrays returned by producer(*args) until it returns an empty one."""
+    while True:
+        chunk = producer(*args)
+        if not chunk:
+            return
+        yield chunk
+
+
+def items(producer, *args):
+    """Yields items of arrays returned by producer(*args) until it returns an empty one."""
+    for chunk in chunks(producer, *args):
+        yield from chunk
@@ -0,0 +1,304 @@
+#include "admission.h"
+#include <algorithm>
+#include <vector>
+
+namespace py3lm {
+	Admission::Entry* Admission::Register(const std::string& plugin, const std::string& method) {
+		std::lock_guard lock(_mutex);
+		return &_entries.emplace_back(&GetBudget(plugin, {}), &GetBudget(plugin, method));
+	}
+
+	// Must be called with _mutex held
+	Admission::Budget& Admission::GetBudget(const std::string& plugin, const std::string& method) {
+		auto it = _index.find({ plugin, method });
+		if (it == _index.end()) {
+			Budget& budget = _budgets.emplace_back();
+			budget.plugin = plugin;
+			budget.method = method;
+			it = _index.emplace(std::pair{ plugin, method }, &budget).first;
+		}
+		return *it->second;
+	}
+
+	void Admission::SetPolicy(const std::string& plugin, const std::string& method, const Py3lmAdmissionPolicy& policy) {
+		std::lock_guard lock(_mutex);
+		Budget& budget = GetBudget(plugin, method);
+		const bool had = budget.HasPolicy();
+		budget.maxCalls.store(policy.maxCallsPerTick, std::memory_order_relaxed);
+		budget.maxNs.store(policy.maxNsPerTick, std::memory_order_relaxed);
+		budget.breakerErrors.store(policy.breakerErrors, std::memory_order_relaxed);
+		budget.breakerTicks.store(std::max<uint32_t>(policy.breakerTicks, 1), std::memory_order_relaxed);
+		const bool has = budget.HasPolicy();
+		if (has && !had) {
+			_policies.fetch_add(1, std::memory_order_relaxed);
+		}
+		else if (had && !has) {
+			_policies.fetch_sub(1, std::memory_order_relaxed);
+			budget.openUntil.store(0, std::memory_order_relaxed);
+			budget.consecutiveErrors.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	void Admission::Refresh(Budget& budget, uint64_t tick) {
+		uint64_t seen = budget.tick.load(std::memory_order_relaxed);
+		if (seen != tick && budget.tick.compare_exchange_strong(seen, tick, std::memory_order_relaxed)) {
+			budget.tickCalls.store(0, std::memory_order_relaxed);
+			budget.tickNs.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	Admission::Decision Admission::Check(Budget& budget, uint64_t tick) {
+		if (!budget.HasPolicy()) {
+			return Decision::Admitted;
+		}
+		Refresh(budget, tick);
+		if (budget.openUntil.load(std::memory_order_relaxed) > tick) {
+			budget.shedBreaker.fetch_add(1, std::memory_order_relaxed);
+			return Decision::ShedBreaker;
+		}
+		const uint64_t maxNs = budget.maxNs.load(std::memory_order_relaxed);
+		if (maxNs && budget.tickNs.load(std::memory_order_relaxed) >= maxNs) {
+			budget.shedTime.fetch_add(1, std::memory_order_relaxed);
+			return Decision::ShedTime;
+		}
+		return Decision::Admitted;
+	}
+
+	// Takes one call of the tick budget, false once it is used up
+	bool Admission::Reserve(Budget& budget) {
+		const uint32_t maxCalls = budget.maxCalls.load(std::memory_order_relaxed);
+		if (!maxCalls) {
+			return true;
+		}
+		uint32_t calls = budget.tickCalls.load(std::memory_order_relaxed);
+		do {
+			if (calls >= maxCalls) {
+				budget.shedCalls.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+		} while (!budget.tickCalls.compare_exchange_weak(calls, calls + 1, std::memory_order_relaxed));
+		return true;
+	}
+
+	// Gives back a call taken by Reserve, the tick may have been reset in between
+	void Admission::Unreserve(Budget& budget) {
+		if (!budget.maxCalls.load(std::memory_order_relaxed)) {
+			return;
+		}
+		uint32_t calls = budget.tickCalls.load(std::memory_order_relaxed);
+		while (calls && !budget.tickCalls.compare_exchange_weak(calls, calls - 1, std::memory_order_relaxed)) {
+		}
+	}
+
+	Admission::Decision Admission::Admit(Entry& entry) {
+		if (_policies.load(std::memory_order_relaxed) == 0) {
+			return Decision::Admitted;
+		}
+		const uint64_t tick = _tick.load(std::memory_order_relaxed);
+		for (Budget* const budget : { entry.plugin, entry.method }) {
+			if (const Decision decision = Check(*budget, tick); decision != Decision::Admitted) {
+				return decision;
+			}
+		}
+		// Calls are counted only once neither budget sheds, a call shed by its method keeps the plugin budget
+		if (!Reserve(*entry.plugin)) {
+			return Decision::ShedCalls;
+		}
+		if (!Reserve(*entry.method)) {
+			Unreserve(*entry.plugin);
+			return Decision::ShedCalls;
+		}
+		return Decision::Admitted;
+	}
+
+	bool Admission::IsTimed(const Entry& entry) const {
+		return _policies.load(std::memory_order_relaxed) != 0 && (entry.plugin->maxNs.load(std::memory_order_relaxed) || entry.method->maxNs.load(std::memory_order_relaxed));
+	}
+
+	// Returns true when this call opened the breaker
+	bool Admission::Finish(Budget& budget, uint64_t ns, bool error, uint64_t tick) {
+		if (!budget.HasPolicy()) {
+			return false;
+		}
+		budget.calls.fetch_add(1, std::memory_order_relaxed);
+		if (ns) {
+			budget.tickNs.fetch_add(ns, std::memory_order_relaxed);
+		}
+		if (!error) {
+			budget.consecutiveErrors.store(0, std::memory_order_relaxed);
+			return false;
+		}
+		budget.errors.fetch_add(1, std::memory_order_relaxed);
+		const uint32_t threshold = budget.breakerErrors.load(std::memory_order_relaxed);
+		const uint32_t errors = budget.consecutiveErrors.fetch_add(1, std::memory_order_relaxed) + 1;
+		if (!threshold || errors < threshold) {
+			return false;
+		}
+		// A failed trial call after the cooldown opens it again
+		budget.openUntil.store(tick + budget.breakerTicks.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		return errors == threshold;
+	}
+
+	void Admission::Complete(Entry& entry, std::chrono::steady_clock::time_point start, bool error) {
+		if (_policies.load(std::memory_order_relaxed) == 0) {
+			return;
+		}
+		const uint64_t tick = _tick.load(std::memory_order_relaxed);
+		const uint64_t ns = start == std::chrono::steady_clock::time_point{} ? 0 : static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+		for (Budget* const budget : { entry.plugin, entry.method }) {
+			if (Finish(*budget, ns, error, tick) && _breakerHandler) {
+				_breakerHandler(budget->plugin, budget->method);
+			}
+		}
+	}
+
+	size_t Admission::Snapshot(Py3lmAdmissionStats* stats, size_t count) const {
+		std::lock_guard lock(_mutex);
+		// Budgets of methods without a policy are left out
+		const auto reported = [](const Budget& budget) {
+			return budget.HasPolicy() || budget.calls.load(std::memory_order_relaxed);
+		};
+		if (!stats) {
+			return static_cast<size_t>(std::count_if(_budgets.begin(), _budgets.end(), reported));
+		}
+		const uint64_t tick = _tick.load(std::memory_order_relaxed);
+		size_t size = 0;
+		for (const Budget& budget : _budgets) {
+			if (size == count) {
+				break;
+			}
+			if (!reported(budget)) {
+				continue;
+			}
+			Py3lmAdmissionStats& out = stats[size++];
+			out.plugin = budget.plugin.c_str();
+			out.method = budget.method.c_str();
+			out.policy.maxCallsPerTick = budget.maxCalls.load(std::memory_order_relaxed);
+			out.policy.maxNsPerTick = budget.maxNs.load(std::memory_order_relaxed);
+			out.policy.breakerErrors = budget.breakerErrors.load(std::memory_order_relaxed);
+			out.policy.breakerTicks = budget.breakerTicks.load(std::memory_order_relaxed);
+			out.calls = budget.calls.load(std::memory_order_relaxed);
+			out.errors = budget.errors.load(std::memory_order_relaxed);
+			out.shedCalls = budget.shedCalls.load(std::memory_order_relaxed);
+			out.shedTime = budget.shedTime.load(std::memory_order_relaxed);
+			out.shedBreaker = budget.shedBreaker.load(std::memory_order_relaxed);
+			out.breakerOpen = budget.openUntil.load(std::memory_order_relaxed) > tick;
+		}
+		return size;
+	}
+
+	void Admission::Reset() {
+		std::lock_guard lock(_mutex);
+		for (Budget& budget : _budgets) {
+			budget.tickCalls.store(0, std::memory_order_relaxed);
+			budget.tickNs.store(0, std::memory_order_relaxed);
+			budget.consecutiveErrors.store(0, std::memory_order_relaxed);
+			budget.openUntil.store(0, std::memory_order_relaxed);
+			budget.calls.store(0, std::memory_order_relaxed);
+			budget.errors.store(0, std::memory_order_relaxed);
+			budget.shedCalls.store(0, std::memory_order_relaxed);
+			budget.shedTime.store(0, std::memory_order_relaxed);
+			budget.shedBreaker.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	void Admission::Clear() {
+		std::lock_guard lock(_mutex);
+		_entries.clear();
+		_index.clear();
+		_budgets.clear();
+		_policies.store(0, std::memory_order_relaxed);
+	}
+
+	namespace {
+		Admission* s_admission = nullptr;
+
+		PyObject* Admission_set_policy(PyObject* /*self*/, PyObject* args, PyObject* kwargs) {
+			static const char* kKeywords[] = { "plugin", "method", "max_calls", "max_ms", "breaker_errors", "breaker_ticks", nullptr };
+			const char* plugin;
+			const char* method = nullptr;
+			unsigned int maxCalls = 0;
+			double maxMs = 0.0;
+			unsigned int breakerErrors = 0;
+			unsigned int breakerTicks = 0;
+			if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|zIdII:set_policy", const_cast<char**>(kKeywords), &plugin, &method, &maxCalls, &maxMs, &breakerErrors, &breakerTicks)) {
+				return nullptr;
+			}
+			if (maxMs < 0.0) {
+				PyErr_SetString(PyExc_ValueError, "max_ms must not be negative");
+				return nullptr;
+			}
+			const Py3lmAdmissionPolicy policy{ maxCalls, static_cast<uint64_t>(maxMs * 1e6), breakerErrors, breakerTicks };
+			s_admission->SetPolicy(plugin, method ? method : "", policy);
+			Py_RETURN_NONE;
+		}
+
+		PyObject* Admission_clear_policy(PyObject* /*self*/, PyObject* args) {
+			const char* plugin;
+			const char* method = nullptr;
+			if (!PyArg_ParseTuple(args, "s|z:clear_policy", &plugin, &method)) {
+				return nullptr;
+			}
+			s_admission->SetPolicy(plugin, method ? method : "", Py3lmAdmissionPolicy{});
+			Py_RETURN_NONE;
+		}
+
+		PyObject* Admission_tick(PyObject* /*self*/, PyObject* /*args*/) {
+			s_admission->Tick();
+			Py_RETURN_NONE;
+		}
+
+		PyObject* Admission_reset(PyObject* /*self*/, PyObject* /*args*/) {
+			s_admission->Reset();
+			Py_RETURN_NONE;
+		}
+
+		PyObject* Admission_stats(PyObject* /*self*/, PyObject* /*args*/) {
+			std::vector<Py3lmAdmissionStats> stats(s_admission->Snapshot(nullptr, 0));
+			stats.resize(s_admission->Snapshot(stats.data(), stats.size()));
+			PyObject* const result = PyDict_New();
+			if (!result) {
+				return nullptr;
+			}
+			for (const auto& entry : stats) {
+				PyObject* const key = *entry.method ? Py_BuildValue("(ss)", entry.plugin, entry.method) : Py_BuildValue("(sO)", entry.plugin, Py_None);
+				PyObject* const value = Py_BuildValue("(KKKKKO)", entry.calls, entry.errors, entry.shedCalls, entry.shedTime, entry.shedBreaker, entry.breakerOpen ? Py_True : Py_False);
+				if (!key || !value || PyDict_SetItem(result, key, value) != 0) {
+					Py_XDECREF(key);
+					Py_XDECREF(value);
+					Py_DECREF(result);
+					return nullptr;
+				}
+				Py_DECREF(key);
+				Py_DECREF(value);
+			}
+			return result;
+		}
+
+		PyMethodDef s_admissionMethods[] = {
+			{ "set_policy", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(Admission_set_policy)), METH_VARARGS | METH_KEYWORDS, "set_policy(plugin, method=None, max_calls=0, max_ms=0, breaker_errors=0, breaker_ticks=0) - limits per tick, 0 disables a limit" },
+			{ "clear_policy", Admission_clear_policy, METH_VARARGS, "clear_policy(plugin, method=None) - remove limits" },
+			{ "tick", Admission_tick, METH_NOARGS, "tick() - start a new tick" },
+			{ "reset", Admission_reset, METH_NOARGS, "reset() - zero counters and close breakers" },
+			{ "stats", Admission_stats, METH_NOARGS, "stats() - {(plugin, method): (calls, errors, shed_calls, shed_time, shed_breaker, breaker_open)}" },
+			{ nullptr, nullptr, 0, nullptr }
+		};
+
+		PyModuleDef s_admissionModule = {
+			PyModuleDef_HEAD_INIT,
+			"plugify.admission",
+			"Admission control of native calls into Python plugins",
+			-1,
+			s_admissionMethods,
+			nullptr,
+			nullptr,
+			nullptr,
+			nullptr
+		};
+	}
+
+	PyObject* CreateAdmissionModule(Admission& admission) {
+		s_admission = &admission;
+		return PyModule_Create(&s_admissionModule);
+	}
+}
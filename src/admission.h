@@ -0,0 +1,123 @@
+#pragma once
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+extern "C" {
+	// Zero disables a limit
+	struct Py3lmAdmissionPolicy {
+		uint32_t maxCallsPerTick;
+		uint64_t maxNsPerTick; // time spent inside the Python callback, GIL wait excluded
+		uint32_t breakerErrors; // consecutive failed calls that open the circuit breaker
+		uint32_t breakerTicks; // ticks the breaker stays open before the next trial call
+	};
+
+	struct Py3lmAdmissionStats {
+		const char* plugin;
+		const char* method; // empty for the plugin-wide budget
+		Py3lmAdmissionPolicy policy;
+		uint64_t calls;
+		uint64_t errors;
+		uint64_t shedCalls; // over maxCallsPerTick
+		uint64_t shedTime; // over maxNsPerTick
+		uint64_t shedBreaker; // while the breaker was open
+		bool breakerOpen;
+	};
+}
+
+namespace py3lm {
+	// Admission control of native -> Python calls, per plugin and per exported method.
+	// Budgets are counted per tick, started by the host through TickAdmission() once per frame.
+	// A shed call does not enter Python, the caller gets the default return value
+	class Admission {
+	public:
+		enum class Decision {
+			Admitted,
+			ShedCalls,
+			ShedTime,
+			ShedBreaker
+		};
+
+		struct Budget {
+			std::string plugin;
+			std::string method;
+			std::atomic<uint32_t> maxCalls{};
+			std::atomic<uint64_t> maxNs{};
+			std::atomic<uint32_t> breakerErrors{};
+			std::atomic<uint32_t> breakerTicks{};
+			// Tick the per-tick counters belong to, reset lazily on the first call of a new tick
+			std::atomic<uint64_t> tick{};
+			std::atomic<uint32_t> tickCalls{};
+			std::atomic<uint64_t> tickNs{};
+			std::atomic<uint32_t> consecutiveErrors{};
+			std::atomic<uint64_t> openUntil{};
+			std::atomic<uint64_t> calls{};
+			std::atomic<uint64_t> errors{};
+			std::atomic<uint64_t> shedCalls{};
+			std::atomic<uint64_t> shedTime{};
+			std::atomic<uint64_t> shedBreaker{};
+
+			bool HasPolicy() const {
+				return maxCalls.load(std::memory_order_relaxed) || maxNs.load(std::memory_order_relaxed) || breakerErrors.load(std::memory_order_relaxed);
+			}
+		};
+
+		// Budgets one exported method is checked against
+		struct Entry {
+			Budget* plugin;
+			Budget* method;
+		};
+
+		using BreakerHandler = std::function<void(const std::string& plugin, const std::string& method)>;
+
+		Entry* Register(const std::string& plugin, const std::string& method);
+		void SetPolicy(const std::string& plugin, const std::string& method, const Py3lmAdmissionPolicy& policy);
+		void SetBreakerHandler(BreakerHandler handler) { _breakerHandler = std::move(handler); }
+
+		// Called before the GIL is taken
+		Decision Admit(Entry& entry);
+		// Whether a time budget applies, the call is then timed from GIL acquisition
+		bool IsTimed(const Entry& entry) const;
+		// Default start means the call was not timed
+		void Complete(Entry& entry, std::chrono::steady_clock::time_point start, bool error);
+
+		void Tick() { _tick.fetch_add(1, std::memory_order_relaxed); }
+		size_t Snapshot(Py3lmAdmissionStats* stats, size_t count) const;
+		void Reset();
+		void Clear();
+
+	private:
+		Budget& GetBudget(const std::string& plugin, const std::string& method);
+		void Refresh(Budget& budget, uint64_t tick);
+		Decision Check(Budget& budget, uint64_t tick);
+		bool Reserve(Budget& budget);
+		void Unreserve(Budget& budget);
+		bool Finish(Budget& budget, uint64_t ns, bool error, uint64_t tick);
+
+		mutable std::mutex _mutex;
+		std::deque<Budget> _budgets;
+		std::map<std::pair<std::string, std::string>, Budget*> _index;
+		std::deque<Entry> _entries;
+		std::atomic<uint64_t> _tick{ 1 };
+		// Number of budgets with a policy, admission is skipped entirely while zero
+		std::atomic<uint32_t> _policies{};
+		BreakerHandler _breakerHandler;
+	};
+
+	// Creates 'plugify.admission' module:
+	//   set_policy(plugin, method=None, max_calls=0, max_ms=0, breaker_errors=0, breaker_ticks=0)
+	//   clear_policy(plugin, method=None)
+	//   tick()   - start a new tick, for hosts driving the loop from Python
+	//   stats()  - {(plugin, method): (calls, errors, shed_calls, shed_time, shed_breaker, breaker_open)}
+	//   reset()  - zero counters, policies stay
+	PyObject* CreateAdmissionModule(Admission& admission);
+}
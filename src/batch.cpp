@@ -0,0 +1,583 @@
+#include "batch.h"
+#include <cstring>
+#include <vector>
+
+namespace py3lm {
+	namespace {
+		// Keeps native column memory borrowed while Python still exports any column of a batch
+		struct BatchLease {
+			Py3lmBatchRelease release;
+			void* user;
+			Py_ssize_t exports;
+			bool dispatched;
+		};
+
+		void ReturnLease(BatchLease* lease) {
+			if (lease->release) {
+				lease->release(lease->user);
+			}
+			delete lease;
+		}
+
+		struct BatchObject {
+			PyObject_HEAD
+			const Py3lmBatchColumn* columns;
+			size_t columnCount;
+			size_t rows;
+			Py3lmBatchCommit commit;
+			void* user;
+			PyObject* name;
+			// Column name -> view, created on first access and released when the batch ends
+			PyObject* views;
+			BatchLease* lease;
+			bool released;
+		};
+
+		PyTypeObject* s_batchType = nullptr;
+		// Batch name -> list of handlers
+		PyObject* s_handlers = nullptr;
+		char s_emptyColumn[sizeof(float) * 3]{};
+
+		bool IsValidType(uint32_t type) {
+			return type <= kPy3lmColumnString;
+		}
+
+		BatchObject* CheckBatch(PyObject* self) {
+			auto* const batch = reinterpret_cast<BatchObject*>(self);
+			if (batch->released) {
+				PyErr_SetString(PyExc_RuntimeError, "Batch is only valid inside its handler");
+				return nullptr;
+			}
+			return batch;
+		}
+
+		const Py3lmBatchColumn* FindColumn(const BatchObject* batch, PyObject* name, uint32_t* index = nullptr) {
+			const char* const key = PyUnicode_Check(name) ? PyUnicode_AsUTF8(name) : nullptr;
+			if (!key) {
+				if (!PyErr_Occurred()) {
+					PyErr_SetString(PyExc_TypeError, "Column name must be a string");
+				}
+				return nullptr;
+			}
+			for (size_t i = 0; i < batch->columnCount; ++i) {
+				if (std::strcmp(batch->columns[i].name, key) == 0) {
+					if (index) {
+						*index = static_cast<uint32_t>(i);
+					}
+					return &batch->columns[i];
+				}
+			}
+			PyErr_Format(PyExc_KeyError, "Batch has no column '%s'", key);
+			return nullptr;
+		}
+
+		// Buffer exporter over native column memory, counts exports so the memory is returned only when none is left
+		struct ColumnObject {
+			PyObject_HEAD
+			BatchLease* lease;
+			void* data;
+			Py_ssize_t shape[2];
+			Py_ssize_t itemSize;
+			const char* format;
+			int ndim;
+			bool readonly;
+			bool released;
+			Py_ssize_t exports;
+		};
+
+		PyTypeObject* s_columnType = nullptr;
+
+		int Column_getbuffer(PyObject* self, Py_buffer* view, int flags) {
+			auto* const column = reinterpret_cast<ColumnObject*>(self);
+			if (column->released) {
+				PyErr_SetString(PyExc_BufferError, "Batch column is no longer valid");
+				return -1;
+			}
+			if ((flags & PyBUF_WRITABLE) && column->readonly) {
+				PyErr_SetString(PyExc_BufferError, "Batch column is read-only");
+				return -1;
+			}
+			view->buf = column->data;
+			view->obj = Py_NewRef(self);
+			view->len = column->shape[0] * (column->ndim > 1 ? column->shape[1] : 1) * column->itemSize;
+			view->itemsize = column->itemSize;
+			view->readonly = column->readonly;
+			view->ndim = column->ndim;
+			view->format = (flags & PyBUF_FORMAT) ? const_cast<char*>(column->format) : nullptr;
+			view->shape = (flags & PyBUF_ND) ? column->shape : nullptr;
+			// Columns are C-contiguous
+			view->strides = nullptr;
+			view->suboffsets = nullptr;
+			view->internal = nullptr;
+			++column->exports;
+			++column->lease->exports;
+			return 0;
+		}
+
+		void Column_releasebuffer(PyObject* self, Py_buffer* /*view*/) {
+			auto* const column = reinterpret_cast<ColumnObject*>(self);
+			--column->exports;
+			BatchLease* const lease = column->lease;
+			if (--lease->exports == 0 && lease->dispatched) {
+				// Last view kept past the handler is gone
+				ReturnLease(lease);
+			}
+		}
+
+		void Column_dealloc(PyObject* self) {
+			PyTypeObject* const type = Py_TYPE(self);
+			type->tp_free(self);
+			Py_DECREF(type);
+		}
+
+		PyType_Slot s_columnSlots[] = {
+			{ Py_tp_dealloc, reinterpret_cast<void*>(Column_dealloc) },
+			{ Py_bf_getbuffer, reinterpret_cast<void*>(Column_getbuffer) },
+			{ Py_bf_releasebuffer, reinterpret_cast<void*>(Column_releasebuffer) },
+			{ 0, nullptr }
+		};
+
+		PyType_Spec s_columnSpec = {
+			"plugify.batch.Column",
+			sizeof(ColumnObject),
+			0,
+			Py_TPFLAGS_DEFAULT | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+			s_columnSlots
+		};
+
+		PyObject* CreateView(BatchLease* lease, void* data, Py_ssize_t count, Py_ssize_t width, const char* format, Py_ssize_t itemSize, bool readonly) {
+			auto* const column = PyObject_New(ColumnObject, s_columnType);
+			if (!column) {
+				return nullptr;
+			}
+			column->lease = lease;
+			// Memoryview needs a non-null buffer even for an empty column
+			column->data = count ? data : s_emptyColumn;
+			column->shape[0] = count;
+			column->shape[1] = width;
+			column->itemSize = itemSize;
+			column->format = format;
+			column->ndim = width > 1 ? 2 : 1;
+			column->readonly = readonly;
+			column->released = false;
+			column->exports = 0;
+			PyObject* const view = PyMemoryView_FromObject(reinterpret_cast<PyObject*>(column));
+			Py_DECREF(column);
+			return view;
+		}
+
+		PyObject* CreateColumnView(BatchLease* lease, const Py3lmBatchColumn& column, size_t rows) {
+			const auto count = static_cast<Py_ssize_t>(rows);
+			const bool readonly = column.writable == 0;
+			switch (column.type) {
+				case kPy3lmColumnInt32:
+					return CreateView(lease, column.data, count, 1, "i", sizeof(int32_t), readonly);
+				case kPy3lmColumnFloat:
+					return CreateView(lease, column.data, count, 1, "f", sizeof(float), readonly);
+				case kPy3lmColumnVector3:
+					return CreateView(lease, column.data, count, 3, "f", sizeof(float), readonly);
+				case kPy3lmColumnString: {
+					const auto* const offsets = static_cast<const uint32_t*>(column.data);
+					PyObject* const offsetsView = CreateView(lease, column.data, count + 1, 1, "I", sizeof(uint32_t), true);
+					if (!offsetsView) {
+						return nullptr;
+					}
+					PyObject* const textView = CreateView(lease, const_cast<char*>(column.text), static_cast<Py_ssize_t>(offsets[rows]), 1, "B", 1, true);
+					if (!textView) {
+						Py_DECREF(offsetsView);
+						return nullptr;
+					}
+					PyObject* const pair = PyTuple_Pack(2, offsetsView, textView);
+					Py_DECREF(offsetsView);
+					Py_DECREF(textView);
+					return pair;
+				}
+				default:
+					PyErr_SetString(PyExc_RuntimeError, "Unsupported column type");
+					return nullptr;
+			}
+		}
+
+		PyObject* Batch_subscript(PyObject* self, PyObject* key) {
+			BatchObject* const batch = CheckBatch(self);
+			if (!batch) {
+				return nullptr;
+			}
+			if (PyObject* const cached = PyDict_GetItemWithError(batch->views, key)) {
+				return Py_NewRef(cached);
+			}
+			if (PyErr_Occurred()) {
+				return nullptr;
+			}
+			const Py3lmBatchColumn* const column = FindColumn(batch, key);
+			if (!column) {
+				return nullptr;
+			}
+			PyObject* const view = CreateColumnView(batch->lease, *column, batch->rows);
+			if (!view) {
+				return nullptr;
+			}
+			if (PyDict_SetItem(batch->views, key, view) != 0) {
+				Py_DECREF(view);
+				return nullptr;
+			}
+			return view;
+		}
+
+		PyObject* Batch_string(PyObject* self, PyObject* const* args, Py_ssize_t nargs) {
+			BatchObject* const batch = CheckBatch(self);
+			if (!batch) {
+				return nullptr;
+			}
+			if (nargs != 2) {
+				PyErr_SetString(PyExc_TypeError, "string(name, row) takes 2 arguments");
+				return nullptr;
+			}
+			const Py3lmBatchColumn* const column = FindColumn(batch, args[0]);
+			if (!column) {
+				return nullptr;
+			}
+			if (column->type != kPy3lmColumnString) {
+				PyErr_SetString(PyExc_TypeError, "Column is not a string column");
+				return nullptr;
+			}
+			const Py_ssize_t row = PyLong_AsSsize_t(args[1]);
+			if (row == -1 && PyErr_Occurred()) {
+				return nullptr;
+			}
+			if (row < 0 || static_cast<size_t>(row) >= batch->rows) {
+				PyErr_SetString(PyExc_IndexError, "Row out of range");
+				return nullptr;
+			}
+			const auto* const offsets = static_cast<const uint32_t*>(column->data);
+			return PyUnicode_DecodeUTF8(column->text + offsets[row], static_cast<Py_ssize_t>(offsets[row + 1] - offsets[row]), "replace");
+		}
+
+		PyObject* Batch_commit(PyObject* self, PyObject* const* args, Py_ssize_t nargs) {
+			BatchObject* const batch = CheckBatch(self);
+			if (!batch) {
+				return nullptr;
+			}
+			std::vector<uint32_t> indices;
+			if (nargs == 0) {
+				for (size_t i = 0; i < batch->columnCount; ++i) {
+					if (batch->columns[i].writable && batch->columns[i].type != kPy3lmColumnString) {
+						indices.push_back(static_cast<uint32_t>(i));
+					}
+				}
+			}
+			else {
+				indices.reserve(static_cast<size_t>(nargs));
+				for (Py_ssize_t i = 0; i < nargs; ++i) {
+					uint32_t index;
+					const Py3lmBatchColumn* const column = FindColumn(batch, args[i], &index);
+					if (!column) {
+						return nullptr;
+					}
+					if (!column->writable || column->type == kPy3lmColumnString) {
+						PyErr_Format(PyExc_ValueError, "Column '%s' is read-only", column->name);
+						return nullptr;
+					}
+					indices.push_back(index);
+				}
+			}
+			if (batch->commit && !indices.empty()) {
+				batch->commit(batch->user, indices.data(), indices.size());
+			}
+			Py_RETURN_NONE;
+		}
+
+		PyObject* Batch_name(PyObject* self, void* /*closure*/) {
+			return Py_NewRef(reinterpret_cast<BatchObject*>(self)->name);
+		}
+
+		PyObject* Batch_rows(PyObject* self, void* /*closure*/) {
+			BatchObject* const batch = CheckBatch(self);
+			return batch ? PyLong_FromSize_t(batch->rows) : nullptr;
+		}
+
+		PyObject* Batch_columns(PyObject* self, void* /*closure*/) {
+			BatchObject* const batch = CheckBatch(self);
+			if (!batch) {
+				return nullptr;
+			}
+			PyObject* const names = PyTuple_New(static_cast<Py_ssize_t>(batch->columnCount));
+			if (!names) {
+				return nullptr;
+			}
+			for (size_t i = 0; i < batch->columnCount; ++i) {
+				PyObject* const name = PyUnicode_FromString(batch->columns[i].name);
+				if (!name) {
+					Py_DECREF(names);
+					return nullptr;
+				}
+				PyTuple_SET_ITEM(names, static_cast<Py_ssize_t>(i), name);
+			}
+			return names;
+		}
+
+		PyObject* Batch_repr(PyObject* self) {
+			const auto* const batch = reinterpret_cast<BatchObject*>(self);
+			if (batch->released) {
+				return PyUnicode_FromFormat("<plugify.batch.Batch %R released>", batch->name);
+			}
+			return PyUnicode_FromFormat("<plugify.batch.Batch %R rows=%zu columns=%zu>", batch->name, batch->rows, batch->columnCount);
+		}
+
+		void Batch_dealloc(PyObject* self) {
+			PyTypeObject* const type = Py_TYPE(self);
+			auto* const batch = reinterpret_cast<BatchObject*>(self);
+			Py_XDECREF(batch->name);
+			Py_XDECREF(batch->views);
+			type->tp_free(self);
+			Py_DECREF(type);
+		}
+
+		PyMethodDef s_batchMethods[] = {
+			{ "commit", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(Batch_commit)), METH_FASTCALL, "commit(*names) - hand written columns back to native side, all writable columns without names" },
+			{ "string", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(Batch_string)), METH_FASTCALL, "string(name, row) - decode one value of a string column" },
+			{ nullptr, nullptr, 0, nullptr }
+		};
+
+		PyGetSetDef s_batchGetSet[] = {
+			{ "name", Batch_name, nullptr, "Name the batch was published under", nullptr },
+			{ "rows", Batch_rows, nullptr, "Number of rows", nullptr },
+			{ "columns", Batch_columns, nullptr, "Tuple of column names", nullptr },
+			{ nullptr, nullptr, nullptr, nullptr, nullptr }
+		};
+
+		PyType_Slot s_batchSlots[] = {
+			{ Py_tp_dealloc, reinterpret_cast<void*>(Batch_dealloc) },
+			{ Py_tp_repr, reinterpret_cast<void*>(Batch_repr) },
+			{ Py_mp_subscript, reinterpret_cast<void*>(Batch_subscript) },
+			{ Py_tp_methods, s_batchMethods },
+			{ Py_tp_getset, s_batchGetSet },
+			{ 0, nullptr }
+		};
+
+		PyType_Spec s_batchSpec = {
+			"plugify.batch.Batch",
+			sizeof(BatchObject),
+			0,
+			Py_TPFLAGS_DEFAULT | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+			s_batchSlots
+		};
+
+		// No new exports once released, the view itself fails to release while arrays derived from it are alive
+		void ReleaseView(PyObject* view) {
+			reinterpret_cast<ColumnObject*>(PyMemoryView_GET_BUFFER(view)->obj)->released = true;
+			PyObject* const result = PyObject_CallMethod(view, "release", nullptr);
+			if (result) {
+				Py_DECREF(result);
+			}
+			else {
+				PyErr_Clear();
+			}
+		}
+
+		// Python must not reach column memory after the handler returns. Memory still exported by views
+		// kept past the handler stays borrowed, and is returned to the native side when the last one is dropped
+		void ReleaseBatch(BatchObject* batch) {
+			batch->released = true;
+			batch->columns = nullptr;
+			batch->columnCount = 0;
+			PyObject* key;
+			PyObject* value;
+			Py_ssize_t pos = 0;
+			while (PyDict_Next(batch->views, &pos, &key, &value)) {
+				const Py_ssize_t count = PyTuple_Check(value) ? PyTuple_GET_SIZE(value) : 1;
+				for (Py_ssize_t i = 0; i < count; ++i) {
+					ReleaseView(PyTuple_Check(value) ? PyTuple_GET_ITEM(value, i) : value);
+				}
+			}
+			PyDict_Clear(batch->views);
+			BatchLease* const lease = batch->lease;
+			batch->lease = nullptr;
+			if (lease->exports == 0) {
+				ReturnLease(lease);
+			}
+			else {
+				lease->dispatched = true;
+			}
+		}
+
+		PyObject* ChangeSubscription(PyObject* const* args, Py_ssize_t nargs, bool subscribe) {
+			if (nargs != 2) {
+				PyErr_SetString(PyExc_TypeError, subscribe ? "subscribe(name, fn) takes 2 arguments" : "unsubscribe(name, fn) takes 2 arguments");
+				return nullptr;
+			}
+			if (!PyUnicode_Check(args[0])) {
+				PyErr_SetString(PyExc_TypeError, "Batch name must be a string");
+				return nullptr;
+			}
+			PyObject* handlers = PyDict_GetItemWithError(s_handlers, args[0]);
+			if (!handlers && PyErr_Occurred()) {
+				return nullptr;
+			}
+			if (subscribe) {
+				if (!PyCallable_Check(args[1])) {
+					PyErr_SetString(PyExc_TypeError, "Batch handler must be callable");
+					return nullptr;
+				}
+				if (!handlers) {
+					handlers = PyList_New(0);
+					if (!handlers || PyDict_SetItem(s_handlers, args[0], handlers) != 0) {
+						Py_XDECREF(handlers);
+						return nullptr;
+					}
+					Py_DECREF(handlers);
+				}
+				if (PyList_Append(handlers, args[1]) != 0) {
+					return nullptr;
+				}
+				Py_RETURN_NONE;
+			}
+			const Py_ssize_t size = handlers ? PyList_GET_SIZE(handlers) : 0;
+			for (Py_ssize_t i = 0; i < size; ++i) {
+				const int equal = PyObject_RichCompareBool(PyList_GET_ITEM(handlers, i), args[1], Py_EQ);
+				if (equal < 0) {
+					return nullptr;
+				}
+				if (equal) {
+					if (PyList_SetSlice(handlers, i, i + 1, nullptr) != 0) {
+						return nullptr;
+					}
+					if (PyList_GET_SIZE(handlers) == 0 && PyDict_DelItem(s_handlers, args[0]) != 0) {
+						return nullptr;
+					}
+					Py_RETURN_TRUE;
+				}
+			}
+			Py_RETURN_FALSE;
+		}
+
+		PyObject* Batch_subscribe(PyObject* /*self*/, PyObject* const* args, Py_ssize_t nargs) {
+			return ChangeSubscription(args, nargs, true);
+		}
+
+		PyObject* Batch_unsubscribe(PyObject* /*self*/, PyObject* const* args, Py_ssize_t nargs) {
+			return ChangeSubscription(args, nargs, false);
+		}
+
+		PyMethodDef s_batchModuleMethods[] = {
+			{ "subscribe", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(Batch_subscribe)), METH_FASTCALL, "subscribe(name, fn) - call fn(batch) for every batch published under name" },
+			{ "unsubscribe", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(Batch_unsubscribe)), METH_FASTCALL, "unsubscribe(name, fn) - remove handler, returns False if it was not subscribed" },
+			{ nullptr, nullptr, 0, nullptr }
+		};
+
+		PyModuleDef s_batchModule = {
+			PyModuleDef_HEAD_INIT,
+			"plugify.batch",
+			"Columnar batches published by native code with zero-copy column views",
+			-1,
+			s_batchModuleMethods,
+			nullptr,
+			nullptr,
+			nullptr,
+			nullptr
+		};
+	}
+
+	PyObject* CreateBatchModule() {
+		PyObject* const module = PyModule_Create(&s_batchModule);
+		if (!module) {
+			return nullptr;
+		}
+		s_batchType = reinterpret_cast<PyTypeObject*>(PyType_FromSpec(&s_batchSpec));
+		s_columnType = reinterpret_cast<PyTypeObject*>(PyType_FromSpec(&s_columnSpec));
+		if (!s_batchType || !s_columnType || PyModule_AddObjectRef(module, "Batch", reinterpret_cast<PyObject*>(s_batchType)) != 0) {
+			Py_DECREF(module);
+			return nullptr;
+		}
+		s_handlers = PyDict_New();
+		if (!s_handlers) {
+			Py_DECREF(module);
+			return nullptr;
+		}
+		return module;
+	}
+
+	size_t DispatchBatch(const char* name, const Py3lmBatchColumn* columns, size_t columnCount, size_t rows, Py3lmBatchCommit commit, Py3lmBatchRelease release, void* user) {
+		// Nothing was exported unless the batch reaches its handlers
+		struct Unused {
+			Py3lmBatchRelease release;
+			void* user;
+			~Unused() {
+				if (release) {
+					release(user);
+				}
+			}
+		} unused{ release, user };
+		if (!s_handlers) {
+			return 0;
+		}
+		for (size_t i = 0; i < columnCount; ++i) {
+			const Py3lmBatchColumn& column = columns[i];
+			if (!column.name || !IsValidType(column.type) || (!column.data && (rows || column.type == kPy3lmColumnString)) || (column.type == kPy3lmColumnString && !column.text)) {
+				PyErr_Format(PyExc_ValueError, "Batch '%s' column %zu is malformed", name, i);
+				PyErr_Print();
+				return 0;
+			}
+		}
+		PyObject* const key = PyUnicode_FromString(name);
+		if (!key) {
+			PyErr_Print();
+			return 0;
+		}
+		PyObject* const registered = PyDict_GetItemWithError(s_handlers, key);
+		// Copy, handlers may unsubscribe while the batch is dispatched
+		PyObject* const handlers = registered ? PyList_GetSlice(registered, 0, PyList_GET_SIZE(registered)) : nullptr;
+		if (!handlers) {
+			if (PyErr_Occurred()) {
+				PyErr_Print();
+			}
+			Py_DECREF(key);
+			return 0;
+		}
+		auto* const batch = PyObject_New(BatchObject, s_batchType);
+		if (batch) {
+			// Dealloc reads them when the views cannot be created
+			batch->name = nullptr;
+			batch->views = nullptr;
+		}
+		PyObject* const views = batch ? PyDict_New() : nullptr;
+		if (!views) {
+			PyErr_Print();
+			Py_XDECREF(batch);
+			Py_DECREF(handlers);
+			Py_DECREF(key);
+			return 0;
+		}
+		batch->columns = columns;
+		batch->columnCount = columnCount;
+		batch->rows = rows;
+		batch->commit = commit;
+		batch->user = user;
+		batch->name = key;
+		batch->views = views;
+		batch->lease = new BatchLease{ release, user, 0, false };
+		batch->released = false;
+		unused.release = nullptr;
+
+		const Py_ssize_t count = PyList_GET_SIZE(handlers);
+		for (Py_ssize_t i = 0; i < count; ++i) {
+			PyObject* const result = PyObject_CallOneArg(PyList_GET_ITEM(handlers, i), reinterpret_cast<PyObject*>(batch));
+			if (result) {
+				Py_DECREF(result);
+			}
+			else {
+				PyErr_Print();
+			}
+		}
+		ReleaseBatch(batch);
+		Py_DECREF(batch);
+		Py_DECREF(handlers);
+		return static_cast<size_t>(count);
+	}
+
+	void ClearBatchHandlers() {
+		Py_CLEAR(s_handlers);
+		Py_CLEAR(s_batchType);
+		Py_CLEAR(s_columnType);
+	}
+}
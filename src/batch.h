@@ -0,0 +1,45 @@
+#pragma once
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+	enum Py3lmColumnType : uint32_t {
+		kPy3lmColumnInt32,
+		kPy3lmColumnFloat,
+		kPy3lmColumnVector3,
+		// data holds rows + 1 uint32 offsets into text, row i is text[offsets[i], offsets[i + 1])
+		kPy3lmColumnString,
+	};
+
+	struct Py3lmBatchColumn {
+		const char* name;
+		uint32_t type; // Py3lmColumnType
+		uint32_t writable; // string columns are always read-only
+		void* data;
+		const char* text; // UTF-8 bytes of string column
+	};
+
+	// Receives indices of the columns committed by Python, called with the GIL held
+	typedef void (*Py3lmBatchCommit)(void* user, const uint32_t* columns, size_t count);
+
+	// Column memory may be freed once called, called exactly once with the GIL held
+	typedef void (*Py3lmBatchRelease)(void* user);
+}
+
+namespace py3lm {
+	// Creates 'plugify.batch' module:
+	//   subscribe(name, fn)   - call fn(batch) for every batch published under name
+	//   unsubscribe(name, fn) - remove handler
+	PyObject* CreateBatchModule();
+
+	// Passes batch to its handlers, GIL must be held. Column memory must stay valid until release is called:
+	// before it returns, or later from the thread dropping the last view Python kept past its handler.
+	// Without release it must stay valid as long as the module is loaded. Returns number of handlers called
+	size_t DispatchBatch(const char* name, const Py3lmBatchColumn* columns, size_t columnCount, size_t rows, Py3lmBatchCommit commit, Py3lmBatchRelease release, void* user);
+
+	// Drops handlers, GIL must be held
+	void ClearBatchHandlers();
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <cstddef>
+#include <cstring>
+
+namespace py3lm {
+	enum class BufferFormat {
+		Float32,
+		Int32,
+		UInt8,
+	};
+
+	// C-contiguous buffer argument viewed as count items of itemSize bytes
+	class BufferArg {
+	public:
+		BufferArg() = default;
+		~BufferArg() {
+			if (_acquired) {
+				PyBuffer_Release(&_view);
+			}
+		}
+		BufferArg(const BufferArg&) = delete;
+		BufferArg& operator=(const BufferArg&) = delete;
+
+		bool Acquire(PyObject* object, bool writable, BufferFormat format, size_t itemSize, const char* name) {
+			if (PyObject_GetBuffer(object, &_view, (writable ? PyBUF_WRITABLE : 0) | PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) != 0) {
+				return false;
+			}
+			_acquired = true;
+			if (!IsCompatible(_view.format, format)) {
+				static constexpr const char* kFormatNames[] = { "a float32", "an int32", "a uint8" };
+				PyErr_Format(PyExc_TypeError, "%s must be %s buffer, got format '%s'", name, kFormatNames[static_cast<int>(format)], _view.format);
+				return false;
+			}
+			if (static_cast<size_t>(_view.len) % itemSize != 0) {
+				PyErr_Format(PyExc_ValueError, "%s size %zd is not a multiple of %zu bytes", name, _view.len, itemSize);
+				return false;
+			}
+			_count = static_cast<size_t>(_view.len) / itemSize;
+			return true;
+		}
+
+		template<typename T>
+		T* Data() const { return static_cast<T*>(_view.buf); }
+		size_t Count() const { return _count; }
+
+	private:
+		// Raw byte buffers are accepted for any format, native byte order only
+		static bool IsCompatible(const char* format, BufferFormat expected) {
+			if (!format) {
+				return true;
+			}
+			if (*format == '@' || *format == '=' || *format == '<') {
+				++format;
+			}
+			if (std::strcmp(format, "B") == 0 || std::strcmp(format, "b") == 0 || std::strcmp(format, "c") == 0) {
+				return true;
+			}
+			switch (expected) {
+				case BufferFormat::Float32:
+					return std::strcmp(format, "f") == 0;
+				case BufferFormat::Int32:
+					return std::strcmp(format, "i") == 0 || (sizeof(long) == 4 && std::strcmp(format, "l") == 0);
+				case BufferFormat::UInt8:
+					return std::strcmp(format, "?") == 0;
+			}
+			return false;
+		}
+
+		Py_buffer _view{};
+		size_t _count = 0;
+		bool _acquired = false;
+	};
+}
@@ -0,0 +1,999 @@
+#include "file_io.h"
+#include "futures.h"
+#include "gil.h"
+#include "worker_pool.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if PY3LM_PLATFORM_LINUX && __has_include(<linux/io_uring.h>)
+#define PY3LM_IO_URING 1
+#include <linux/io_uring.h>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#else
+#define PY3LM_IO_URING 0
+#endif
+
+namespace py3lm {
+	namespace {
+		constexpr uint64_t kToEnd = UINT64_MAX;
+		// Kernel limits of IORING_REGISTER_BUFFERS
+		constexpr Py_ssize_t kMaxRegisteredBuffers = 1 << 14;
+		constexpr Py_ssize_t kMaxRegisteredBufferSize = 1 << 30;
+
+		enum class FileOp : uint8_t {
+			Read,
+			ReadInto,
+			Write,
+			Append
+		};
+
+		enum class FileStage : uint8_t {
+			Open,
+			Transfer,
+			Close
+		};
+
+		struct FileRequest {
+			FileOp op;
+			FileStage stage = FileStage::Open;
+			bool truncate = false;
+			int bufferIndex = -1; // registered buffer holding data
+			int fd = -1;
+			int error = 0; // errno
+			std::string path;
+			uint64_t offset = 0;
+			uint64_t size = 0;
+			uint64_t done = 0;
+			std::byte* data = nullptr;
+			std::unique_ptr<std::byte[]> readData; // read() result, copied to bytes on delivery
+			Py_buffer view{}; // data of write() or target of read_into(), held until delivery
+			PyObject* callback = nullptr;
+			PyObject* future = nullptr;
+			PyObject* loop = nullptr;
+			uint32_t tag = GilStats::kModuleTag;
+		};
+
+		// Requests are only dropped with the GIL held
+		struct RequestDeleter {
+			void operator()(FileRequest* request) const {
+				if (request->view.obj) {
+					PyBuffer_Release(&request->view);
+				}
+				Py_XDECREF(request->callback);
+				Py_XDECREF(request->future);
+				Py_XDECREF(request->loop);
+				delete request;
+			}
+		};
+
+		using RequestPtr = std::unique_ptr<FileRequest, RequestDeleter>;
+
+		bool IsWrite(FileOp op) {
+			return op == FileOp::Write || op == FileOp::Append;
+		}
+
+		void SizeToEnd(FileRequest& request, uint64_t fileSize) {
+			request.size = fileSize > request.offset ? fileSize - request.offset : 0;
+		}
+
+		bool AllocateRead(FileRequest& request) {
+			if (request.size > static_cast<uint64_t>(PY_SSIZE_T_MAX)) {
+				request.error = EFBIG;
+				return false;
+			}
+			request.readData.reset(new (std::nothrow) std::byte[request.size ? request.size : 1]);
+			if (!request.readData) {
+				request.error = ENOMEM;
+				return false;
+			}
+			request.data = request.readData.get();
+			return true;
+		}
+
+		// Filled by the ring thread or worker threads, drained on the host tick
+		class CompletionQueue {
+		public:
+			void Push(FileRequest* request) {
+				std::lock_guard lock(_mutex);
+				_requests.push_back(request);
+			}
+
+			void Take(std::vector<FileRequest*>& requests) {
+				std::lock_guard lock(_mutex);
+				requests.swap(_requests);
+			}
+
+		private:
+			std::mutex _mutex;
+			std::vector<FileRequest*> _requests;
+		};
+
+		int SeekFile(std::FILE* file, uint64_t offset, int origin) {
+#if PY3LM_PLATFORM_WINDOWS
+			return _fseeki64(file, static_cast<int64_t>(offset), origin);
+#else
+			return fseeko(file, static_cast<off_t>(offset), origin);
+#endif
+		}
+
+		int64_t TellFile(std::FILE* file) {
+#if PY3LM_PLATFORM_WINDOWS
+			return _ftelli64(file);
+#else
+			return ftello(file);
+#endif
+		}
+
+		int LastError() {
+			return errno ? errno : EIO;
+		}
+
+		const char* GetOpenMode(const FileRequest& request) {
+			switch (request.op) {
+				case FileOp::Read:
+				case FileOp::ReadInto:
+					return "rb";
+				case FileOp::Append:
+					return "ab";
+				case FileOp::Write:
+					break;
+			}
+			return request.truncate ? "wb" : "r+b";
+		}
+
+		// Thread pool path, runs on a worker thread without the GIL
+		void RunBlocking(FileRequest& request) {
+			errno = 0;
+			std::FILE* file = std::fopen(request.path.c_str(), GetOpenMode(request));
+			if (!file && request.op == FileOp::Write && errno == ENOENT) {
+				// r+b does not create the file
+				file = std::fopen(request.path.c_str(), "w+b");
+			}
+			if (!file) {
+				request.error = LastError();
+				return;
+			}
+			if (request.op == FileOp::Read) {
+				if (request.size == kToEnd) {
+					int64_t end = -1;
+					if (SeekFile(file, 0, SEEK_END) != 0 || (end = TellFile(file)) < 0) {
+						request.error = LastError();
+					}
+					else {
+						SizeToEnd(request, static_cast<uint64_t>(end));
+					}
+				}
+				if (!request.error) {
+					AllocateRead(request);
+				}
+			}
+			if (!request.error && request.op != FileOp::Append && SeekFile(file, request.offset, SEEK_SET) != 0) {
+				request.error = LastError();
+			}
+			if (!request.error && request.size) {
+				errno = 0;
+				request.done = IsWrite(request.op)
+					? std::fwrite(request.data, 1, request.size, file)
+					: std::fread(request.data, 1, request.size, file);
+				if (request.done < request.size && std::ferror(file)) {
+					request.error = LastError();
+				}
+			}
+			if (std::fclose(file) != 0 && IsWrite(request.op) && !request.error) {
+				request.error = LastError();
+			}
+		}
+
+#if PY3LM_IO_URING
+		// Ring driven by one thread through raw syscalls. A request goes open -> read/write until done -> close,
+		// each step queued as the previous completes, so many files progress in one io_uring_enter
+		class UringBackend {
+		public:
+			explicit UringBackend(CompletionQueue& completed) : _completed{completed} {
+			}
+
+			~UringBackend() {
+				Stop();
+				if (_sqes) {
+					munmap(_sqes, _sqesSize);
+				}
+				if (_cqRing != MAP_FAILED && _cqRing != _sqRing) {
+					munmap(_cqRing, _cqRingSize);
+				}
+				if (_sqRing != MAP_FAILED) {
+					munmap(_sqRing, _sqRingSize);
+				}
+				if (_eventFd >= 0) {
+					close(_eventFd);
+				}
+				if (_ringFd >= 0) {
+					close(_ringFd);
+				}
+			}
+
+			UringBackend(const UringBackend&) = delete;
+			UringBackend& operator=(const UringBackend&) = delete;
+
+			// False when io_uring or one of the operations used is not available
+			bool Init(unsigned entries) {
+				io_uring_params params{};
+				_ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+				if (_ringFd < 0) {
+					return false;
+				}
+				const bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+				_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+				_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+				if (singleMmap) {
+					_sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+				}
+				_sqRing = mmap(nullptr, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQ_RING);
+				if (_sqRing == MAP_FAILED) {
+					return false;
+				}
+				_cqRing = singleMmap ? _sqRing : mmap(nullptr, _cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_CQ_RING);
+				if (_cqRing == MAP_FAILED) {
+					return false;
+				}
+				_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+				void* const sqes = mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQES);
+				if (sqes == MAP_FAILED) {
+					return false;
+				}
+				_sqes = static_cast<io_uring_sqe*>(sqes);
+
+				auto* const sq = static_cast<std::byte*>(_sqRing);
+				_sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+				_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+				_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+				_sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+				_sqEntries = params.sq_entries;
+				_sqLocalTail = *_sqTail;
+
+				auto* const cq = static_cast<std::byte*>(_cqRing);
+				_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+				_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+				_cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+				_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+				_eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+				return _eventFd >= 0 && SupportsOps();
+			}
+
+			// Returns errno, the ring thread must not be running yet:
+			// registration waits for the ring to go idle, which it never does while blocked in io_uring_enter
+			int RegisterBuffers(const std::vector<iovec>& buffers) {
+				if (syscall(__NR_io_uring_register, _ringFd, IORING_REGISTER_BUFFERS, buffers.data(), static_cast<unsigned>(buffers.size())) < 0) {
+					return errno;
+				}
+				return 0;
+			}
+
+			bool IsStarted() const {
+				return _thread.joinable();
+			}
+
+			// Called with the GIL held, one wakeup per batch
+			void Submit(std::vector<FileRequest*>& requests) {
+				if (!_thread.joinable()) {
+					_thread = std::thread(&UringBackend::Run, this);
+				}
+				{
+					std::lock_guard lock(_mutex);
+					_incoming.insert(_incoming.end(), requests.begin(), requests.end());
+				}
+				requests.clear();
+				Wake();
+			}
+
+			// Returns once every submitted request has completed
+			void Stop() {
+				if (!_thread.joinable()) {
+					return;
+				}
+				{
+					std::lock_guard lock(_mutex);
+					_stopping = true;
+				}
+				Wake();
+				_thread.join();
+			}
+
+		private:
+			static constexpr uint64_t kWakeupData = 0;
+			// Largest transfer of one read or write, len is 32 bit
+			static constexpr uint64_t kMaxChunk = 1 << 30;
+
+			bool SupportsOps() {
+				constexpr unsigned kProbeOps = 64;
+				std::vector<std::byte> storage(sizeof(io_uring_probe) + kProbeOps * sizeof(io_uring_probe_op));
+				auto* const probe = reinterpret_cast<io_uring_probe*>(storage.data());
+				if (syscall(__NR_io_uring_register, _ringFd, IORING_REGISTER_PROBE, probe, kProbeOps) < 0) {
+					return false;
+				}
+				for (const uint8_t op : { IORING_OP_OPENAT, IORING_OP_CLOSE, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED, IORING_OP_POLL_ADD }) {
+					if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+						return false;
+					}
+				}
+				return true;
+			}
+
+			void Wake() {
+				const uint64_t value = 1;
+				[[maybe_unused]] const ssize_t written = write(_eventFd, &value, sizeof(value));
+			}
+
+			io_uring_sqe* GetSqe() {
+				const unsigned head = std::atomic_ref<unsigned>(*_sqHead).load(std::memory_order_acquire);
+				if (_sqLocalTail - head >= _sqEntries) {
+					return nullptr;
+				}
+				const unsigned index = _sqLocalTail++ & _sqMask;
+				_sqArray[index] = index;
+				io_uring_sqe* const sqe = &_sqes[index];
+				std::memset(sqe, 0, sizeof(io_uring_sqe));
+				return sqe;
+			}
+
+			// Full queue is submitted to make room
+			io_uring_sqe* NextSqe() {
+				if (io_uring_sqe* const sqe = GetSqe()) {
+					return sqe;
+				}
+				Enter(0);
+				return GetSqe();
+			}
+
+			int Enter(unsigned waitCount) {
+				std::atomic_ref<unsigned>(*_sqTail).store(_sqLocalTail, std::memory_order_release);
+				const unsigned toSubmit = _sqLocalTail - std::atomic_ref<unsigned>(*_sqHead).load(std::memory_order_acquire);
+				int result;
+				do {
+					result = static_cast<int>(syscall(__NR_io_uring_enter, _ringFd, toSubmit, waitCount, waitCount ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0));
+				} while (result < 0 && errno == EINTR);
+				return result;
+			}
+
+			template<typename F>
+			void Reap(F&& handler) {
+				unsigned head = *_cqHead;
+				const unsigned tail = std::atomic_ref<unsigned>(*_cqTail).load(std::memory_order_acquire);
+				for (; head != tail; ++head) {
+					const io_uring_cqe& cqe = _cqes[head & _cqMask];
+					const uint64_t userData = cqe.user_data;
+					const int32_t result = cqe.res;
+					// Slot is handed back before the handler queues more work
+					std::atomic_ref<unsigned>(*_cqHead).store(head + 1, std::memory_order_release);
+					handler(userData, result);
+				}
+			}
+
+			bool ArmWakeup() {
+				io_uring_sqe* const sqe = NextSqe();
+				if (!sqe) {
+					return false;
+				}
+				sqe->opcode = IORING_OP_POLL_ADD;
+				sqe->fd = _eventFd;
+				sqe->poll32_events = POLLIN;
+				sqe->user_data = kWakeupData;
+				return true;
+			}
+
+			void Run() {
+				std::vector<FileRequest*> requests;
+				bool wakeupArmed = false;
+				for (;;) {
+					bool stopping;
+					{
+						std::lock_guard lock(_mutex);
+						requests.swap(_incoming);
+						stopping = _stopping;
+					}
+					for (FileRequest* const request : requests) {
+						++_inflight;
+						Step(*request);
+					}
+					requests.clear();
+					if (stopping && !_inflight) {
+						return;
+					}
+					if (!wakeupArmed) {
+						wakeupArmed = ArmWakeup();
+					}
+					Enter(1);
+					Reap([this, &wakeupArmed](uint64_t userData, int32_t result) {
+						if (userData == kWakeupData) {
+							uint64_t value;
+							[[maybe_unused]] const ssize_t read = ::read(_eventFd, &value, sizeof(value));
+							wakeupArmed = false;
+							return;
+						}
+						Advance(*reinterpret_cast<FileRequest*>(userData), result);
+					});
+				}
+			}
+
+			void Step(FileRequest& request) {
+				io_uring_sqe* const sqe = NextSqe();
+				if (!sqe) {
+					// Kernel refuses submissions, e.g. completion queue overflow
+					if (request.fd >= 0) {
+						close(request.fd);
+						request.fd = -1;
+					}
+					if (!request.error) {
+						request.error = EBUSY;
+					}
+					Finish(request);
+					return;
+				}
+				sqe->user_data = reinterpret_cast<uint64_t>(&request);
+				switch (request.stage) {
+					case FileStage::Open:
+						sqe->opcode = IORING_OP_OPENAT;
+						sqe->fd = AT_FDCWD;
+						sqe->addr = reinterpret_cast<uint64_t>(request.path.c_str());
+						sqe->len = 0666; // mode
+						sqe->open_flags = GetOpenFlags(request);
+						break;
+					case FileStage::Transfer: {
+						const bool write = IsWrite(request.op);
+						if (request.bufferIndex >= 0) {
+							sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+							sqe->buf_index = static_cast<uint16_t>(request.bufferIndex);
+						}
+						else {
+							sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+						}
+						sqe->fd = request.fd;
+						sqe->addr = reinterpret_cast<uint64_t>(request.data + request.done);
+						sqe->len = static_cast<uint32_t>(std::min(request.size - request.done, kMaxChunk));
+						// O_APPEND writes go to the end of file whatever the offset
+						sqe->off = request.offset + request.done;
+						break;
+					}
+					case FileStage::Close:
+						sqe->opcode = IORING_OP_CLOSE;
+						sqe->fd = request.fd;
+						break;
+				}
+			}
+
+			void Advance(FileRequest& request, int32_t result) {
+				switch (request.stage) {
+					case FileStage::Open:
+						if (result < 0) {
+							request.error = -result;
+							Finish(request);
+							return;
+						}
+						request.fd = result;
+						request.stage = FileStage::Transfer;
+						if (request.op == FileOp::Read) {
+							if (request.size == kToEnd) {
+								struct stat status;
+								if (fstat(request.fd, &status) != 0) {
+									request.error = errno;
+								}
+								else {
+									SizeToEnd(request, static_cast<uint64_t>(status.st_size));
+								}
+							}
+							if (!request.error) {
+								AllocateRead(request);
+							}
+						}
+						if (request.error || request.done == request.size) {
+							request.stage = FileStage::Close;
+						}
+						break;
+					case FileStage::Transfer:
+						if (result == -EAGAIN || result == -EINTR) {
+							break;
+						}
+						if (result < 0) {
+							request.error = -result;
+							request.stage = FileStage::Close;
+						}
+						else if (result == 0) {
+							// End of file, read is short
+							request.stage = FileStage::Close;
+						}
+						else if ((request.done += static_cast<uint64_t>(result)) >= request.size) {
+							request.stage = FileStage::Close;
+						}
+						break;
+					case FileStage::Close:
+						if (result < 0 && IsWrite(request.op) && !request.error) {
+							request.error = -result;
+						}
+						request.fd = -1;
+						Finish(request);
+						return;
+				}
+				Step(request);
+			}
+
+			void Finish(FileRequest& request) {
+				--_inflight;
+				_completed.Push(&request);
+			}
+
+			static int GetOpenFlags(const FileRequest& request) {
+				switch (request.op) {
+					case FileOp::Read:
+					case FileOp::ReadInto:
+						return O_RDONLY | O_CLOEXEC;
+					case FileOp::Append:
+						return O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC;
+					case FileOp::Write:
+						break;
+				}
+				return O_WRONLY | O_CREAT | O_CLOEXEC | (request.truncate ? O_TRUNC : 0);
+			}
+
+			CompletionQueue& _completed;
+			int _ringFd = -1;
+			int _eventFd = -1;
+			void* _sqRing = MAP_FAILED;
+			void* _cqRing = MAP_FAILED;
+			size_t _sqRingSize = 0;
+			size_t _cqRingSize = 0;
+			size_t _sqesSize = 0;
+			io_uring_sqe* _sqes = nullptr;
+			unsigned* _sqHead = nullptr;
+			unsigned* _sqTail = nullptr;
+			unsigned* _sqArray = nullptr;
+			unsigned _sqMask = 0;
+			unsigned _sqEntries = 0;
+			unsigned _sqLocalTail = 0;
+			unsigned* _cqHead = nullptr;
+			unsigned* _cqTail = nullptr;
+			unsigned _cqMask = 0;
+			io_uring_cqe* _cqes = nullptr;
+
+			std::thread _thread;
+			std::mutex _mutex;
+			std::vector<FileRequest*> _incoming;
+			bool _stopping = false;
+			size_t _inflight = 0; // ring thread only
+		};
+
+		constexpr unsigned kRingEntries = 256;
+#endif
+
+		struct FileIoState {
+			WorkerPool& pool;
+			GilStats& stats;
+#if PY3LM_IO_URING
+			std::unique_ptr<UringBackend> ring; // null when served by the worker pool
+#endif
+			CompletionQueue completed;
+			std::vector<FileRequest*> queued; // made since the last submission
+			size_t pending = 0; // made and not delivered yet
+			PyObject* buffers = nullptr; // memoryview over the registered buffers
+			std::byte* buffersBegin = nullptr;
+			size_t bufferSize = 0;
+			size_t bufferCount = 0;
+
+			FileIoState(WorkerPool& pool, GilStats& stats) : pool{pool}, stats{stats} {
+			}
+
+			bool UsesRing() const {
+#if PY3LM_IO_URING
+				return ring != nullptr;
+#else
+				return false;
+#endif
+			}
+		};
+
+		FileIoState* s_state = nullptr;
+
+		FileIoState* GetState() {
+			if (!s_state) {
+				PyErr_SetString(PyExc_RuntimeError, "File I/O is shut down");
+			}
+			return s_state;
+		}
+
+		void Submit(FileIoState& state) {
+			if (state.queued.empty()) {
+				return;
+			}
+#if PY3LM_IO_URING
+			if (state.ring) {
+				state.ring->Submit(state.queued);
+				return;
+			}
+#endif
+			for (FileRequest* const request : state.queued) {
+				state.pool.Submit([request, &completed = state.completed] {
+					RunBlocking(*request);
+					completed.Push(request);
+				});
+			}
+			state.queued.clear();
+		}
+
+		void Deliver(FileIoState& state, RequestPtr request) {
+			GilEnterScope gil(state.stats, request->tag);
+
+			PyObject* result = nullptr;
+			PyObject* error = nullptr;
+			if (request->error) {
+				errno = request->error;
+				PyErr_SetFromErrnoWithFilename(PyExc_OSError, request->path.c_str());
+				error = PyErr_GetRaisedException();
+			}
+			else {
+				result = request->op == FileOp::Read
+					? PyBytes_FromStringAndSize(reinterpret_cast<const char*>(request->data), static_cast<Py_ssize_t>(request->done))
+					: PyLong_FromUnsignedLongLong(request->done);
+				if (!result) {
+					error = PyErr_GetRaisedException();
+				}
+			}
+
+			PyObject* const resultArg = result ? result : Py_None;
+			PyObject* const errorArg = error ? error : Py_None;
+			if (request->callback) {
+				PyObject* const ret = PyObject_CallFunctionObjArgs(request->callback, resultArg, errorArg, nullptr);
+				if (ret) {
+					Py_DECREF(ret);
+				}
+				else {
+					PyErr_Print();
+				}
+			}
+			else {
+				ResolveFuture(request->future, request->loop, resultArg, errorArg);
+			}
+			Py_XDECREF(result);
+			Py_XDECREF(error);
+		}
+
+		// Registered buffer fully holding [data, data + size), -1 otherwise
+		int FindRegisteredBuffer(const FileIoState& state, const void* data, size_t size) {
+			if (!state.buffers || !state.UsesRing()) {
+				return -1;
+			}
+			const auto* const begin = static_cast<const std::byte*>(data);
+			if (begin < state.buffersBegin || begin >= state.buffersBegin + state.bufferCount * state.bufferSize) {
+				return -1;
+			}
+			const size_t index = static_cast<size_t>(begin - state.buffersBegin) / state.bufferSize;
+			return begin + size <= state.buffersBegin + (index + 1) * state.bufferSize ? static_cast<int>(index) : -1;
+		}
+
+		RequestPtr NewRequest(FileOp op, PyObject* pathBytes, long long offset) {
+			RequestPtr request{ new FileRequest() };
+			request->op = op;
+			request->path.assign(PyBytes_AS_STRING(pathBytes), static_cast<size_t>(PyBytes_GET_SIZE(pathBytes)));
+			request->offset = static_cast<uint64_t>(offset);
+			request->tag = GilStats::CurrentTag();
+			return request;
+		}
+
+		// Takes the buffer into the request, data of write() or target of read_into()
+		void AttachBuffer(FileIoState& state, FileRequest& request, Py_buffer& view) {
+			request.view = view;
+			view.obj = nullptr;
+			request.data = static_cast<std::byte*>(request.view.buf);
+			request.size = static_cast<uint64_t>(request.view.len);
+			request.bufferIndex = FindRegisteredBuffer(state, request.view.buf, static_cast<size_t>(request.view.len));
+		}
+
+		bool CheckArgs(long long offset, PyObject* callback) {
+			if (offset < 0) {
+				PyErr_SetString(PyExc_ValueError, "offset must not be negative");
+				return false;
+			}
+			if (callback != Py_None && !PyCallable_Check(callback)) {
+				PyErr_SetString(PyExc_TypeError, "callback must be callable");
+				return false;
+			}
+			return true;
+		}
+
+		// Returns the future, or None when completion goes to callback
+		PyObject* Queue(FileIoState& state, RequestPtr request, PyObject* callback) {
+			PyObject* result;
+			if (callback != Py_None) {
+				request->callback = Py_NewRef(callback);
+				result = Py_NewRef(Py_None);
+			}
+			else {
+				request->future = CreateFuture(&request->loop);
+				if (!request->future) {
+					return nullptr;
+				}
+				result = Py_NewRef(request->future);
+			}
+			state.queued.push_back(request.release());
+			++state.pending;
+			return result;
+		}
+
+		// PyArg_ParseTupleAndKeywords takes char** before 3.13
+		PyObject* FileIo_read(PyObject* /*self*/, PyObject* args, PyObject* kwargs) {
+			static const char* kKeywords[] = { "path", "offset", "size", "callback", nullptr };
+			PyObject* path;
+			long long offset = 0;
+			Py_ssize_t size = -1;
+			PyObject* callback = Py_None;
+			if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O&|LnO:read", const_cast<char**>(kKeywords), PyUnicode_FSConverter, &path, &offset, &size, &callback)) {
+				return nullptr;
+			}
+			FileIoState* const state = GetState();
+			if (!state || !CheckArgs(offset, callback)) {
+				Py_DECREF(path);
+				return nullptr;
+			}
+			RequestPtr request = NewRequest(FileOp::Read, path, offset);
+			Py_DECREF(path);
+			request->size = size < 0 ? kToEnd : static_cast<uint64_t>(size);
+			return Queue(*state, std::move(request), callback);
+		}
+
+		PyObject* FileIo_read_into(PyObject* /*self*/, PyObject* args, PyObject* kwargs) {
+			static const char* kKeywords[] = { "path", "buffer", "offset", "callback", nullptr };
+			PyObject* path;
+			Py_buffer view;
+			long long offset = 0;
+			PyObject* callback = Py_None;
+			if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O&w*|LO:read_into", const_cast<char**>(kKeywords), PyUnicode_FSConverter, &path, &view, &offset, &callback)) {
+				return nullptr;
+			}
+			FileIoState* const state = GetState();
+			if (!state || !CheckArgs(offset, callback)) {
+				PyBuffer_Release(&view);
+				Py_DECREF(path);
+				return nullptr;
+			}
+			RequestPtr request = NewRequest(FileOp::ReadInto, path, offset);
+			Py_DECREF(path);
+			AttachBuffer(*state, *request, view);
+			return Queue(*state, std::move(request), callback);
+		}
+
+		PyObject* WriteFile(FileOp op, const char* format, const char* const* keywords, PyObject* args, PyObject* kwargs) {
+			PyObject* path;
+			Py_buffer view;
+			long long offset = 0;
+			int truncate = 1;
+			PyObject* callback = Py_None;
+			const bool parsed = op == FileOp::Append
+				? PyArg_ParseTupleAndKeywords(args, kwargs, format, const_cast<char**>(keywords), PyUnicode_FSConverter, &path, &view, &callback)
+				: PyArg_ParseTupleAndKeywords(args, kwargs, format, const_cast<char**>(keywords), PyUnicode_FSConverter, &path, &view, &offset, &truncate, &callback);
+			if (!parsed) {
+				return nullptr;
+			}
+			FileIoState* const state = GetState();
+			if (!state || !CheckArgs(offset, callback)) {
+				PyBuffer_Release(&view);
+				Py_DECREF(path);
+				return nullptr;
+			}
+			RequestPtr request = NewRequest(op, path, offset);
+			Py_DECREF(path);
+			request->truncate = truncate != 0;
+			AttachBuffer(*state, *request, view);
+			return Queue(*state, std::move(request), callback);
+		}
+
+		PyObject* FileIo_write(PyObject* /*self*/, PyObject* args, PyObject* kwargs) {
+			static const char* kKeywords[] = { "path", "data", "offset", "truncate", "callback", nullptr };
+			return WriteFile(FileOp::Write, "O&y*|LpO:write", kKeywords, args, kwargs);
+		}
+
+		PyObject* FileIo_append(PyObject* /*self*/, PyObject* args, PyObject* kwargs) {
+			static const char* kKeywords[] = { "path", "data", "callback", nullptr };
+			return WriteFile(FileOp::Append, "O&y*|O:append", kKeywords, args, kwargs);
+		}
+
+		PyObject* FileIo_register_buffers(PyObject* /*self*/, PyObject* args) {
+			Py_ssize_t count;
+			Py_ssize_t size;
+			if (!PyArg_ParseTuple(args, "nn:register_buffers", &count, &size)) {
+				return nullptr;
+			}
+			FileIoState* const state = GetState();
+			if (!state) {
+				return nullptr;
+			}
+			if (state->buffers) {
+				PyErr_SetString(PyExc_RuntimeError, "Buffers are already registered");
+				return nullptr;
+			}
+#if PY3LM_IO_URING
+			if (state->ring && state->ring->IsStarted()) {
+				PyErr_SetString(PyExc_RuntimeError, "Buffers must be registered before the first request");
+				return nullptr;
+			}
+#endif
+			if (count < 1 || count > kMaxRegisteredBuffers || size < 1 || size > kMaxRegisteredBufferSize) {
+				PyErr_Format(PyExc_ValueError, "Expected 1..%zd buffers of 1..%zd bytes", kMaxRegisteredBuffers, kMaxRegisteredBufferSize);
+				return nullptr;
+			}
+			if (count > PY_SSIZE_T_MAX / size) {
+				PyErr_NoMemory();
+				return nullptr;
+			}
+
+			// Memory belongs to a bytearray, the views keep it alive after shutdown
+			PyObject* const storage = PyByteArray_FromStringAndSize(nullptr, count * size);
+			if (!storage) {
+				return nullptr;
+			}
+			PyObject* const buffers = PyMemoryView_FromObject(storage);
+			Py_DECREF(storage);
+			if (!buffers) {
+				return nullptr;
+			}
+			auto* const begin = static_cast<std::byte*>(PyMemoryView_GET_BUFFER(buffers)->buf);
+
+#if PY3LM_IO_URING
+			if (state->ring) {
+				std::vector<iovec> vectors(static_cast<size_t>(count));
+				for (Py_ssize_t i = 0; i < count; ++i) {
+					vectors[static_cast<size_t>(i)] = { begin + i * size, static_cast<size_t>(size) };
+				}
+				if (const int error = state->ring->RegisterBuffers(vectors)) {
+					Py_DECREF(buffers);
+					errno = error;
+					return PyErr_SetFromErrno(PyExc_OSError);
+				}
+			}
+#endif
+
+			PyObject* const result = PyTuple_New(count);
+			if (!result) {
+				Py_DECREF(buffers);
+				return nullptr;
+			}
+			for (Py_ssize_t i = 0; i < count; ++i) {
+				PyObject* const view = PySequence_GetSlice(buffers, i * size, (i + 1) * size);
+				if (!view) {
+					Py_DECREF(result);
+					Py_DECREF(buffers);
+					return nullptr;
+				}
+				PyTuple_SET_ITEM(result, i, view);
+			}
+			state->buffers = buffers;
+			state->buffersBegin = begin;
+			state->bufferCount = static_cast<size_t>(count);
+			state->bufferSize = static_cast<size_t>(size);
+			return result;
+		}
+
+		PyObject* FileIo_submit(PyObject* /*self*/, PyObject* /*args*/) {
+			FileIoState* const state = GetState();
+			if (!state) {
+				return nullptr;
+			}
+			Submit(*state);
+			Py_RETURN_NONE;
+		}
+
+		PyObject* FileIo_poll(PyObject* /*self*/, PyObject* /*args*/) {
+			if (!GetState()) {
+				return nullptr;
+			}
+			return PyLong_FromSize_t(DeliverFileIo());
+		}
+
+		PyObject* FileIo_pending(PyObject* /*self*/, PyObject* /*args*/) {
+			FileIoState* const state = GetState();
+			return state ? PyLong_FromSize_t(state->pending) : nullptr;
+		}
+
+		PyMethodDef s_fileIoMethods[] = {
+			{ "read", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(FileIo_read)), METH_VARARGS | METH_KEYWORDS, "read(path, offset=0, size=-1, callback=None) - bytes of the file, size -1 reads to the end" },
+			{ "read_into", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(FileIo_read_into)), METH_VARARGS | METH_KEYWORDS, "read_into(path, buffer, offset=0, callback=None) - fill buffer, returns bytes read" },
+			{ "write", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(FileIo_write)), METH_VARARGS | METH_KEYWORDS, "write(path, data, offset=0, truncate=True, callback=None) - returns bytes written" },
+			{ "append", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(FileIo_append)), METH_VARARGS | METH_KEYWORDS, "append(path, data, callback=None) - returns bytes written" },
+			{ "register_buffers", FileIo_register_buffers, METH_VARARGS, "register_buffers(count, size) - memoryviews read_into and write use without mapping per request" },
+			{ "submit", FileIo_submit, METH_NOARGS, "submit() - hand queued requests to the kernel now" },
+			{ "poll", FileIo_poll, METH_NOARGS, "poll() - submit and deliver finished requests now, returns their number" },
+			{ "pending", FileIo_pending, METH_NOARGS, "pending() - number of requests not delivered yet" },
+			{ nullptr, nullptr, 0, nullptr }
+		};
+
+		PyModuleDef s_fileIoModule = {
+			PyModuleDef_HEAD_INIT,
+			"plugify.fileio",
+			"Asynchronous file reads and writes completed on the host tick",
+			-1,
+			s_fileIoMethods,
+			nullptr,
+			nullptr,
+			nullptr,
+			nullptr
+		};
+	}
+
+	PyObject* CreateFileIoModule(WorkerPool& pool, GilStats& stats) {
+		PyObject* const module = PyModule_Create(&s_fileIoModule);
+		if (!module) {
+			return nullptr;
+		}
+		auto state = std::make_unique<FileIoState>(pool, stats);
+#if PY3LM_IO_URING
+		// PY3LM_FILE_IO=threads keeps the worker pool, e.g. to compare paths
+		const char* const env = std::getenv("PY3LM_FILE_IO");
+		if (std::string_view(env ? env : "") != "threads") {
+			auto ring = std::make_unique<UringBackend>(state->completed);
+			if (ring->Init(kRingEntries)) {
+				state->ring = std::move(ring);
+			}
+		}
+#endif
+		if (PyModule_AddStringConstant(module, "BACKEND", state->UsesRing() ? "io_uring" : "threads") != 0) {
+			Py_DECREF(module);
+			return nullptr;
+		}
+		s_state = state.release();
+		return module;
+	}
+
+	size_t DeliverFileIo() {
+		FileIoState* const state = s_state;
+		if (!state) {
+			return 0;
+		}
+		Submit(*state);
+		std::vector<FileRequest*> finished;
+		state->completed.Take(finished);
+		for (FileRequest* const request : finished) {
+			--state->pending;
+			Deliver(*state, RequestPtr{ request });
+		}
+		return finished.size();
+	}
+
+	void ClearFileIo() {
+		// Detached first, callbacks of dropped requests see a closed service
+		FileIoState* const state = s_state;
+		s_state = nullptr;
+		if (!state) {
+			return;
+		}
+#if PY3LM_IO_URING
+		// Kernel may still write into request buffers until the ring is idle
+		state->ring.reset();
+#endif
+		std::vector<FileRequest*> finished;
+		state->completed.Take(finished);
+		for (FileRequest* const request : finished) {
+			RequestDeleter{}(request);
+		}
+		for (FileRequest* const request : state->queued) {
+			RequestDeleter{}(request);
+		}
+		Py_XDECREF(state->buffers);
+		delete state;
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <cstddef>
+
+namespace py3lm {
+	class GilStats;
+	class WorkerPool;
+
+	// Creates 'plugify.fileio' module, asynchronous file reads and writes served by io_uring on Linux
+	// and by the worker pool elsewhere (or with PY3LM_FILE_IO=threads). Requests made between two ticks
+	// go to the kernel in one submission, results are delivered on the host tick:
+	//   read(path, offset=0, size=-1, callback=None)       - bytes, size -1 reads to the end of file
+	//   read_into(path, buffer, offset=0, callback=None)   - fills a writable buffer, returns bytes read
+	//   write(path, data, offset=0, truncate=True, callback=None) - returns bytes written
+	//   append(path, data, callback=None)                  - returns bytes written
+	//   register_buffers(count, size) - memoryviews over memory registered with the ring, read_into
+	//                                   and write use fixed-buffer operations on them. Once, before the first request
+	//   submit()   - hand queued requests to the kernel now instead of at the next tick
+	//   poll()     - submit, then deliver finished requests now, returns their number
+	//   pending()  - requests not delivered yet
+	//   BACKEND    - 'io_uring' or 'threads'
+	// Without callback a request returns a future, asyncio when called from a coroutine.
+	// callback(result, error) gets None for the missing one, error is an OSError
+	PyObject* CreateFileIoModule(WorkerPool& pool, GilStats& stats);
+
+	// Submits queued requests and delivers finished ones on the calling thread, GIL must be held.
+	// Returns number of requests delivered
+	size_t DeliverFileIo();
+
+	// Waits for requests in flight and drops undelivered ones, GIL must be held.
+	// Worker pool must be stopped first
+	void ClearFileIo();
+}
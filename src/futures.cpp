@@ -0,0 +1,86 @@
+#include "futures.h"
+
+namespace py3lm {
+	namespace {
+		// resolve(future, result, exception), runs on the loop thread for asyncio futures
+		PyObject* Resolve(PyObject* /*self*/, PyObject* args) {
+			PyObject* future;
+			PyObject* result;
+			PyObject* exception;
+			if (!PyArg_ParseTuple(args, "OOO", &future, &result, &exception)) {
+				return nullptr;
+			}
+			PyObject* const done = PyObject_CallMethod(future, "done", nullptr);
+			if (!done) {
+				return nullptr;
+			}
+			const int isDone = PyObject_IsTrue(done);
+			Py_DECREF(done);
+			if (isDone < 0) {
+				return nullptr;
+			}
+			if (isDone) {
+				// Cancelled by caller
+				Py_RETURN_NONE;
+			}
+			PyObject* const setResult = exception != Py_None
+				? PyObject_CallMethod(future, "set_exception", "O", exception)
+				: PyObject_CallMethod(future, "set_result", "O", result);
+			if (!setResult) {
+				return nullptr;
+			}
+			Py_DECREF(setResult);
+			Py_RETURN_NONE;
+		}
+
+		PyMethodDef s_resolveDef = { "_resolve_future", &Resolve, METH_VARARGS, nullptr };
+	}
+
+	PyObject* CreateFuture(PyObject** loop) {
+		*loop = nullptr;
+		PyObject* const asyncio = PyImport_ImportModule("asyncio");
+		if (!asyncio) {
+			return nullptr;
+		}
+		PyObject* const running = PyObject_CallMethod(asyncio, "_get_running_loop", nullptr);
+		Py_DECREF(asyncio);
+		if (!running) {
+			return nullptr;
+		}
+		if (running != Py_None) {
+			PyObject* const future = PyObject_CallMethod(running, "create_future", nullptr);
+			if (!future) {
+				Py_DECREF(running);
+				return nullptr;
+			}
+			*loop = running;
+			return future;
+		}
+		Py_DECREF(running);
+		PyObject* const futures = PyImport_ImportModule("concurrent.futures");
+		if (!futures) {
+			return nullptr;
+		}
+		PyObject* const future = PyObject_CallMethod(futures, "Future", nullptr);
+		Py_DECREF(futures);
+		return future;
+	}
+
+	void ResolveFuture(PyObject* future, PyObject* loop, PyObject* result, PyObject* exception) {
+		PyObject* resolved = nullptr;
+		PyObject* const resolve = PyCFunction_New(&s_resolveDef, nullptr);
+		if (resolve) {
+			resolved = loop
+				? PyObject_CallMethod(loop, "call_soon_threadsafe", "OOOO", resolve, future, result, exception)
+				: PyObject_CallFunctionObjArgs(resolve, future, result, exception, nullptr);
+			Py_DECREF(resolve);
+		}
+		if (resolved) {
+			Py_DECREF(resolved);
+		}
+		else {
+			// e.g. loop already closed
+			PyErr_Print();
+		}
+	}
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+namespace py3lm {
+	// Future of the running asyncio loop when called from a coroutine, concurrent.futures.Future otherwise.
+	// loop receives a new reference to the running loop or null, GIL must be held
+	PyObject* CreateFuture(PyObject** loop);
+
+	// Sets exception, or result when exception is None, on the loop thread for asyncio futures.
+	// Futures cancelled by the caller are left alone, errors are printed. GIL must be held
+	void ResolveFuture(PyObject* future, PyObject* loop, PyObject* result, PyObject* exception);
+}
@@ -0,0 +1,332 @@
+#include "gil.h"
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+
+namespace py3lm {
+	namespace {
+		std::atomic<uint64_t> s_epochCounter{ 1 };
+
+		uint64_t ElapsedNs(GilClock::time_point start, GilClock::time_point end) {
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+		}
+
+		void StoreMax(std::atomic<uint64_t>& value, uint64_t candidate) {
+			uint64_t current = value.load(std::memory_order_relaxed);
+			while (candidate > current && !value.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {
+			}
+		}
+
+		PyGILState_STATE Acquire(GilPriority& priority) {
+			if (!priority.IsEnabled()) {
+				return PyGILState_Ensure();
+			}
+			if (priority.IsCritical()) {
+				priority.BeginWait();
+				const PyGILState_STATE state = PyGILState_Ensure();
+				priority.EndWait();
+				return state;
+			}
+			priority.Defer();
+			return PyGILState_Ensure();
+		}
+
+		void Restore(GilPriority& priority, PyThreadState* threadState) {
+			if (!priority.IsEnabled()) {
+				PyEval_RestoreThread(threadState);
+				return;
+			}
+			if (priority.IsCritical()) {
+				priority.BeginWait();
+				PyEval_RestoreThread(threadState);
+				priority.EndWait();
+				return;
+			}
+			priority.Defer();
+			PyEval_RestoreThread(threadState);
+		}
+
+		unsigned long ReadSwitchInterval() {
+#if PY_VERSION_HEX >= 0x030C0000 && PY_VERSION_HEX < 0x030D0000
+			const char* const env = std::getenv("PY3LM_GIL_SWITCH_INTERVAL_US");
+			return env ? std::strtoul(env, nullptr, 10) : 0;
+#else
+			return 0;
+#endif
+		}
+	}
+
+	GilPriority::GilPriority() : _generation{ s_epochCounter.fetch_add(1) }, _interval{ ReadSwitchInterval() } {
+	}
+
+	void GilPriority::SetCritical(bool critical) {
+		const std::thread::id id = std::this_thread::get_id();
+		std::lock_guard lock(_mutex);
+		const auto it = std::find(_criticalThreads.begin(), _criticalThreads.end(), id);
+		if (critical == (it != _criticalThreads.end())) {
+			return;
+		}
+		if (critical) {
+			_criticalThreads.push_back(id);
+		}
+		else {
+			_criticalThreads.erase(it);
+		}
+		_generation.store(s_epochCounter.fetch_add(1), std::memory_order_release);
+		UpdateInterval();
+	}
+
+	void GilPriority::ClearCritical() {
+		std::lock_guard lock(_mutex);
+		_criticalThreads.clear();
+		_generation.store(s_epochCounter.fetch_add(1), std::memory_order_release);
+		UpdateInterval();
+	}
+
+	bool GilPriority::IsCritical() const {
+		struct Cache {
+			const GilPriority* owner{};
+			uint64_t generation{};
+			bool critical{};
+		};
+		thread_local Cache t_cache;
+
+		const uint64_t generation = _generation.load(std::memory_order_acquire);
+		if (t_cache.owner == this && t_cache.generation == generation) [[likely]] {
+			return t_cache.critical;
+		}
+		std::lock_guard lock(_mutex);
+		t_cache = { this, generation, std::find(_criticalThreads.begin(), _criticalThreads.end(), std::this_thread::get_id()) != _criticalThreads.end() };
+		return t_cache.critical;
+	}
+
+	// _mutex and the GIL must be held
+	void GilPriority::UpdateInterval() {
+#if PY_VERSION_HEX >= 0x030C0000 && PY_VERSION_HEX < 0x030D0000
+		const bool lower = _interval != 0 && !_criticalThreads.empty();
+		if (lower == _intervalLowered) {
+			return;
+		}
+		if (lower) {
+			_savedInterval = _PyEval_GetSwitchInterval();
+			_PyEval_SetSwitchInterval(std::min(_savedInterval, _interval));
+		}
+		else {
+			_PyEval_SetSwitchInterval(_savedInterval);
+		}
+		_intervalLowered = lower;
+#endif
+	}
+
+	void GilPriority::BeginWait() {
+		_waiters.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void GilPriority::EndWait() {
+		if (_waiters.fetch_sub(1, std::memory_order_release) == 1) {
+			// Lock orders the wakeup after the predicate check of deferred threads
+			{ std::lock_guard lock(_mutex); }
+			_condition.notify_all();
+		}
+	}
+
+	void GilPriority::Defer() {
+		if (_waiters.load(std::memory_order_acquire) == 0) [[likely]] {
+			return;
+		}
+		std::unique_lock lock(_mutex);
+		_condition.wait_for(lock, kMaxDeferral, [this] { return _waiters.load(std::memory_order_acquire) == 0; });
+	}
+
+	thread_local uint32_t GilStats::t_currentTag = GilStats::kModuleTag;
+	thread_local GilClock::time_point GilStats::t_holdStart{};
+	thread_local bool GilStats::t_holdActive = false;
+
+	void GilStats::Histogram::Add(uint64_t ns) {
+		const size_t bucket = std::min<size_t>(static_cast<size_t>(std::bit_width(ns)), kBucketCount - 1);
+		_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+		_count.fetch_add(1, std::memory_order_relaxed);
+		_totalNs.fetch_add(ns, std::memory_order_relaxed);
+		StoreMax(_maxNs, ns);
+	}
+
+	void GilStats::Histogram::CopyTo(Py3lmGilHistogram& out) const {
+		out.count = _count.load(std::memory_order_relaxed);
+		out.totalNs = _totalNs.load(std::memory_order_relaxed);
+		out.maxNs = _maxNs.load(std::memory_order_relaxed);
+		for (size_t i = 0; i < kBucketCount; ++i) {
+			out.buckets[i] = _buckets[i].load(std::memory_order_relaxed);
+		}
+	}
+
+	void GilStats::Histogram::Reset() {
+		// Reset runs on another thread than Add, exchange keeps samples added meanwhile
+		_count.exchange(0, std::memory_order_relaxed);
+		_totalNs.exchange(0, std::memory_order_relaxed);
+		_maxNs.exchange(0, std::memory_order_relaxed);
+		for (auto& bucket : _buckets) {
+			bucket.exchange(0, std::memory_order_relaxed);
+		}
+	}
+
+	GilStats::GilStats() : _epoch{ s_epochCounter.fetch_add(1) } {
+		_tags.emplace_back("<module>");
+	}
+
+	uint32_t GilStats::RegisterTag(const std::string& name) {
+		std::lock_guard lock(_mutex);
+		const auto it = std::find(_tags.begin(), _tags.end(), name);
+		if (it != _tags.end()) {
+			return static_cast<uint32_t>(std::distance(_tags.begin(), it));
+		}
+		_tags.emplace_back(name);
+		return static_cast<uint32_t>(_tags.size() - 1);
+	}
+
+	const char* GilStats::GetTagName(uint32_t tag) const {
+		std::lock_guard lock(_mutex);
+		return tag < _tags.size() ? _tags[tag].c_str() : "";
+	}
+
+	GilStats::Slot& GilStats::GetSlot(uint32_t tag) {
+		struct Cache {
+			uint64_t epoch{};
+			std::vector<Slot*> slots;
+		};
+		thread_local Cache t_cache;
+
+		const uint64_t epoch = _epoch.load(std::memory_order_relaxed);
+		if (t_cache.epoch != epoch) {
+			t_cache.epoch = epoch;
+			t_cache.slots.clear();
+		}
+		if (tag < t_cache.slots.size() && t_cache.slots[tag]) [[likely]] {
+			return *t_cache.slots[tag];
+		}
+
+		std::lock_guard lock(_mutex);
+		Slot& slot = _slots.emplace_back(tag, static_cast<uint64_t>(PyThread_get_thread_native_id()));
+		if (tag >= t_cache.slots.size()) {
+			t_cache.slots.resize(tag + 1);
+		}
+		t_cache.slots[tag] = &slot;
+		return slot;
+	}
+
+	void GilStats::RecordWait(uint32_t tag, uint64_t ns) {
+		GetSlot(tag).wait.Add(ns);
+	}
+
+	void GilStats::RecordHold(uint32_t tag, uint64_t ns) {
+		GetSlot(tag).hold.Add(ns);
+	}
+
+	size_t GilStats::Snapshot(Py3lmGilStats* stats, size_t count) const {
+		std::lock_guard lock(_mutex);
+		if (!stats) {
+			return _slots.size();
+		}
+		const size_t size = std::min(count, _slots.size());
+		for (size_t i = 0; i < size; ++i) {
+			const Slot& slot = _slots[i];
+			Py3lmGilStats& out = stats[i];
+			out.plugin = _tags[slot.tag].c_str();
+			out.threadId = slot.threadId;
+			slot.wait.CopyTo(out.wait);
+			slot.hold.CopyTo(out.hold);
+		}
+		return size;
+	}
+
+	void GilStats::Reset() {
+		std::lock_guard lock(_mutex);
+		for (auto& slot : _slots) {
+			slot.wait.Reset();
+			slot.hold.Reset();
+		}
+	}
+
+	void GilStats::Clear() {
+		std::lock_guard lock(_mutex);
+		// Invalidate thread caches before slots are gone
+		_epoch.store(s_epochCounter.fetch_add(1), std::memory_order_relaxed);
+		_slots.clear();
+		// Tag names are kept, Snapshot and GetTagName hand out pointers to them
+	}
+
+	GilEnterScope::GilEnterScope(GilStats& stats, uint32_t tag) : _stats{stats}, _tag{tag}, _prevTag{GilStats::t_currentTag}, _nested{PyGILState_Check() != 0}, _prevHoldActive{GilStats::t_holdActive} {
+		GilStats::t_currentTag = tag;
+		if (_nested) {
+			// Already holding the GIL, only split the hold segment between the tags
+			if (GilStats::t_holdActive && _prevTag != _tag) {
+				const auto now = GilClock::now();
+				_stats.RecordHold(_prevTag, ElapsedNs(GilStats::t_holdStart, now));
+				GilStats::t_holdStart = now;
+			}
+			_state = PyGILState_Ensure();
+			return;
+		}
+		const auto start = GilClock::now();
+		_state = Acquire(_stats.Priority());
+		const auto acquired = GilClock::now();
+		_stats.RecordWait(_tag, ElapsedNs(start, acquired));
+		GilStats::t_holdStart = acquired;
+		GilStats::t_holdActive = true;
+	}
+
+	GilEnterScope::~GilEnterScope() {
+		if (GilStats::t_holdActive && (!_nested || _prevTag != _tag)) {
+			const auto now = GilClock::now();
+			_stats.RecordHold(_tag, ElapsedNs(GilStats::t_holdStart, now));
+			GilStats::t_holdStart = now;
+		}
+		// Restore outer state when entered from native code called by Python with the GIL released
+		GilStats::t_holdActive = _prevHoldActive;
+		GilStats::t_currentTag = _prevTag;
+		PyGILState_Release(_state);
+	}
+
+	GilTimingScope::GilTimingScope(GilStats& stats, uint32_t tag) : _stats{stats}, _tag{tag}, _prevTag{GilStats::t_currentTag}, _prevHoldActive{GilStats::t_holdActive} {
+		_start = GilClock::now();
+		// A hold segment of the outer tag ends here, it resumes with the scope
+		if (GilStats::t_holdActive) {
+			_stats.RecordHold(_prevTag, ElapsedNs(GilStats::t_holdStart, _start));
+		}
+		GilStats::t_currentTag = tag;
+		GilStats::t_holdActive = false;
+	}
+
+	void GilTimingScope::Acquired() {
+		const auto acquired = GilClock::now();
+		_stats.RecordWait(_tag, ElapsedNs(_start, acquired));
+		GilStats::t_holdStart = acquired;
+		GilStats::t_holdActive = true;
+	}
+
+	GilTimingScope::~GilTimingScope() {
+		const auto now = GilClock::now();
+		if (GilStats::t_holdActive) {
+			_stats.RecordHold(_tag, ElapsedNs(GilStats::t_holdStart, now));
+		}
+		GilStats::t_holdStart = now;
+		GilStats::t_holdActive = _prevHoldActive;
+		GilStats::t_currentTag = _prevTag;
+	}
+
+	GilReleaseScope::GilReleaseScope(GilStats& stats) : _stats{stats} {
+		if (GilStats::t_holdActive) {
+			_stats.RecordHold(GilStats::t_currentTag, ElapsedNs(GilStats::t_holdStart, GilClock::now()));
+		}
+		_threadState = PyEval_SaveThread();
+	}
+
+	GilReleaseScope::~GilReleaseScope() {
+		const auto start = GilClock::now();
+		Restore(_stats.Priority(), _threadState);
+		const auto acquired = GilClock::now();
+		if (GilStats::t_holdActive) {
+			_stats.RecordWait(GilStats::t_currentTag, ElapsedNs(start, acquired));
+			GilStats::t_holdStart = acquired;
+		}
+	}
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+	// Buckets are log2 of nanoseconds: bucket N counts samples in [2^(N-1), 2^N) ns
+	struct Py3lmGilHistogram {
+		uint64_t count;
+		uint64_t totalNs;
+		uint64_t maxNs;
+		uint64_t buckets[40];
+	};
+
+	struct Py3lmGilStats {
+		const char* plugin; // valid until the language module is unloaded, also across Reset and re-initialization
+		uint64_t threadId;
+		Py3lmGilHistogram wait;
+		Py3lmGilHistogram hold;
+	};
+}
+
+namespace py3lm {
+	using GilClock = std::chrono::steady_clock;
+
+	// GIL handoff to latency-critical threads (host main thread by default), off unless
+	// PY3LM_GIL_SWITCH_INTERVAL_US is set. A thread already running Python keeps the GIL until the waiter's
+	// switch interval runs out. The interval can only be changed with the GIL held and a waiter reads it
+	// when it starts waiting, so it cannot be lowered for a single wait. When enabled, it is lowered for as
+	// long as a critical thread is registered, at the cost of more frequent switches between all Python
+	// threads, and module entry points of other threads hold back (up to kMaxDeferral) while a critical
+	// thread waits, so they do not win the handoff. It uses private _PyEval_SetSwitchInterval and is only built for 3.12
+	class GilPriority {
+	public:
+		static constexpr auto kMaxDeferral = std::chrono::milliseconds(2);
+
+		GilPriority();
+
+		// Must be called with the GIL held, applies to the current thread
+		void SetCritical(bool critical);
+		// Unregisters critical threads of every thread and restores the switch interval, GIL must be held
+		void ClearCritical();
+		bool IsCritical() const;
+		bool IsEnabled() const { return _interval != 0; }
+
+		void BeginWait();
+		void EndWait();
+		void Defer();
+
+	private:
+		void UpdateInterval();
+
+		mutable std::mutex _mutex;
+		std::condition_variable _condition;
+		std::atomic<uint32_t> _waiters{};
+		std::vector<std::thread::id> _criticalThreads;
+		// Bumped on every change of the critical threads, invalidates per-thread IsCritical caches
+		std::atomic<uint64_t> _generation;
+		unsigned long _interval; // lowered interval in us, 0 when not enabled
+		unsigned long _savedInterval = 0;
+		bool _intervalLowered = false;
+	};
+
+	class GilStats {
+	public:
+		static constexpr size_t kBucketCount = std::size(Py3lmGilHistogram{}.buckets);
+		// Tag used for work not attributed to any plugin (module init, exports)
+		static constexpr uint32_t kModuleTag = 0;
+
+		GilStats();
+
+		uint32_t RegisterTag(const std::string& name);
+		// Names are never removed, the pointer is stable for the lifetime of stats
+		const char* GetTagName(uint32_t tag) const;
+		void RecordWait(uint32_t tag, uint64_t ns);
+		void RecordHold(uint32_t tag, uint64_t ns);
+		size_t Snapshot(Py3lmGilStats* stats, size_t count) const;
+		void Reset();
+		void Clear();
+
+		static uint32_t CurrentTag() { return t_currentTag; }
+		GilPriority& Priority() { return _priority; }
+
+	private:
+		class Histogram {
+		public:
+			void Add(uint64_t ns);
+			void CopyTo(Py3lmGilHistogram& out) const;
+			void Reset();
+
+		private:
+			// Every slot is written only by its own thread, atomic adds keep samples recorded during Reset
+			std::atomic<uint64_t> _count{};
+			std::atomic<uint64_t> _totalNs{};
+			std::atomic<uint64_t> _maxNs{};
+			std::array<std::atomic<uint64_t>, kBucketCount> _buckets{};
+		};
+
+		struct Slot {
+			uint32_t tag;
+			uint64_t threadId;
+			Histogram wait;
+			Histogram hold;
+		};
+
+		Slot& GetSlot(uint32_t tag);
+
+		mutable std::mutex _mutex;
+		std::deque<std::string> _tags;
+		std::deque<Slot> _slots;
+		std::atomic<uint64_t> _epoch;
+		GilPriority _priority;
+
+		friend class GilEnterScope;
+		friend class GilReleaseScope;
+		friend class GilTimingScope;
+		static thread_local uint32_t t_currentTag;
+		static thread_local GilClock::time_point t_holdStart;
+		static thread_local bool t_holdActive;
+	};
+
+	// Acquire GIL on native -> Python entry, records wait and hold time for the given plugin tag
+	class GilEnterScope {
+	public:
+		GilEnterScope(GilStats& stats, uint32_t tag);
+		~GilEnterScope();
+		GilEnterScope(const GilEnterScope&) = delete;
+		GilEnterScope& operator=(const GilEnterScope&) = delete;
+
+	private:
+		GilStats& _stats;
+		PyGILState_STATE _state;
+		uint32_t _tag;
+		uint32_t _prevTag;
+		bool _nested;
+		bool _prevHoldActive;
+	};
+
+	// Records wait and hold time for the given plugin tag of a GIL the caller takes itself, such as the own GIL of
+	// a replica interpreter. Construct right before taking it and call Acquired once it is held, the hold ends with the scope
+	class GilTimingScope {
+	public:
+		GilTimingScope(GilStats& stats, uint32_t tag);
+		~GilTimingScope();
+		GilTimingScope(const GilTimingScope&) = delete;
+		GilTimingScope& operator=(const GilTimingScope&) = delete;
+
+		void Acquired();
+
+	private:
+		GilStats& _stats;
+		GilClock::time_point _start;
+		uint32_t _tag;
+		uint32_t _prevTag;
+		bool _prevHoldActive;
+	};
+
+	// Release GIL on Python -> native exit, the hold segment ends here and a new wait starts on return
+	class GilReleaseScope {
+	public:
+		explicit GilReleaseScope(GilStats& stats);
+		~GilReleaseScope();
+		GilReleaseScope(const GilReleaseScope&) = delete;
+		GilReleaseScope& operator=(const GilReleaseScope&) = delete;
+
+	private:
+		GilStats& _stats;
+		PyThreadState* _threadState;
+	};
+}
@@ -0,0 +1,241 @@
+#include "handles.h"
+#include "gil.h"
+#include <vector>
+
+namespace py3lm {
+	namespace {
+		constexpr uint32_t kNoSlot = UINT32_MAX;
+
+		struct HandleSlot {
+			PyObject* object; // null while free
+			uint32_t generation; // bumped on release, so old handles of a reused slot are rejected
+			uint32_t owner;
+			uint32_t nextFree;
+		};
+
+		struct HandleCounters {
+			uint64_t live;
+			uint64_t pinned;
+			uint64_t released;
+			uint64_t stale;
+		};
+
+		// Handle is slot index in the low half and generation in the high half.
+		// Generations start at 1, so 0 is never a valid handle
+		class HandleTable {
+		public:
+			uint64_t Pin(PyObject* object, uint32_t tag) {
+				uint32_t index = _freeHead;
+				if (index != kNoSlot) {
+					_freeHead = _slots[index].nextFree;
+				}
+				else {
+					index = static_cast<uint32_t>(_slots.size());
+					_slots.push_back({ nullptr, 1, 0, kNoSlot });
+				}
+				HandleSlot& slot = _slots[index];
+				slot.object = Py_NewRef(object);
+				slot.owner = tag;
+				HandleCounters& counters = GetCounters(tag);
+				++counters.live;
+				++counters.pinned;
+				return (static_cast<uint64_t>(slot.generation) << 32) | index;
+			}
+
+			HandleSlot* Find(uint64_t handle) {
+				const uint32_t index = static_cast<uint32_t>(handle);
+				if (index >= _slots.size()) {
+					return nullptr;
+				}
+				HandleSlot& slot = _slots[index];
+				return slot.object && slot.generation == static_cast<uint32_t>(handle >> 32) ? &slot : nullptr;
+			}
+
+			// Returns the reference held by the slot
+			PyObject* Release(HandleSlot& slot) {
+				PyObject* const object = slot.object;
+				slot.object = nullptr;
+				if (++slot.generation == 0) {
+					slot.generation = 1;
+				}
+				slot.nextFree = _freeHead;
+				_freeHead = static_cast<uint32_t>(&slot - _slots.data());
+				HandleCounters& counters = GetCounters(slot.owner);
+				--counters.live;
+				++counters.released;
+				return object;
+			}
+
+			// Releasing may run finalizers that pin new handles, so slots are revisited by index
+			size_t ReleaseOwned(uint32_t tag) {
+				size_t released = 0;
+				for (size_t i = 0; i < _slots.size(); ++i) {
+					if (_slots[i].object && _slots[i].owner == tag) {
+						Py_DECREF(Release(_slots[i]));
+						++released;
+					}
+				}
+				return released;
+			}
+
+			bool IsFull() const {
+				return _freeHead == kNoSlot && _slots.size() >= kNoSlot;
+			}
+
+			HandleCounters& GetCounters(uint32_t tag) {
+				if (tag >= _counters.size()) {
+					_counters.resize(tag + 1);
+				}
+				return _counters[tag];
+			}
+
+			const std::vector<HandleCounters>& GetAllCounters() const {
+				return _counters;
+			}
+
+		private:
+			std::vector<HandleSlot> _slots;
+			std::vector<HandleCounters> _counters; // by plugin tag
+			uint32_t _freeHead = kNoSlot;
+		};
+
+		HandleTable* s_table = nullptr;
+		GilStats* s_gilStats = nullptr;
+		HandleOwnerFunc s_owner = nullptr;
+
+		HandleTable* GetTable() {
+			if (!s_table) {
+				PyErr_SetString(PyExc_RuntimeError, "Handle table is shut down");
+			}
+			return s_table;
+		}
+
+		// Accepts handles that came back through signed integer parameters too
+		HandleSlot* Lookup(HandleTable& table, PyObject* arg) {
+			const uint64_t handle = PyLong_AsUnsignedLongLongMask(arg);
+			if (handle == static_cast<uint64_t>(-1) && PyErr_Occurred()) {
+				return nullptr;
+			}
+			if (HandleSlot* const slot = table.Find(handle)) {
+				return slot;
+			}
+			++table.GetCounters(s_owner()).stale;
+			PyErr_Format(PyExc_LookupError, "Invalid or released handle 0x%llx", static_cast<unsigned long long>(handle));
+			return nullptr;
+		}
+
+		PyObject* Handles_pin(PyObject* /*self*/, PyObject* object) {
+			HandleTable* const table = GetTable();
+			if (!table) {
+				return nullptr;
+			}
+			if (table->IsFull()) {
+				PyErr_SetString(PyExc_MemoryError, "Handle table is full");
+				return nullptr;
+			}
+			return PyLong_FromUnsignedLongLong(table->Pin(object, s_owner()));
+		}
+
+		PyObject* Handles_get(PyObject* /*self*/, PyObject* arg) {
+			HandleTable* const table = GetTable();
+			if (!table) {
+				return nullptr;
+			}
+			HandleSlot* const slot = Lookup(*table, arg);
+			return slot ? Py_NewRef(slot->object) : nullptr;
+		}
+
+		PyObject* Handles_release(PyObject* /*self*/, PyObject* arg) {
+			HandleTable* const table = GetTable();
+			if (!table) {
+				return nullptr;
+			}
+			HandleSlot* const slot = Lookup(*table, arg);
+			return slot ? table->Release(*slot) : nullptr;
+		}
+
+		PyObject* Handles_release_all(PyObject* /*self*/, PyObject* /*args*/) {
+			HandleTable* const table = GetTable();
+			if (!table) {
+				return nullptr;
+			}
+			return PyLong_FromSize_t(table->ReleaseOwned(s_owner()));
+		}
+
+		PyObject* Handles_stats(PyObject* /*self*/, PyObject* /*args*/) {
+			HandleTable* const table = GetTable();
+			if (!table) {
+				return nullptr;
+			}
+			PyObject* const result = PyDict_New();
+			if (!result) {
+				return nullptr;
+			}
+			const auto& counters = table->GetAllCounters();
+			for (size_t tag = 0; tag < counters.size(); ++tag) {
+				const HandleCounters& entry = counters[tag];
+				if (!entry.pinned && !entry.stale) {
+					continue;
+				}
+				PyObject* const value = Py_BuildValue("(KKKK)", entry.live, entry.pinned, entry.released, entry.stale);
+				if (!value || PyDict_SetItemString(result, s_gilStats->GetTagName(static_cast<uint32_t>(tag)), value) != 0) {
+					Py_XDECREF(value);
+					Py_DECREF(result);
+					return nullptr;
+				}
+				Py_DECREF(value);
+			}
+			return result;
+		}
+
+		PyMethodDef s_handlesMethods[] = {
+			{ "pin", Handles_pin, METH_O, "pin(obj) - keep obj alive and return its handle" },
+			{ "get", Handles_get, METH_O, "get(handle) - object pinned under handle" },
+			{ "release", Handles_release, METH_O, "release(handle) - unpin and return the object" },
+			{ "release_all", Handles_release_all, METH_NOARGS, "release_all() - unpin all handles of the calling plugin" },
+			{ "stats", Handles_stats, METH_NOARGS, "stats() - {plugin: (live, pinned, released, stale)}" },
+			{ nullptr, nullptr, 0, nullptr }
+		};
+
+		PyModuleDef s_handlesModule = {
+			PyModuleDef_HEAD_INIT,
+			"plugify.handles",
+			"Integer handles to Python objects passed through native code",
+			-1,
+			s_handlesMethods,
+			nullptr,
+			nullptr,
+			nullptr,
+			nullptr
+		};
+	}
+
+	PyObject* CreateHandlesModule(GilStats& stats, HandleOwnerFunc owner) {
+		PyObject* const module = PyModule_Create(&s_handlesModule);
+		if (!module) {
+			return nullptr;
+		}
+		s_gilStats = &stats;
+		s_owner = owner;
+		s_table = new HandleTable();
+		return module;
+	}
+
+	size_t ReleaseHandles(uint32_t tag) {
+		return s_table ? s_table->ReleaseOwned(tag) : 0;
+	}
+
+	void ClearHandles() {
+		// Detached first, finalizers of released objects see a closed table
+		HandleTable* const table = s_table;
+		s_table = nullptr;
+		if (!table) {
+			return;
+		}
+		const auto& counters = table->GetAllCounters();
+		for (size_t tag = 0; tag < counters.size(); ++tag) {
+			table->ReleaseOwned(static_cast<uint32_t>(tag));
+		}
+		delete table;
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace py3lm {
+	class GilStats;
+
+	// Creates 'plugify.handles' module, a table of pinned objects addressed by integer handles
+	// that pass through native code as Pointer or UInt64 values:
+	//   pin(obj)         - keep obj alive, returns a non-zero handle owned by the calling plugin
+	//   get(handle)      - pinned object, LookupError for released or unknown handles
+	//   release(handle)  - unpin and return the object
+	//   release_all()    - unpin every handle of the calling plugin, returns their number
+	//   stats()          - {plugin: (live, pinned, released, stale)}
+	// The calling plugin is the GIL tag returned by owner, called with the GIL held
+	using HandleOwnerFunc = uint32_t (*)();
+	PyObject* CreateHandlesModule(GilStats& stats, HandleOwnerFunc owner);
+
+	// Unpins all handles of a plugin, GIL must be held. Returns number of handles released
+	size_t ReleaseHandles(uint32_t tag);
+
+	// Drops the table, GIL must be held
+	void ClearHandles();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+extern "C" {
+	// Cumulative time spent in module entry points and JIT, all durations in nanoseconds
+	struct Py3lmLoadStats {
+		uint64_t initializeNs;
+		uint64_t pluginLoadNs;
+		uint64_t methodExportNs;
+		uint64_t pluginStartNs;
+		uint64_t jitNs;
+		uint64_t jitCount;
+		uint64_t activationNs; // import of dormant plugins on first use
+		uint64_t activationCount;
+	};
+}
+
+namespace py3lm {
+	// Adds duration of the scope to a counter
+	class LoadTimer {
+	public:
+		explicit LoadTimer(uint64_t& counter) : _counter{counter}, _start{std::chrono::steady_clock::now()} {}
+		~LoadTimer() {
+			_counter += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count());
+		}
+		LoadTimer(const LoadTimer&) = delete;
+		LoadTimer& operator=(const LoadTimer&) = delete;
+
+	private:
+		uint64_t& _counter;
+		std::chrono::steady_clock::time_point _start;
+	};
+}
@@ -1,4 +1,14 @@
 #include "module.h"
+#include "batch.h"
+#include "file_io.h"
+#include "futures.h"
+#include "handles.h"
+#include "probes.h"
+#include "ref_audit.h"
+#include "snapshot.h"
+#include "spatial.h"
+#include "timers.h"
+#include "vector_kernels.h"
 #include <plugify/plugify_provider.h>
 #include <plugify/compat_format.h>
 #include <plugify/log.h>
@@ -9,8 +19,11 @@
 #include <module_export.h>
 #include <dyncall/dyncall.h>
 #include <cuchar>
+#include <cstring>
 #include <climits>
+#include <cstdlib>
 #include <array>
+#include <bit>
 
 using namespace plugify;
 namespace fs = std::filesystem;
@@ -19,6 +32,41 @@ namespace py3lm {
 	extern Python3LanguageModule g_py3lm;
 
 	namespace {
+		constexpr const char* kExternalTargetName = "plugify.external_target";
+
+		// Thunk kinds of jit_thunk probes: Python callback, Python wrapper of a native function, pps module function
+		constexpr const char* kJitThunkInternal = "internal";
+		constexpr const char* kJitThunkExternal = "external";
+		constexpr const char* kJitThunkModule = "module";
+
+		// Plugin name for probe arguments, copied only while a tracer is attached
+		std::string ProbePluginName(PluginRef plugin, bool traced) {
+			return traced ? std::string(plugin.GetName()) : std::string();
+		}
+
+		void AppendSignature(std::string& signature, MethodRef method);
+
+		void AppendSignature(std::string& signature, PropertyRef type) {
+			signature.push_back(static_cast<char>(type.GetType()));
+			if (type.IsReference()) {
+				signature.push_back('&');
+			}
+			if (const auto prototype = type.GetPrototype()) {
+				signature.push_back('(');
+				AppendSignature(signature, *prototype);
+				signature.push_back(')');
+			}
+		}
+
+		// Everything conversion code reads from method, equal strings may share one thunk
+		void AppendSignature(std::string& signature, MethodRef method) {
+			AppendSignature(signature, method.GetReturnType());
+			signature.push_back(':');
+			for (const PropertyRef paramType : method.GetParamTypes()) {
+				AppendSignature(signature, paramType);
+			}
+		}
+
 		void ReplaceAll(std::string& str, const std::string& from, const std::string& to) {
 			size_t start_pos{};
 			while ((start_pos = str.find(from, start_pos)) != std::string::npos) {
@@ -27,6 +75,21 @@ namespace py3lm {
 			}
 		}
 
+		// PY3LM_LAZY_PLUGINS=name,name or * lists plugins imported on first use instead of at load
+		std::vector<std::string> ReadLazyPlugins() {
+			std::vector<std::string> names;
+			const char* const env = std::getenv("PY3LM_LAZY_PLUGINS");
+			std::string_view list = env ? env : "";
+			while (!list.empty()) {
+				const auto pos = list.find(',');
+				if (const std::string_view name = list.substr(0, pos); !name.empty()) {
+					names.emplace_back(name);
+				}
+				list = pos == std::string_view::npos ? std::string_view{} : list.substr(pos + 1);
+			}
+			return names;
+		}
+
 		bool IsStaticMethod(PyObject* obj) {
 			if (PyCFunction_Check(obj)) {
 				PyCFunctionObject* cfunc = reinterpret_cast<PyCFunctionObject*>(obj);
@@ -110,8 +173,9 @@ namespace py3lm {
 		}
 
 		using MethodExportError = std::string;
-		using MethodExportData = PythonMethodData;
+		using MethodExportData = std::unique_ptr<PythonMethodData>;
 		using MethodExportResult = std::variant<MethodExportError, MethodExportData>;
+		using MethodResolveResult = std::variant<MethodExportError, PyObject*>;
 
 		template<class T>
 		inline constexpr bool always_false_v = std::is_same_v<std::decay_t<T>, std::add_cv_t<std::decay_t<T>>>;
@@ -316,15 +380,11 @@ namespace py3lm {
 		}
 
 		template<typename T>
-		std::optional<std::vector<T>> ArrayFromObject(PyObject* arrayObject) {
-			if (!PyList_Check(arrayObject)) {
-				PyErr_SetString(PyExc_TypeError, "Not list");
-				return std::nullopt;
-			}
-			const Py_ssize_t size = PyList_Size(arrayObject);
+		std::optional<std::vector<T>> ArrayFromSequenceItems(PyObject* arrayObject, PyObject* (*getItem)(PyObject*, Py_ssize_t)) {
+			const Py_ssize_t size = PySequence_Size(arrayObject);
 			std::vector<T> array(static_cast<size_t>(size));
 			for (Py_ssize_t i = 0; i < size; ++i) {
-				if (PyObject* const valueObject = PyList_GetItem(arrayObject, i)) {
+				if (PyObject* const valueObject = getItem(arrayObject, i)) {
 					if (auto value = ValueFromObject<T>(valueObject)) {
 						array[static_cast<size_t>(i)] = std::move(*value);
 						continue;
@@ -335,928 +395,573 @@ namespace py3lm {
 			return array;
 		}
 
+		template<typename T>
+		std::optional<std::vector<T>> ArrayFromObject(PyObject* arrayObject) {
+			if (PyList_Check(arrayObject)) {
+				return ArrayFromSequenceItems<T>(arrayObject, &PyList_GetItem);
+			}
+			if (PyTuple_Check(arrayObject)) {
+				return ArrayFromSequenceItems<T>(arrayObject, &PyTuple_GetItem);
+			}
+			// Strings are iterable too, but never meant as array of characters.
+			// Mappings and sets would pass their keys in arbitrary order
+			if (PyUnicode_Check(arrayObject) || PyBytes_Check(arrayObject) || PyByteArray_Check(arrayObject) || PyDict_Check(arrayObject) || PyAnySet_Check(arrayObject)) {
+				PyErr_Format(PyExc_TypeError, "Not list or iterable of items ('%s' not accepted as array)", Py_TYPE(arrayObject)->tp_name);
+				return std::nullopt;
+			}
+
+			// Other iterables (generators) are consumed straight into the array, without intermediate list
+			PyObject* const iterator = PyObject_GetIter(arrayObject);
+			if (!iterator) {
+				PyErr_SetString(PyExc_TypeError, "Not list or iterable");
+				return std::nullopt;
+			}
+			std::vector<T> array;
+			const Py_ssize_t sizeHint = PyObject_LengthHint(arrayObject, 0);
+			if (sizeHint < 0) {
+				Py_DECREF(iterator);
+				return std::nullopt;
+			}
+			array.reserve(static_cast<size_t>(sizeHint));
+			while (PyObject* const valueObject = PyIter_Next(iterator)) {
+				auto value = ValueFromObject<T>(valueObject);
+				Py_DECREF(valueObject);
+				if (!value) {
+					Py_DECREF(iterator);
+					return std::nullopt;
+				}
+				array.push_back(std::move(*value));
+			}
+			Py_DECREF(iterator);
+			if (PyErr_Occurred()) {
+				return std::nullopt;
+			}
+			return array;
+		}
+
 		std::optional<void*> GetOrCreateFunctionValue(MethodRef method, PyObject* object) {
 			return g_py3lm.GetOrCreateFunctionValue(method, object);
 		}
 
 		template<typename T>
-		void* CreateValue(PyObject* pItem) {
-			auto value = ValueFromObject<T>(pItem);
-			if (value) {
-				return new T(std::move(*value));
-			}
+		PyObject* CreatePyObject(T /*value*/) {
+			static_assert(always_false_v<T>, "CreatePyObject specialization required");
 			return nullptr;
 		}
 
-		template<typename T>
-		void* CreateArray(PyObject* pItem) {
-			auto array = ArrayFromObject<T>(pItem);
-			if (array) {
-				return new std::vector<T>(std::move(*array));
+		template<>
+		PyObject* CreatePyObject(bool value) {
+			return PyBool_FromLong(value);
+		}
+
+		template<>
+		PyObject* CreatePyObject(char value) {
+			if (value == char{ 0 }) {
+				return PyUnicode_FromStringAndSize(nullptr, Py_ssize_t{ 0 });
 			}
-			return nullptr;
+			return PyUnicode_FromStringAndSize(&value, Py_ssize_t{ 1 });
 		}
 
-		void SetFallbackReturn(ValueType retType, const ReturnValue* ret, const Parameters* params) {
-			switch (retType) {
-			case ValueType::Void:
-				break;
-			case ValueType::Bool:
-			case ValueType::Char8:
-			case ValueType::Char16:
-			case ValueType::Int8:
-			case ValueType::Int16:
-			case ValueType::Int32:
-			case ValueType::Int64:
-			case ValueType::UInt8:
-			case ValueType::UInt16:
-			case ValueType::UInt32:
-			case ValueType::UInt64:
-			case ValueType::Pointer:
-			case ValueType::Float:
-			case ValueType::Double:
-				// HACK: Fill all 8 byte with 0
-				ret->SetReturnPtr<uintptr_t>({});
-				break;
-			case ValueType::String: {
-				auto* const returnParam = params->GetArgument<std::string*>(0);
-				std::construct_at(returnParam);
-				break;
+		template<>
+		PyObject* CreatePyObject(char16_t value) {
+			if (value == char16_t{ 0 }) {
+				return PyUnicode_FromStringAndSize(nullptr, Py_ssize_t{ 0 });
 			}
-			case ValueType::Function:
-				ret->SetReturnPtr<void*>(nullptr);
-				break;
-			case ValueType::ArrayChar8:
-			case ValueType::ArrayChar16:
-			case ValueType::ArrayInt8:
-			case ValueType::ArrayInt16:
-			case ValueType::ArrayInt32:
-			case ValueType::ArrayInt64:
-			case ValueType::ArrayUInt8:
-			case ValueType::ArrayUInt16:
-			case ValueType::ArrayUInt32:
-			case ValueType::ArrayUInt64:
-			case ValueType::ArrayPointer:
-			case ValueType::ArrayFloat:
-			case ValueType::ArrayDouble: {
-				// HACK: Assume the same structure for empty array
-				auto* const returnParam = params->GetArgument<std::vector<uintptr_t>*>(0);
-				std::construct_at(returnParam);
-				break;
+			const auto [rc, out] = ConvertUtf16ToUtf8(value);
+			if (rc == -1) {
+				PyErr_SetString(PyExc_ValueError, "Surrogate pair");
+				return nullptr;
 			}
-			case ValueType::ArrayString: {
-				auto* const returnParam = params->GetArgument<std::vector<std::string>*>(0);
-				std::construct_at(returnParam);
-				break;
+			return PyUnicode_FromStringAndSize(out.data(), static_cast<Py_ssize_t>(rc));
+		}
+
+		template<>
+		PyObject* CreatePyObject(int8_t value) {
+			return PyLong_FromLong(value);
+		}
+
+		template<>
+		PyObject* CreatePyObject(int16_t value) {
+			return PyLong_FromLong(value);
+		}
+
+		template<>
+		PyObject* CreatePyObject(int32_t value) {
+			return PyLong_FromLong(value);
+		}
+
+		template<>
+		PyObject* CreatePyObject(int64_t value) {
+			return PyLong_FromLongLong(value);
+		}
+
+		template<>
+		PyObject* CreatePyObject(uint8_t value) {
+			return PyLong_FromUnsignedLong(value);
+		}
+
+		template<>
+		PyObject* CreatePyObject(uint16_t value) {
+			return PyLong_FromUnsignedLong(value);
+		}
+
+		template<>
+		PyObject* CreatePyObject(uint32_t value) {
+			return PyLong_FromUnsignedLong(value);
+		}
+
+		template<>
+		PyObject* CreatePyObject(uint64_t value) {
+			return PyLong_FromUnsignedLongLong(value);
+		}
+
+		template<>
+		PyObject* CreatePyObject(void* value) {
+			return PyLong_FromVoidPtr(value);
+		}
+
+		template<>
+		PyObject* CreatePyObject(float value) {
+			return PyFloat_FromDouble(static_cast<double>(value));
+		}
+
+		template<>
+		PyObject* CreatePyObject(double value) {
+			return PyFloat_FromDouble(value);
+		}
+
+		template<>
+		PyObject* CreatePyObject(std::string value) {
+			return PyUnicode_FromStringAndSize(value.data(), static_cast<Py_ssize_t>(value.size()));
+		}
+
+		template<>
+		PyObject* CreatePyObject(Vector2 value) {
+			return g_py3lm.CreateVector2Object(value);
+		}
+
+		template<>
+		PyObject* CreatePyObject(Vector3 value) {
+			return g_py3lm.CreateVector3Object(value);
+		}
+
+		template<>
+		PyObject* CreatePyObject(Vector4 value) {
+			return g_py3lm.CreateVector4Object(value);
+		}
+
+		template<>
+		PyObject* CreatePyObject(Matrix4x4 value) {
+			return g_py3lm.CreateMatrix4x4Object(value);
+		}
+
+		PyObject* GetOrCreateFunctionObject(MethodRef method, void* funcAddr) {
+			return g_py3lm.GetOrCreateFunctionObject(method, funcAddr);
+		}
+
+		template<typename T>
+		PyObject* CreatePyObjectList(const std::vector<T>& arrayArg) {
+			const auto size = static_cast<Py_ssize_t>(arrayArg.size());
+			PyObject* const arrayObject = PyList_New(size);
+			if (arrayObject) {
+				for (Py_ssize_t i = 0; i < size; ++i) {
+					PyObject* const valueObject = CreatePyObject(arrayArg[i]);
+					if (!valueObject) {
+						Py_DECREF(arrayObject);
+						return nullptr;
+					}
+					PyList_SET_ITEM(arrayObject, i, valueObject);
+				}
 			}
-			case ValueType::Vector2: {
-				ret->SetReturnPtr<Vector2>({});
-				break;
+			return arrayObject;
+		}
+
+		template<typename T>
+		constexpr bool is_vector_v = false;
+		template<typename T>
+		constexpr bool is_vector_v<std::vector<T>> = true;
+
+		template<typename T>
+		std::optional<T> ConvertFromObject(PyObject* object) {
+			if constexpr (is_vector_v<T>) {
+				return ArrayFromObject<typename T::value_type>(object);
 			}
-#if PY3LM_PLATFORM_WINDOWS
-			case ValueType::Vector3: {
-				auto* const returnParam = params->GetArgument<Vector3*>(0);
-				std::construct_at(returnParam);
-				ret->SetReturnPtr<Vector3*>(returnParam);
-				break;
+			else {
+				return ValueFromObject<T>(object);
 			}
-			case ValueType::Vector4: {
-				auto* const returnParam = params->GetArgument<Vector4*>(0);
-				std::construct_at(returnParam);
-				ret->SetReturnPtr<Vector4*>(returnParam);
-				break;
+		}
+
+		template<typename T>
+		PyObject* ConvertToObject(const T& value) {
+			if constexpr (is_vector_v<T>) {
+				return CreatePyObjectList(value);
 			}
-#elif PY3LM_PLATFORM_LINUX || PY3LM_PLATFORM_APPLE
-			case ValueType::Vector3: {
-				ret->SetReturnPtr<Vector3>({});
-				break;
+			else {
+				return CreatePyObject(value);
 			}
-			case ValueType::Vector4: {
-				ret->SetReturnPtr<Vector4>({});
-				break;
+		}
+
+		template<typename T>
+		void* CreateValue(PyObject* pItem) {
+			auto value = ConvertFromObject<T>(pItem);
+			if (value) {
+				return new T(std::move(*value));
 			}
-#endif // PY3LM_PLATFORM_WINDOWS
-			case ValueType::Matrix4x4: {
-				auto* const returnParam = params->GetArgument<Matrix4x4*>(0);
-				std::construct_at(returnParam);
-				ret->SetReturnPtr<Matrix4x4*>(returnParam);
-				break;
+			return nullptr;
+		}
+
+		// How a value crosses the native boundary, everything per type is derived from it
+		enum class ValueKind {
+			Unsupported,
+			Void,
+			Scalar,   // passed and returned by value in registers
+			Function, // native function pointer, Python callable on the other side
+			Object,   // string and arrays, returned through hidden parameter
+			Struct    // vectors and matrix, returned as aggregate
+		};
+
+		template<ValueKind K, typename T = void>
+		struct ValueTraitsBase {
+			static constexpr ValueKind kind = K;
+			using Type = T;
+		};
+
+		template<ValueType V>
+		struct ValueTraits : ValueTraitsBase<ValueKind::Unsupported> {};
+		template<> struct ValueTraits<ValueType::Void> : ValueTraitsBase<ValueKind::Void> {};
+		template<> struct ValueTraits<ValueType::Bool> : ValueTraitsBase<ValueKind::Scalar, bool> {};
+		template<> struct ValueTraits<ValueType::Char8> : ValueTraitsBase<ValueKind::Scalar, char> {};
+		template<> struct ValueTraits<ValueType::Char16> : ValueTraitsBase<ValueKind::Scalar, char16_t> {};
+		template<> struct ValueTraits<ValueType::Int8> : ValueTraitsBase<ValueKind::Scalar, int8_t> {};
+		template<> struct ValueTraits<ValueType::Int16> : ValueTraitsBase<ValueKind::Scalar, int16_t> {};
+		template<> struct ValueTraits<ValueType::Int32> : ValueTraitsBase<ValueKind::Scalar, int32_t> {};
+		template<> struct ValueTraits<ValueType::Int64> : ValueTraitsBase<ValueKind::Scalar, int64_t> {};
+		template<> struct ValueTraits<ValueType::UInt8> : ValueTraitsBase<ValueKind::Scalar, uint8_t> {};
+		template<> struct ValueTraits<ValueType::UInt16> : ValueTraitsBase<ValueKind::Scalar, uint16_t> {};
+		template<> struct ValueTraits<ValueType::UInt32> : ValueTraitsBase<ValueKind::Scalar, uint32_t> {};
+		template<> struct ValueTraits<ValueType::UInt64> : ValueTraitsBase<ValueKind::Scalar, uint64_t> {};
+		template<> struct ValueTraits<ValueType::Pointer> : ValueTraitsBase<ValueKind::Scalar, void*> {};
+		template<> struct ValueTraits<ValueType::Float> : ValueTraitsBase<ValueKind::Scalar, float> {};
+		template<> struct ValueTraits<ValueType::Double> : ValueTraitsBase<ValueKind::Scalar, double> {};
+		template<> struct ValueTraits<ValueType::Function> : ValueTraitsBase<ValueKind::Function, void*> {};
+		template<> struct ValueTraits<ValueType::String> : ValueTraitsBase<ValueKind::Object, std::string> {};
+		template<> struct ValueTraits<ValueType::ArrayBool> : ValueTraitsBase<ValueKind::Object, std::vector<bool>> {};
+		template<> struct ValueTraits<ValueType::ArrayChar8> : ValueTraitsBase<ValueKind::Object, std::vector<char>> {};
+		template<> struct ValueTraits<ValueType::ArrayChar16> : ValueTraitsBase<ValueKind::Object, std::vector<char16_t>> {};
+		template<> struct ValueTraits<ValueType::ArrayInt8> : ValueTraitsBase<ValueKind::Object, std::vector<int8_t>> {};
+		template<> struct ValueTraits<ValueType::ArrayInt16> : ValueTraitsBase<ValueKind::Object, std::vector<int16_t>> {};
+		template<> struct ValueTraits<ValueType::ArrayInt32> : ValueTraitsBase<ValueKind::Object, std::vector<int32_t>> {};
+		template<> struct ValueTraits<ValueType::ArrayInt64> : ValueTraitsBase<ValueKind::Object, std::vector<int64_t>> {};
+		template<> struct ValueTraits<ValueType::ArrayUInt8> : ValueTraitsBase<ValueKind::Object, std::vector<uint8_t>> {};
+		template<> struct ValueTraits<ValueType::ArrayUInt16> : ValueTraitsBase<ValueKind::Object, std::vector<uint16_t>> {};
+		template<> struct ValueTraits<ValueType::ArrayUInt32> : ValueTraitsBase<ValueKind::Object, std::vector<uint32_t>> {};
+		template<> struct ValueTraits<ValueType::ArrayUInt64> : ValueTraitsBase<ValueKind::Object, std::vector<uint64_t>> {};
+		template<> struct ValueTraits<ValueType::ArrayPointer> : ValueTraitsBase<ValueKind::Object, std::vector<void*>> {};
+		template<> struct ValueTraits<ValueType::ArrayFloat> : ValueTraitsBase<ValueKind::Object, std::vector<float>> {};
+		template<> struct ValueTraits<ValueType::ArrayDouble> : ValueTraitsBase<ValueKind::Object, std::vector<double>> {};
+		template<> struct ValueTraits<ValueType::ArrayString> : ValueTraitsBase<ValueKind::Object, std::vector<std::string>> {};
+		template<> struct ValueTraits<ValueType::Vector2> : ValueTraitsBase<ValueKind::Struct, Vector2> {};
+		template<> struct ValueTraits<ValueType::Vector3> : ValueTraitsBase<ValueKind::Struct, Vector3> {};
+		template<> struct ValueTraits<ValueType::Vector4> : ValueTraitsBase<ValueKind::Struct, Vector4> {};
+		template<> struct ValueTraits<ValueType::Matrix4x4> : ValueTraitsBase<ValueKind::Struct, Matrix4x4> {};
+
+		// Values that can be held in memory and passed by pointer (ref params, temp storage)
+		template<ValueType V>
+		constexpr bool IsStorable = ValueTraits<V>::kind == ValueKind::Scalar || ValueTraits<V>::kind == ValueKind::Object || ValueTraits<V>::kind == ValueKind::Struct;
+
+		// Aggregate returned through hidden pointer parameter instead of registers
+		template<ValueType V>
+		constexpr bool IsStructReturnedByPointer() {
+			if constexpr (V == ValueType::Matrix4x4) {
+				return true;
 			}
-			default: {
-				const std::string error(std::format("[py3lm] SetFallbackReturn unsupported type {:#x}", static_cast<uint8_t>(retType)));
-				g_py3lm.LogFatal(error);
-				std::terminate();
+			else if constexpr (V == ValueType::Vector3 || V == ValueType::Vector4) {
+				return PY3LM_PLATFORM_WINDOWS;
 			}
+			else {
+				return false;
 			}
 		}
 
-		bool SetReturn(PyObject* result, PropertyRef retType, const ReturnValue* ret, const Parameters* params) {
-			switch (retType.GetType()) {
-			case ValueType::Void:
-				return true;
-			case ValueType::Bool:
-				if (auto value = ValueFromObject<bool>(result)) {
-					ret->SetReturnPtr<bool>(*value);
-					return true;
-				}
-				break;
-			case ValueType::Char8:
-				if (auto value = ValueFromObject<char>(result)) {
-					ret->SetReturnPtr<char>(*value);
-					return true;
+		constexpr size_t kValueTypeCount = static_cast<size_t>(ValueType::Matrix4x4) + 1;
+
+		template<typename Op, size_t... I>
+		constexpr auto MakeDispatchTable(std::index_sequence<I...>) {
+			using Func = decltype(&Op::template Invoke<ValueType::Invalid>);
+			return std::array<Func, sizeof...(I)>{ &Op::template Invoke<static_cast<ValueType>(I)>... };
+		}
+
+		template<typename Op>
+		constexpr auto kDispatchTable = MakeDispatchTable<Op>(std::make_index_sequence<kValueTypeCount>{});
+
+		// Single indexed load instead of switch, out of range types land on Invalid entry
+		template<typename Op>
+		auto Dispatch(ValueType type) {
+			const auto index = static_cast<size_t>(type);
+			return kDispatchTable<Op>[index < kValueTypeCount ? index : 0];
+		}
+
+		[[noreturn]] void FatalUnsupportedType(const char* func, ValueType type) {
+			const std::string error(std::format("[py3lm] {} unsupported type {:#x}", func, static_cast<uint8_t>(type)));
+			g_py3lm.LogFatal(error);
+			std::terminate();
+		}
+
+		void SetUnsupportedTypeError(const char* func, ValueType type) {
+			const std::string error(std::format("{} unsupported type {:#x}", func, static_cast<uint8_t>(type)));
+			PyErr_SetString(PyExc_RuntimeError, error.c_str());
+		}
+
+		struct SetFallbackReturnOp {
+			template<ValueType V>
+			static void Invoke(ValueType retType, const ReturnValue* ret, const Parameters* params) {
+				using Traits = ValueTraits<V>;
+				using T = typename Traits::Type;
+				if constexpr (Traits::kind == ValueKind::Void) {
 				}
-				break;
-			case ValueType::Char16:
-				if (auto value = ValueFromObject<char16_t>(result)) {
-					ret->SetReturnPtr<char16_t>(*value);
-					return true;
+				else if constexpr (Traits::kind == ValueKind::Scalar) {
+					// HACK: Fill all 8 byte with 0
+					ret->SetReturnPtr<uintptr_t>({});
 				}
-				break;
-			case ValueType::Int8:
-				if (auto value = ValueFromObject<int8_t>(result)) {
-					ret->SetReturnPtr<int8_t>(*value);
-					return true;
+				else if constexpr (Traits::kind == ValueKind::Function) {
+					ret->SetReturnPtr<void*>(nullptr);
 				}
-				break;
-			case ValueType::Int16:
-				if (auto value = ValueFromObject<int16_t>(result)) {
-					ret->SetReturnPtr<int16_t>(*value);
-					return true;
+				else if constexpr (Traits::kind == ValueKind::Object) {
+					std::construct_at(params->GetArgument<T*>(0));
 				}
-				break;
-			case ValueType::Int32:
-				if (auto value = ValueFromObject<int32_t>(result)) {
-					ret->SetReturnPtr<int32_t>(*value);
-					return true;
+				else if constexpr (Traits::kind == ValueKind::Struct) {
+					if constexpr (IsStructReturnedByPointer<V>()) {
+						auto* const returnParam = params->GetArgument<T*>(0);
+						std::construct_at(returnParam);
+						ret->SetReturnPtr<T*>(returnParam);
+					}
+					else {
+						ret->SetReturnPtr<T>({});
+					}
 				}
-				break;
-			case ValueType::Int64:
-				if (auto value = ValueFromObject<int64_t>(result)) {
-					ret->SetReturnPtr<int64_t>(*value);
-					return true;
+				else {
+					FatalUnsupportedType("SetFallbackReturn", retType);
 				}
-				break;
-			case ValueType::UInt8:
-				if (auto value = ValueFromObject<uint8_t>(result)) {
-					ret->SetReturnPtr<uint8_t>(*value);
+			}
+		};
+
+		struct SetReturnOp {
+			template<ValueType V>
+			static bool Invoke(PyObject* result, PropertyRef retType, const ReturnValue* ret, const Parameters* params) {
+				using Traits = ValueTraits<V>;
+				using T = typename Traits::Type;
+				if constexpr (Traits::kind == ValueKind::Void) {
 					return true;
 				}
-				break;
-			case ValueType::UInt16:
-				if (auto value = ValueFromObject<uint16_t>(result)) {
-					ret->SetReturnPtr<uint16_t>(*value);
-					return true;
+				else if constexpr (Traits::kind == ValueKind::Scalar) {
+					if (auto value = ValueFromObject<T>(result)) {
+						ret->SetReturnPtr<T>(*value);
+						return true;
+					}
+					return false;
 				}
-				break;
-			case ValueType::UInt32:
-				if (auto value = ValueFromObject<uint32_t>(result)) {
-					ret->SetReturnPtr<uint32_t>(*value);
-					return true;
+				else if constexpr (Traits::kind == ValueKind::Function) {
+					if (auto value = GetOrCreateFunctionValue(retType.GetPrototype().value(), result)) {
+						ret->SetReturnPtr<void*>(*value);
+						return true;
+					}
+					return false;
 				}
-				break;
-			case ValueType::UInt64:
-				if (auto value = ValueFromObject<uint64_t>(result)) {
-					ret->SetReturnPtr<uint64_t>(*value);
+				else if constexpr (Traits::kind == ValueKind::Object || Traits::kind == ValueKind::Struct) {
+					auto value = ConvertFromObject<T>(result);
+					if (!value) {
+						return false;
+					}
+					if constexpr (Traits::kind == ValueKind::Object) {
+						std::construct_at(params->GetArgument<T*>(0), std::move(*value));
+					}
+					else if constexpr (IsStructReturnedByPointer<V>()) {
+						auto* const returnParam = params->GetArgument<T*>(0);
+						std::construct_at(returnParam, std::move(*value));
+						ret->SetReturnPtr<T*>(returnParam);
+					}
+					else {
+						ret->SetReturnPtr<T>(*value);
+					}
 					return true;
 				}
-				break;
-			case ValueType::Pointer:
-				if (auto value = ValueFromObject<void*>(result)) {
-					ret->SetReturnPtr<void*>(*value);
-					return true;
+				else {
+					FatalUnsupportedType("SetReturn", retType.GetType());
 				}
-				break;
-			case ValueType::Float:
-				if (auto value = ValueFromObject<float>(result)) {
-					ret->SetReturnPtr<float>(*value);
-					return true;
-				}
-				break;
-			case ValueType::Double:
-				if (auto value = ValueFromObject<double>(result)) {
-					ret->SetReturnPtr<double>(*value);
-					return true;
-				}
-				break;
-			case ValueType::Function:
-				if (auto value = GetOrCreateFunctionValue(retType.GetPrototype().value(), result)) {
-					ret->SetReturnPtr<void*>(*value);
-					return true;
-				}
-				break;
-			case ValueType::String:
-				if (auto value = ValueFromObject<std::string>(result)) {
-					auto* const returnParam = params->GetArgument<std::string*>(0);
-					std::construct_at(returnParam, std::move(*value));
-					return true;
-				}
-				break;
-			case ValueType::ArrayBool:
-				if (auto value = ArrayFromObject<bool>(result)) {
-					auto* const returnParam = params->GetArgument<std::vector<bool>*>(0);
-					std::construct_at(returnParam, std::move(*value));
-					return true;
-				}
-				break;
-			case ValueType::ArrayChar8:
-				if (auto value = ArrayFromObject<char>(result)) {
-					auto* const returnParam = params->GetArgument<std::vector<char>*>(0);
-					std::construct_at(returnParam, std::move(*value));
-					return true;
-				}
-				break;
-			case ValueType::ArrayChar16:
-				if (auto value = ArrayFromObject<char16_t>(result)) {
-					auto* const returnParam = params->GetArgument<std::vector<char16_t>*>(0);
-					std::construct_at(returnParam, std::move(*value));
-					return true;
-				}
-				break;
-			case ValueType::ArrayInt8:
-				if (auto value = ArrayFromObject<int8_t>(result)) {
-					auto* const returnParam = params->GetArgument<std::vector<int8_t>*>(0);
-					std::construct_at(returnParam, std::move(*value));
-					return true;
-				}
-				break;
-			case ValueType::ArrayInt16:
-				if (auto value = ArrayFromObject<int16_t>(result)) {
-					auto* const returnParam = params->GetArgument<std::vector<int16_t>*>(0);
-					std::construct_at(returnParam, std::move(*value));
-					return true;
-				}
-				break;
-			case ValueType::ArrayInt32:
-				if (auto value = ArrayFromObject<int32_t>(result)) {
-					auto* const returnParam = params->GetArgument<std::vector<int32_t>*>(0);
-					std::construct_at(returnParam, std::move(*value));
-					return true;
-				}
-				break;
-			case ValueType::ArrayInt64:
-				if (auto value = ArrayFromObject<int64_t>(result)) {
-					auto* const returnParam = params->GetArgument<std::vector<int64_t>*>(0);
-					std::construct_at(returnParam, std::move(*value));
-					return true;
-				}
-				break;
-			case ValueType::ArrayUInt8:
-				if (auto value = ArrayFromObject<uint8_t>(result)) {
-					auto* const returnParam = params->GetArgument<std::vector<uint8_t>*>(0);
-					std::construct_at(returnParam, std::move(*value));
-					return true;
-				}
-				break;
-			case ValueType::ArrayUInt16:
-				if (auto value = ArrayFromObject<uint16_t>(result)) {
-					auto* const returnParam = params->GetArgument<std::vector<uint16_t>*>(0);
-					std::construct_at(returnParam, std::move(*value));
-					return true;
-				}
-				break;
-			case ValueType::ArrayUInt32:
-				if (auto value = ArrayFromObject<uint32_t>(result)) {
-					auto* const returnParam = params->GetArgument<std::vector<uint32_t>*>(0);
-					std::construct_at(returnParam, std::move(*value));
-					return true;
-				}
-				break;
-			case ValueType::ArrayUInt64:
-				if (auto value = ArrayFromObject<uint64_t>(result)) {
-					auto* const returnParam = params->GetArgument<std::vector<uint64_t>*>(0);
-					std::construct_at(returnParam, std::move(*value));
-					return true;
-				}
-				break;
-			case ValueType::ArrayPointer:
-				if (auto value = ArrayFromObject<void*>(result)) {
-					auto* const returnParam = params->GetArgument<std::vector<void*>*>(0);
-					std::construct_at(returnParam, std::move(*value));
-					return true;
-				}
-				break;
-			case ValueType::ArrayFloat:
-				if (auto value = ArrayFromObject<float>(result)) {
-					auto* const returnParam = params->GetArgument<std::vector<float>*>(0);
-					std::construct_at(returnParam, std::move(*value));
-					return true;
-				}
-				break;
-			case ValueType::ArrayDouble:
-				if (auto value = ArrayFromObject<double>(result)) {
-					auto* const returnParam = params->GetArgument<std::vector<double>*>(0);
-					std::construct_at(returnParam, std::move(*value));
-					return true;
-				}
-				break;
-			case ValueType::ArrayString:
-				if (auto value = ArrayFromObject<std::string>(result)) {
-					auto* const returnParam = params->GetArgument<std::vector<std::string>*>(0);
-					std::construct_at(returnParam, std::move(*value));
-					return true;
-				}
-				break;
-			case ValueType::Vector2:
-				if (auto value = ValueFromObject<Vector2>(result)) {
-					ret->SetReturnPtr<Vector2>(*value);
-					return true;
-				}
-				break;
-#if PY3LM_PLATFORM_WINDOWS
-			case ValueType::Vector3:
-				if (auto value = ValueFromObject<Vector3>(result)) {
-					auto* const returnParam = params->GetArgument<Vector3*>(0);
-					std::construct_at(returnParam, std::move(*value));
-					ret->SetReturnPtr<Vector3*>(returnParam);
-					return true;
-				}
-				break;
-			case ValueType::Vector4:
-				if (auto value = ValueFromObject<Vector4>(result)) {
-					auto* const returnParam = params->GetArgument<Vector4*>(0);
-					std::construct_at(returnParam, std::move(*value));
-					ret->SetReturnPtr<Vector4*>(returnParam);
-					return true;
-				}
-				break;
-#elif PY3LM_PLATFORM_LINUX || PY3LM_PLATFORM_APPLE
-			case ValueType::Vector3:
-				if (auto value = ValueFromObject<Vector3>(result)) {
-					ret->SetReturnPtr<Vector3>(*value);
-					return true;
-				}
-				break;
-			case ValueType::Vector4:
-				if (auto value = ValueFromObject<Vector4>(result)) {
-					ret->SetReturnPtr<Vector4>(*value);
-					return true;
-				}
-				break;
-#endif // PY3LM_PLATFORM_WINDOWS
-			case ValueType::Matrix4x4:
-				if (auto value = ValueFromObject<Matrix4x4>(result)) {
-					auto* const returnParam = params->GetArgument<Matrix4x4*>(0);
-					std::construct_at(returnParam, std::move(*value));
-					ret->SetReturnPtr<Matrix4x4*>(returnParam);
-					return true;
-				}
-				break;
-			default: {
-				const std::string error(std::format("[py3lm] SetReturn unsupported type {:#x}", static_cast<uint8_t>(retType.GetType())));
-				g_py3lm.LogFatal(error);
-				std::terminate();
 			}
-			}
-
-			return false;
-		}
+		};
 
-		bool SetRefParam(PyObject* object, PropertyRef paramType, const Parameters* params, uint8_t index) {
-			switch (paramType.GetType()) {
-			case ValueType::Bool:
-				if (auto value = ValueFromObject<bool>(object)) {
-					auto* const param = params->GetArgument<bool*>(index);
-					*param = *value;
-					return true;
-				}
-				break;
-			case ValueType::Char8:
-				if (auto value = ValueFromObject<char>(object)) {
-					auto* const param = params->GetArgument<char*>(index);
-					*param = *value;
-					return true;
-				}
-				break;
-			case ValueType::Char16:
-				if (auto value = ValueFromObject<char16_t>(object)) {
-					auto* const param = params->GetArgument<char16_t*>(index);
-					*param = *value;
-					return true;
-				}
-				break;
-			case ValueType::Int8:
-				if (auto value = ValueFromObject<int8_t>(object)) {
-					auto* const param = params->GetArgument<int8_t*>(index);
-					*param = *value;
-					return true;
-				}
-				break;
-			case ValueType::Int16:
-				if (auto value = ValueFromObject<int16_t>(object)) {
-					auto* const param = params->GetArgument<int16_t*>(index);
-					*param = *value;
-					return true;
-				}
-				break;
-			case ValueType::Int32:
-				if (auto value = ValueFromObject<int32_t>(object)) {
-					auto* const param = params->GetArgument<int32_t*>(index);
-					*param = *value;
-					return true;
-				}
-				break;
-			case ValueType::Int64:
-				if (auto value = ValueFromObject<int64_t>(object)) {
-					auto* const param = params->GetArgument<int64_t*>(index);
-					*param = *value;
-					return true;
-				}
-				break;
-			case ValueType::UInt8:
-				if (auto value = ValueFromObject<uint8_t>(object)) {
-					auto* const param = params->GetArgument<uint8_t*>(index);
-					*param = *value;
-					return true;
-				}
-				break;
-			case ValueType::UInt16:
-				if (auto value = ValueFromObject<uint16_t>(object)) {
-					auto* const param = params->GetArgument<uint16_t*>(index);
-					*param = *value;
-					return true;
-				}
-				break;
-			case ValueType::UInt32:
-				if (auto value = ValueFromObject<uint32_t>(object)) {
-					auto* const param = params->GetArgument<uint32_t*>(index);
-					*param = *value;
-					return true;
-				}
-				break;
-			case ValueType::UInt64:
-				if (auto value = ValueFromObject<uint64_t>(object)) {
-					auto* const param = params->GetArgument<uint64_t*>(index);
-					*param = *value;
-					return true;
-				}
-				break;
-			case ValueType::Pointer:
-				if (auto value = ValueFromObject<void*>(object)) {
-					auto* const param = params->GetArgument<void**>(index);
-					*param = *value;
-					return true;
-				}
-				break;
-			case ValueType::Float:
-				if (auto value = ValueFromObject<float>(object)) {
-					auto* const param = params->GetArgument<float*>(index);
-					*param = *value;
-					return true;
-				}
-				break;
-			case ValueType::Double:
-				if (auto value = ValueFromObject<double>(object)) {
-					auto* const param = params->GetArgument<double*>(index);
-					*param = *value;
-					return true;
-				}
-				break;
-			case ValueType::String:
-				if (auto value = ValueFromObject<std::string>(object)) {
-					auto* const param = params->GetArgument<std::string*>(index);
-					*param = std::move(*value);
-					return true;
-				}
-				break;
-			case ValueType::ArrayBool:
-				if (auto value = ArrayFromObject<bool>(object)) {
-					auto* const param = params->GetArgument<std::vector<bool>*>(index);
-					*param = std::move(*value);
-					return true;
-				}
-				break;
-			case ValueType::ArrayChar8:
-				if (auto value = ArrayFromObject<char>(object)) {
-					auto* const param = params->GetArgument<std::vector<char>*>(index);
-					*param = std::move(*value);
-					return true;
-				}
-				break;
-			case ValueType::ArrayChar16:
-				if (auto value = ArrayFromObject<char16_t>(object)) {
-					auto* const param = params->GetArgument<std::vector<char16_t>*>(index);
-					*param = std::move(*value);
-					return true;
-				}
-				break;
-			case ValueType::ArrayInt8:
-				if (auto value = ArrayFromObject<int8_t>(object)) {
-					auto* const param = params->GetArgument<std::vector<int8_t>*>(index);
-					*param = std::move(*value);
-					return true;
-				}
-				break;
-			case ValueType::ArrayInt16:
-				if (auto value = ArrayFromObject<int16_t>(object)) {
-					auto* const param = params->GetArgument<std::vector<int16_t>*>(index);
-					*param = std::move(*value);
-					return true;
-				}
-				break;
-			case ValueType::ArrayInt32:
-				if (auto value = ArrayFromObject<int32_t>(object)) {
-					auto* const param = params->GetArgument<std::vector<int32_t>*>(index);
-					*param = std::move(*value);
-					return true;
-				}
-				break;
-			case ValueType::ArrayInt64:
-				if (auto value = ArrayFromObject<int64_t>(object)) {
-					auto* const param = params->GetArgument<std::vector<int64_t>*>(index);
-					*param = std::move(*value);
-					return true;
-				}
-				break;
-			case ValueType::ArrayUInt8:
-				if (auto value = ArrayFromObject<uint8_t>(object)) {
-					auto* const param = params->GetArgument<std::vector<uint8_t>*>(index);
-					*param = std::move(*value);
-					return true;
-				}
-				break;
-			case ValueType::ArrayUInt16:
-				if (auto value = ArrayFromObject<uint16_t>(object)) {
-					auto* const param = params->GetArgument<std::vector<uint16_t>*>(index);
-					*param = std::move(*value);
-					return true;
-				}
-				break;
-			case ValueType::ArrayUInt32:
-				if (auto value = ArrayFromObject<uint32_t>(object)) {
-					auto* const param = params->GetArgument<std::vector<uint32_t>*>(index);
-					*param = std::move(*value);
-					return true;
-				}
-				break;
-			case ValueType::ArrayUInt64:
-				if (auto value = ArrayFromObject<uint64_t>(object)) {
-					auto* const param = params->GetArgument<std::vector<uint64_t>*>(index);
-					*param = std::move(*value);
-					return true;
-				}
-				break;
-			case ValueType::ArrayPointer:
-				if (auto value = ArrayFromObject<void*>(object)) {
-					auto* const param = params->GetArgument<std::vector<void*>*>(index);
-					*param = std::move(*value);
-					return true;
-				}
-				break;
-			case ValueType::ArrayFloat:
-				if (auto value = ArrayFromObject<float>(object)) {
-					auto* const param = params->GetArgument<std::vector<float>*>(index);
-					*param = std::move(*value);
-					return true;
-				}
-				break;
-			case ValueType::ArrayDouble:
-				if (auto value = ArrayFromObject<double>(object)) {
-					auto* const param = params->GetArgument<std::vector<double>*>(index);
-					*param = std::move(*value);
-					return true;
+		struct SetRefParamOp {
+			template<ValueType V>
+			static bool Invoke(PyObject* object, PropertyRef paramType, const Parameters* params, uint8_t index) {
+				using T = typename ValueTraits<V>::Type;
+				if constexpr (IsStorable<V>) {
+					if (auto value = ConvertFromObject<T>(object)) {
+						*params->GetArgument<T*>(index) = std::move(*value);
+						return true;
+					}
+					return false;
 				}
-				break;
-			case ValueType::ArrayString:
-				if (auto value = ArrayFromObject<std::string>(object)) {
-					auto* const param = params->GetArgument<std::vector<std::string>*>(index);
-					*param = std::move(*value);
-					return true;
+				else {
+					FatalUnsupportedType("SetRefParam", paramType.GetType());
 				}
-				break;
-			case ValueType::Vector2:
-				if (auto value = ValueFromObject<Vector2>(object)) {
-					auto* const param = params->GetArgument<Vector2*>(index);
-					*param = *value;
-					return true;
+			}
+		};
+
+		struct ParamToObjectOp {
+			template<ValueType V>
+			static PyObject* Invoke(PropertyRef paramType, const Parameters* params, uint8_t index) {
+				using Traits = ValueTraits<V>;
+				using T = typename Traits::Type;
+				if constexpr (Traits::kind == ValueKind::Scalar) {
+					return CreatePyObject(params->GetArgument<T>(index));
 				}
-				break;
-			case ValueType::Vector3:
-				if (auto value = ValueFromObject<Vector3>(object)) {
-					auto* const param = params->GetArgument<Vector3*>(index);
-					*param = *value;
-					return true;
+				else if constexpr (Traits::kind == ValueKind::Function) {
+					return GetOrCreateFunctionObject(paramType.GetPrototype().value(), params->GetArgument<void*>(index));
 				}
-				break;
-			case ValueType::Vector4:
-				if (auto value = ValueFromObject<Vector4>(object)) {
-					auto* const param = params->GetArgument<Vector4*>(index);
-					*param = *value;
-					return true;
+				else if constexpr (Traits::kind == ValueKind::Object || Traits::kind == ValueKind::Struct) {
+					return ConvertToObject(*(params->GetArgument<const T*>(index)));
 				}
-				break;
-			case ValueType::Matrix4x4:
-				if (auto value = ValueFromObject<Vector2>(object)) {
-					auto* const param = params->GetArgument<Vector2*>(index);
-					*param = *value;
-					return true;
+				else {
+					FatalUnsupportedType("ParamToObject", paramType.GetType());
 				}
-				break;
-			default: {
-				const std::string error(std::format("[py3lm] SetRefParam unsupported type {:#x}", static_cast<uint8_t>(paramType.GetType())));
-				g_py3lm.LogFatal(error);
-				std::terminate();
-			}
-			}
-
-			return false;
-		}
-
-		template<typename T>
-		PyObject* CreatePyObject(T /*value*/) {
-			static_assert(always_false_v<T>, "CreatePyObject specialization required");
-			return nullptr;
-		}
-
-		template<>
-		PyObject* CreatePyObject(bool value) {
-			return PyBool_FromLong(value);
-		}
-
-		template<>
-		PyObject* CreatePyObject(char value) {
-			if (value == char{ 0 }) {
-				return PyUnicode_FromStringAndSize(nullptr, Py_ssize_t{ 0 });
 			}
-			return PyUnicode_FromStringAndSize(&value, Py_ssize_t{ 1 });
-		}
+		};
 
-		template<>
-		PyObject* CreatePyObject(char16_t value) {
-			if (value == char16_t{ 0 }) {
-				return PyUnicode_FromStringAndSize(nullptr, Py_ssize_t{ 0 });
-			}
-			const auto [rc, out] = ConvertUtf16ToUtf8(value);
-			if (rc == -1) {
-				PyErr_SetString(PyExc_ValueError, "Surrogate pair");
-				return nullptr;
+		struct ParamRefToObjectOp {
+			template<ValueType V>
+			static PyObject* Invoke(PropertyRef paramType, const Parameters* params, uint8_t index) {
+				using T = typename ValueTraits<V>::Type;
+				if constexpr (IsStorable<V>) {
+					return ConvertToObject(*(params->GetArgument<const T*>(index)));
+				}
+				else {
+					FatalUnsupportedType("ParamRefToObject", paramType.GetType());
+				}
 			}
-			return PyUnicode_FromStringAndSize(out.data(), static_cast<Py_ssize_t>(rc));
-		}
-
-		template<>
-		PyObject* CreatePyObject(int8_t value) {
-			return PyLong_FromLong(value);
-		}
-
-		template<>
-		PyObject* CreatePyObject(int16_t value) {
-			return PyLong_FromLong(value);
-		}
-
-		template<>
-		PyObject* CreatePyObject(int32_t value) {
-			return PyLong_FromLong(value);
-		}
-
-		template<>
-		PyObject* CreatePyObject(int64_t value) {
-			return PyLong_FromLongLong(value);
-		}
-
-		template<>
-		PyObject* CreatePyObject(uint8_t value) {
-			return PyLong_FromUnsignedLong(value);
-		}
-
-		template<>
-		PyObject* CreatePyObject(uint16_t value) {
-			return PyLong_FromUnsignedLong(value);
-		}
-
-		template<>
-		PyObject* CreatePyObject(uint32_t value) {
-			return PyLong_FromUnsignedLong(value);
-		}
-
-		template<>
-		PyObject* CreatePyObject(uint64_t value) {
-			return PyLong_FromUnsignedLongLong(value);
-		}
-
-		template<>
-		PyObject* CreatePyObject(void* value) {
-			return PyLong_FromVoidPtr(value);
-		}
-
-		template<>
-		PyObject* CreatePyObject(float value) {
-			return PyFloat_FromDouble(static_cast<double>(value));
-		}
-
-		template<>
-		PyObject* CreatePyObject(double value) {
-			return PyFloat_FromDouble(value);
-		}
-
-		template<>
-		PyObject* CreatePyObject(std::string value) {
-			return PyUnicode_FromStringAndSize(value.data(), static_cast<Py_ssize_t>(value.size()));
-		}
-
-		template<>
-		PyObject* CreatePyObject(Vector2 value) {
-			return g_py3lm.CreateVector2Object(value);
-		}
-
-		template<>
-		PyObject* CreatePyObject(Vector3 value) {
-			return g_py3lm.CreateVector3Object(value);
-		}
-
-		template<>
-		PyObject* CreatePyObject(Vector4 value) {
-			return g_py3lm.CreateVector4Object(value);
-		}
-
-		template<>
-		PyObject* CreatePyObject(Matrix4x4 value) {
-			return g_py3lm.CreateMatrix4x4Object(value);
-		}
-
-		PyObject* GetOrCreateFunctionObject(MethodRef method, void* funcAddr) {
-			return g_py3lm.GetOrCreateFunctionObject(method, funcAddr);
-		}
+		};
 
-		template<typename T>
-		PyObject* CreatePyObjectList(const std::vector<T>& arrayArg) {
-			const auto size = static_cast<Py_ssize_t>(arrayArg.size());
-			PyObject* const arrayObject = PyList_New(size);
-			if (arrayObject) {
-				for (Py_ssize_t i = 0; i < size; ++i) {
-					PyObject* const valueObject = CreatePyObject(arrayArg[i]);
-					if (!valueObject) {
-						Py_DECREF(arrayObject);
-						return nullptr;
+		// Argument size reported to probes: value size, or contents of strings and arrays.
+		// Null value means passed in a register, objects and structs always travel by pointer
+		struct ValueBytesOp {
+			template<ValueType V>
+			static uint64_t Invoke(const void* value) {
+				using Traits = ValueTraits<V>;
+				using T = typename Traits::Type;
+				if constexpr (Traits::kind == ValueKind::Scalar || Traits::kind == ValueKind::Function) {
+					return sizeof(T);
+				}
+				else if constexpr (Traits::kind == ValueKind::Struct) {
+					return value ? sizeof(T) : 0;
+				}
+				else if constexpr (Traits::kind == ValueKind::Object) {
+					if (!value) {
+						return 0;
+					}
+					const T& object = *static_cast<const T*>(value);
+					if constexpr (std::is_same_v<T, std::string>) {
+						return object.size();
+					}
+					else if constexpr (std::is_same_v<T, std::vector<std::string>>) {
+						uint64_t bytes = 0;
+						for (const std::string& item : object) {
+							bytes += item.size();
+						}
+						return bytes;
+					}
+					else {
+						return object.size() * sizeof(typename T::value_type);
 					}
-					PyList_SET_ITEM(arrayObject, i, valueObject);
+				}
+				else {
+					return 0;
 				}
 			}
-			return arrayObject;
-		}
+		};
 
-		PyObject* ParamToObject(PropertyRef paramType, const Parameters* params, uint8_t index) {
-			switch (paramType.GetType()) {
-			case ValueType::Bool:
-				return CreatePyObject(params->GetArgument<bool>(index));
-			case ValueType::Char8:
-				return CreatePyObject(params->GetArgument<char>(index));
-			case ValueType::Char16:
-				return CreatePyObject(params->GetArgument<char16_t>(index));
-			case ValueType::Int8:
-				return CreatePyObject(params->GetArgument<int8_t>(index));
-			case ValueType::Int16:
-				return CreatePyObject(params->GetArgument<int16_t>(index));
-			case ValueType::Int32:
-				return CreatePyObject(params->GetArgument<int32_t>(index));
-			case ValueType::Int64:
-				return CreatePyObject(params->GetArgument<int64_t>(index));
-			case ValueType::UInt8:
-				return CreatePyObject(params->GetArgument<uint8_t>(index));
-			case ValueType::UInt16:
-				return CreatePyObject(params->GetArgument<uint16_t>(index));
-			case ValueType::UInt32:
-				return CreatePyObject(params->GetArgument<uint32_t>(index));
-			case ValueType::UInt64:
-				return CreatePyObject(params->GetArgument<uint64_t>(index));
-			case ValueType::Pointer:
-				return CreatePyObject(params->GetArgument<void*>(index));
-			case ValueType::Float:
-				return CreatePyObject(params->GetArgument<float>(index));
-			case ValueType::Double:
-				return CreatePyObject(params->GetArgument<double>(index));
-			case ValueType::Function:
-				return GetOrCreateFunctionObject(paramType.GetPrototype().value(), params->GetArgument<void*>(index));
-			case ValueType::String:
-				return CreatePyObject(*(params->GetArgument<const std::string*>(index)));
-			case ValueType::ArrayBool:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<bool>*>(index)));
-			case ValueType::ArrayChar8:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<char>*>(index)));
-			case ValueType::ArrayChar16:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<char16_t>*>(index)));
-			case ValueType::ArrayInt8:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<int8_t>*>(index)));
-			case ValueType::ArrayInt16:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<int16_t>*>(index)));
-			case ValueType::ArrayInt32:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<int32_t>*>(index)));
-			case ValueType::ArrayInt64:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<int64_t>*>(index)));
-			case ValueType::ArrayUInt8:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<uint8_t>*>(index)));
-			case ValueType::ArrayUInt16:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<uint16_t>*>(index)));
-			case ValueType::ArrayUInt32:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<uint32_t>*>(index)));
-			case ValueType::ArrayUInt64:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<uint64_t>*>(index)));
-			case ValueType::ArrayPointer:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<void*>*>(index)));
-			case ValueType::ArrayFloat:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<float>*>(index)));
-			case ValueType::ArrayDouble:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<double>*>(index)));
-			case ValueType::ArrayString:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<std::string>*>(index)));
-			case ValueType::Vector2:
-				return CreatePyObject(*(params->GetArgument<Vector2*>(index)));
-			case ValueType::Vector3:
-				return CreatePyObject(*(params->GetArgument<Vector3*>(index)));
-			case ValueType::Vector4:
-				return CreatePyObject(*(params->GetArgument<Vector4*>(index)));
-			case ValueType::Matrix4x4:
-				return CreatePyObject(*(params->GetArgument<Matrix4x4*>(index)));
-			default: {
-				const std::string error(std::format("[py3lm] ParamToObject unsupported type {:#x}", static_cast<uint8_t>(paramType.GetType())));
-				g_py3lm.LogFatal(error);
-				std::terminate();
-				return nullptr;
+		struct ParamBytesOp {
+			template<ValueType V>
+			static uint64_t Invoke(PropertyRef paramType, const Parameters* params, uint8_t index) {
+				constexpr ValueKind kind = ValueTraits<V>::kind;
+				const bool byPointer = paramType.IsReference() || kind == ValueKind::Object || kind == ValueKind::Struct;
+				return ValueBytesOp::Invoke<V>(byPointer ? params->GetArgument<const void*>(index) : nullptr);
 			}
+		};
+
+		uint64_t ParamBytes(MethodRef method, const Parameters* params, uint8_t startIndex) {
+			uint64_t bytes = 0;
+			uint8_t index = startIndex;
+			for (const PropertyRef paramType : method.GetParamTypes()) {
+				bytes += Dispatch<ParamBytesOp>(paramType.GetType())(paramType, params, index++);
 			}
+			return bytes;
 		}
 
-		PyObject* ParamRefToObject(PropertyRef paramType, const Parameters* params, uint8_t index) {
-			switch (paramType.GetType()) {
-			case ValueType::Bool:
-				return CreatePyObject(*(params->GetArgument<bool*>(index)));
-			case ValueType::Char8:
-				return CreatePyObject(*(params->GetArgument<char*>(index)));
-			case ValueType::Char16:
-				return CreatePyObject(*(params->GetArgument<char16_t*>(index)));
-			case ValueType::Int8:
-				return CreatePyObject(*(params->GetArgument<int8_t*>(index)));
-			case ValueType::Int16:
-				return CreatePyObject(*(params->GetArgument<int16_t*>(index)));
-			case ValueType::Int32:
-				return CreatePyObject(*(params->GetArgument<int32_t*>(index)));
-			case ValueType::Int64:
-				return CreatePyObject(*(params->GetArgument<int64_t*>(index)));
-			case ValueType::UInt8:
-				return CreatePyObject(*(params->GetArgument<uint8_t*>(index)));
-			case ValueType::UInt16:
-				return CreatePyObject(*(params->GetArgument<uint16_t*>(index)));
-			case ValueType::UInt32:
-				return CreatePyObject(*(params->GetArgument<uint32_t*>(index)));
-			case ValueType::UInt64:
-				return CreatePyObject(*(params->GetArgument<uint64_t*>(index)));
-			case ValueType::Pointer:
-				return CreatePyObject(*(params->GetArgument<void**>(index)));
-			case ValueType::Float:
-				return CreatePyObject(*(params->GetArgument<float*>(index)));
-			case ValueType::Double:
-				return CreatePyObject(*(params->GetArgument<double*>(index)));
-			case ValueType::String:
-				return CreatePyObject(*(params->GetArgument<const std::string*>(index)));
-			case ValueType::ArrayBool:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<bool>*>(index)));
-			case ValueType::ArrayChar8:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<char>*>(index)));
-			case ValueType::ArrayChar16:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<char16_t>*>(index)));
-			case ValueType::ArrayInt8:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<int8_t>*>(index)));
-			case ValueType::ArrayInt16:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<int16_t>*>(index)));
-			case ValueType::ArrayInt32:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<int32_t>*>(index)));
-			case ValueType::ArrayInt64:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<int64_t>*>(index)));
-			case ValueType::ArrayUInt8:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<uint8_t>*>(index)));
-			case ValueType::ArrayUInt16:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<uint16_t>*>(index)));
-			case ValueType::ArrayUInt32:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<uint32_t>*>(index)));
-			case ValueType::ArrayUInt64:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<uint64_t>*>(index)));
-			case ValueType::ArrayPointer:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<void*>*>(index)));
-			case ValueType::ArrayFloat:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<float>*>(index)));
-			case ValueType::ArrayDouble:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<double>*>(index)));
-			case ValueType::ArrayString:
-				return CreatePyObjectList(*(params->GetArgument<const std::vector<std::string>*>(index)));
-			case ValueType::Vector2:
-				return CreatePyObject(*(params->GetArgument<Vector2*>(index)));
-			case ValueType::Vector3:
-				return CreatePyObject(*(params->GetArgument<Vector3*>(index)));
-			case ValueType::Vector4:
-				return CreatePyObject(*(params->GetArgument<Vector4*>(index)));
-			case ValueType::Matrix4x4:
-				return CreatePyObject(*(params->GetArgument<Matrix4x4*>(index)));
-			default: {
-				const std::string error(std::format("[py3lm] ParamRefToObject unsupported type {:#x}", static_cast<uint8_t>(paramType.GetType())));
-				g_py3lm.LogFatal(error);
-				std::terminate();
-				return nullptr;
+		// Fires internal_call__return and settles admission when the callback is left, after the GIL is released
+		struct InternalCallScope {
+			const char* plugin;
+			const char* method;
+			Admission::Entry* admission;
+			std::chrono::steady_clock::time_point start{};
+			bool error = true;
+
+			~InternalCallScope() {
+				PY3LM_PROBE(internal_call__return, plugin, method, error);
+				if (admission) {
+					g_py3lm.GetAdmission().Complete(*admission, start, error);
+				}
+			}
+		};
+
+		struct DeleteStorageOp {
+			template<ValueType V>
+			static void Invoke(void* ptr) {
+				if constexpr (IsStorable<V>) {
+					delete static_cast<typename ValueTraits<V>::Type*>(ptr);
+				}
+				else {
+					FatalUnsupportedType("ArgsScope", V);
+				}
 			}
+		};
+
+		// Routing key of a replicated plugin call, scalars by value and strings by contents
+		struct RoutingKeyOp {
+			template<ValueType V>
+			static uint64_t Invoke(const Parameters* params, uint8_t index) {
+				using Traits = ValueTraits<V>;
+				using T = typename Traits::Type;
+				if constexpr (Traits::kind == ValueKind::Scalar) {
+					const T value = params->GetArgument<T>(index);
+					if constexpr (std::is_pointer_v<T>) {
+						return reinterpret_cast<uintptr_t>(value);
+					}
+					else if constexpr (std::is_floating_point_v<T>) {
+						return std::bit_cast<std::conditional_t<sizeof(T) == sizeof(uint64_t), uint64_t, uint32_t>>(value);
+					}
+					else {
+						return static_cast<uint64_t>(value);
+					}
+				}
+				else if constexpr (V == ValueType::String) {
+					return std::hash<std::string>{}(*params->GetArgument<const T*>(index));
+				}
+				else {
+					FatalUnsupportedType("RoutingKey", V);
+				}
 			}
-		}
+		};
 
-		void InternalCall(MethodRef method, MemAddr data, const Parameters* params, const uint8_t count, const ReturnValue* ret) {
-			PyObject* const func = data.RCast<PyObject*>();
+		struct IsRoutingKeyOp {
+			template<ValueType V>
+			static bool Invoke() {
+				return ValueTraits<V>::kind == ValueKind::Scalar || V == ValueType::String;
+			}
+		};
 
+		// Converts parameters, calls func and sets the return value, GIL of the interpreter owning func must be held.
+		// Returns false when the fallback return value was set
+		bool CallPythonFunction(MethodRef method, PyObject* func, const PythonMethodData* methodData, const Parameters* params, const ReturnValue* ret) {
 			enum class ParamProcess {
 				NoError,
 				Error,
@@ -1265,9 +970,9 @@ namespace py3lm {
 			ParamProcess processResult = ParamProcess::NoError;
 
 			const auto paramTypes = method.GetParamTypes();
-			uint8_t paramsCount = static_cast<uint8_t>(paramTypes.size());
-			uint8_t refParamsCount = 0;
-			uint8_t paramsStartIndex = ValueUtils::IsHiddenParam(method.GetReturnType().GetType()) ? 1 : 0;
+			const uint8_t paramsCount = static_cast<uint8_t>(paramTypes.size());
+			const uint8_t refParamsCount = static_cast<uint8_t>(methodData->refParams.size());
+			const uint8_t paramsStartIndex = methodData->paramsStartIndex;
 
 			PyObject* argTuple = nullptr;
 			if (paramsCount) {
@@ -1278,15 +983,9 @@ namespace py3lm {
 				}
 				else {
 					for (uint8_t index = 0; index < paramsCount; ++index) {
-						const PropertyRef paramType = paramTypes[index];
-						if (paramType.IsReference()) {
-							++refParamsCount;
-						}
-						using ParamConvertionFunc = PyObject* (*)(PropertyRef, const Parameters*, uint8_t);
-						ParamConvertionFunc const convertFunc = paramType.IsReference() ? &ParamRefToObject : &ParamToObject;
-						PyObject* const arg = convertFunc(paramType, params, paramsStartIndex + index);
+						PyObject* const arg = methodData->paramToObject[index](paramTypes[index], params, paramsStartIndex + index);
 						if (!arg) {
-							// convertFunc may set error
+							// converter may set error
 							processResult = PyErr_Occurred() ? ParamProcess::ErrorWithException : ParamProcess::Error;
 							break;
 						}
@@ -1309,9 +1008,9 @@ namespace py3lm {
 					PyErr_Print();
 				}
 
-				SetFallbackReturn(method.GetReturnType().GetType(), ret, params);
+				methodData->setFallbackReturn(method.GetReturnType().GetType(), ret, params);
 
-				return;
+				return false;
 			}
 
 			const bool hasRefParams = refParamsCount != 0;
@@ -1325,9 +1024,9 @@ namespace py3lm {
 			if (!result) {
 				PyErr_Print();
 
-				SetFallbackReturn(method.GetReturnType().GetType(), ret, params);
+				methodData->setFallbackReturn(method.GetReturnType().GetType(), ret, params);
 
-				return;
+				return false;
 			}
 
 			if (hasRefParams) {
@@ -1336,1156 +1035,1162 @@ namespace py3lm {
 
 					PyErr_Print();
 
-					Py_DECREF(result);
-
-					SetFallbackReturn(method.GetReturnType().GetType(), ret, params);
-
-					return;
-				}
-				const Py_ssize_t tupleSize = PyTuple_Size(result);
-				if (tupleSize != static_cast<Py_ssize_t>(1 + refParamsCount)) {
-					const std::string error(std::format("Returned tuple wrong size {}, expected {}", tupleSize, static_cast<Py_ssize_t>(1 + refParamsCount)));
-					PyErr_SetString(PyExc_TypeError, error.c_str());
-
-					PyErr_Print();
-
-					Py_DECREF(result);
-
-					SetFallbackReturn(method.GetReturnType().GetType(), ret, params);
-
-					return;
-				}
-			}
-
-			PyObject* const returnObject = hasRefParams ? PyTuple_GET_ITEM(result, Py_ssize_t{ 0 }) : result;
-
-			if (hasRefParams) {
-				for (uint8_t index = 0, k = 0; index < paramsCount; ++index) {
-					const PropertyRef paramType = paramTypes[index];
-					if (!paramType.IsReference()) {
-						continue;
-					}
-					if (!SetRefParam(PyTuple_GET_ITEM(result, Py_ssize_t{ 1 + k }), paramType, params, paramsStartIndex + index)) {
-						// SetRefParam may set error
-						if (PyErr_Occurred()) {
-							PyErr_Print();
-						}
-					}
-					++k;
-					if (k == refParamsCount) {
-						break;
-					}
-				}
-			}
-
-			if (!SetReturn(returnObject, method.GetReturnType(), ret, params)) {
-				if (PyErr_Occurred()) {
-					PyErr_Print();
-				}
-
-				SetFallbackReturn(method.GetReturnType().GetType(), ret, params);
-			}
-
-			Py_DECREF(result);
-		}
-
-		std::tuple<bool, Function> CreateInternalCall(const std::shared_ptr<asmjit::JitRuntime>& jitRuntime, MethodRef method, PyObject* func) {
-			Function function(jitRuntime);
-			void* const methodAddr = function.GetJitFunc(method, &InternalCall, reinterpret_cast<void*>(func));
-			return { methodAddr != nullptr, std::move(function) };
-		}
-
-		MethodExportResult GenerateMethodExport(MethodRef method, const std::shared_ptr<asmjit::JitRuntime>& jitRuntime, PyObject* pluginModule, PyObject* pluginInstance) {
-			PyObject* func{};
-
-			std::string className, methodName;
-			{
-				const auto& funcName = method.GetFunctionName();
-				if (const auto pos = funcName.find('.'); pos != std::string::npos) {
-					className = funcName.substr(0, pos);
-					methodName = std::string(funcName.begin() + (pos + 1), funcName.end());
-				}
-				else {
-					methodName = funcName;
-				}
-			}
-
-			const bool funcIsMethod = !className.empty();
-
-			if (funcIsMethod) {
-				PyObject* const classType = PyObject_GetAttrString(pluginModule, className.c_str());
-				if (classType) {
-					func = PyObject_GetAttrString(classType, methodName.c_str());
-					Py_DECREF(classType);
-				}
-			}
-			else {
-				func = PyObject_GetAttrString(pluginModule, methodName.c_str());
-			}
-
-			if (!func) {
-				return MethodExportError{ std::format("{} (Not found '{}' in module)", method.GetName(), method.GetFunctionName())};
-			}
-
-			if (!PyFunction_Check(func)) {
-				Py_DECREF(func);
-				return MethodExportError{ std::format("{} ('{}' not function type)", method.GetName(), method.GetFunctionName()) };
-			}
-
-			if (funcIsMethod && !IsStaticMethod(func)) {
-				PyObject* const bind = PyMethod_New(func, pluginInstance);
-				Py_DECREF(func);
-				if (!bind) {
-					return MethodExportError{ std::format("{} (instance bind fail)", method.GetName()) };
-				}
-				func = bind;
-			}
-
-			auto [result, function] = CreateInternalCall(jitRuntime, method, func);
-
-			if (!result) {
-				Py_DECREF(func);
-				return MethodExportError{ std::format("{} (jit error: {})", method.GetName(), function.GetError()) };
-			}
-
-			return MethodExportData{ std::move(function), func };
-		}
-
-		struct ArgsScope {
-			DCCallVM* vm;
-			std::vector<std::pair<void*, ValueType>> storage; // used to store array temp memory
-			DCaggr* ag = nullptr;
-
-			ArgsScope(uint8_t size) {
-				vm = dcNewCallVM(4096);
-				dcMode(vm, DC_CALL_C_DEFAULT);
-				dcReset(vm);
-				if (size) {
-					storage.reserve(size);
-				}
-			}
-
-			~ArgsScope() {
-				for (auto& [ptr, type] : storage) {
-					switch (type) {
-					case ValueType::Bool: {
-						delete reinterpret_cast<bool*>(ptr);
-						break;
-					}
-					case ValueType::Char8: {
-						delete reinterpret_cast<char*>(ptr);
-						break;
-					}
-					case ValueType::Char16: {
-						delete reinterpret_cast<char16_t*>(ptr);
-						break;
-					}
-					case ValueType::Int8: {
-						delete reinterpret_cast<int8_t*>(ptr);
-						break;
-					}
-					case ValueType::Int16: {
-						delete reinterpret_cast<int16_t*>(ptr);
-						break;
-					}
-					case ValueType::Int32: {
-						delete reinterpret_cast<int32_t*>(ptr);
-						break;
-					}
-					case ValueType::Int64: {
-						delete reinterpret_cast<int64_t*>(ptr);
-						break;
-					}
-					case ValueType::UInt8: {
-						delete reinterpret_cast<uint8_t*>(ptr);
-						break;
-					}
-					case ValueType::UInt16: {
-						delete reinterpret_cast<uint16_t*>(ptr);
-						break;
-					}
-					case ValueType::UInt32: {
-						delete reinterpret_cast<uint32_t*>(ptr);
-						break;
-					}
-					case ValueType::UInt64: {
-						delete reinterpret_cast<uint64_t*>(ptr);
-						break;
-					}
-					case ValueType::Pointer: {
-						delete reinterpret_cast<uintptr_t*>(ptr);
-						break;
-					}
-					case ValueType::Float: {
-						delete reinterpret_cast<float*>(ptr);
-						break;
-					}
-					case ValueType::Double: {
-						delete reinterpret_cast<double*>(ptr);
-						break;
-					}
-					case ValueType::String: {
-						delete reinterpret_cast<std::string*>(ptr);
-						break;
-					}
-					case ValueType::ArrayBool: {
-						delete reinterpret_cast<std::vector<bool>*>(ptr);
-						break;
-					}
-					case ValueType::ArrayChar8: {
-						delete reinterpret_cast<std::vector<char>*>(ptr);
-						break;
-					}
-					case ValueType::ArrayChar16: {
-						delete reinterpret_cast<std::vector<char16_t>*>(ptr);
-						break;
-					}
-					case ValueType::ArrayInt8: {
-						delete reinterpret_cast<std::vector<int16_t>*>(ptr);
-						break;
-					}
-					case ValueType::ArrayInt16: {
-						delete reinterpret_cast<std::vector<int16_t>*>(ptr);
-						break;
-					}
-					case ValueType::ArrayInt32: {
-						delete reinterpret_cast<std::vector<int32_t>*>(ptr);
-						break;
-					}
-					case ValueType::ArrayInt64: {
-						delete reinterpret_cast<std::vector<int64_t>*>(ptr);
-						break;
-					}
-					case ValueType::ArrayUInt8: {
-						delete reinterpret_cast<std::vector<uint8_t>*>(ptr);
-						break;
-					}
-					case ValueType::ArrayUInt16: {
-						delete reinterpret_cast<std::vector<uint16_t>*>(ptr);
-						break;
-					}
-					case ValueType::ArrayUInt32: {
-						delete reinterpret_cast<std::vector<uint32_t>*>(ptr);
-						break;
-					}
-					case ValueType::ArrayUInt64: {
-						delete reinterpret_cast<std::vector<uint64_t>*>(ptr);
-						break;
-					}
-					case ValueType::ArrayPointer: {
-						delete reinterpret_cast<std::vector<uintptr_t>*>(ptr);
-						break;
-					}
-					case ValueType::ArrayFloat: {
-						delete reinterpret_cast<std::vector<float>*>(ptr);
-						break;
-					}
-					case ValueType::ArrayDouble: {
-						delete reinterpret_cast<std::vector<double>*>(ptr);
-						break;
-					}
-					case ValueType::ArrayString: {
-						delete reinterpret_cast<std::vector<std::string>*>(ptr);
-						break;
-					}
-					case ValueType::Vector2: {
-						delete reinterpret_cast<Vector2*>(ptr);
-						break;
-					}
-					case ValueType::Vector3: {
-						delete reinterpret_cast<Vector3*>(ptr);
-						break;
-					}
-					case ValueType::Vector4: {
-						delete reinterpret_cast<Vector4*>(ptr);
-						break;
-					}
-					case ValueType::Matrix4x4: {
-						delete reinterpret_cast<Matrix4x4*>(ptr);
-						break;
-					}
-					default: {
-						const std::string error(std::format("[py3lm] ArgsScope unhandled type {:#x}", static_cast<uint8_t>(type)));
-						g_py3lm.LogFatal(error);
-						std::terminate();
-						break;
-					}
-					}
-				}
-				if (ag) {
-					dcFreeAggr(ag);
-				}
-				dcFree(vm);
-			}
-		};
-
-		void BeginExternalCall(MethodRef method, ArgsScope& a) {
-			switch (method.GetReturnType().GetType()) {
-			case ValueType::String: {
-				void* const value = new std::string();
-				a.storage.emplace_back(value, method.GetReturnType().GetType());
-				dcArgPointer(a.vm, value);
-				break;
-			}
-			case ValueType::ArrayBool: {
-				void* const value = new std::vector<bool>();
-				a.storage.emplace_back(value, method.GetReturnType().GetType());
-				dcArgPointer(a.vm, value);
-				break;
-			}
-			case ValueType::ArrayChar8: {
-				void* const value = new std::vector<char>();
-				a.storage.emplace_back(value, method.GetReturnType().GetType());
-				dcArgPointer(a.vm, value);
-				break;
-			}
-			case ValueType::ArrayChar16: {
-				void* const value = new std::vector<char16_t>();
-				a.storage.emplace_back(value, method.GetReturnType().GetType());
-				dcArgPointer(a.vm, value);
-				break;
-			}
-			case ValueType::ArrayInt8: {
-				void* const value = new std::vector<int8_t>();
-				a.storage.emplace_back(value, method.GetReturnType().GetType());
-				dcArgPointer(a.vm, value);
-				break;
-			}
-			case ValueType::ArrayInt16: {
-				void* const value = new std::vector<int16_t>();
-				a.storage.emplace_back(value, method.GetReturnType().GetType());
-				dcArgPointer(a.vm, value);
-				break;
-			}
-			case ValueType::ArrayInt32: {
-				void* const value = new std::vector<int32_t>();
-				a.storage.emplace_back(value, method.GetReturnType().GetType());
-				dcArgPointer(a.vm, value);
-				break;
-			}
-			case ValueType::ArrayInt64: {
-				void* const value = new std::vector<int64_t>();
-				a.storage.emplace_back(value, method.GetReturnType().GetType());
-				dcArgPointer(a.vm, value);
-				break;
-			}
-			case ValueType::ArrayUInt8: {
-				void* const value = new std::vector<uint8_t>();
-				a.storage.emplace_back(value, method.GetReturnType().GetType());
-				dcArgPointer(a.vm, value);
-				break;
-			}
-			case ValueType::ArrayUInt16: {
-				void* const value = new std::vector<uint16_t>();
-				a.storage.emplace_back(value, method.GetReturnType().GetType());
-				dcArgPointer(a.vm, value);
-				break;
-			}
-			case ValueType::ArrayUInt32: {
-				void* const value = new std::vector<uint32_t>();
-				a.storage.emplace_back(value, method.GetReturnType().GetType());
-				dcArgPointer(a.vm, value);
-				break;
-			}
-			case ValueType::ArrayUInt64: {
-				void* const value = new std::vector<uint64_t>();
-				a.storage.emplace_back(value, method.GetReturnType().GetType());
-				dcArgPointer(a.vm, value);
-				break;
-			}
-			case ValueType::ArrayPointer: {
-				void* const value = new std::vector<uintptr_t>();
-				a.storage.emplace_back(value, method.GetReturnType().GetType());
-				dcArgPointer(a.vm, value);
-				break;
-			}
-			case ValueType::ArrayFloat: {
-				void* const value = new std::vector<float>();
-				a.storage.emplace_back(value, method.GetReturnType().GetType());
-				dcArgPointer(a.vm, value);
-				break;
-			}
-			case ValueType::ArrayDouble: {
-				void* const value = new std::vector<double>();
-				a.storage.emplace_back(value, method.GetReturnType().GetType());
-				dcArgPointer(a.vm, value);
-				break;
-			}
-			case ValueType::ArrayString: {
-				void* const value = new std::vector<std::string>();
-				a.storage.emplace_back(value, method.GetReturnType().GetType());
-				dcArgPointer(a.vm, value);
-				break;
-			}
-			case ValueType::Vector2:
-				a.ag = dcNewAggr(2, sizeof(Vector2));
-				for (int i = 0; i < 2; ++i) {
-					dcAggrField(a.ag, DC_SIGCHAR_FLOAT, static_cast<int>(sizeof(float) * i), 1);
+					Py_DECREF(result);
+
+					methodData->setFallbackReturn(method.GetReturnType().GetType(), ret, params);
+
+					return false;
 				}
-				dcCloseAggr(a.ag);
-				dcBeginCallAggr(a.vm, a.ag);
-				break;
-			case ValueType::Vector3:
-				a.ag = dcNewAggr(3, sizeof(Vector3));
-				for (int i = 0; i < 3; ++i) {
-					dcAggrField(a.ag, DC_SIGCHAR_FLOAT, static_cast<int>(sizeof(float) * i), 1);
+				const Py_ssize_t tupleSize = PyTuple_Size(result);
+				if (tupleSize != static_cast<Py_ssize_t>(1 + refParamsCount)) {
+					const std::string error(std::format("Returned tuple wrong size {}, expected {}", tupleSize, static_cast<Py_ssize_t>(1 + refParamsCount)));
+					PyErr_SetString(PyExc_TypeError, error.c_str());
+
+					PyErr_Print();
+
+					Py_DECREF(result);
+
+					methodData->setFallbackReturn(method.GetReturnType().GetType(), ret, params);
+
+					return false;
 				}
-				dcCloseAggr(a.ag);
-				dcBeginCallAggr(a.vm, a.ag);
-				break;
-			case ValueType::Vector4:
-				a.ag = dcNewAggr(4, sizeof(Vector4));
-				for (int i = 0; i < 4; ++i) {
-					dcAggrField(a.ag, DC_SIGCHAR_FLOAT, static_cast<int>(sizeof(float) * i), 1);
+			}
+
+			PyObject* const returnObject = hasRefParams ? PyTuple_GET_ITEM(result, Py_ssize_t{ 0 }) : result;
+
+			if (hasRefParams) {
+				for (uint8_t k = 0; k < refParamsCount; ++k) {
+					const auto& [index, setRefParam] = methodData->refParams[k];
+					if (!setRefParam(PyTuple_GET_ITEM(result, Py_ssize_t{ 1 + k }), paramTypes[index], params, paramsStartIndex + index)) {
+						// setRefParam may set error
+						if (PyErr_Occurred()) {
+							PyErr_Print();
+						}
+					}
 				}
-				dcCloseAggr(a.ag);
-				dcBeginCallAggr(a.vm, a.ag);
-				break;
-			case ValueType::Matrix4x4:
-				a.ag = dcNewAggr(16, sizeof(Matrix4x4));
-				for (int i = 0; i < 16; ++i) {
-					dcAggrField(a.ag, DC_SIGCHAR_FLOAT, static_cast<int>(sizeof(float) * i), 1);
+			}
+
+			const bool returned = methodData->setReturn(returnObject, method.GetReturnType(), ret, params);
+			if (!returned) {
+				if (PyErr_Occurred()) {
+					PyErr_Print();
 				}
-				dcCloseAggr(a.ag);
-				dcBeginCallAggr(a.vm, a.ag);
-				break;
-			default:
-				// Should not require storage
-				break;
+
+				methodData->setFallbackReturn(method.GetReturnType().GetType(), ret, params);
 			}
+
+			Py_DECREF(result);
+			return returned;
 		}
 
-		PyObject* MakeExternalCall(MethodRef method, void* addr, const ArgsScope& a) {
-			switch (method.GetReturnType().GetType()) {
-			case ValueType::Void:
-				dcCallVoid(a.vm, addr);
-				return Py_None;
-			case ValueType::Bool: {
-				const bool val = dcCallBool(a.vm, addr);
-				return CreatePyObject(val);
-			}
-			case ValueType::Char8: {
-				const char val = dcCallChar(a.vm, addr);
-				return CreatePyObject(val);
-			}
-			case ValueType::Char16: {
-				const char16_t val = static_cast<char16_t>(dcCallShort(a.vm, addr));
-				return CreatePyObject(val);
-			}
-			case ValueType::Int8: {
-				const int8_t val = dcCallChar(a.vm, addr);
-				return CreatePyObject(val);
-			}
-			case ValueType::Int16: {
-				const int16_t val = dcCallShort(a.vm, addr);
-				return CreatePyObject(val);
-			}
-			case ValueType::Int32: {
-				const int32_t val = dcCallInt(a.vm, addr);
-				return CreatePyObject(val);
-			}
-			case ValueType::Int64: {
-				const int64_t val = dcCallLongLong(a.vm, addr);
-				return CreatePyObject(val);
-			}
-			case ValueType::UInt8: {
-				const uint8_t val = static_cast<uint8_t>(dcCallChar(a.vm, addr));
-				return CreatePyObject(val);
-			}
-			case ValueType::UInt16: {
-				const uint16_t val = static_cast<uint16_t>(dcCallShort(a.vm, addr));
-				return CreatePyObject(val);
-			}
-			case ValueType::UInt32: {
-				const uint32_t val = static_cast<uint32_t>(dcCallInt(a.vm, addr));
-				return CreatePyObject(val);
-			}
-			case ValueType::UInt64: {
-				const uint64_t val = static_cast<uint64_t>(dcCallLongLong(a.vm, addr));
-				return CreatePyObject(val);
-			}
-			case ValueType::Pointer: {
-				const uintptr_t val = reinterpret_cast<uintptr_t>(dcCallPointer(a.vm, addr));
-				return CreatePyObject(val);
+
+		void InternalCall(MethodRef method, MemAddr data, const Parameters* params, const uint8_t count, const ReturnValue* ret) {
+			const auto* const methodData = data.RCast<const PythonMethodData*>();
+
+			// Shed calls never wait for the GIL
+			Admission& admission = g_py3lm.GetAdmission();
+			if (methodData->admission) {
+				const Admission::Decision decision = admission.Admit(*methodData->admission);
+				if (decision != Admission::Decision::Admitted) {
+					PY3LM_PROBE(internal_call__shed, PY3LM_PROBE_ENABLED(internal_call__shed) ? g_py3lm.GetGilStats().GetTagName(methodData->tag) : "", method.GetName().c_str(), static_cast<int>(decision));
+					methodData->setFallbackReturn(method.GetReturnType().GetType(), ret, params);
+					return;
+				}
 			}
-			case ValueType::Float: {
-				const float val = dcCallFloat(a.vm, addr);
-				return CreatePyObject(val);
+
+			const bool traced = PY3LM_PROBE_ENABLED(internal_call__entry) || PY3LM_PROBE_ENABLED(internal_call__return);
+			InternalCallScope probe{ traced ? g_py3lm.GetGilStats().GetTagName(methodData->tag) : "", method.GetName().c_str(), methodData->admission };
+			PY3LM_PROBE(internal_call__entry, probe.plugin, probe.method, traced ? ParamBytes(method, params, methodData->paramsStartIndex) : 0);
+
+			// Replicated plugin runs in the interpreter picked for this call, under that interpreter's GIL
+			if (ReplicaSet* const replicas = methodData->replicas) {
+				Replica& replica = replicas->keyParam < 0
+					? replicas->ForThread()
+					: replicas->ForKey(Dispatch<RoutingKeyOp>(method.GetParamTypes()[replicas->keyParam].GetType())(params, static_cast<uint8_t>(methodData->paramsStartIndex + replicas->keyParam)));
+				GilTimingScope gil(g_py3lm.GetGilStats(), methodData->tag);
+				ReplicaScope scope(replica);
+				gil.Acquired();
+				if (probe.admission && admission.IsTimed(*probe.admission)) {
+					probe.start = std::chrono::steady_clock::now();
+				}
+				probe.error = !CallPythonFunction(method, replica.functions[methodData->replicaMethod], methodData, params, ret);
+				return;
 			}
-			case ValueType::Double: {
-				const double val = dcCallDouble(a.vm, addr);
-				return CreatePyObject(val);
+
+			GilEnterScope gil(g_py3lm.GetGilStats(), methodData->tag);
+
+			// Dormant plugin is imported by its first call, the function is set under the GIL
+			PyObject* func = methodData->pythonFunction;
+			if (!func && g_py3lm.ActivatePlugin(methodData->tag)) {
+				func = methodData->pythonFunction;
 			}
-			case ValueType::Function: {
-				void* const val = dcCallPointer(a.vm, addr);
-				return GetOrCreateFunctionObject(method.GetReturnType().GetPrototype().value(), val);
+			if (!func) {
+				methodData->setFallbackReturn(method.GetReturnType().GetType(), ret, params);
+				return;
 			}
-			case ValueType::String: {
-				dcCallVoid(a.vm, addr);
-				return CreatePyObject(*reinterpret_cast<std::string*>(std::get<0>(a.storage[0])));
+
+			if (probe.admission && admission.IsTimed(*probe.admission)) {
+				probe.start = std::chrono::steady_clock::now();
 			}
-			case ValueType::ArrayBool: {
-				dcCallVoid(a.vm, addr);
-				return CreatePyObjectList<bool>(*reinterpret_cast<std::vector<bool>*>(std::get<0>(a.storage[0])));
+			RefAuditScope audit(g_py3lm.GetRefAudit(), "callback", method.GetName());
+
+			probe.error = !CallPythonFunction(method, func, methodData, params, ret);
+		}
+
+		std::tuple<bool, std::unique_ptr<PythonMethodData>> CreateInternalCall(const std::shared_ptr<asmjit::JitRuntime>& jitRuntime, MethodRef method, PyObject* func, uint32_t tag) {
+			const ValueType retType = method.GetReturnType().GetType();
+			auto data = std::make_unique<PythonMethodData>(Function(jitRuntime), func, tag);
+			data->setReturn = Dispatch<SetReturnOp>(retType);
+			data->setFallbackReturn = Dispatch<SetFallbackReturnOp>(retType);
+			data->paramsStartIndex = ValueUtils::IsHiddenParam(retType) ? 1 : 0;
+			const auto paramTypes = method.GetParamTypes();
+			data->paramToObject.reserve(paramTypes.size());
+			for (uint8_t index = 0; index < static_cast<uint8_t>(paramTypes.size()); ++index) {
+				const PropertyRef paramType = paramTypes[index];
+				if (paramType.IsReference()) {
+					data->paramToObject.push_back(Dispatch<ParamRefToObjectOp>(paramType.GetType()));
+					data->refParams.emplace_back(index, Dispatch<SetRefParamOp>(paramType.GetType()));
+				}
+				else {
+					data->paramToObject.push_back(Dispatch<ParamToObjectOp>(paramType.GetType()));
+				}
 			}
-			case ValueType::ArrayChar8: {
-				dcCallVoid(a.vm, addr);
-				return CreatePyObjectList<char>(*reinterpret_cast<std::vector<char>*>(std::get<0>(a.storage[0])));
+			Py3lmLoadStats& stats = g_py3lm.GetLoadStats();
+			LoadTimer timer(stats.jitNs);
+			++stats.jitCount;
+			PY3LM_PROBE(jit_thunk__entry, method.GetName().c_str(), kJitThunkInternal);
+			void* const methodAddr = data->jitFunction.GetJitFunc(method, &InternalCall, data.get());
+			PY3LM_PROBE(jit_thunk__return, method.GetName().c_str(), kJitThunkInternal, methodAddr == nullptr);
+			return { methodAddr != nullptr, std::move(data) };
+		}
+
+		MethodResolveResult ResolveMethodFunction(MethodRef method, PyObject* pluginModule, PyObject* pluginInstance) {
+			PyObject* func{};
+
+			std::string className, methodName;
+			{
+				const auto& funcName = method.GetFunctionName();
+				if (const auto pos = funcName.find('.'); pos != std::string::npos) {
+					className = funcName.substr(0, pos);
+					methodName = std::string(funcName.begin() + (pos + 1), funcName.end());
+				}
+				else {
+					methodName = funcName;
+				}
 			}
-			case ValueType::ArrayChar16: {
-				dcCallVoid(a.vm, addr);
-				return CreatePyObjectList<char16_t>(*reinterpret_cast<std::vector<char16_t>*>(std::get<0>(a.storage[0])));
+
+			const bool funcIsMethod = !className.empty();
+
+			if (funcIsMethod) {
+				PyObject* const classType = PyObject_GetAttrString(pluginModule, className.c_str());
+				if (classType) {
+					func = PyObject_GetAttrString(classType, methodName.c_str());
+					Py_DECREF(classType);
+				}
 			}
-			case ValueType::ArrayInt8: {
-				dcCallVoid(a.vm, addr);
-				return CreatePyObjectList<int8_t>(*reinterpret_cast<std::vector<int8_t>*>(std::get<0>(a.storage[0])));
+			else {
+				func = PyObject_GetAttrString(pluginModule, methodName.c_str());
 			}
-			case ValueType::ArrayInt16: {
-				dcCallVoid(a.vm, addr);
-				return CreatePyObjectList<int16_t>(*reinterpret_cast<std::vector<int16_t>*>(std::get<0>(a.storage[0])));
+
+			if (!func) {
+				return MethodExportError{ std::format("{} (Not found '{}' in module)", method.GetName(), method.GetFunctionName())};
 			}
-			case ValueType::ArrayInt32: {
-				dcCallVoid(a.vm, addr);
-				return CreatePyObjectList<int32_t>(*reinterpret_cast<std::vector<int32_t>*>(std::get<0>(a.storage[0])));
+
+			if (!PyFunction_Check(func)) {
+				Py_DECREF(func);
+				return MethodExportError{ std::format("{} ('{}' not function type)", method.GetName(), method.GetFunctionName()) };
 			}
-			case ValueType::ArrayInt64: {
-				dcCallVoid(a.vm, addr);
-				return CreatePyObjectList<int64_t>(*reinterpret_cast<std::vector<int64_t>*>(std::get<0>(a.storage[0])));
+
+			if (funcIsMethod && !IsStaticMethod(func)) {
+				PyObject* const bind = PyMethod_New(func, pluginInstance);
+				Py_DECREF(func);
+				if (!bind) {
+					return MethodExportError{ std::format("{} (instance bind fail)", method.GetName()) };
+				}
+				func = bind;
 			}
-			case ValueType::ArrayUInt8: {
-				dcCallVoid(a.vm, addr);
-				return CreatePyObjectList<uint8_t>(*reinterpret_cast<std::vector<uint8_t>*>(std::get<0>(a.storage[0])));
-			}
-			case ValueType::ArrayUInt16: {
-				dcCallVoid(a.vm, addr);
-				return CreatePyObjectList<uint16_t>(*reinterpret_cast<std::vector<uint16_t>*>(std::get<0>(a.storage[0])));
-			}
-			case ValueType::ArrayUInt32: {
-				dcCallVoid(a.vm, addr);
-				return CreatePyObjectList<uint32_t>(*reinterpret_cast<std::vector<uint32_t>*>(std::get<0>(a.storage[0])));
-			}
-			case ValueType::ArrayUInt64: {
-				dcCallVoid(a.vm, addr);
-				return CreatePyObjectList<uint64_t>(*reinterpret_cast<std::vector<uint64_t>*>(std::get<0>(a.storage[0])));
-			}
-			case ValueType::ArrayPointer: {
-				dcCallVoid(a.vm, addr);
-				return CreatePyObjectList<uintptr_t>(*reinterpret_cast<std::vector<uintptr_t>*>(std::get<0>(a.storage[0])));
-			}
-			case ValueType::ArrayFloat: {
-				dcCallVoid(a.vm, addr);
-				return CreatePyObjectList<float>(*reinterpret_cast<std::vector<float>*>(std::get<0>(a.storage[0])));
-			}
-			case ValueType::ArrayDouble: {
-				dcCallVoid(a.vm, addr);
-				return CreatePyObjectList<double>(*reinterpret_cast<std::vector<double>*>(std::get<0>(a.storage[0])));
-			}
-			case ValueType::ArrayString: {
-				dcCallVoid(a.vm, addr);
-				return CreatePyObjectList<std::string>(*reinterpret_cast<std::vector<std::string>*>(std::get<0>(a.storage[0])));
-			}
-			case ValueType::Vector2: {
-				Vector2 val;
-				dcCallAggr(a.vm, addr, a.ag, &val);
-				return CreatePyObject(val);
-			}
-			case ValueType::Vector3: {
-				Vector3 val;
-				dcCallAggr(a.vm, addr, a.ag, &val);
-				return CreatePyObject(val);
-			}
-			case ValueType::Vector4: {
-				Vector4 val;
-				dcCallAggr(a.vm, addr, a.ag, &val);
-				return CreatePyObject(val);
-			}
-			case ValueType::Matrix4x4: {
-				Matrix4x4 val;
-				dcCallAggr(a.vm, addr, a.ag, &val);
-				return CreatePyObject(val);
-			}
-			default: {
-				const std::string error(std::format("MakeExternalCall unsupported type {:#x}", static_cast<uint8_t>(method.GetReturnType().GetType())));
-				PyErr_SetString(PyExc_RuntimeError, error.c_str());
-				return nullptr;
+
+			return func;
+		}
+
+		// Without a module the thunk is left unbound, the function is resolved when the plugin is activated
+		MethodExportResult GenerateMethodExport(MethodRef method, const std::shared_ptr<asmjit::JitRuntime>& jitRuntime, PyObject* pluginModule, PyObject* pluginInstance, uint32_t tag) {
+			PyObject* func{};
+			if (pluginModule) {
+				MethodResolveResult resolved = ResolveMethodFunction(method, pluginModule, pluginInstance);
+				if (auto* error = std::get_if<MethodExportError>(&resolved)) {
+					return std::move(*error);
+				}
+				func = std::get<PyObject*>(resolved);
 			}
+
+			auto [result, data] = CreateInternalCall(jitRuntime, method, func, tag);
+
+			if (!result) {
+				Py_XDECREF(func);
+				return MethodExportError{ std::format("{} (jit error: {})", method.GetName(), data->jitFunction.GetError()) };
 			}
 
-			return nullptr;
+			return MethodExportData{ std::move(data) };
 		}
 
-		bool PushObjectAsParam(PropertyRef paramType, PyObject* pItem, ArgsScope& a) {
-			switch (paramType.GetType()) {
-			case ValueType::Bool: {
-				const auto value = ValueFromObject<bool>(pItem);
-				if (!value) {
-					return false;
+		struct ArgsScope {
+			DCCallVM* vm;
+			bool ownsVm;
+			std::vector<std::pair<void*, ValueType>> storage; // used to store array temp memory
+			std::vector<uint8_t> refs; // storage index of each reference parameter
+
+			ArgsScope(uint8_t size) : ArgsScope(dcNewCallVM(4096), size, true) {}
+
+			// Borrowed vm is reset here and must outlive the scope
+			ArgsScope(DCCallVM* callVm, uint8_t size, bool owns = false) : vm{callVm}, ownsVm{owns} {
+				dcMode(vm, DC_CALL_C_DEFAULT);
+				dcReset(vm);
+				if (size) {
+					storage.reserve(size);
 				}
-				dcArgBool(a.vm, *value);
-				return true;
 			}
-			case ValueType::Char8: {
-				const auto value = ValueFromObject<char>(pItem);
-				if (!value) {
-					return false;
+
+			~ArgsScope() {
+				for (auto& [ptr, type] : storage) {
+					Dispatch<DeleteStorageOp>(type)(ptr);
 				}
-				dcArgChar(a.vm, *value);
-				return true;
-			}
-			case ValueType::Char16: {
-				const auto value = ValueFromObject<char16_t>(pItem);
-				if (!value) {
-					return false;
+				if (ownsVm) {
+					dcFree(vm);
 				}
-				dcArgShort(a.vm, static_cast<short>(*value));
-				return true;
 			}
-			case ValueType::Int8: {
-				const auto value = ValueFromObject<int8_t>(pItem);
-				if (!value) {
-					return false;
-				}
-				dcArgChar(a.vm, *value);
-				return true;
+		};
+
+		void PushArg(DCCallVM* vm, bool value) {
+			dcArgBool(vm, value);
+		}
+
+		void PushArg(DCCallVM* vm, char value) {
+			dcArgChar(vm, value);
+		}
+
+		void PushArg(DCCallVM* vm, char16_t value) {
+			dcArgShort(vm, static_cast<short>(value));
+		}
+
+		void PushArg(DCCallVM* vm, int8_t value) {
+			dcArgChar(vm, value);
+		}
+
+		void PushArg(DCCallVM* vm, int16_t value) {
+			dcArgShort(vm, value);
+		}
+
+		void PushArg(DCCallVM* vm, int32_t value) {
+			dcArgInt(vm, value);
+		}
+
+		void PushArg(DCCallVM* vm, int64_t value) {
+			dcArgLongLong(vm, value);
+		}
+
+		void PushArg(DCCallVM* vm, uint8_t value) {
+			dcArgChar(vm, static_cast<int8_t>(value));
+		}
+
+		void PushArg(DCCallVM* vm, uint16_t value) {
+			dcArgShort(vm, static_cast<int16_t>(value));
+		}
+
+		void PushArg(DCCallVM* vm, uint32_t value) {
+			dcArgInt(vm, static_cast<int32_t>(value));
+		}
+
+		void PushArg(DCCallVM* vm, uint64_t value) {
+			dcArgLongLong(vm, static_cast<int64_t>(value));
+		}
+
+		void PushArg(DCCallVM* vm, void* value) {
+			dcArgPointer(vm, value);
+		}
+
+		void PushArg(DCCallVM* vm, float value) {
+			dcArgFloat(vm, value);
+		}
+
+		void PushArg(DCCallVM* vm, double value) {
+			dcArgDouble(vm, value);
+		}
+
+		// Passes temp value by pointer, ArgsScope owns it afterwards
+		bool PushStorage(ArgsScope& a, void* value, ValueType type) {
+			if (!value) {
+				return false;
 			}
-			case ValueType::Int16: {
-				const auto value = ValueFromObject<int16_t>(pItem);
-				if (!value) {
-					return false;
-				}
-				dcArgShort(a.vm, *value);
-				return true;
+			a.storage.emplace_back(value, type);
+			dcArgPointer(a.vm, value);
+			return true;
+		}
+
+		template<typename T>
+		T CallNative(DCCallVM* vm, void* addr) {
+			if constexpr (std::is_same_v<T, bool>) {
+				return dcCallBool(vm, addr);
 			}
-			case ValueType::Int32: {
-				const auto value = ValueFromObject<int32_t>(pItem);
-				if (!value) {
-					return false;
-				}
-				dcArgInt(a.vm, *value);
-				return true;
+			else if constexpr (std::is_same_v<T, char> || std::is_same_v<T, int8_t> || std::is_same_v<T, uint8_t>) {
+				return static_cast<T>(dcCallChar(vm, addr));
 			}
-			case ValueType::Int64: {
-				const auto value = ValueFromObject<int64_t>(pItem);
-				if (!value) {
-					return false;
-				}
-				dcArgLongLong(a.vm, *value);
-				return true;
+			else if constexpr (std::is_same_v<T, char16_t> || std::is_same_v<T, int16_t> || std::is_same_v<T, uint16_t>) {
+				return static_cast<T>(dcCallShort(vm, addr));
 			}
-			case ValueType::UInt8: {
-				const auto value = ValueFromObject<uint8_t>(pItem);
-				if (!value) {
-					return false;
-				}
-				dcArgChar(a.vm, static_cast<int8_t>(*value));
-				return true;
+			else if constexpr (std::is_same_v<T, int32_t> || std::is_same_v<T, uint32_t>) {
+				return static_cast<T>(dcCallInt(vm, addr));
 			}
-			case ValueType::UInt16: {
-				const auto value = ValueFromObject<uint16_t>(pItem);
-				if (!value) {
-					return false;
-				}
-				dcArgShort(a.vm, static_cast<int16_t>(*value));
-				return true;
+			else if constexpr (std::is_same_v<T, int64_t> || std::is_same_v<T, uint64_t>) {
+				return static_cast<T>(dcCallLongLong(vm, addr));
 			}
-			case ValueType::UInt32: {
-				const auto value = ValueFromObject<uint32_t>(pItem);
-				if (!value) {
-					return false;
-				}
-				dcArgInt(a.vm, static_cast<int32_t>(*value));
-				return true;
+			else if constexpr (std::is_same_v<T, void*>) {
+				return dcCallPointer(vm, addr);
 			}
-			case ValueType::UInt64: {
-				const auto value = ValueFromObject<uint64_t>(pItem);
-				if (!value) {
-					return false;
-				}
-				dcArgLongLong(a.vm, static_cast<int64_t>(*value));
-				return true;
+			else if constexpr (std::is_same_v<T, float>) {
+				return dcCallFloat(vm, addr);
 			}
-			case ValueType::Pointer: {
-				const auto value = ValueFromObject<uintptr_t>(pItem);
-				if (!value) {
-					return false;
-				}
-				dcArgPointer(a.vm, reinterpret_cast<void*>(*value));
-				return true;
+			else if constexpr (std::is_same_v<T, double>) {
+				return dcCallDouble(vm, addr);
 			}
-			case ValueType::Float: {
-				const auto value = ValueFromObject<float>(pItem);
-				if (!value) {
-					return false;
-				}
-				dcArgFloat(a.vm, *value);
-				return true;
+			else {
+				static_assert(always_false_v<T>, "CallNative specialization required");
 			}
-			case ValueType::Double: {
-				const auto value = ValueFromObject<double>(pItem);
-				if (!value) {
-					return false;
+		}
+
+		// Raw return value of native call, converted to Python object once the GIL is held again
+		struct ExternalReturn {
+			alignas(16) std::byte data[sizeof(Matrix4x4)];
+		};
+
+		// Layout of a float struct never changes, so its aggregate is described once per type and kept for the process lifetime
+		template<typename T>
+		DCaggr* GetAggregate() {
+			static DCaggr* const ag = [] {
+				constexpr int fieldCount = static_cast<int>(sizeof(T) / sizeof(float));
+				DCaggr* const aggr = dcNewAggr(fieldCount, sizeof(T));
+				for (int i = 0; i < fieldCount; ++i) {
+					dcAggrField(aggr, DC_SIGCHAR_FLOAT, static_cast<int>(sizeof(float) * i), 1);
 				}
-				dcArgDouble(a.vm, *value);
-				return true;
-			}
-			case ValueType::String: {
-				void* const value = CreateValue<std::string>(pItem);
-				if (!value) {
-					return false;
+				dcCloseAggr(aggr);
+				return aggr;
+			}();
+			return ag;
+		}
+
+		struct BeginExternalCallOp {
+			template<ValueType V>
+			static void Invoke(ArgsScope& a) {
+				using Traits = ValueTraits<V>;
+				using T = typename Traits::Type;
+				if constexpr (Traits::kind == ValueKind::Object) {
+					PushStorage(a, new T(), V);
 				}
-				a.storage.emplace_back(value, paramType.GetType());
-				dcArgPointer(a.vm, value);
-				return true;
-			}
-			case ValueType::Function: {
-				const auto value = GetOrCreateFunctionValue(paramType.GetPrototype().value(), pItem);
-				if (!value) {
-					return false;
+				else if constexpr (Traits::kind == ValueKind::Struct) {
+					dcBeginCallAggr(a.vm, GetAggregate<T>());
 				}
-				dcArgPointer(a.vm, reinterpret_cast<void*>(*value));
-				return true;
+				// Other types should not require storage
 			}
-			case ValueType::ArrayBool: {
-				void* const value = CreateArray<bool>(pItem);
-				if (!value) {
-					return false;
+		};
+
+		// Runs without the GIL, must not touch Python objects
+		struct InvokeExternalOp {
+			template<ValueType V>
+			static void Invoke(void* addr, const ArgsScope& a, ExternalReturn& ret) {
+				using Traits = ValueTraits<V>;
+				using T = typename Traits::Type;
+				if constexpr (Traits::kind == ValueKind::Void || Traits::kind == ValueKind::Object) {
+					dcCallVoid(a.vm, addr);
 				}
-				a.storage.emplace_back(value, paramType.GetType());
-				dcArgPointer(a.vm, value);
-				return true;
-			}
-			case ValueType::ArrayChar8: {
-				void* const value = CreateArray<char>(pItem);
-				if (!value) {
-					return false;
+				else if constexpr (Traits::kind == ValueKind::Scalar) {
+					static_assert(sizeof(T) <= sizeof(ExternalReturn::data));
+					std::construct_at(reinterpret_cast<T*>(ret.data), CallNative<T>(a.vm, addr));
 				}
-				a.storage.emplace_back(value, paramType.GetType());
-				dcArgPointer(a.vm, value);
-				return true;
-			}
-			case ValueType::ArrayChar16: {
-				void* const value = CreateArray<char16_t>(pItem);
-				if (!value) {
-					return false;
+				else if constexpr (Traits::kind == ValueKind::Function) {
+					std::construct_at(reinterpret_cast<void**>(ret.data), dcCallPointer(a.vm, addr));
 				}
-				a.storage.emplace_back(value, paramType.GetType());
-				dcArgPointer(a.vm, value);
-				return true;
+				else if constexpr (Traits::kind == ValueKind::Struct) {
+					static_assert(sizeof(T) <= sizeof(ExternalReturn::data));
+					dcCallAggr(a.vm, addr, GetAggregate<T>(), ret.data);
+				}
+				// Unsupported types are not called, ExternalReturnToObject reports them
 			}
-			case ValueType::ArrayInt8: {
-				void* const value = CreateArray<int8_t>(pItem);
-				if (!value) {
-					return false;
+		};
+
+		// Return values that need nothing but their type, function pointers are handled by ExternalReturnToObjectOp
+		struct ValueReturnToObjectOp {
+			template<ValueType V>
+			static PyObject* Invoke(const ArgsScope& a, const ExternalReturn& ret) {
+				using Traits = ValueTraits<V>;
+				using T = typename Traits::Type;
+				if constexpr (Traits::kind == ValueKind::Void) {
+					Py_RETURN_NONE;
+				}
+				else if constexpr (Traits::kind == ValueKind::Scalar || Traits::kind == ValueKind::Struct) {
+					return CreatePyObject(*std::launder(reinterpret_cast<const T*>(ret.data)));
+				}
+				else if constexpr (Traits::kind == ValueKind::Object) {
+					return ConvertToObject(*static_cast<const T*>(std::get<0>(a.storage[0])));
+				}
+				else {
+					SetUnsupportedTypeError("MakeExternalCall", V);
+					return nullptr;
 				}
-				a.storage.emplace_back(value, paramType.GetType());
-				dcArgPointer(a.vm, value);
-				return true;
 			}
-			case ValueType::ArrayInt16: {
-				void* const value = CreateArray<int16_t>(pItem);
-				if (!value) {
-					return false;
+		};
+
+		struct ExternalReturnToObjectOp {
+			template<ValueType V>
+			static PyObject* Invoke(MethodRef method, const ArgsScope& a, const ExternalReturn& ret) {
+				if constexpr (ValueTraits<V>::kind == ValueKind::Function) {
+					return GetOrCreateFunctionObject(method.GetReturnType().GetPrototype().value(), *std::launder(reinterpret_cast<void* const*>(ret.data)));
 				}
-				a.storage.emplace_back(value, paramType.GetType());
-				dcArgPointer(a.vm, value);
-				return true;
-			}
-			case ValueType::ArrayInt32: {
-				void* const value = CreateArray<int32_t>(pItem);
-				if (!value) {
-					return false;
+				else {
+					return ValueReturnToObjectOp::Invoke<V>(a, ret);
 				}
-				a.storage.emplace_back(value, paramType.GetType());
-				dcArgPointer(a.vm, value);
-				return true;
 			}
-			case ValueType::ArrayInt64: {
-				void* const value = CreateArray<int64_t>(pItem);
-				if (!value) {
-					return false;
+		};
+
+		// Parameters that need nothing but their type, function pointers are handled by PushObjectAsParamOp
+		struct PushValueParamOp {
+			template<ValueType V>
+			static bool Invoke(PyObject* pItem, ArgsScope& a) {
+				using Traits = ValueTraits<V>;
+				using T = typename Traits::Type;
+				if constexpr (Traits::kind == ValueKind::Scalar) {
+					const auto value = ValueFromObject<T>(pItem);
+					if (!value) {
+						return false;
+					}
+					PushArg(a.vm, *value);
+					return true;
 				}
-				a.storage.emplace_back(value, paramType.GetType());
-				dcArgPointer(a.vm, value);
-				return true;
-			}
-			case ValueType::ArrayUInt8: {
-				void* const value = CreateArray<uint8_t>(pItem);
-				if (!value) {
-					return false;
+				else if constexpr (Traits::kind == ValueKind::Object || Traits::kind == ValueKind::Struct) {
+					return PushStorage(a, CreateValue<T>(pItem), V);
 				}
-				a.storage.emplace_back(value, paramType.GetType());
-				dcArgPointer(a.vm, value);
-				return true;
-			}
-			case ValueType::ArrayUInt16: {
-				void* const value = CreateArray<uint16_t>(pItem);
-				if (!value) {
+				else {
+					SetUnsupportedTypeError("PushObjectAsParam", V);
 					return false;
 				}
-				a.storage.emplace_back(value, paramType.GetType());
-				dcArgPointer(a.vm, value);
-				return true;
 			}
-			case ValueType::ArrayUInt32: {
-				void* const value = CreateArray<uint32_t>(pItem);
-				if (!value) {
-					return false;
+		};
+
+		struct PushObjectAsParamOp {
+			template<ValueType V>
+			static bool Invoke(PropertyRef paramType, PyObject* pItem, ArgsScope& a) {
+				if constexpr (ValueTraits<V>::kind == ValueKind::Function) {
+					const auto value = GetOrCreateFunctionValue(paramType.GetPrototype().value(), pItem);
+					if (!value) {
+						return false;
+					}
+					dcArgPointer(a.vm, *value);
+					return true;
 				}
-				a.storage.emplace_back(value, paramType.GetType());
-				dcArgPointer(a.vm, value);
-				return true;
-			}
-			case ValueType::ArrayUInt64: {
-				void* const value = CreateArray<uint64_t>(pItem);
-				if (!value) {
-					return false;
+				else {
+					return PushValueParamOp::Invoke<V>(pItem, a);
 				}
-				a.storage.emplace_back(value, paramType.GetType());
-				dcArgPointer(a.vm, value);
-				return true;
 			}
-			case ValueType::ArrayPointer: {
-				void* const value = CreateArray<uintptr_t>(pItem);
-				if (!value) {
-					return false;
+		};
+
+		struct PushObjectAsRefParamOp {
+			template<ValueType V>
+			static bool Invoke(PyObject* pItem, ArgsScope& a) {
+				if constexpr (IsStorable<V>) {
+					return PushStorage(a, CreateValue<typename ValueTraits<V>::Type>(pItem), V);
 				}
-				a.storage.emplace_back(value, paramType.GetType());
-				dcArgPointer(a.vm, value);
-				return true;
-			}
-			case ValueType::ArrayFloat: {
-				void* const value = CreateArray<float>(pItem);
-				if (!value) {
+				else {
+					SetUnsupportedTypeError("PushObjectAsRefParam", V);
 					return false;
 				}
-				a.storage.emplace_back(value, paramType.GetType());
-				dcArgPointer(a.vm, value);
-				return true;
 			}
-			case ValueType::ArrayDouble: {
-				void* const value = CreateArray<double>(pItem);
-				if (!value) {
-					return false;
+		};
+
+		// Reference parameter left out by the caller, the callee gets a default value to write to
+		struct PushDefaultRefParamOp {
+			template<ValueType V>
+			static bool Invoke(ArgsScope& a) {
+				if constexpr (IsStorable<V>) {
+					return PushStorage(a, new typename ValueTraits<V>::Type{}, V);
 				}
-				a.storage.emplace_back(value, paramType.GetType());
-				dcArgPointer(a.vm, value);
-				return true;
-			}
-			case ValueType::ArrayString: {
-				void* const value = CreateArray<std::string>(pItem);
-				if (!value) {
+				else {
+					SetUnsupportedTypeError("PushDefaultRefParam", V);
 					return false;
 				}
-				a.storage.emplace_back(value, paramType.GetType());
-				dcArgPointer(a.vm, value);
-				return true;
 			}
-			case ValueType::Vector2: {
-				void* const value = CreateValue<Vector2>(pItem);
-				if (!value) {
-					return false;
+		};
+
+		struct StorageValueToObjectOp {
+			template<ValueType V>
+			static PyObject* Invoke(ValueType type, const void* value) {
+				if constexpr (IsStorable<V>) {
+					return ConvertToObject(*static_cast<const typename ValueTraits<V>::Type*>(value));
 				}
-				a.storage.emplace_back(value, paramType.GetType());
-				dcArgPointer(a.vm, value);
-				return true;
-			}
-			case ValueType::Vector3: {
-				void* const value = CreateValue<Vector3>(pItem);
-				if (!value) {
-					return false;
+				else {
+					SetUnsupportedTypeError("StorageValueToObject", type);
+					return nullptr;
 				}
-				a.storage.emplace_back(value, paramType.GetType());
-				dcArgPointer(a.vm, value);
-				return true;
 			}
-			case ValueType::Vector4: {
-				void* const value = CreateValue<Vector4>(pItem);
-				if (!value) {
-					return false;
-				}
-				a.storage.emplace_back(value, paramType.GetType());
-				dcArgPointer(a.vm, value);
-				return true;
+		};
+
+		void BeginExternalCall(MethodRef method, ArgsScope& a) {
+			Dispatch<BeginExternalCallOp>(method.GetReturnType().GetType())(a);
+		}
+
+		void InvokeExternal(MethodRef method, void* addr, const ArgsScope& a, ExternalReturn& ret) {
+			Dispatch<InvokeExternalOp>(method.GetReturnType().GetType())(addr, a, ret);
+		}
+
+		PyObject* ExternalReturnToObject(MethodRef method, const ArgsScope& a, const ExternalReturn& ret) {
+			return Dispatch<ExternalReturnToObjectOp>(method.GetReturnType().GetType())(method, a, ret);
+		}
+
+		bool PushObjectAsParam(PropertyRef paramType, PyObject* pItem, ArgsScope& a) {
+			return Dispatch<PushObjectAsParamOp>(paramType.GetType())(paramType, pItem, a);
+		}
+
+		bool PushObjectAsRefParam(PropertyRef paramType, PyObject* pItem, ArgsScope& a) {
+			return Dispatch<PushObjectAsRefParamOp>(paramType.GetType())(pItem, a);
+		}
+
+		PyObject* StorageValueToObject(const std::pair<void*, ValueType>& value) {
+			return Dispatch<StorageValueToObjectOp>(value.second)(value.second, value.first);
+		}
+
+		// Converted arguments: everything held in storage plus scalars pushed directly
+		uint64_t StorageBytes(MethodRef method, const ArgsScope& a) {
+			uint64_t bytes = 0;
+			for (const auto& [ptr, type] : a.storage) {
+				bytes += Dispatch<ValueBytesOp>(type)(ptr);
 			}
-			case ValueType::Matrix4x4: {
-				void* const value = CreateValue<Matrix4x4>(pItem);
-				if (!value) {
-					return false;
+			for (const PropertyRef paramType : method.GetParamTypes()) {
+				if (!paramType.IsReference()) {
+					bytes += Dispatch<ValueBytesOp>(paramType.GetType())(nullptr);
 				}
-				a.storage.emplace_back(value, paramType.GetType());
-				dcArgPointer(a.vm, value);
-				return true;
-			}
-			default: {
-				const std::string error(std::format("PushObjectAsParam unsupported type {:#x}", static_cast<uint8_t>(paramType.GetType())));
-				PyErr_SetString(PyExc_RuntimeError, error.c_str());
-				return false;
 			}
+			return bytes;
+		}
+
+		// Calling plugin for probes, looked up only while a tracer is attached
+		const char* ExternalCallPlugin() {
+			if (PY3LM_PROBE_ENABLED(external_call__entry) || PY3LM_PROBE_ENABLED(external_call__return)) {
+				return g_py3lm.GetGilStats().GetTagName(GilStats::CurrentTag());
 			}
+			return "";
+		}
 
-			return false;
+		// Module functions have target baked into the thunk, thunks shared per signature carry it in PyCFunction self
+		void* GetExternalTarget(MemAddr data, const Parameters* p) {
+			if (data) {
+				return data;
+			}
+			return PyCapsule_GetPointer(p->GetArgument<PyObject*>(0), kExternalTargetName);
 		}
 
-		bool PushObjectAsRefParam(PropertyRef paramType, PyObject* pItem, ArgsScope& a) {
-			const auto PushRefParam = [&paramType, &a](void* value) {
-				if (!value) {
-					return false;
-				}
-				a.storage.emplace_back(value, paramType.GetType());
-				dcArgPointer(a.vm, value);
-				return true;
-			};
+		// Converts arguments under the GIL, the call itself can then run without it
+		bool PrepareExternalCall(MethodRef method, PyObject* args, ArgsScope& a) {
+			if (!PyTuple_Check(args)) {
+				const std::string error(std::format("Function \"{}\" expects a tuple of arguments", method.GetFunctionName()));
+				PyErr_SetString(PyExc_TypeError, error.c_str());
+				return false;
+			}
 
-			switch (paramType.GetType()) {
-			case ValueType::Bool:
-				return PushRefParam(CreateValue<bool>(pItem));
-			case ValueType::Char8:
-				return PushRefParam(CreateValue<char>(pItem));
-			case ValueType::Char16:
-				return PushRefParam(CreateValue<char16_t>(pItem));
-			case ValueType::Int8:
-				return PushRefParam(CreateValue<int8_t>(pItem));
-			case ValueType::Int16:
-				return PushRefParam(CreateValue<int16_t>(pItem));
-			case ValueType::Int32:
-				return PushRefParam(CreateValue<int32_t>(pItem));
-			case ValueType::Int64:
-				return PushRefParam(CreateValue<int64_t>(pItem));
-			case ValueType::UInt8:
-				return PushRefParam(CreateValue<uint8_t>(pItem));
-			case ValueType::UInt16:
-				return PushRefParam(CreateValue<uint16_t>(pItem));
-			case ValueType::UInt32:
-				return PushRefParam(CreateValue<uint32_t>(pItem));
-			case ValueType::UInt64:
-				return PushRefParam(CreateValue<uint64_t>(pItem));
-			case ValueType::Pointer:
-				return PushRefParam(CreateValue<uintptr_t>(pItem));
-			case ValueType::Float:
-				return PushRefParam(CreateValue<float>(pItem));
-			case ValueType::Double:
-				return PushRefParam(CreateValue<double>(pItem));
-			case ValueType::String:
-				return PushRefParam(CreateValue<std::string>(pItem));
-			case ValueType::ArrayBool:
-				return PushRefParam(CreateArray<bool>(pItem));
-			case ValueType::ArrayChar8:
-				return PushRefParam(CreateArray<char>(pItem));
-			case ValueType::ArrayChar16:
-				return PushRefParam(CreateArray<char16_t>(pItem));
-			case ValueType::ArrayInt8:
-				return PushRefParam(CreateArray<int8_t>(pItem));
-			case ValueType::ArrayInt16:
-				return PushRefParam(CreateArray<int16_t>(pItem));
-			case ValueType::ArrayInt32:
-				return PushRefParam(CreateArray<int32_t>(pItem));
-			case ValueType::ArrayInt64:
-				return PushRefParam(CreateArray<int64_t>(pItem));
-			case ValueType::ArrayUInt8:
-				return PushRefParam(CreateArray<uint8_t>(pItem));
-			case ValueType::ArrayUInt16:
-				return PushRefParam(CreateArray<uint16_t>(pItem));
-			case ValueType::ArrayUInt32:
-				return PushRefParam(CreateArray<uint32_t>(pItem));
-			case ValueType::ArrayUInt64:
-				return PushRefParam(CreateArray<uint64_t>(pItem));
-			case ValueType::ArrayPointer:
-				return PushRefParam(CreateArray<uintptr_t>(pItem));
-			case ValueType::ArrayFloat:
-				return PushRefParam(CreateArray<float>(pItem));
-			case ValueType::ArrayDouble:
-				return PushRefParam(CreateArray<double>(pItem));
-			case ValueType::ArrayString:
-				return PushRefParam(CreateArray<std::string>(pItem));
-			case ValueType::Vector2:
-				return PushRefParam(CreateValue<Vector2>(pItem));
-			case ValueType::Vector3:
-				return PushRefParam(CreateValue<Vector3>(pItem));
-			case ValueType::Vector4:
-				return PushRefParam(CreateValue<Vector4>(pItem));
-			case ValueType::Matrix4x4:
-				return PushRefParam(CreateValue<Matrix4x4>(pItem));
-			default: {
-				const std::string error(std::format("PushObjectAsRefParam unsupported type {:#x}", static_cast<uint8_t>(paramType.GetType())));
-				PyErr_SetString(PyExc_RuntimeError, error.c_str());
+			const auto paramTypes = method.GetParamTypes();
+			const auto paramCount = static_cast<uint8_t>(paramTypes.size());
+			const Py_ssize_t size = PyTuple_Size(args);
+			if (size != static_cast<Py_ssize_t>(paramCount)) {
+				const std::string error(std::format("Wrong number of parameters, {} when {} required.", size, paramCount));
+				PyErr_SetString(PyExc_TypeError, error.c_str());
 				return false;
 			}
+
+			BeginExternalCall(method, a);
+
+			for (Py_ssize_t i = 0; i < size; ++i) {
+				const PropertyRef paramType = paramTypes[i];
+				if (paramType.IsReference()) {
+					a.refs.push_back(static_cast<uint8_t>(a.storage.size()));
+				}
+				using PushParamFunc = bool (*)(PropertyRef, PyObject*, ArgsScope&);
+				PushParamFunc const pushParamFunc = paramType.IsReference() ? &PushObjectAsRefParam : &PushObjectAsParam;
+				if (!pushParamFunc(paramType, PyTuple_GetItem(args, i), a)) {
+					// pushParamFunc set error
+					return false;
+				}
 			}
 
-			return false;
+			return true;
 		}
 
-		PyObject* StorageValueToObject(PropertyRef paramType, const ArgsScope& a, uint8_t index) {
-			switch (paramType.GetType()) {
-			case ValueType::Bool:
-				return CreatePyObject(*reinterpret_cast<bool*>(std::get<0>(a.storage[index])));
-			case ValueType::Char8:
-				return CreatePyObject(*reinterpret_cast<char*>(std::get<0>(a.storage[index])));
-			case ValueType::Char16:
-				return CreatePyObject(*reinterpret_cast<char16_t*>(std::get<0>(a.storage[index])));
-			case ValueType::Int8:
-				return CreatePyObject(*reinterpret_cast<int8_t*>(std::get<0>(a.storage[index])));
-			case ValueType::Int16:
-				return CreatePyObject(*reinterpret_cast<int16_t*>(std::get<0>(a.storage[index])));
-			case ValueType::Int32:
-				return CreatePyObject(*reinterpret_cast<int32_t*>(std::get<0>(a.storage[index])));
-			case ValueType::Int64:
-				return CreatePyObject(*reinterpret_cast<int64_t*>(std::get<0>(a.storage[index])));
-			case ValueType::UInt8:
-				return CreatePyObject(*reinterpret_cast<uint8_t*>(std::get<0>(a.storage[index])));
-			case ValueType::UInt16:
-				return CreatePyObject(*reinterpret_cast<uint16_t*>(std::get<0>(a.storage[index])));
-			case ValueType::UInt32:
-				return CreatePyObject(*reinterpret_cast<uint32_t*>(std::get<0>(a.storage[index])));
-			case ValueType::UInt64:
-				return CreatePyObject(*reinterpret_cast<uint64_t*>(std::get<0>(a.storage[index])));
-			case ValueType::Float:
-				return CreatePyObject(*reinterpret_cast<float*>(std::get<0>(a.storage[index])));
-			case ValueType::Double:
-				return CreatePyObject(*reinterpret_cast<double*>(std::get<0>(a.storage[index])));
-			case ValueType::String:
-				return CreatePyObject(*reinterpret_cast<std::string*>(std::get<0>(a.storage[index])));
-			case ValueType::Pointer:
-				return CreatePyObject(*reinterpret_cast<uintptr_t*>(std::get<0>(a.storage[index])));
-			case ValueType::ArrayBool:
-				return CreatePyObjectList(*reinterpret_cast<std::vector<bool>*>(std::get<0>(a.storage[index])));
-			case ValueType::ArrayChar8:
-				return CreatePyObjectList(*reinterpret_cast<std::vector<char>*>(std::get<0>(a.storage[index])));
-			case ValueType::ArrayChar16:
-				return CreatePyObjectList(*reinterpret_cast<std::vector<char16_t>*>(std::get<0>(a.storage[index])));
-			case ValueType::ArrayInt8:
-				return CreatePyObjectList(*reinterpret_cast<std::vector<int8_t>*>(std::get<0>(a.storage[index])));
-			case ValueType::ArrayInt16:
-				return CreatePyObjectList(*reinterpret_cast<std::vector<int16_t>*>(std::get<0>(a.storage[index])));
-			case ValueType::ArrayInt32:
-				return CreatePyObjectList(*reinterpret_cast<std::vector<int32_t>*>(std::get<0>(a.storage[index])));
-			case ValueType::ArrayInt64:
-				return CreatePyObjectList(*reinterpret_cast<std::vector<int64_t>*>(std::get<0>(a.storage[index])));
-			case ValueType::ArrayUInt8:
-				return CreatePyObjectList(*reinterpret_cast<std::vector<uint8_t>*>(std::get<0>(a.storage[index])));
-			case ValueType::ArrayUInt16:
-				return CreatePyObjectList(*reinterpret_cast<std::vector<uint16_t>*>(std::get<0>(a.storage[index])));
-			case ValueType::ArrayUInt32:
-				return CreatePyObjectList(*reinterpret_cast<std::vector<uint32_t>*>(std::get<0>(a.storage[index])));
-			case ValueType::ArrayUInt64:
-				return CreatePyObjectList(*reinterpret_cast<std::vector<uint64_t>*>(std::get<0>(a.storage[index])));
-			case ValueType::ArrayPointer:
-				return CreatePyObjectList(*reinterpret_cast<std::vector<uintptr_t>*>(std::get<0>(a.storage[index])));
-			case ValueType::ArrayFloat:
-				return CreatePyObjectList(*reinterpret_cast<std::vector<float>*>(std::get<0>(a.storage[index])));
-			case ValueType::ArrayDouble:
-				return CreatePyObjectList(*reinterpret_cast<std::vector<double>*>(std::get<0>(a.storage[index])));
-			case ValueType::ArrayString:
-				return CreatePyObjectList(*reinterpret_cast<std::vector<std::string>*>(std::get<0>(a.storage[index])));
-			case ValueType::Vector2:
-				return CreatePyObject(*reinterpret_cast<Vector2*>(std::get<0>(a.storage[index])));
-			case ValueType::Vector3:
-				return CreatePyObject(*reinterpret_cast<Vector3*>(std::get<0>(a.storage[index])));
-			case ValueType::Vector4:
-				return CreatePyObject(*reinterpret_cast<Vector4*>(std::get<0>(a.storage[index])));
-			case ValueType::Matrix4x4:
-				return CreatePyObject(*reinterpret_cast<Matrix4x4*>(std::get<0>(a.storage[index])));
-			default: {
-				const std::string error(std::format("StorageValueToObject unsupported type {:#x}", static_cast<uint8_t>(paramType.GetType())));
-				PyErr_SetString(PyExc_RuntimeError, error.c_str());
+		// Return value, or tuple of return value followed by reference parameters. Takes over retObj
+		PyObject* AppendRefValues(PyObject* retObj, const ArgsScope& a) {
+			if (!retObj) {
+				// Return conversion set error
+				return nullptr;
+			}
+
+			if (a.refs.empty()) {
+				return retObj;
+			}
+
+			PyObject* const retTuple = PyTuple_New(static_cast<Py_ssize_t>(1 + a.refs.size()));
+			if (!retTuple) {
+				Py_DECREF(retObj);
 				return nullptr;
 			}
+
+			Py_ssize_t k = 0;
+
+			PyTuple_SET_ITEM(retTuple, k++, retObj); // retObj ref taken by tuple
+
+			for (const uint8_t index : a.refs) {
+				PyObject* const value = StorageValueToObject(a.storage[index]);
+				if (!value) {
+					// StorageValueToObject set error
+					Py_DECREF(retTuple);
+					return nullptr;
+				}
+				PyTuple_SET_ITEM(retTuple, k++, value);
 			}
+
+			return retTuple;
+		}
+
+		PyObject* FinishExternalCall(MethodRef method, const ArgsScope& a, const ExternalReturn& ret) {
+			return AppendRefValues(ExternalReturnToObject(method, a, ret), a);
 		}
 
-		void ExternalCallNoArgs(MethodRef method, MemAddr addr, const Parameters* p, uint8_t count, const ReturnValue* ret) {
+		void ExternalCallNoArgs(MethodRef method, MemAddr data, const Parameters* p, uint8_t count, const ReturnValue* ret) {
 			// PyObject* (MethodPyCall*)(PyObject* self, PyObject* args)
+			void* const addr = GetExternalTarget(data, p);
+			const char* const plugin = ExternalCallPlugin();
+			PY3LM_PROBE(external_call__entry, plugin, method.GetName().c_str(), 0);
 			ArgsScope a(1);
 			BeginExternalCall(method, a);
-			PyObject* const retObj = MakeExternalCall(method, addr, a);
-			if (!retObj) {
-				// MakeExternalCall set error
-				ret->SetReturnPtr(nullptr);
-				return;
+			ExternalReturn result;
+			{
+				GilReleaseScope gil(g_py3lm.GetGilStats());
+				InvokeExternal(method, addr, a, result);
 			}
+			PyObject* const retObj = FinishExternalCall(method, a, result);
+			PY3LM_PROBE(external_call__return, plugin, method.GetName().c_str(), retObj == nullptr);
 			ret->SetReturnPtr(retObj);
 		}
 
-		void ExternalCall(MethodRef method, MemAddr addr, const Parameters* p, uint8_t count, const ReturnValue* ret) {
+		void ExternalCall(MethodRef method, MemAddr data, const Parameters* p, uint8_t count, const ReturnValue* ret) {
 			// PyObject* (MethodPyCall*)(PyObject* self, PyObject* args)
-			const auto args = p->GetArgument<PyObject*>(1);
-
-			if (!PyTuple_Check(args)) {
-				const std::string error(std::format("Function \"{}\" expects a tuple of arguments", method.GetFunctionName()));
-				PyErr_SetString(PyExc_TypeError, error.c_str());
+			void* const addr = GetExternalTarget(data, p);
+			ArgsScope a(static_cast<uint8_t>(1 + method.GetParamTypes().size()));
+			bool prepared;
+			{
+				// Result object is owned by caller, only argument conversion is expected to be balanced
+				RefAuditScope audit(g_py3lm.GetRefAudit(), "call", method.GetName());
+				prepared = PrepareExternalCall(method, p->GetArgument<PyObject*>(1), a);
+			}
+			const char* const plugin = ExternalCallPlugin();
+			PY3LM_PROBE(external_call__entry, plugin, method.GetName().c_str(), prepared && PY3LM_PROBE_ENABLED(external_call__entry) ? StorageBytes(method, a) : 0);
+			if (!prepared) {
+				PY3LM_PROBE(external_call__return, plugin, method.GetName().c_str(), true);
 				ret->SetReturnPtr(nullptr);
 				return;
 			}
+			ExternalReturn result;
+			{
+				GilReleaseScope gil(g_py3lm.GetGilStats());
+				InvokeExternal(method, addr, a, result);
+			}
+			PyObject* const retObj = FinishExternalCall(method, a, result);
+			PY3LM_PROBE(external_call__return, plugin, method.GetName().c_str(), retObj == nullptr);
+			ret->SetReturnPtr(retObj);
+		}
 
-			const auto paramTypes = method.GetParamTypes();
-			const auto paramCount = static_cast<uint8_t>(paramTypes.size());
-			const Py_ssize_t size = PyTuple_Size(args);
-			if (size != static_cast<Py_ssize_t>(paramCount)) {
-				const std::string error(std::format("Wrong number of parameters, {} when {} required.", size, paramCount));
-				PyErr_SetString(PyExc_TypeError, error.c_str());
-				ret->SetReturnPtr(nullptr);
-				return;
+		// Awaitable variant of module functions: arguments are converted under the GIL,
+		// native call runs on the module worker pool and its result resolves a future
+
+		struct AsyncExternalCall {
+			MethodRef method;
+			void* addr;
+			ArgsScope args;
+			ExternalReturn result;
+			PyObject* future = nullptr;
+			PyObject* loop = nullptr; // null for concurrent.futures.Future
+			uint32_t tag = GilStats::kModuleTag;
+
+			AsyncExternalCall(MethodRef method, void* addr) : method{method}, addr{addr}, args{static_cast<uint8_t>(1 + method.GetParamTypes().size())} {}
+
+			// Completed calls drop their references under the GIL, these are left only by calls never run
+			~AsyncExternalCall() {
+				if ((future || loop) && Py_IsInitialized()) {
+					GilEnterScope gil(g_py3lm.GetGilStats(), tag);
+					Py_XDECREF(future);
+					Py_XDECREF(loop);
+				}
+			}
+		};
+
+		bool CreateCallFuture(AsyncExternalCall& call) {
+			call.future = CreateFuture(&call.loop);
+			return call.future != nullptr;
+		}
+
+		void CompleteAsyncExternalCall(AsyncExternalCall& call) {
+			InvokeExternal(call.method, call.addr, call.args, call.result);
+
+			GilEnterScope gil(g_py3lm.GetGilStats(), call.tag);
+
+			PyObject* result = FinishExternalCall(call.method, call.args, call.result);
+			PyObject* exception;
+			if (result) {
+				exception = Py_NewRef(Py_None);
+			}
+			else {
+				exception = PyErr_GetRaisedException();
+				result = Py_NewRef(Py_None);
+			}
+
+			ResolveFuture(call.future, call.loop, result, exception);
+
+			Py_DECREF(result);
+			Py_DECREF(exception);
+			// Job is destroyed without the GIL
+			Py_CLEAR(call.future);
+			Py_CLEAR(call.loop);
+		}
+
+		struct ExternalFunctionObject {
+			PyObject_HEAD
+			vectorcallfunc vectorcall;
+			PyObject* function; // PyCFunction making the synchronous call
+			MethodRef method;
+			void* addr;
+		};
+
+		PyObject* ExternalFunction_Vectorcall(PyObject* self, PyObject* const* args, size_t nargsf, PyObject* kwnames) {
+			return PyObject_Vectorcall(reinterpret_cast<ExternalFunctionObject*>(self)->function, args, nargsf, kwnames);
+		}
+
+		PyObject* ExternalFunction_AsyncCall(PyObject* self, PyObject* args) {
+			const auto* const object = reinterpret_cast<ExternalFunctionObject*>(self);
+			auto call = std::make_shared<AsyncExternalCall>(object->method, object->addr);
+			if (!PrepareExternalCall(call->method, args, call->args)) {
+				return nullptr;
+			}
+			if (!CreateCallFuture(*call)) {
+				return nullptr;
+			}
+			call->tag = GilStats::CurrentTag();
+			PyObject* const future = Py_NewRef(call->future);
+			g_py3lm.GetWorkerPool().Submit([call = std::move(call)] {
+				CompleteAsyncExternalCall(*call);
+			});
+			return future;
+		}
+
+		PyObject* ExternalFunction_Repr(PyObject* self) {
+			return PyUnicode_FromFormat("<plugify function %R>", reinterpret_cast<ExternalFunctionObject*>(self)->function);
+		}
+
+		int ExternalFunction_Traverse(PyObject* self, visitproc visit, void* arg) {
+			Py_VISIT(reinterpret_cast<ExternalFunctionObject*>(self)->function);
+			Py_VISIT(Py_TYPE(self));
+			return 0;
+		}
+
+		int ExternalFunction_Clear(PyObject* self) {
+			Py_CLEAR(reinterpret_cast<ExternalFunctionObject*>(self)->function);
+			return 0;
+		}
+
+		void ExternalFunction_Dealloc(PyObject* self) {
+			PyTypeObject* const type = Py_TYPE(self);
+			PyObject_GC_UnTrack(self);
+			ExternalFunction_Clear(self);
+			std::destroy_at(&reinterpret_cast<ExternalFunctionObject*>(self)->method);
+			type->tp_free(self);
+			Py_DECREF(type);
+		}
+
+		PyMethodDef kExternalFunctionMethods[] = {
+			{ "async_call", &ExternalFunction_AsyncCall, METH_VARARGS, "Run the native call on a worker thread, returns an awaitable future" },
+			{ nullptr, nullptr, 0, nullptr }
+		};
+
+		PyMemberDef kExternalFunctionMembers[] = {
+			{ "__wrapped__", Py_T_OBJECT_EX, offsetof(ExternalFunctionObject, function), Py_READONLY, nullptr },
+			{ "__vectorcalloffset__", Py_T_PYSSIZET, offsetof(ExternalFunctionObject, vectorcall), Py_READONLY, nullptr },
+			{ nullptr, 0, 0, 0, nullptr }
+		};
+
+		PyType_Slot kExternalFunctionSlots[] = {
+			{ Py_tp_dealloc, reinterpret_cast<void*>(&ExternalFunction_Dealloc) },
+			{ Py_tp_traverse, reinterpret_cast<void*>(&ExternalFunction_Traverse) },
+			{ Py_tp_clear, reinterpret_cast<void*>(&ExternalFunction_Clear) },
+			{ Py_tp_repr, reinterpret_cast<void*>(&ExternalFunction_Repr) },
+			{ Py_tp_call, reinterpret_cast<void*>(&PyVectorcall_Call) },
+			{ Py_tp_methods, kExternalFunctionMethods },
+			{ Py_tp_members, kExternalFunctionMembers },
+			{ 0, nullptr }
+		};
+
+		PyType_Spec kExternalFunctionSpec = {
+			"plugify.Function",
+			sizeof(ExternalFunctionObject),
+			0,
+			Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC | Py_TPFLAGS_HAVE_VECTORCALL | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+			kExternalFunctionSlots
+		};
+
+		PyObject* CreateExternalFunction(PyObject* type, PyObject* function, MethodRef method, void* addr) {
+			auto* const object = PyObject_GC_New(ExternalFunctionObject, reinterpret_cast<PyTypeObject*>(type));
+			if (!object) {
+				return nullptr;
+			}
+			object->vectorcall = &ExternalFunction_Vectorcall;
+			object->function = Py_NewRef(function);
+			std::construct_at(&object->method, method);
+			object->addr = addr;
+			PyObject_GC_Track(object);
+			return reinterpret_cast<PyObject*>(object);
+		}
+
+		// plugify.ffi: calls to raw function pointers described by a signature string instead of a manifest prototype
+
+		// Call VMs reused per thread, one per nesting level since the callee may call back into Python
+		class FfiCallVms {
+		public:
+			~FfiCallVms() {
+				for (DCCallVM* const vm : _vms) {
+					dcFree(vm);
+				}
+			}
+
+			DCCallVM* Acquire() {
+				if (_depth == _vms.size()) {
+					_vms.push_back(dcNewCallVM(4096));
+				}
+				return _vms[_depth++];
+			}
+
+			void Release() {
+				--_depth;
+			}
+
+		private:
+			std::vector<DCCallVM*> _vms;
+			size_t _depth = 0;
+		};
+
+		thread_local FfiCallVms t_ffiCallVms;
+
+		struct FfiVmLease {
+			DCCallVM* const vm = t_ffiCallVms.Acquire();
+			~FfiVmLease() {
+				t_ffiCallVms.Release();
+			}
+		};
+
+		struct FfiParam {
+			bool (*push)(PyObject*, ArgsScope&);
+			bool (*pushDefault)(ArgsScope&); // set for reference parameters
+			bool ref;
+		};
+
+		// Parsed once per distinct signature, a call only follows the resolved conversion functions
+		struct FfiSignature {
+			std::string text;
+			void (*begin)(ArgsScope&);
+			void (*invoke)(void*, const ArgsScope&, ExternalReturn&);
+			PyObject* (*toObject)(const ArgsScope&, const ExternalReturn&);
+			std::vector<FfiParam> params;
+			size_t required; // trailing reference parameters may be left out
+			uint8_t storageSize; // temp values held by ArgsScope, no allocation when zero
+		};
+
+		// Type names of plugin manifests, arrays also spelled "int32[]". Function pointers need a prototype,
+		// so they are passed as pointers here
+		std::optional<ValueType> FfiTypeFromName(std::string_view name) {
+			static constexpr std::pair<std::string_view, ValueType> kNames[] = {
+				{ "void", ValueType::Void },
+				{ "bool", ValueType::Bool },
+				{ "char8", ValueType::Char8 },
+				{ "char16", ValueType::Char16 },
+				{ "int8", ValueType::Int8 },
+				{ "int16", ValueType::Int16 },
+				{ "int32", ValueType::Int32 },
+				{ "int64", ValueType::Int64 },
+				{ "uint8", ValueType::UInt8 },
+				{ "uint16", ValueType::UInt16 },
+				{ "uint32", ValueType::UInt32 },
+				{ "uint64", ValueType::UInt64 },
+				{ sizeof(void*) == 8 ? "ptr64" : "ptr32", ValueType::Pointer },
+				{ "float", ValueType::Float },
+				{ "double", ValueType::Double },
+				{ "string", ValueType::String },
+				{ "bool*", ValueType::ArrayBool },
+				{ "char8*", ValueType::ArrayChar8 },
+				{ "char16*", ValueType::ArrayChar16 },
+				{ "int8*", ValueType::ArrayInt8 },
+				{ "int16*", ValueType::ArrayInt16 },
+				{ "int32*", ValueType::ArrayInt32 },
+				{ "int64*", ValueType::ArrayInt64 },
+				{ "uint8*", ValueType::ArrayUInt8 },
+				{ "uint16*", ValueType::ArrayUInt16 },
+				{ "uint32*", ValueType::ArrayUInt32 },
+				{ "uint64*", ValueType::ArrayUInt64 },
+				{ sizeof(void*) == 8 ? "ptr64*" : "ptr32*", ValueType::ArrayPointer },
+				{ "float*", ValueType::ArrayFloat },
+				{ "double*", ValueType::ArrayDouble },
+				{ "string*", ValueType::ArrayString },
+				{ "vec2", ValueType::Vector2 },
+				{ "vec3", ValueType::Vector3 },
+				{ "vec4", ValueType::Vector4 },
+				{ "mat4x4", ValueType::Matrix4x4 },
+			};
+			const bool brackets = name.ends_with("[]");
+			if (brackets) {
+				name.remove_suffix(2);
+			}
+			for (const auto& [typeName, type] : kNames) {
+				if (brackets ? typeName.size() == name.size() + 1 && typeName.starts_with(name) && typeName.back() == '*' : typeName == name) {
+					return type;
+				}
+			}
+			return std::nullopt;
+		}
+
+		// "ret(param, param&, ...)", sets ValueError on malformed input
+		const FfiSignature* GetFfiSignature(std::string_view text) {
+			std::string key;
+			key.reserve(text.size());
+			for (const char c : text) {
+				if (c != ' ' && c != '\t' && c != '\n') {
+					key.push_back(c);
+				}
+			}
+
+			// Shared by interpreters with their own GIL, entries are kept for the process lifetime like aggregates
+			static std::mutex mutex;
+			static std::unordered_map<std::string, std::unique_ptr<FfiSignature>> cache;
+			std::lock_guard lock(mutex);
+			if (const auto it = cache.find(key); it != cache.end()) {
+				return it->second.get();
+			}
+
+			const auto fail = [&key](const std::string& reason) -> const FfiSignature* {
+				const std::string error(std::format("Signature '{}': {}", key, reason));
+				PyErr_SetString(PyExc_ValueError, error.c_str());
+				return nullptr;
+			};
+
+			const auto open = key.find('(');
+			if (open == std::string::npos || key.back() != ')') {
+				return fail("expected 'ret(param, ...)'");
+			}
+			const std::string_view retName = std::string_view(key).substr(0, open);
+			const auto retType = FfiTypeFromName(retName);
+			if (!retType) {
+				return fail(std::format("unknown return type '{}'", retName));
+			}
+
+			auto signature = std::make_unique<FfiSignature>();
+			signature->text = key;
+			signature->begin = Dispatch<BeginExternalCallOp>(*retType);
+			signature->invoke = Dispatch<InvokeExternalOp>(*retType);
+			signature->toObject = Dispatch<ValueReturnToObjectOp>(*retType);
+			size_t storageSize = ValueUtils::IsObject(*retType) ? 1 : 0;
+
+			std::string_view list = std::string_view(key).substr(open + 1, key.size() - open - 2);
+			while (!list.empty()) {
+				const auto pos = list.find(',');
+				std::string_view name = list.substr(0, pos);
+				list = pos == std::string_view::npos ? std::string_view{} : list.substr(pos + 1);
+				if (pos != std::string_view::npos && list.empty()) {
+					return fail("trailing ','");
+				}
+				const bool ref = name.ends_with('&');
+				if (ref) {
+					name.remove_suffix(1);
+				}
+				const auto type = FfiTypeFromName(name);
+				if (!type || *type == ValueType::Void) {
+					return fail(std::format("invalid parameter type '{}'", name));
+				}
+				const bool stored = ref || ValueUtils::IsObject(*type) || (*type >= ValueType::Vector2 && *type <= ValueType::Matrix4x4);
+				storageSize += stored ? 1 : 0;
+				if (ref) {
+					signature->params.push_back({ Dispatch<PushObjectAsRefParamOp>(*type), Dispatch<PushDefaultRefParamOp>(*type), true });
+				}
+				else {
+					signature->params.push_back({ Dispatch<PushValueParamOp>(*type), nullptr, false });
+					signature->required = signature->params.size();
+				}
+			}
+			if (storageSize > UINT8_MAX) {
+				return fail("too many parameters");
 			}
+			signature->storageSize = static_cast<uint8_t>(storageSize);
 
-			Py_ssize_t refParamsCount = 0;
-			const Py_ssize_t paramsStartIndex = plugify::ValueUtils::IsObject(method.GetReturnType().GetType()) ? 1 : 0;
+			return cache.emplace(std::move(key), std::move(signature)).first->second.get();
+		}
 
-			ArgsScope a(1 + paramCount);
+		struct FfiFunctionObject {
+			PyObject_HEAD
+			vectorcallfunc vectorcall;
+			const FfiSignature* signature;
+			void* addr;
+			bool releaseGil;
+		};
 
-			BeginExternalCall(method, a);
+		PyObject* FfiFunction_Vectorcall(PyObject* self, PyObject* const* args, size_t nargsf, PyObject* kwnames) {
+			const auto* const object = reinterpret_cast<FfiFunctionObject*>(self);
+			const FfiSignature& signature = *object->signature;
+			const Py_ssize_t nargs = PyVectorcall_NARGS(nargsf);
+			if (kwnames && PyTuple_GET_SIZE(kwnames) != 0) {
+				PyErr_SetString(PyExc_TypeError, "ffi functions take no keyword arguments");
+				return nullptr;
+			}
+			if (nargs < static_cast<Py_ssize_t>(signature.required) || nargs > static_cast<Py_ssize_t>(signature.params.size())) {
+				if (signature.required == signature.params.size()) {
+					PyErr_Format(PyExc_TypeError, "Wrong number of parameters, %zd when %zu required.", nargs, signature.params.size());
+				}
+				else {
+					PyErr_Format(PyExc_TypeError, "Wrong number of parameters, %zd when %zu to %zu required.", nargs, signature.required, signature.params.size());
+				}
+				return nullptr;
+			}
 
-			for (Py_ssize_t i = 0; i < size; ++i) {
-				const PropertyRef paramType = paramTypes[i];
-				if (paramType.IsReference()) {
-					++refParamsCount;
+			FfiVmLease lease;
+			ArgsScope a(lease.vm, signature.storageSize);
+			signature.begin(a);
+			for (size_t i = 0; i < signature.params.size(); ++i) {
+				const FfiParam& param = signature.params[i];
+				if (param.ref) {
+					a.refs.push_back(static_cast<uint8_t>(a.storage.size()));
 				}
-				using PushParamFunc = bool (*)(PropertyRef, PyObject*, ArgsScope&);
-				PushParamFunc const pushParamFunc = paramType.IsReference() ? &PushObjectAsRefParam : &PushObjectAsParam;
-				const bool pushResult = pushParamFunc(paramType, PyTuple_GetItem(args, i), a);
-				if (!pushResult) {
-					// pushParamFunc set error
-					ret->SetReturnPtr(nullptr);
-					return;
+				if (!(i < static_cast<size_t>(nargs) ? param.push(args[i], a) : param.pushDefault(a))) {
+					// push set error
+					return nullptr;
 				}
 			}
 
-			PyObject* retObj = MakeExternalCall(method, addr, a);
-			if (!retObj) {
-				// MakeExternalCall set error
-				ret->SetReturnPtr(nullptr);
-				return;
+			ExternalReturn result;
+			if (object->releaseGil) {
+				GilReleaseScope gil(g_py3lm.GetGilStats());
+				signature.invoke(object->addr, a, result);
 			}
+			else {
+				signature.invoke(object->addr, a, result);
+			}
+			return AppendRefValues(signature.toObject(a, result), a);
+		}
 
-			if (refParamsCount) {
-				PyObject* const retTuple = PyTuple_New(1 + refParamsCount);
+		PyObject* FfiFunction_Repr(PyObject* self) {
+			const auto* const object = reinterpret_cast<FfiFunctionObject*>(self);
+			return PyUnicode_FromFormat("<ffi function %s at %p>", object->signature->text.c_str(), object->addr);
+		}
 
-				Py_ssize_t k = 0;
+		PyObject* FfiFunction_GetAddress(PyObject* self, void* /*closure*/) {
+			return PyLong_FromVoidPtr(reinterpret_cast<FfiFunctionObject*>(self)->addr);
+		}
 
-				PyTuple_SET_ITEM(retTuple, k++, retObj); // retObj ref taken by tuple
+		PyObject* FfiFunction_GetSignature(PyObject* self, void* /*closure*/) {
+			const std::string& text = reinterpret_cast<FfiFunctionObject*>(self)->signature->text;
+			return PyUnicode_FromStringAndSize(text.data(), static_cast<Py_ssize_t>(text.size()));
+		}
 
-				for (Py_ssize_t i = 0, j = paramsStartIndex; i < paramCount; ++i) {
-					const PropertyRef paramType = paramTypes[i];
-					if (!paramType.IsReference()) {
-						continue;
-					}
-					PyObject* const value = StorageValueToObject(paramType, a, j);
-					if (!value) {
-						// StorageValueToObject set error
-						Py_DECREF(retTuple);
-						ret->SetReturnPtr(nullptr);
-						return;
-					}
-					PyTuple_SET_ITEM(retTuple, k++, value);
-					++j;
-					if (k >= refParamsCount + 1) {
-						break;
-					}
-				}
+		void FfiFunction_Dealloc(PyObject* self) {
+			PyTypeObject* const type = Py_TYPE(self);
+			type->tp_free(self);
+			Py_DECREF(type);
+		}
+
+		PyGetSetDef kFfiFunctionGetSet[] = {
+			{ "address", &FfiFunction_GetAddress, nullptr, "Native function pointer", nullptr },
+			{ "signature", &FfiFunction_GetSignature, nullptr, "Normalized signature string", nullptr },
+			{ nullptr, nullptr, nullptr, nullptr, nullptr }
+		};
+
+		PyMemberDef kFfiFunctionMembers[] = {
+			{ "__vectorcalloffset__", Py_T_PYSSIZET, offsetof(FfiFunctionObject, vectorcall), Py_READONLY, nullptr },
+			{ nullptr, 0, 0, 0, nullptr }
+		};
+
+		PyType_Slot kFfiFunctionSlots[] = {
+			{ Py_tp_dealloc, reinterpret_cast<void*>(&FfiFunction_Dealloc) },
+			{ Py_tp_repr, reinterpret_cast<void*>(&FfiFunction_Repr) },
+			{ Py_tp_call, reinterpret_cast<void*>(&PyVectorcall_Call) },
+			{ Py_tp_getset, kFfiFunctionGetSet },
+			{ Py_tp_members, kFfiFunctionMembers },
+			{ 0, nullptr }
+		};
 
-				retObj = retTuple;
+		PyType_Spec kFfiFunctionSpec = {
+			"plugify.ffi.Function",
+			sizeof(FfiFunctionObject),
+			0,
+			Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_VECTORCALL | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+			kFfiFunctionSlots
+		};
+
+		PyObject* s_ffiFunctionType = nullptr;
+
+		PyObject* Ffi_Function(PyObject* /*self*/, PyObject* args, PyObject* kwargs) {
+			static const char* kKeywords[] = { "address", "signature", "release_gil", nullptr };
+			PyObject* addressObject;
+			const char* text;
+			int releaseGil = 1;
+			if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Os|p:function", const_cast<char**>(kKeywords), &addressObject, &text, &releaseGil)) {
+				return nullptr;
+			}
+			void* const addr = PyLong_AsVoidPtr(addressObject);
+			if (!addr) {
+				if (!PyErr_Occurred()) {
+					PyErr_SetString(PyExc_ValueError, "Function address is null");
+				}
+				return nullptr;
 			}
+			const FfiSignature* const signature = GetFfiSignature(text);
+			if (!signature) {
+				return nullptr;
+			}
+			auto* const object = PyObject_New(FfiFunctionObject, reinterpret_cast<PyTypeObject*>(s_ffiFunctionType));
+			if (!object) {
+				return nullptr;
+			}
+			object->vectorcall = &FfiFunction_Vectorcall;
+			object->signature = signature;
+			object->addr = addr;
+			object->releaseGil = releaseGil != 0;
+			return reinterpret_cast<PyObject*>(object);
+		}
 
-			ret->SetReturnPtr(retObj);
+		PyMethodDef kFfiMethods[] = {
+			{ "function", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(Ffi_Function)), METH_VARARGS | METH_KEYWORDS, "function(address, signature, release_gil=True) - callable for a native function pointer, e.g. signature 'int32(string, float&)'" },
+			{ nullptr, nullptr, 0, nullptr }
+		};
+
+		PyModuleDef kFfiModule = {
+			PyModuleDef_HEAD_INIT,
+			"plugify.ffi",
+			"Calls to raw native function pointers with the conversions of plugin functions",
+			-1,
+			kFfiMethods,
+			nullptr,
+			nullptr,
+			nullptr,
+			nullptr
+		};
+
+		PyObject* CreateFfiModule() {
+			PyObject* const module = PyModule_Create(&kFfiModule);
+			if (!module) {
+				return nullptr;
+			}
+			s_ffiFunctionType = PyType_FromSpec(&kFfiFunctionSpec);
+			if (!s_ffiFunctionType || PyModule_AddObjectRef(module, "Function", s_ffiFunctionType) != 0) {
+				Py_DECREF(module);
+				return nullptr;
+			}
+			return module;
 		}
 
 		template<typename T>
@@ -2500,6 +2205,149 @@ namespace py3lm {
 			Py_DECREF(attrObject);
 			return value;
 		}
+
+		// Thunks are allocated in load order, so one big block keeps exports of a plugin next to each other
+		// and the hot ones on a few (large when available) pages instead of many scattered 4 KiB ones
+		constexpr uint32_t kJitBlockSize = 2 * 1024 * 1024;
+
+		std::shared_ptr<asmjit::JitRuntime> CreateJitRuntime() {
+			asmjit::JitAllocator::CreateParams params{};
+			params.blockSize = kJitBlockSize;
+#if ASMJIT_LIBRARY_VERSION >= ASMJIT_LIBRARY_MAKE_VERSION(1, 10, 0)
+			// Allocator falls back to regular pages when large pages are not available
+			params.options = asmjit::JitAllocatorOptions::kUseLargePages | asmjit::JitAllocatorOptions::kAlignBlockSizeToLargePage;
+#endif
+			return std::make_shared<asmjit::JitRuntime>(&params);
+		}
+
+		// Makes module importable as 'plugify.<name>', steals module reference
+		bool RegisterNativeModule(const char* name, PyObject* module) {
+			if (!module) {
+				return false;
+			}
+			PyObject* const package = PyImport_ImportModule("plugify");
+			if (!package) {
+				Py_DECREF(module);
+				return false;
+			}
+			const std::string fullName(std::format("plugify.{}", name));
+			// PyImport_GetModuleDict returns borrowed reference
+			const bool result = PyDict_SetItemString(PyImport_GetModuleDict(), fullName.c_str(), module) == 0
+				&& PyObject_SetAttrString(package, name, module) == 0;
+			Py_DECREF(package);
+			Py_DECREF(module);
+			return result;
+		}
+
+		enum class FloatsResult {
+			Success,
+			Mismatch,
+			Error
+		};
+
+		bool FloatFromItem(PyObject* object, float& out) {
+			if (PyFloat_CheckExact(object)) [[likely]] {
+				out = static_cast<float>(PyFloat_AS_DOUBLE(object));
+				return true;
+			}
+			if (PyFloat_Check(object) || PyLong_Check(object)) {
+				const double value = PyFloat_AsDouble(object);
+				if (value == -1.0 && PyErr_Occurred()) {
+					return false;
+				}
+				out = static_cast<float>(value);
+				return true;
+			}
+			PyErr_SetString(PyExc_TypeError, "Not float");
+			return false;
+		}
+
+		// Works with exact list/tuple or result of PySequence_Fast
+		bool FloatsFromFastSequence(PyObject* sequence, float* out, Py_ssize_t count) {
+			if (PySequence_Fast_GET_SIZE(sequence) != count) {
+				PyErr_Format(PyExc_ValueError, "Expected sequence of %zd floats, got %zd", count, PySequence_Fast_GET_SIZE(sequence));
+				return false;
+			}
+			PyObject** const items = PySequence_Fast_ITEMS(sequence);
+			for (Py_ssize_t i = 0; i < count; ++i) {
+				if (!FloatFromItem(items[i], out[i])) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		FloatsResult FloatsFromBuffer(PyObject* object, float* out, Py_ssize_t count) {
+			Py_buffer view;
+			if (PyObject_GetBuffer(object, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0) {
+				// PyObject_GetBuffer set error. e.g. BufferError
+				return FloatsResult::Error;
+			}
+			// Native byte order 'f'/'d' only, with optional '@' or '=' prefix
+			const char* format = view.format ? view.format : "B";
+			if (*format == '@' || *format == '=') {
+				++format;
+			}
+			FloatsResult result = FloatsResult::Success;
+			if (format[0] == 'f' && format[1] == '\0' && view.len == count * Py_ssize_t{ sizeof(float) }) {
+				std::memcpy(out, view.buf, static_cast<size_t>(view.len));
+			}
+			else if (format[0] == 'd' && format[1] == '\0' && view.len == count * Py_ssize_t{ sizeof(double) }) {
+				const auto* const values = static_cast<const double*>(view.buf);
+				for (Py_ssize_t i = 0; i < count; ++i) {
+					out[i] = static_cast<float>(values[i]);
+				}
+			}
+			else {
+				PyErr_Format(PyExc_ValueError, "Expected buffer of %zd floats or doubles", count);
+				result = FloatsResult::Error;
+			}
+			PyBuffer_Release(&view);
+			return result;
+		}
+
+		// Accepts tuple/list, buffer objects and any other sequence of count numbers
+		FloatsResult FloatsFromObject(PyObject* object, float* out, Py_ssize_t count) {
+			if (PyTuple_CheckExact(object) || PyList_CheckExact(object)) {
+				return FloatsFromFastSequence(object, out, count) ? FloatsResult::Success : FloatsResult::Error;
+			}
+			if (PyObject_CheckBuffer(object)) {
+				return FloatsFromBuffer(object, out, count);
+			}
+			if (PySequence_Check(object) && !PyUnicode_Check(object)) {
+				PyObject* const sequence = PySequence_Fast(object, "Not sequence");
+				if (!sequence) {
+					// PySequence_Fast set error
+					return FloatsResult::Error;
+				}
+				const bool result = FloatsFromFastSequence(sequence, out, count);
+				Py_DECREF(sequence);
+				return result ? FloatsResult::Success : FloatsResult::Error;
+			}
+			return FloatsResult::Mismatch;
+		}
+
+		// Accepts flat sequence of 16 numbers or sequence of 4 rows
+		FloatsResult MatrixFromObject(PyObject* object, Matrix4x4& matrix) {
+			if (!PyTuple_CheckExact(object) && !PyList_CheckExact(object)) {
+				return FloatsFromObject(object, matrix.data, Py_ssize_t{ 16 });
+			}
+			const Py_ssize_t size = PySequence_Fast_GET_SIZE(object);
+			if (size != Py_ssize_t{ 4 }) {
+				return FloatsFromFastSequence(object, matrix.data, Py_ssize_t{ 16 }) ? FloatsResult::Success : FloatsResult::Error;
+			}
+			PyObject** const rows = PySequence_Fast_ITEMS(object);
+			for (Py_ssize_t i = 0; i < size; ++i) {
+				const FloatsResult result = FloatsFromObject(rows[i], matrix.data + i * Py_ssize_t{ 4 }, Py_ssize_t{ 4 });
+				if (result != FloatsResult::Success) {
+					if (result == FloatsResult::Mismatch) {
+						PyErr_SetString(PyExc_ValueError, "Elements must be a 4x4 or 1x16 sequence");
+					}
+					return FloatsResult::Error;
+				}
+			}
+			return FloatsResult::Success;
+		}
 	}
 
 	Python3LanguageModule::Python3LanguageModule() = default;
@@ -2507,11 +2355,15 @@ namespace py3lm {
 	Python3LanguageModule::~Python3LanguageModule() = default;
 
 	InitResult Python3LanguageModule::Initialize(std::weak_ptr<IPlugifyProvider> provider, ModuleRef module) {
+		LoadTimer timer(_loadStats.initializeNs);
+
 		if (!(_provider = provider.lock())) {
 			return ErrorData{ "Provider not exposed" };
 		}
 
-		_jitRuntime = std::make_shared<asmjit::JitRuntime>();
+		_jitRuntime = CreateJitRuntime();
+		_lazyPlugins = ReadLazyPlugins();
+		_replicaConfig = ReadReplicaConfig();
 
 		std::error_code ec;
 		const fs::path moduleBasePath = fs::absolute(module.GetBaseDir(), ec);
@@ -2584,108 +2436,140 @@ namespace py3lm {
 			return ErrorData{ std::format("Failed to init python: {}", status.err_msg) };
 		}
 
-		PyObject* const plugifyPluginModuleName = PyUnicode_DecodeFSDefault("plugify.plugin");
-		if (!plugifyPluginModuleName) {
+		if (std::string error = ImportPluginTypes(_types); !error.empty()) {
 			PyErr_Print();
-			return ErrorData{ "Failed to allocate plugify.plugin module string" };
+			return ErrorData{ std::move(error) };
 		}
 
-		PyObject* const plugifyPluginModule = PyImport_Import(plugifyPluginModuleName);
-		Py_DECREF(plugifyPluginModuleName);
-		if (!plugifyPluginModule) {
+		_ppsModule = PyImport_ImportModule("plugify.pps");
+		if (!_ppsModule) {
 			PyErr_Print();
-			return ErrorData{ "Failed to import plugify.plugin python module" };
+			return ErrorData{ "Failed to import plugify.pps python module" };
 		}
 
-		_PluginTypeObject = PyObject_GetAttrString(plugifyPluginModule, "Plugin");
-		if (!_PluginTypeObject) {
-			Py_DECREF(plugifyPluginModule);
+		_ExternalFunctionTypeObject = PyType_FromSpec(&kExternalFunctionSpec);
+		if (!_ExternalFunctionTypeObject) {
 			PyErr_Print();
-			return ErrorData{ "Failed to find plugify.plugin.Plugin type" };
+			return ErrorData{ "Failed to create plugify.Function type" };
 		}
-		_PluginInfoTypeObject = PyObject_GetAttrString(plugifyPluginModule, "PluginInfo");
-		if (!_PluginInfoTypeObject) {
-			Py_DECREF(plugifyPluginModule);
+
+		if (!RegisterNativeModule("snapshot", CreateSnapshotModule())) {
 			PyErr_Print();
-			return ErrorData{ "Failed to find plugify.plugin.PluginInfo type" };
+			return ErrorData{ "Failed to create plugify.snapshot module" };
 		}
 
-		_Vector2TypeObject = PyObject_GetAttrString(plugifyPluginModule, "Vector2");
-		if (!_Vector2TypeObject) {
-			Py_DECREF(plugifyPluginModule);
+		if (!RegisterNativeModule("timers", CreateTimersModule())) {
 			PyErr_Print();
-			return ErrorData{ "Failed to find plugify.plugin.Vector2 type" };
+			return ErrorData{ "Failed to create plugify.timers module" };
 		}
-		_Vector3TypeObject = PyObject_GetAttrString(plugifyPluginModule, "Vector3");
-		if (!_Vector3TypeObject) {
-			Py_DECREF(plugifyPluginModule);
+
+		if (!RegisterNativeModule("batch", CreateBatchModule())) {
 			PyErr_Print();
-			return ErrorData{ "Failed to find plugify.plugin.Vector3 type" };
+			return ErrorData{ "Failed to create plugify.batch module" };
 		}
-		_Vector4TypeObject = PyObject_GetAttrString(plugifyPluginModule, "Vector4");
-		if (!_Vector4TypeObject) {
-			Py_DECREF(plugifyPluginModule);
+
+		if (!RegisterNativeModule("vecbatch", CreateVectorBatchModule())) {
 			PyErr_Print();
-			return ErrorData{ "Failed to find plugify.plugin.Vector4 type" };
+			return ErrorData{ "Failed to create plugify.vecbatch module" };
 		}
-		_Matrix4x4TypeObject = PyObject_GetAttrString(plugifyPluginModule, "Matrix4x4");
-		if (!_Matrix4x4TypeObject) {
-			Py_DECREF(plugifyPluginModule);
+
+		if (!RegisterNativeModule("spatial", CreateSpatialModule(_gilStats))) {
 			PyErr_Print();
-			return ErrorData{ "Failed to find plugify.plugin.Matrix4x4 type" };
+			return ErrorData{ "Failed to create plugify.spatial module" };
 		}
 
-		Py_DECREF(plugifyPluginModule);
+		if (!RegisterNativeModule("refaudit", CreateRefAuditModule(_refAudit))) {
+			PyErr_Print();
+			return ErrorData{ "Failed to create plugify.refaudit module" };
+		}
 
-		_ppsModule = PyImport_ImportModule("plugify.pps");
-		if (!_ppsModule) {
+		if (!RegisterNativeModule("admission", CreateAdmissionModule(_admission))) {
 			PyErr_Print();
-			return ErrorData{ "Failed to import plugify.pps python module" };
+			return ErrorData{ "Failed to create plugify.admission module" };
+		}
+
+		if (!RegisterNativeModule("handles", CreateHandlesModule(_gilStats, [] { return g_py3lm.GetCallerTag(); }))) {
+			PyErr_Print();
+			return ErrorData{ "Failed to create plugify.handles module" };
+		}
+
+		if (!RegisterNativeModule("ffi", CreateFfiModule())) {
+			PyErr_Print();
+			return ErrorData{ "Failed to create plugify.ffi module" };
+		}
+
+		if (!RegisterNativeModule("fileio", CreateFileIoModule(_workerPool, _gilStats))) {
+			PyErr_Print();
+			return ErrorData{ "Failed to create plugify.fileio module" };
+		}
+
+		if (!RegisterGcProbes()) {
+			PyErr_Print();
+			return ErrorData{ "Failed to register gc probes" };
 		}
+		_refAudit.SetLeakHandler([this](const std::string& path) {
+			_provider->Log(std::format("[py3lm] Object count of '{}' keeps growing per call, possible reference leak", path), Severity::Warning);
+		});
+		_admission.SetBreakerHandler([this](const std::string& plugin, const std::string& method) {
+			_provider->Log(std::format("[py3lm] Circuit breaker opened for '{}{}{}' after repeated exceptions, calls are shed", plugin, method.empty() ? "" : ".", method), Severity::Warning);
+		});
+
+		// Host main thread gets GIL handoff priority over background Python threads once PY3LM_GIL_SWITCH_INTERVAL_US enables it
+		_gilStats.Priority().SetCritical(true);
+
+		// Release GIL taken by initialization, every entry point acquires it on demand
+		_mainThreadState = PyEval_SaveThread();
 
 		return InitResultData{};
 	}
 
 	void Python3LanguageModule::Shutdown() {
-		if (Py_IsInitialized()) {
-			if (_ppsModule) {
-				Py_DECREF(_ppsModule);
-			}
+		// Pending async calls take the GIL to resolve their futures, so finish them before it is restored
+		_workerPool.Stop();
 
-			if (_Vector2TypeObject) {
-				Py_DECREF(_Vector2TypeObject);
+		if (Py_IsInitialized()) {
+			// Replica interpreters end while no thread state is attached
+			for (const auto& [_, replicated] : _replicatedPlugins) {
+				for (const auto& replica : replicated->replicas) {
+					replica->End();
+				}
 			}
+			ReleaseMainThreadStates();
 
-			if (_Vector3TypeObject) {
-				Py_DECREF(_Vector3TypeObject);
+			if (_mainThreadState) {
+				PyEval_RestoreThread(_mainThreadState);
 			}
 
-			if (_Vector4TypeObject) {
-				Py_DECREF(_Vector4TypeObject);
-			}
+			// Worker pool is stopped, only the ring may still be writing into request buffers
+			ClearFileIo();
+			_refAudit.Enable(false);
+			UnregisterGcProbes();
+			ClearTimers();
+			ClearBatchHandlers();
+			ClearHandles();
+			Py_CLEAR(s_ffiFunctionType);
+			_gilStats.Priority().ClearCritical();
 
-			if (_Matrix4x4TypeObject) {
-				Py_DECREF(_Matrix4x4TypeObject);
+			if (_ppsModule) {
+				Py_DECREF(_ppsModule);
 			}
 
-			if (_PluginTypeObject) {
-				Py_DECREF(_PluginTypeObject);
-			}
+			ClearPluginTypes(_types);
 
-			if (_PluginInfoTypeObject) {
-				Py_DECREF(_PluginInfoTypeObject);
+			if (_ExternalFunctionTypeObject) {
+				Py_DECREF(_ExternalFunctionTypeObject);
 			}
 
 			for (const auto& data : _internalFunctions) {
-				Py_DECREF(data.pythonFunction);
+				Py_DECREF(data->pythonFunction);
 			}
 
-			for (const auto& [_1, _2, object] : _externalFunctions) {
-				Py_DECREF(object);
+			for (const auto& entry : _externalFunctions) {
+				Py_DECREF(entry.object);
 			}
 
 			for (const auto& data : _pythonMethods) {
-				Py_DECREF(data.pythonFunction);
+				Py_XDECREF(data->pythonFunction);
 			}
 
 			for (const auto& [_, pluginData] : _pluginsMap) {
@@ -2695,28 +2579,38 @@ namespace py3lm {
 
 			Py_Finalize();
 		}
+		_mainThreadState = nullptr;
 		_ppsModule = nullptr;
-		_Vector2TypeObject = nullptr;
-		_Vector3TypeObject = nullptr;
-		_Vector4TypeObject = nullptr;
-		_Matrix4x4TypeObject = nullptr;
-		_PluginTypeObject = nullptr;
-		_PluginInfoTypeObject = nullptr;
+		_ExternalFunctionTypeObject = nullptr;
 		_internalMap.clear();
 		_externalMap.clear();
 		_internalFunctions.clear();
+		_externalCache.clear();
 		_externalFunctions.clear();
+		_externalThunkRefs.clear();
+		_externalThunks.clear();
 		_moduleDefinitions.clear();
 		_moduleMethods.clear();
 		_moduleFunctions.clear();
 		_pythonMethods.clear();
 		_pluginsMap.clear();
+		_packageTags.clear();
+		_dormantPlugins.clear();
+		_replicatedPlugins.clear();
+		_gilStats.Clear();
+		_refAudit.Clear();
+		_admission.Clear();
+		_loadStats = {};
 		_jitRuntime.reset();
 		_provider.reset();
 	}
 
 	void Python3LanguageModule::OnMethodExport(PluginRef plugin) {
+		LoadTimer timer(_loadStats.methodExportNs);
+
 		if (_ppsModule) {
+			GilEnterScope gil(_gilStats, GilStats::kModuleTag);
+
 			PyObject* moduleObject = CreateInternalModule(plugin);
 			if (!moduleObject) {
 				moduleObject = CreateExternalModule(plugin);
@@ -2731,6 +2625,15 @@ namespace py3lm {
 	}
 
 	LoadResult Python3LanguageModule::OnPluginLoad(PluginRef plugin) {
+		LoadTimer timer(_loadStats.pluginLoadNs);
+		const std::string name = ProbePluginName(plugin, PY3LM_PROBE_ENABLED(plugin_load__entry) || PY3LM_PROBE_ENABLED(plugin_load__return));
+		PY3LM_PROBE(plugin_load__entry, name.c_str());
+		LoadResult result = LoadPlugin(plugin);
+		PY3LM_PROBE(plugin_load__return, name.c_str(), std::holds_alternative<ErrorData>(result));
+		return result;
+	}
+
+	LoadResult Python3LanguageModule::LoadPlugin(PluginRef plugin) {
 		const std::string& entryPoint = plugin.GetDescriptor().GetEntryPoint();
 		if (entryPoint.empty()) {
 			return ErrorData{ "Incorrect entry point: empty" };
@@ -2738,37 +2641,235 @@ namespace py3lm {
 		if (entryPoint.find_first_of("/\\") != std::string::npos) {
 			return ErrorData{ "Incorrect entry point: contains '/' or '\\'" };
 		}
-		const std::string::size_type lastDotPos = entryPoint.find_last_of('.');
-		if (lastDotPos == std::string::npos) {
-			return ErrorData{ "Incorrect entry point: not have any dot '.' character" };
+		const std::string::size_type lastDotPos = entryPoint.find_last_of('.');
+		if (lastDotPos == std::string::npos) {
+			return ErrorData{ "Incorrect entry point: not have any dot '.' character" };
+		}
+		std::string_view className(entryPoint.begin() + (lastDotPos + 1), entryPoint.end());
+		if (className.empty()) {
+			return ErrorData{ "Incorrect entry point: empty class name part" };
+		}
+		std::string_view modulePathRel(entryPoint.begin(), entryPoint.begin() + lastDotPos);
+		if (modulePathRel.empty()) {
+			return ErrorData{ "Incorrect entry point: empty module path part" };
+		}
+
+		const fs::path& baseFolder = plugin.GetBaseDir();
+		auto modulePath = std::string(modulePathRel);
+		ReplaceAll(modulePath, ".", { static_cast<char>(fs::path::preferred_separator) });
+		fs::path filePathRelative = modulePath;
+		filePathRelative.replace_extension(".py");
+		const fs::path filePath = baseFolder / filePathRelative;
+		std::error_code ec;
+		if (!fs::exists(filePath, ec) || !fs::is_regular_file(filePath, ec)) {
+			return ErrorData{ std::format("Module file '{}' not exist", filePath.string()) };
+		}
+		const fs::path pluginsFolder = baseFolder.parent_path();
+		filePathRelative = fs::relative(filePath, pluginsFolder, ec);
+		filePathRelative.replace_extension();
+		std::string moduleName = filePathRelative.generic_string();
+		ReplaceAll(moduleName, "/", ".");
+
+		_provider->Log(std::format("[py3lm] Load plugin module '{}'", moduleName), Severity::Verbose);
+
+		const uint32_t tag = _gilStats.RegisterTag(plugin.GetName());
+		if (const ReplicaConfig* const replicaConfig = FindReplicaConfig(plugin.GetName())) {
+			return LoadReplicatedPlugin(plugin, *replicaConfig, moduleName, className, tag);
+		}
+
+		GilEnterScope gil(_gilStats, tag);
+		// Plugin folder is the package every module of the plugin is imported under
+		_packageTags.try_emplace(moduleName.substr(0, moduleName.find('.')), tag);
+
+		PyObject* pluginModule = nullptr;
+		PyObject* pluginInstance = nullptr;
+		const bool dormant = IsLazyPlugin(plugin.GetName());
+		if (!dormant) {
+			ImportResult imported = ImportPlugin(moduleName, className);
+			if (auto* error = std::get_if<ErrorData>(&imported)) {
+				return std::move(*error);
+			}
+			std::tie(pluginModule, pluginInstance) = std::get<std::pair<PyObject*, PyObject*>>(imported);
+		}
+
+		if (_pluginsMap.contains(plugin.GetName()) || _dormantPlugins.contains(tag) || _replicatedPlugins.contains(plugin.GetName())) {
+			Py_XDECREF(pluginInstance);
+			Py_XDECREF(pluginModule);
+			return ErrorData{ "Plugin name duplicate" };
+		}
+
+		const auto exportedMethods = plugin.GetDescriptor().GetExportedMethods();
+		bool exportResult = true;
+		std::vector<std::string> exportErrors;
+		std::vector<std::tuple<MethodRef, std::unique_ptr<PythonMethodData>>> methodsHolders;
+
+		if (!exportedMethods.empty()) {
+			for (const MethodRef method : exportedMethods) {
+				MethodExportResult generateResult = GenerateMethodExport(method, _jitRuntime, pluginModule, pluginInstance, tag);
+				if (auto* data = std::get_if<MethodExportError>(&generateResult)) {
+					exportResult = false;
+					exportErrors.emplace_back(std::move(*data));
+					continue;
+				}
+				methodsHolders.emplace_back(method, std::move(std::get<MethodExportData>(generateResult)));
+			}
+		}
+
+		if (!exportResult) {
+			Py_XDECREF(pluginInstance);
+			Py_XDECREF(pluginModule);
+			std::string errorString = "Methods export error(s): " + exportErrors[0];
+			for (auto it = std::next(exportErrors.begin()); it != exportErrors.end(); ++it) {
+				std::format_to(std::back_inserter(errorString), ", {}", *it);
+			}
+			return ErrorData{ std::move(errorString) };
+		}
+
+		DormantPlugin* dormantPlugin = nullptr;
+		if (dormant) {
+			dormantPlugin = &_dormantPlugins.try_emplace(tag, plugin.GetName(), std::move(moduleName), std::string(className)).first->second;
+			_provider->Log(std::format("[py3lm] Plugin '{}' is dormant until its first call", plugin.GetName()), Severity::Verbose);
+		}
+		else {
+			const auto [_, result] = _pluginsMap.try_emplace(plugin.GetName(), pluginModule, pluginInstance, tag);
+			if (!result) {
+				Py_DECREF(pluginInstance);
+				Py_DECREF(pluginModule);
+				return ErrorData{ std::format("Save plugin data to map unsuccessful") };
+			}
+		}
+
+		std::vector<MethodData> methods;
+		methods.reserve(methodsHolders.size());
+		_pythonMethods.reserve(methodsHolders.size());
+
+		// Admission entries are registered only once the plugin is accepted, they cannot be removed
+		for (auto& [method, methodData] : methodsHolders) {
+			const MemAddr methodAddr = methodData->jitFunction.GetFunction();
+			methodData->admission = _admission.Register(_gilStats.GetTagName(tag), method.GetName());
+			methods.emplace_back(method, methodAddr);
+			if (dormantPlugin) {
+				dormantPlugin->_methods.emplace_back(method, methodData.get());
+			}
+			else {
+				AddToFunctionsMap(methodAddr, methodData->pythonFunction);
+			}
+			_pythonMethods.emplace_back(std::move(methodData));
+		}
+
+		return LoadResultData{ std::move(methods) };
+	}
+
+	const ReplicaConfig* Python3LanguageModule::FindReplicaConfig(const std::string& name) const {
+		const auto it = std::find_if(_replicaConfig.begin(), _replicaConfig.end(), [&name](const ReplicaConfig& config) { return config.plugin == name; });
+		return it != _replicaConfig.end() ? &*it : nullptr;
+	}
+
+	LoadResult Python3LanguageModule::LoadReplicatedPlugin(PluginRef plugin, const ReplicaConfig& config, const std::string& moduleName, std::string_view className, uint32_t tag) {
+		const auto exportedMethods = plugin.GetDescriptor().GetExportedMethods();
+
+		// Function objects belong to the main interpreter, the routing key is read by value
+		for (const MethodRef method : exportedMethods) {
+			const auto paramTypes = method.GetParamTypes();
+			const bool passesFunction = method.GetReturnType().GetType() == ValueType::Function ||
+				std::any_of(paramTypes.begin(), paramTypes.end(), [](PropertyRef paramType) { return paramType.GetType() == ValueType::Function; });
+			if (passesFunction) {
+				return ErrorData{ std::format("Replicated method '{}' passes function", method.GetName()) };
+			}
+			if (config.keyParam < 0) {
+				continue;
+			}
+			if (static_cast<size_t>(config.keyParam) >= paramTypes.size()) {
+				return ErrorData{ std::format("Replicated method '{}' has no key parameter {}", method.GetName(), config.keyParam) };
+			}
+			const PropertyRef keyType = paramTypes[config.keyParam];
+			if (keyType.IsReference() || !Dispatch<IsRoutingKeyOp>(keyType.GetType())()) {
+				return ErrorData{ std::format("Replicated method '{}' key parameter {} not scalar or string", method.GetName(), config.keyParam) };
+			}
+		}
+
+		std::vector<std::unique_ptr<PythonMethodData>> methodsData;
+		{
+			GilEnterScope gil(_gilStats, tag);
+			if (_pluginsMap.contains(plugin.GetName()) || _dormantPlugins.contains(tag) || _replicatedPlugins.contains(plugin.GetName())) {
+				return ErrorData{ "Plugin name duplicate" };
+			}
+			for (const MethodRef method : exportedMethods) {
+				MethodExportResult generateResult = GenerateMethodExport(method, _jitRuntime, nullptr, nullptr, tag);
+				if (auto* data = std::get_if<MethodExportError>(&generateResult)) {
+					return ErrorData{ "Methods export error: " + *data };
+				}
+				methodsData.push_back(std::move(std::get<MethodExportData>(generateResult)));
+			}
+		}
+
+		// Interpreters are created with no thread state attached
+		auto replicated = std::make_unique<ReplicaSet>();
+		replicated->keyParam = config.keyParam;
+		std::string error;
+		for (uint32_t i = 0; i < config.count && error.empty(); ++i) {
+			std::unique_ptr<Replica> replica = Replica::Create(error);
+			if (!replica) {
+				break;
+			}
+			{
+				ReplicaScope scope(*replica);
+				error = LoadReplica(*replica, exportedMethods, moduleName, className);
+			}
+			replicated->replicas.push_back(std::move(replica));
+		}
+		if (!error.empty()) {
+			for (const auto& replica : replicated->replicas) {
+				replica->End();
+			}
+			return ErrorData{ std::format("Replica {} failed: {}", replicated->replicas.size(), error) };
 		}
-		std::string_view className(entryPoint.begin() + (lastDotPos + 1), entryPoint.end());
-		if (className.empty()) {
-			return ErrorData{ "Incorrect entry point: empty class name part" };
+
+		std::vector<MethodData> methods;
+		methods.reserve(methodsData.size());
+
+		GilEnterScope gil(_gilStats, tag);
+		_pythonMethods.reserve(_pythonMethods.size() + methodsData.size());
+		for (size_t i = 0; i < methodsData.size(); ++i) {
+			auto& methodData = methodsData[i];
+			methodData->replicas = replicated.get();
+			methodData->replicaMethod = static_cast<uint32_t>(i);
+			methodData->admission = _admission.Register(_gilStats.GetTagName(tag), exportedMethods[i].GetName());
+			methods.emplace_back(exportedMethods[i], methodData->jitFunction.GetFunction());
+			_pythonMethods.emplace_back(std::move(methodData));
 		}
-		std::string_view modulePathRel(entryPoint.begin(), entryPoint.begin() + lastDotPos);
-		if (modulePathRel.empty()) {
-			return ErrorData{ "Incorrect entry point: empty module path part" };
+		_replicatedPlugins.try_emplace(plugin.GetName(), std::move(replicated));
+
+		_provider->Log(std::format("[py3lm] Plugin '{}' loaded in {} replicas", plugin.GetName(), config.count), Severity::Verbose);
+
+		return LoadResultData{ std::move(methods) };
+	}
+
+	// Runs attached to the replica, so its classes are the current types
+	std::string Python3LanguageModule::LoadReplica(Replica& replica, std::span<const MethodRef> methods, const std::string& moduleName, std::string_view className) {
+		if (std::string error = ImportPluginTypes(replica.types); !error.empty()) {
+			PyErr_Print();
+			return error;
 		}
 
-		const fs::path& baseFolder = plugin.GetBaseDir();
-		auto modulePath = std::string(modulePathRel);
-		ReplaceAll(modulePath, ".", { static_cast<char>(fs::path::preferred_separator) });
-		fs::path filePathRelative = modulePath;
-		filePathRelative.replace_extension(".py");
-		const fs::path filePath = baseFolder / filePathRelative;
-		std::error_code ec;
-		if (!fs::exists(filePath, ec) || !fs::is_regular_file(filePath, ec)) {
-			return ErrorData{ std::format("Module file '{}' not exist", filePath.string()) };
+		ImportResult imported = ImportPlugin(moduleName, className);
+		if (auto* error = std::get_if<ErrorData>(&imported)) {
+			return std::move(error->error);
 		}
-		const fs::path pluginsFolder = baseFolder.parent_path();
-		filePathRelative = fs::relative(filePath, pluginsFolder, ec);
-		filePathRelative.replace_extension();
-		std::string moduleName = filePathRelative.generic_string();
-		ReplaceAll(moduleName, "/", ".");
+		std::tie(replica.module, replica.instance) = std::get<std::pair<PyObject*, PyObject*>>(imported);
 
-		_provider->Log(std::format("[py3lm] Load plugin module '{}'", moduleName), Severity::Verbose);
+		replica.functions.reserve(methods.size());
+		for (const MethodRef method : methods) {
+			MethodResolveResult resolved = ResolveMethodFunction(method, replica.module, replica.instance);
+			if (auto* error = std::get_if<MethodExportError>(&resolved)) {
+				return "Methods export error: " + *error;
+			}
+			replica.functions.push_back(std::get<PyObject*>(resolved));
+		}
+		return {};
+	}
 
+	Python3LanguageModule::ImportResult Python3LanguageModule::ImportPlugin(const std::string& moduleName, std::string_view className) {
 		PyObject* const pluginModule = PyImport_ImportModule(moduleName.c_str());
 		if (!pluginModule) {
 			PyErr_Print();
@@ -2789,7 +2890,7 @@ namespace py3lm {
 			return ErrorData{ "Failed to find plugin class" };
 		}
 
-		const int typeResult = PyObject_IsSubclass(pluginClass, _PluginTypeObject);
+		const int typeResult = PyObject_IsSubclass(pluginClass, GetTypes().plugin);
 		if (typeResult != 1) {
 			Py_DECREF(pluginClass);
 			Py_DECREF(classNameString);
@@ -2819,7 +2920,7 @@ namespace py3lm {
 		Py_INCREF(pluginInstance);
 		PyTuple_SET_ITEM(args, Py_ssize_t{ 1 }, pluginInstance); // pluginInstance ref taken by list
 
-		PyObject* const pluginInfo = PyObject_CallObject(_PluginInfoTypeObject, args);
+		PyObject* const pluginInfo = PyObject_CallObject(GetTypes().pluginInfo, args);
 		Py_DECREF(args);
 		if (!pluginInfo) {
 			Py_DECREF(pluginInstance);
@@ -2837,66 +2938,184 @@ namespace py3lm {
 			return ErrorData{ "Failed to save instance: assignment fail" };
 		}
 
-		if (_pluginsMap.contains(plugin.GetName())) {
-			Py_DECREF(pluginInstance);
-			Py_DECREF(pluginModule);
-			return ErrorData{ "Plugin name duplicate" };
+		return std::pair{ pluginModule, pluginInstance };
+	}
+
+	bool Python3LanguageModule::IsLazyPlugin(const std::string& name) const {
+		return std::any_of(_lazyPlugins.begin(), _lazyPlugins.end(), [&name](const std::string& lazy) { return lazy == "*" || lazy == name; });
+	}
+
+	// Must be called with the GIL held
+	bool Python3LanguageModule::ActivatePlugin(uint32_t tag) {
+		auto it = _dormantPlugins.find(tag);
+		// Import runs Python code which may switch threads, concurrent first calls wait for it
+		while (it != _dormantPlugins.end() && it->second._activator != std::thread::id{}) {
+			if (it->second._activator == std::this_thread::get_id()) {
+				return false; // plugin calls its own exports while being imported
+			}
+			// Import ends with the GIL held, so it cannot end before the wait starts
+			uint64_t seen;
+			{
+				std::lock_guard lock(_activationMutex);
+				seen = _activations;
+			}
+			{
+				GilReleaseScope release(_gilStats);
+				std::unique_lock lock(_activationMutex);
+				_activationDone.wait(lock, [&] { return _activations != seen; });
+			}
+			it = _dormantPlugins.find(tag);
+		}
+		if (it == _dormantPlugins.end()) {
+			return true;
 		}
 
-		const auto exportedMethods = plugin.GetDescriptor().GetExportedMethods();
-		bool exportResult = true;
-		std::vector<std::string> exportErrors;
-		std::vector<std::tuple<MethodRef, PythonMethodData>> methodsHolders;
+		DormantPlugin& dormant = it->second;
+		if (dormant._failed) {
+			return false;
+		}
 
-		if (!exportedMethods.empty()) {
-			for (const MethodRef method : exportedMethods) {
-				MethodExportResult generateResult = GenerateMethodExport(method, _jitRuntime, pluginModule, pluginInstance);
-				if (auto* data = std::get_if<MethodExportError>(&generateResult)) {
-					exportResult = false;
-					exportErrors.emplace_back(std::move(*data));
-					continue;
+		LoadTimer timer(_loadStats.activationNs);
+		++_loadStats.activationCount;
+		dormant._activator = std::this_thread::get_id();
+
+		std::string error;
+		ImportResult imported = ImportPlugin(dormant._moduleName, dormant._className);
+		if (auto* importError = std::get_if<ErrorData>(&imported)) {
+			error = std::move(importError->error);
+		}
+		else {
+			const auto [pluginModule, pluginInstance] = std::get<std::pair<PyObject*, PyObject*>>(imported);
+			std::vector<PyObject*> functions;
+			functions.reserve(dormant._methods.size());
+			for (const auto& [method, _] : dormant._methods) {
+				MethodResolveResult resolved = ResolveMethodFunction(method, pluginModule, pluginInstance);
+				if (auto* methodError = std::get_if<MethodExportError>(&resolved)) {
+					error = "Methods export error: " + *methodError;
+					break;
 				}
-				methodsHolders.emplace_back(method, std::move(std::get<MethodExportData>(generateResult)));
+				functions.push_back(std::get<PyObject*>(resolved));
 			}
-		}
 
-		if (!exportResult) {
-			Py_DECREF(pluginInstance);
-			Py_DECREF(pluginModule);
-			std::string errorString = "Methods export error(s): " + exportErrors[0];
-			for (auto it = std::next(exportErrors.begin()); it != exportErrors.end(); ++it) {
-				std::format_to(std::back_inserter(errorString), ", {}", *it);
+			if (error.empty()) {
+				for (size_t i = 0; i < functions.size(); ++i) {
+					PythonMethodData* const methodData = dormant._methods[i].second;
+					methodData->pythonFunction = functions[i];
+					AddToFunctionsMap(methodData->jitFunction.GetFunction(), functions[i]);
+				}
+				_pluginsMap.try_emplace(dormant._name, pluginModule, pluginInstance, tag);
+			}
+			else {
+				for (PyObject* const function : functions) {
+					Py_DECREF(function);
+				}
+				Py_DECREF(pluginInstance);
+				Py_DECREF(pluginModule);
 			}
-			return ErrorData{ std::move(errorString) };
 		}
 
-		const auto [_, result] = _pluginsMap.try_emplace(plugin.GetName(), pluginModule, pluginInstance);
-		if (!result) {
-			Py_DECREF(pluginInstance);
-			Py_DECREF(pluginModule);
-			return ErrorData{ std::format("Save plugin data to map unsuccessful") };
+		{
+			std::lock_guard lock(_activationMutex);
+			++_activations;
 		}
+		_activationDone.notify_all();
 
-		std::vector<MethodData> methods;
-		methods.reserve(methodsHolders.size());
-		_pythonMethods.reserve(methodsHolders.size());
+		if (!error.empty()) {
+			// Calls keep returning default values, the import is not retried
+			dormant._activator = {};
+			dormant._failed = true;
+			_provider->Log(std::format("[py3lm] Failed to activate plugin '{}': {}", dormant._name, error), Severity::Error);
+			return false;
+		}
 
-		for (auto& [method, methodData] : methodsHolders) {
-			const MemAddr methodAddr = methodData.jitFunction.GetFunction();
-			methods.emplace_back(method, methodAddr);
-			AddToFunctionsMap(methodAddr, methodData.pythonFunction);
-			_pythonMethods.emplace_back(std::move(methodData));
+		const std::string name = std::move(dormant._name);
+		const bool started = dormant._started;
+		_dormantPlugins.erase(it);
+		_provider->Log(std::format("[py3lm] Activated plugin '{}'", name), Severity::Verbose);
+
+		// Host already started it, plugin_start was held back until now
+		if (started) {
+			TryCallPluginMethodNoArgs(name, "plugin_start", "ActivatePlugin");
 		}
+		return true;
+	}
 
-		return LoadResultData{ std::move(methods) };
+	size_t Python3LanguageModule::WarmUpPlugins(size_t count) {
+		const auto pending = [](const auto& entry) {
+			return !entry.second._failed && entry.second._activator == std::thread::id{};
+		};
+		for (size_t i = 0; i < count; ++i) {
+			uint32_t tag;
+			{
+				GilEnterScope gil(_gilStats, GilStats::kModuleTag);
+				const auto it = std::find_if(_dormantPlugins.begin(), _dormantPlugins.end(), pending);
+				if (it == _dormantPlugins.end()) {
+					break;
+				}
+				tag = it->first;
+			}
+			GilEnterScope gil(_gilStats, tag);
+			ActivatePlugin(tag);
+		}
+		GilEnterScope gil(_gilStats, GilStats::kModuleTag);
+		return static_cast<size_t>(std::count_if(_dormantPlugins.begin(), _dormantPlugins.end(), pending));
+	}
+
+	// Plugin the running Python code belongs to, found by the package of its module, so code run from
+	// threads, timers or asyncio is attributed too. Otherwise the plugin of the native call, GIL must be held
+	uint32_t Python3LanguageModule::GetCallerTag() const {
+		PyObject* const globals = PyEval_GetGlobals();
+		PyObject* const name = globals ? PyDict_GetItemString(globals, "__name__") : nullptr;
+		if (name && PyUnicode_Check(name)) {
+			Py_ssize_t size;
+			if (const char* const chars = PyUnicode_AsUTF8AndSize(name, &size)) {
+				const std::string_view module(chars, static_cast<size_t>(size));
+				if (const auto it = _packageTags.find(std::string(module.substr(0, module.find('.')))); it != _packageTags.end()) {
+					return it->second;
+				}
+			}
+			else {
+				PyErr_Clear();
+			}
+		}
+		return GilStats::CurrentTag();
+	}
+
+	// Returns false when the plugin is not dormant
+	bool Python3LanguageModule::SetDormantStarted(const std::string& name, bool started) {
+		GilEnterScope gil(_gilStats, GilStats::kModuleTag);
+		const auto it = std::find_if(_dormantPlugins.begin(), _dormantPlugins.end(), [&name](const auto& entry) {
+			return entry.second._name == name;
+		});
+		if (it == _dormantPlugins.end()) {
+			return false;
+		}
+		it->second._started = started;
+		return true;
 	}
 
 	void Python3LanguageModule::OnPluginStart(PluginRef plugin) {
-		TryCallPluginMethodNoArgs(plugin, "plugin_start", "OnPluginStart");
+		LoadTimer timer(_loadStats.pluginStartNs);
+		const std::string name = ProbePluginName(plugin, PY3LM_PROBE_ENABLED(plugin_start__entry) || PY3LM_PROBE_ENABLED(plugin_start__return));
+		PY3LM_PROBE(plugin_start__entry, name.c_str());
+		// Dormant plugin is started when activated
+		const bool result = SetDormantStarted(plugin.GetName(), true) || TryCallPluginMethodNoArgs(plugin.GetName(), "plugin_start", "OnPluginStart");
+		PY3LM_PROBE(plugin_start__return, name.c_str(), !result);
 	}
 
 	void Python3LanguageModule::OnPluginEnd(PluginRef plugin) {
-		TryCallPluginMethodNoArgs(plugin, "plugin_end", "OnPluginEnd");
+		const std::string name = ProbePluginName(plugin, PY3LM_PROBE_ENABLED(plugin_end__entry) || PY3LM_PROBE_ENABLED(plugin_end__return));
+		PY3LM_PROBE(plugin_end__entry, name.c_str());
+		const bool result = SetDormantStarted(plugin.GetName(), false) || TryCallPluginMethodNoArgs(plugin.GetName(), "plugin_end", "OnPluginEnd");
+		// Handles still pinned after plugin_end are never returned by native code
+		GilEnterScope gil(_gilStats, GilStats::kModuleTag);
+		if (const auto it = _pluginsMap.find(plugin.GetName()); it != _pluginsMap.end()) {
+			GilEnterScope pluginGil(_gilStats, it->second._tag);
+			if (const size_t released = ReleaseHandles(it->second._tag)) {
+				_provider->Log(std::format("[py3lm] Plugin '{}' ended with {} pinned handle(s), released", plugin.GetName(), released), Severity::Warning);
+			}
+		}
+		PY3LM_PROBE(plugin_end__return, name.c_str(), !result);
 	}
 
 	bool Python3LanguageModule::IsDebugBuild() {
@@ -2924,10 +3143,18 @@ namespace py3lm {
 		_internalMap.emplace(object, funcAddr);
 	}
 
-	PyObject* Python3LanguageModule::GetOrCreateFunctionObject(MethodRef method, void* funcAddr) {
-		if (PyObject* const object = FindExternal(funcAddr)) {
-			Py_INCREF(object);
-			return object;
+	const Python3LanguageModule::ExternalThunk* Python3LanguageModule::GetOrCreateExternalThunk(MethodRef method) {
+		// Method descriptors live as long as the plugins, the address of the name they own identifies one
+		const void* const ref = &method.GetName();
+		if (const auto it = _externalThunkRefs.find(ref); it != _externalThunkRefs.end()) {
+			return it->second;
+		}
+
+		std::string signature;
+		AppendSignature(signature, method);
+		if (const auto it = _externalThunks.find(signature); it != _externalThunks.end()) {
+			_externalThunkRefs.emplace(ref, it->second.get());
+			return it->second.get();
 		}
 
 		Function function(_jitRuntime);
@@ -2939,29 +3166,88 @@ namespace py3lm {
 
 		const bool noArgs = method.GetParamTypes().empty();
 
-		void* const methodAddr = function.GetJitFunc(sig, method, noArgs ? &ExternalCallNoArgs : &ExternalCall, funcAddr);
+		void* methodAddr;
+		{
+			LoadTimer timer(_loadStats.jitNs);
+			++_loadStats.jitCount;
+			PY3LM_PROBE(jit_thunk__entry, method.GetName().c_str(), kJitThunkExternal);
+			methodAddr = function.GetJitFunc(sig, method, noArgs ? &ExternalCallNoArgs : &ExternalCall);
+			PY3LM_PROBE(jit_thunk__return, method.GetName().c_str(), kJitThunkExternal, methodAddr == nullptr);
+		}
 		if (!methodAddr) {
 			const std::string error(std::format("Lang module JIT failed to generate c++ PyCFunction wrapper '{}'", function.GetError()));
 			PyErr_SetString(PyExc_RuntimeError, error.c_str());
 			return nullptr;
 		}
 
-		auto defPtr = std::make_unique<PyMethodDef>();
-		PyMethodDef& def = *(defPtr.get());
+		auto thunk = std::make_unique<ExternalThunk>(std::move(function));
+		PyMethodDef& def = thunk->def;
 		def.ml_name = "PlugifyExternal";
 		def.ml_meth = reinterpret_cast<PyCFunction>(methodAddr);
 		def.ml_flags = noArgs ? METH_NOARGS : METH_VARARGS;
 		def.ml_doc = nullptr;
 
-		PyObject* const object = PyCFunction_New(defPtr.get(), nullptr);
+		const ExternalThunk* const created = _externalThunks.emplace(std::move(signature), std::move(thunk)).first->second.get();
+		_externalThunkRefs.emplace(ref, created);
+		return created;
+	}
+
+	void Python3LanguageModule::EvictExternalFunctions() {
+		// Only objects referenced by the cache alone can go. Live ones move to the front and may keep it over capacity,
+		// the scan is bounded so a cache full of live objects does not cost a full pass per insert
+		for (size_t scanned = 0; scanned < kExternalEvictScan && _externalFunctions.size() >= kExternalCacheCapacity; ++scanned) {
+			const auto it = std::prev(_externalFunctions.end());
+			if (Py_REFCNT(it->object) != 1) {
+				_externalFunctions.splice(_externalFunctions.begin(), _externalFunctions, it);
+				continue;
+			}
+			PyObject* const object = it->object;
+			_externalCache.erase(ExternalKey{ it->addr, it->thunk });
+			_externalFunctions.pop_back();
+			Py_DECREF(object);
+		}
+	}
+
+	PyObject* Python3LanguageModule::GetOrCreateFunctionObject(MethodRef method, void* funcAddr) {
+		if (!funcAddr) {
+			Py_RETURN_NONE;
+		}
+
+		if (PyObject* const object = FindExternal(funcAddr)) {
+			Py_INCREF(object);
+			return object;
+		}
+
+		const ExternalThunk* const thunk = GetOrCreateExternalThunk(method);
+		if (!thunk) {
+			return nullptr;
+		}
+
+		const ExternalKey key{ funcAddr, thunk };
+		if (const auto it = _externalCache.find(key); it != _externalCache.end()) {
+			_externalFunctions.splice(_externalFunctions.begin(), _externalFunctions, it->second);
+			PyObject* const object = it->second->object;
+			Py_INCREF(object);
+			return object;
+		}
+
+		PyObject* const target = PyCapsule_New(funcAddr, kExternalTargetName, nullptr);
+		if (!target) {
+			return nullptr;
+		}
+
+		PyObject* const object = PyCFunction_New(const_cast<PyMethodDef*>(&thunk->def), target);
+		Py_DECREF(target);
 		if (!object) {
 			PyErr_SetString(PyExc_RuntimeError, "Fail to create function object from function pointer");
 			return nullptr;
 		}
 
+		EvictExternalFunctions();
+
 		Py_INCREF(object);
-		_externalFunctions.emplace_back(std::move(function), std::move(defPtr), object);
-		AddToFunctionsMap(funcAddr, object);
+		_externalFunctions.emplace_front(funcAddr, thunk, object);
+		_externalCache.emplace(key, _externalFunctions.begin());
 
 		return object;
 	}
@@ -2971,6 +3257,20 @@ namespace py3lm {
 			return { nullptr };
 		}
 
+		// Native function passed back with matching signature, no need to wrap it twice
+		if (PyCFunction_Check(object)) {
+			PyObject* const self = PyCFunction_GET_SELF(object);
+			if (self && PyCapsule_IsValid(self, kExternalTargetName)) {
+				const ExternalThunk* const thunk = GetOrCreateExternalThunk(method);
+				if (!thunk) {
+					return std::nullopt;
+				}
+				if (PyCFunction_GET_FUNCTION(object) == thunk->def.ml_meth) {
+					return { PyCapsule_GetPointer(self, kExternalTargetName) };
+				}
+			}
+		}
+
 		if (!PyFunction_Check(object)) {
 			PyErr_SetString(PyExc_TypeError, "Not function");
 			return std::nullopt;
@@ -2980,17 +3280,18 @@ namespace py3lm {
 			return { funcAddr };
 		}
 
-		auto [result, function] = CreateInternalCall(_jitRuntime, method, object);
+		// Callback is attributed to the plugin currently executing
+		auto [result, data] = CreateInternalCall(_jitRuntime, method, object, GilStats::CurrentTag());
 		if (!result) {
-			const std::string error(std::format("Lang module JIT failed to generate C++ wrapper from function object '{}'", function.GetError()));
+			const std::string error(std::format("Lang module JIT failed to generate C++ wrapper from function object '{}'", data->jitFunction.GetError()));
 			PyErr_SetString(PyExc_RuntimeError, error.c_str());
 			return std::nullopt;
 		}
 
-		void* const funcAddr = function.GetFunction();
+		void* const funcAddr = data->jitFunction.GetFunction();
 
 		Py_INCREF(object);
-		_internalFunctions.emplace_back(std::move(function), object);
+		_internalFunctions.emplace_back(std::move(data));
 		AddToFunctionsMap(funcAddr, object);
 
 		return { funcAddr };
@@ -3015,13 +3316,25 @@ namespace py3lm {
 			return nullptr;
 		}
 		PyTuple_SET_ITEM(args, Py_ssize_t{ 1 }, yObject); // yObject ref taken by tuple
-		PyObject* const vectorObject = PyObject_CallObject(_Vector2TypeObject, args);
+		PyObject* const vectorObject = PyObject_CallObject(GetTypes().vector2, args);
 		Py_DECREF(args);
 		return vectorObject;
 	}
 
 	std::optional<Vector2> Python3LanguageModule::Vector2ValueFromObject(PyObject* object) {
-		const int typeResult = PyObject_IsInstance(object, _Vector2TypeObject);
+		if (!PyObject_TypeCheck(object, reinterpret_cast<PyTypeObject*>(GetTypes().vector2))) {
+			Vector2 vector{};
+			switch (FloatsFromObject(object, &vector.x, Py_ssize_t{ 2 })) {
+			case FloatsResult::Success:
+				return vector;
+			case FloatsResult::Error:
+				// FloatsFromObject set error. e.g. TypeError, ValueError
+				return std::nullopt;
+			case FloatsResult::Mismatch:
+				break;
+			}
+		}
+		const int typeResult = PyObject_IsInstance(object, GetTypes().vector2);
 		if (typeResult == -1) {
 			// Python exception was set by PyObject_IsInstance
 			return std::nullopt;
@@ -3068,13 +3381,25 @@ namespace py3lm {
 			return nullptr;
 		}
 		PyTuple_SET_ITEM(args, Py_ssize_t{ 2 }, zObject); // zObject ref taken by tuple
-		PyObject* const vectorObject = PyObject_CallObject(_Vector3TypeObject, args);
+		PyObject* const vectorObject = PyObject_CallObject(GetTypes().vector3, args);
 		Py_DECREF(args);
 		return vectorObject;
 	}
 
 	std::optional<Vector3> Python3LanguageModule::Vector3ValueFromObject(PyObject* object) {
-		const int typeResult = PyObject_IsInstance(object, _Vector3TypeObject);
+		if (!PyObject_TypeCheck(object, reinterpret_cast<PyTypeObject*>(GetTypes().vector3))) {
+			Vector3 vector{};
+			switch (FloatsFromObject(object, &vector.x, Py_ssize_t{ 3 })) {
+			case FloatsResult::Success:
+				return vector;
+			case FloatsResult::Error:
+				// FloatsFromObject set error. e.g. TypeError, ValueError
+				return std::nullopt;
+			case FloatsResult::Mismatch:
+				break;
+			}
+		}
+		const int typeResult = PyObject_IsInstance(object, GetTypes().vector3);
 		if (typeResult == -1) {
 			// Python exception was set by PyObject_IsInstance
 			return std::nullopt;
@@ -3132,13 +3457,25 @@ namespace py3lm {
 			return nullptr;
 		}
 		PyTuple_SET_ITEM(args, Py_ssize_t{ 3 }, wObject); // wObject ref taken by tuple
-		PyObject* const vectorObject = PyObject_CallObject(_Vector4TypeObject, args);
+		PyObject* const vectorObject = PyObject_CallObject(GetTypes().vector4, args);
 		Py_DECREF(args);
 		return vectorObject;
 	}
 
 	std::optional<Vector4> Python3LanguageModule::Vector4ValueFromObject(PyObject* object) {
-		const int typeResult = PyObject_IsInstance(object, _Vector4TypeObject);
+		if (!PyObject_TypeCheck(object, reinterpret_cast<PyTypeObject*>(GetTypes().vector4))) {
+			Vector4 vector{};
+			switch (FloatsFromObject(object, &vector.x, Py_ssize_t{ 4 })) {
+			case FloatsResult::Success:
+				return vector;
+			case FloatsResult::Error:
+				// FloatsFromObject set error. e.g. TypeError, ValueError
+				return std::nullopt;
+			case FloatsResult::Mismatch:
+				break;
+			}
+		}
+		const int typeResult = PyObject_IsInstance(object, GetTypes().vector4);
 		if (typeResult == -1) {
 			// Python exception was set by PyObject_IsInstance
 			return std::nullopt;
@@ -3280,13 +3617,25 @@ namespace py3lm {
 			return nullptr;
 		}
 		PyTuple_SET_ITEM(args, Py_ssize_t{ 0 }, elementsObject); // elementsObject ref taken by tuple
-		PyObject* const vectorObject = PyObject_CallObject(_Matrix4x4TypeObject, args);
+		PyObject* const vectorObject = PyObject_CallObject(GetTypes().matrix4x4, args);
 		Py_DECREF(args);
 		return vectorObject;
 	}
 
 	std::optional<Matrix4x4> Python3LanguageModule::Matrix4x4ValueFromObject(PyObject* object) {
-		const int typeResult = PyObject_IsInstance(object, _Matrix4x4TypeObject);
+		Matrix4x4 matrix{};
+		if (!PyObject_TypeCheck(object, reinterpret_cast<PyTypeObject*>(GetTypes().matrix4x4))) {
+			switch (MatrixFromObject(object, matrix)) {
+			case FloatsResult::Success:
+				return { std::move(matrix) };
+			case FloatsResult::Error:
+				// MatrixFromObject set error. e.g. TypeError, ValueError
+				return std::nullopt;
+			case FloatsResult::Mismatch:
+				break;
+			}
+		}
+		const int typeResult = PyObject_IsInstance(object, GetTypes().matrix4x4);
 		if (typeResult == -1) {
 			// Python exception was set by PyObject_IsInstance
 			return std::nullopt;
@@ -3300,57 +3649,38 @@ namespace py3lm {
 			// PyObject_GetAttrString set error. e.g. AttributeError
 			return std::nullopt;
 		}
-		if (!PyList_CheckExact(elementsListObject)) {
-			Py_DECREF(elementsListObject);
-			PyErr_SetString(PyExc_ValueError, "Elements must be a 4x4 list");
+		const FloatsResult result = MatrixFromObject(elementsListObject, matrix);
+		Py_DECREF(elementsListObject);
+		if (result != FloatsResult::Success) {
+			if (result == FloatsResult::Mismatch) {
+				PyErr_SetString(PyExc_ValueError, "Elements must be a 4x4 list");
+			}
+			// MatrixFromObject set error. e.g. TypeError, ValueError
 			return std::nullopt;
 		}
-		if (PyList_Size(elementsListObject) != Py_ssize_t{ 4 }) {
-			Py_DECREF(elementsListObject);
-			PyErr_SetString(PyExc_ValueError, "Elements must be a 4x4 list");
-			return std::nullopt;
+		return { std::move(matrix) };
+	}
+
+	ValueType Python3LanguageModule::GetMathObjectType(PyObject* object) const {
+		if (PyObject_TypeCheck(object, reinterpret_cast<PyTypeObject*>(GetTypes().vector2))) {
+			return ValueType::Vector2;
 		}
-		Matrix4x4 matrix{};
-		for (Py_ssize_t i = 0; i < Py_ssize_t{ 4 }; ++i) {
-			PyObject* const elementsRowListObject = PyList_GetItem(elementsListObject, i);
-			if (!elementsRowListObject) [[unlikely]] {
-				Py_DECREF(elementsListObject);
-				// PyList_GetItem set error. e.g. IndexError
-				return std::nullopt;
-				}
-				if (!PyList_CheckExact(elementsRowListObject)) {
-					Py_DECREF(elementsListObject);
-					PyErr_SetString(PyExc_ValueError, "Elements must be a 4x4 list");
-					return std::nullopt;
-				}
-				if (PyList_Size(elementsRowListObject) != Py_ssize_t{ 4 }) {
-					Py_DECREF(elementsListObject);
-					PyErr_SetString(PyExc_ValueError, "Elements must be a 4x4 list");
-					return std::nullopt;
-				}
-				for (Py_ssize_t j = 0; j < Py_ssize_t{ 4 }; ++j) {
-					PyObject* const mObject = PyList_GetItem(elementsRowListObject, j);
-					if (!mObject) [[unlikely]] {
-						Py_DECREF(elementsListObject);
-						/// PyList_GetItem set error. e.g. IndexError
-						return std::nullopt;
-						}
-					const auto mValue = ValueFromObject<float>(mObject);
-					if (!mValue) {
-						Py_DECREF(elementsListObject);
-						// ValueFromObject set error. e.g. TypeError
-						return std::nullopt;
-					}
-					matrix.data[static_cast<size_t>(i * Py_ssize_t{ 4 } + j)] = *mValue;
-				}
+		if (PyObject_TypeCheck(object, reinterpret_cast<PyTypeObject*>(GetTypes().vector3))) {
+			return ValueType::Vector3;
 		}
-		return { std::move(matrix) };
+		if (PyObject_TypeCheck(object, reinterpret_cast<PyTypeObject*>(GetTypes().vector4))) {
+			return ValueType::Vector4;
+		}
+		if (PyObject_TypeCheck(object, reinterpret_cast<PyTypeObject*>(GetTypes().matrix4x4))) {
+			return ValueType::Matrix4x4;
+		}
+		return ValueType::Invalid;
 	}
 
 	PyObject* Python3LanguageModule::FindPythonMethod(MemAddr addr) const {
 		for (const auto& data : _pythonMethods) {
-			if (data.jitFunction.GetFunction() == addr) {
-				return data.pythonFunction;
+			if (data->jitFunction.GetFunction() == addr) {
+				return data->pythonFunction;
 			}
 		}
 		return nullptr;
@@ -3377,6 +3707,7 @@ namespace py3lm {
 
 	PyObject* Python3LanguageModule::CreateExternalModule(PluginRef plugin) {
 		auto& moduleMethods = _moduleMethods.emplace_back();
+		std::vector<std::pair<MethodRef, void*>> targets;
 
 		for (const auto& [method, addr] : plugin.GetMethods()) {
 			Function function(_jitRuntime);
@@ -3389,7 +3720,14 @@ namespace py3lm {
 			const bool noArgs = method.GetParamTypes().empty();
 
 			// Generate function --> PyObject* (MethodPyCall*)(PyObject* self, PyObject* args)
-			void* const methodAddr = function.GetJitFunc(sig, method, noArgs ? &ExternalCallNoArgs : &ExternalCall, addr);
+			void* methodAddr;
+			{
+				LoadTimer timer(_loadStats.jitNs);
+				++_loadStats.jitCount;
+				PY3LM_PROBE(jit_thunk__entry, method.GetName().c_str(), kJitThunkModule);
+				methodAddr = function.GetJitFunc(sig, method, noArgs ? &ExternalCallNoArgs : &ExternalCall, addr);
+				PY3LM_PROBE(jit_thunk__return, method.GetName().c_str(), kJitThunkModule, methodAddr == nullptr);
+			}
 			if (!methodAddr)
 				break;
 
@@ -3399,6 +3737,7 @@ namespace py3lm {
 			def.ml_flags = noArgs ? METH_NOARGS : METH_VARARGS;
 			def.ml_doc = nullptr;
 
+			targets.emplace_back(method, addr);
 			_moduleFunctions.emplace_back(std::move(function));
 		}
 
@@ -3421,40 +3760,85 @@ namespace py3lm {
 		moduleDef.m_clear = nullptr;
 		moduleDef.m_free = nullptr;
 
-		return PyModule_Create(&moduleDef);
+		PyObject* const moduleObject = PyModule_Create(&moduleDef);
+		if (!moduleObject) {
+			return nullptr;
+		}
+
+		// Replace functions with wrappers adding async_call
+		for (size_t i = 0; i < targets.size(); ++i) {
+			const char* const name = moduleMethods[i].ml_name;
+			PyObject* const function = PyObject_GetAttrString(moduleObject, name);
+			if (!function) {
+				Py_DECREF(moduleObject);
+				return nullptr;
+			}
+			const auto& [method, addr] = targets[i];
+			PyObject* const wrapper = CreateExternalFunction(_ExternalFunctionTypeObject, function, method, addr);
+			Py_DECREF(function);
+			if (!wrapper || PyObject_SetAttrString(moduleObject, name, wrapper) < 0) {
+				Py_XDECREF(wrapper);
+				Py_DECREF(moduleObject);
+				return nullptr;
+			}
+			Py_DECREF(wrapper);
+		}
+
+		return moduleObject;
 	}
 
-	void Python3LanguageModule::TryCallPluginMethodNoArgs(PluginRef plugin, const std::string& name, const std::string& context) {
-		const auto it = _pluginsMap.find(plugin.GetName());
+	bool Python3LanguageModule::TryCallPluginMethodNoArgs(const std::string& pluginName, const std::string& name, const std::string& context) {
+		// Every replica runs its own plugin_start and plugin_end
+		if (const auto replicated = _replicatedPlugins.find(pluginName); replicated != _replicatedPlugins.end()) {
+			bool result = true;
+			for (const auto& replica : replicated->second->replicas) {
+				ReplicaScope scope(*replica);
+				result = CallInstanceMethodNoArgs(replica->instance, name, context) && result;
+			}
+			return result;
+		}
+
+		const auto it = _pluginsMap.find(pluginName);
 		if (it == _pluginsMap.end()) {
-			_provider->Log(std::format("[py3lm] {}: plugin '{}' not found in map", context, plugin.GetName()), Severity::Error);
-			return;
+			_provider->Log(std::format("[py3lm] {}: plugin '{}' not found in map", context, pluginName), Severity::Error);
+			return false;
 		}
 
 		const auto& pluginData = std::get<PluginData>(*it);
 		if (!pluginData._instance) {
 			_provider->Log(std::format("[py3lm] {}: null plugin instance", context), Severity::Error);
-			return;
+			return false;
 		}
 
+		GilEnterScope gil(_gilStats, pluginData._tag);
+		return CallInstanceMethodNoArgs(pluginData._instance, name, context);
+	}
+
+	// GIL of the interpreter owning instance must be held
+	bool Python3LanguageModule::CallInstanceMethodNoArgs(PyObject* instance, const std::string& name, const std::string& context) {
 		PyObject* const nameString = PyUnicode_DecodeFSDefault(name.c_str());
 		if (!nameString) {
 			PyErr_Print();
 			_provider->Log(std::format("[py3lm] {}: failed to allocate name string", context), Severity::Error);
-			return;
+			return false;
 		}
 
-		if (PyObject_HasAttr(pluginData._instance, nameString)) {
-			PyObject* const returnObject = PyObject_CallMethodNoArgs(pluginData._instance, nameString);
+		bool result = true;
+		if (PyObject_HasAttr(instance, nameString)) {
+			PyObject* const returnObject = PyObject_CallMethodNoArgs(instance, nameString);
 			if (!returnObject) {
 				PyErr_Print();
 				_provider->Log(std::format("[py3lm] {}: call '{}' failed", context, name), Severity::Error);
+				result = false;
+			}
+			else {
+				Py_DECREF(returnObject);
 			}
 		}
 
 		Py_DECREF(nameString);
 
-		return;
+		return result;
 	}
 
 	void Python3LanguageModule::LogFatal(const std::string& msg) const {
@@ -3467,4 +3851,103 @@ namespace py3lm {
 	PY3LM_EXPORT ILanguageModule* GetLanguageModule() {
 		return &g_py3lm;
 	}
+
+	// Fills up to count entries, with null stats returns number of available entries
+	extern "C"
+	PY3LM_EXPORT size_t GetGilStats(Py3lmGilStats* stats, size_t count) {
+		return g_py3lm.GetGilStats().Snapshot(stats, count);
+	}
+
+	extern "C"
+	PY3LM_EXPORT void ResetGilStats() {
+		g_py3lm.GetGilStats().Reset();
+	}
+
+	// Marks calling thread as latency-critical for GIL handoff, the thread that initialized the module already is.
+	// Has no effect unless PY3LM_GIL_SWITCH_INTERVAL_US is set
+	extern "C"
+	PY3LM_EXPORT void SetGilLatencyCritical(bool critical) {
+		GilEnterScope gil(g_py3lm.GetGilStats(), GilStats::kModuleTag);
+		g_py3lm.GetGilStats().Priority().SetCritical(critical);
+	}
+
+	// Fires due plugify.timers callbacks in one batch, meant to be called once per host frame
+	extern "C"
+	PY3LM_EXPORT void TickTimers() {
+		GilEnterScope gil(g_py3lm.GetGilStats(), GilStats::kModuleTag);
+		PY3LM_PROBE(timers_tick__entry, PendingTimers());
+		const size_t fired = FireTimers();
+		PY3LM_PROBE(timers_tick__return, fired);
+	}
+
+	// Passes columns to plugify.batch handlers subscribed to name, columns must stay valid until release is called,
+	// which happens before it returns unless Python kept a view of them. commit is called for every batch.commit()
+	// with indices of the written columns, returns number of handlers called
+	extern "C"
+	PY3LM_EXPORT size_t PublishBatch(const char* name, const Py3lmBatchColumn* columns, size_t columnCount, size_t rows, Py3lmBatchCommit commit, Py3lmBatchRelease release, void* user) {
+		GilEnterScope gil(g_py3lm.GetGilStats(), GilStats::kModuleTag);
+		PY3LM_PROBE(batch__entry, name, rows);
+		const size_t handlers = DispatchBatch(name, columns, columnCount, rows, commit, release, user);
+		PY3LM_PROBE(batch__return, name, handlers);
+		return handlers;
+	}
+
+	// Submits plugify.fileio requests made since the last call and delivers finished ones, meant to be called once per host frame.
+	// Returns number of requests delivered
+	extern "C"
+	PY3LM_EXPORT size_t TickFileIo() {
+		GilEnterScope gil(g_py3lm.GetGilStats(), GilStats::kModuleTag);
+		return DeliverFileIo();
+	}
+
+	// Imports up to count dormant plugins, meant to be called once the host is live. Returns number of plugins still dormant
+	extern "C"
+	PY3LM_EXPORT size_t WarmUpPlugins(size_t count) {
+		return g_py3lm.WarmUpPlugins(count);
+	}
+
+	extern "C"
+	PY3LM_EXPORT void GetLoadStats(Py3lmLoadStats* stats) {
+		*stats = g_py3lm.GetLoadStats();
+	}
+
+	extern "C"
+	PY3LM_EXPORT void SetRefAuditEnabled(bool enabled) {
+		GilEnterScope gil(g_py3lm.GetGilStats(), GilStats::kModuleTag);
+		g_py3lm.GetRefAudit().Enable(enabled);
+	}
+
+	// Fills up to count entries, with null stats returns number of available entries
+	extern "C"
+	PY3LM_EXPORT size_t GetRefAuditStats(Py3lmRefAuditStats* stats, size_t count) {
+		return g_py3lm.GetRefAudit().Snapshot(stats, count);
+	}
+
+	extern "C"
+	PY3LM_EXPORT void ResetRefAudit() {
+		g_py3lm.GetRefAudit().Reset();
+	}
+
+	// Null method sets the plugin-wide budget, null policy removes the limits
+	extern "C"
+	PY3LM_EXPORT void SetAdmissionPolicy(const char* plugin, const char* method, const Py3lmAdmissionPolicy* policy) {
+		g_py3lm.GetAdmission().SetPolicy(plugin, method ? method : "", policy ? *policy : Py3lmAdmissionPolicy{});
+	}
+
+	// Starts a new budget period, call once per host frame
+	extern "C"
+	PY3LM_EXPORT void TickAdmission() {
+		g_py3lm.GetAdmission().Tick();
+	}
+
+	// Fills up to count entries, with null stats returns number of available entries
+	extern "C"
+	PY3LM_EXPORT size_t GetAdmissionStats(Py3lmAdmissionStats* stats, size_t count) {
+		return g_py3lm.GetAdmission().Snapshot(stats, count);
+	}
+
+	extern "C"
+	PY3LM_EXPORT void ResetAdmissionStats() {
+		g_py3lm.GetAdmission().Reset();
+	}
 }
@@ -5,10 +5,24 @@
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
 #include <asmjit/asmjit.h>
+#include "admission.h"
+#include "gil.h"
+#include "load_stats.h"
+#include "ref_audit.h"
+#include "replicas.h"
+#include "worker_pool.h"
 #include <unordered_map>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <mutex>
 #include <optional>
+#include <span>
 #include <string>
+#include <thread>
 #include <memory>
+#include <variant>
+#include <vector>
 
 namespace plugify {
 	struct Vector2;
@@ -19,8 +33,27 @@ namespace plugify {
 
 namespace py3lm {
 	struct PythonMethodData {
+		using SetReturnFunc = bool (*)(PyObject*, plugify::PropertyRef, const plugify::ReturnValue*, const plugify::Parameters*);
+		using SetFallbackReturnFunc = void (*)(plugify::ValueType, const plugify::ReturnValue*, const plugify::Parameters*);
+		using ParamToObjectFunc = PyObject* (*)(plugify::PropertyRef, const plugify::Parameters*, uint8_t);
+		using SetRefParamFunc = bool (*)(PyObject*, plugify::PropertyRef, const plugify::Parameters*, uint8_t);
+
 		plugify::Function jitFunction;
 		PyObject* pythonFunction{};
+		uint32_t tag{};
+		// Return convention of the method, resolved once when the thunk is generated
+		SetReturnFunc setReturn{};
+		SetFallbackReturnFunc setFallbackReturn{};
+		uint8_t paramsStartIndex{};
+		// Per parameter marshalling, resolved once as well: converter of each parameter,
+		// and the position and write back of each reference parameter in order
+		std::vector<ParamToObjectFunc> paramToObject;
+		std::vector<std::pair<uint8_t, SetRefParamFunc>> refParams;
+		// Budgets checked before each call, set for exported methods only
+		Admission::Entry* admission{};
+		// Set for replicated plugins, the function is picked from the replica a call is routed to
+		ReplicaSet* replicas{};
+		uint32_t replicaMethod{};
 	};
 
 	class Python3LanguageModule final : public plugify::ILanguageModule {
@@ -38,9 +71,28 @@ namespace py3lm {
 		bool IsDebugBuild() override;
 
 	private:
+		// PyCFunction thunk shared by all native functions with the same signature
+		struct ExternalThunk {
+			plugify::Function func;
+			PyMethodDef def{};
+		};
+		struct ExternalEntry {
+			void* addr;
+			const ExternalThunk* thunk;
+			PyObject* object;
+		};
+		using ExternalKey = std::pair<void*, const ExternalThunk*>;
+		struct ExternalKeyHash {
+			size_t operator()(const ExternalKey& key) const noexcept {
+				return std::hash<void*>{}(key.first) ^ (std::hash<const void*>{}(key.second) << 1);
+			}
+		};
+
 		PyObject* FindExternal(void* funcAddr) const;
 		void* FindInternal(PyObject* object) const;
 		void AddToFunctionsMap(void* funcAddr, PyObject* object);
+		const ExternalThunk* GetOrCreateExternalThunk(plugify::MethodRef method);
+		void EvictExternalFunctions();
 
 	public:
 		PyObject* GetOrCreateFunctionObject(plugify::MethodRef method, void* funcAddr);
@@ -53,13 +105,36 @@ namespace py3lm {
 		std::optional<plugify::Vector4> Vector4ValueFromObject(PyObject* object);
 		PyObject* CreateMatrix4x4Object(const plugify::Matrix4x4& matrix);
 		std::optional<plugify::Matrix4x4> Matrix4x4ValueFromObject(PyObject* object);
+		plugify::ValueType GetMathObjectType(PyObject* object) const;
+		// Classes of the interpreter the calling thread is in
+		const PluginTypes& GetTypes() const {
+			const PluginTypes* const replica = ReplicaScope::CurrentTypes();
+			return replica ? *replica : _types;
+		}
 		void LogFatal(const std::string& msg) const;
+		GilStats& GetGilStats() { return _gilStats; }
+		Py3lmLoadStats& GetLoadStats() { return _loadStats; }
+		WorkerPool& GetWorkerPool() { return _workerPool; }
+		RefAudit& GetRefAudit() { return _refAudit; }
+		Admission& GetAdmission() { return _admission; }
+		bool ActivatePlugin(uint32_t tag);
+		size_t WarmUpPlugins(size_t count);
+		uint32_t GetCallerTag() const;
 
 	private:
 		PyObject* FindPythonMethod(plugify::MemAddr addr) const;
 		PyObject* CreateInternalModule(plugify::PluginRef plugin);
 		PyObject* CreateExternalModule(plugify::PluginRef plugin);
-		void TryCallPluginMethodNoArgs(plugify::PluginRef plugin, const std::string& name, const std::string& context);
+		plugify::LoadResult LoadPlugin(plugify::PluginRef plugin);
+		using ImportResult = std::variant<plugify::ErrorData, std::pair<PyObject*, PyObject*>>;
+		ImportResult ImportPlugin(const std::string& moduleName, std::string_view className);
+		const ReplicaConfig* FindReplicaConfig(const std::string& name) const;
+		plugify::LoadResult LoadReplicatedPlugin(plugify::PluginRef plugin, const ReplicaConfig& config, const std::string& moduleName, std::string_view className, uint32_t tag);
+		std::string LoadReplica(Replica& replica, std::span<const plugify::MethodRef> methods, const std::string& moduleName, std::string_view className);
+		bool IsLazyPlugin(const std::string& name) const;
+		bool SetDormantStarted(const std::string& name, bool started);
+		bool TryCallPluginMethodNoArgs(const std::string& pluginName, const std::string& name, const std::string& context);
+		bool CallInstanceMethodNoArgs(PyObject* instance, const std::string& name, const std::string& context);
 
 	private:
 		std::shared_ptr<plugify::IPlugifyProvider> _provider;
@@ -67,27 +142,49 @@ namespace py3lm {
 		struct PluginData {
 			PyObject* _module = nullptr;
 			PyObject* _instance = nullptr;
+			uint32_t _tag = GilStats::kModuleTag;
 		};
 		std::unordered_map<std::string, PluginData> _pluginsMap;
-		std::vector<PythonMethodData> _pythonMethods;
-		PyObject* _PluginTypeObject = nullptr;
-		PyObject* _PluginInfoTypeObject = nullptr;
-		PyObject* _Vector2TypeObject = nullptr;
-		PyObject* _Vector3TypeObject = nullptr;
-		PyObject* _Vector4TypeObject = nullptr;
-		PyObject* _Matrix4x4TypeObject = nullptr;
+		std::unordered_map<std::string, uint32_t> _packageTags; // top-level package of plugin modules -> GIL tag
+		// Loaded with unbound thunks, imported on the first call or by WarmUpPlugins
+		struct DormantPlugin {
+			std::string _name;
+			std::string _moduleName;
+			std::string _className;
+			std::vector<std::pair<plugify::MethodRef, PythonMethodData*>> _methods;
+			std::thread::id _activator; // set while importing
+			bool _started = false;
+			bool _failed = false;
+		};
+		std::map<uint32_t, DormantPlugin> _dormantPlugins; // by GIL tag, in load order
+		// Bumped whenever an import ends, first calls racing it wait here without the GIL
+		std::mutex _activationMutex;
+		std::condition_variable _activationDone;
+		uint64_t _activations = 0;
+		std::vector<std::string> _lazyPlugins;
+		std::vector<std::unique_ptr<PythonMethodData>> _pythonMethods;
+		std::vector<ReplicaConfig> _replicaConfig;
+		std::unordered_map<std::string, std::unique_ptr<ReplicaSet>> _replicatedPlugins;
+		PluginTypes _types; // of the main interpreter
+		PyObject* _ExternalFunctionTypeObject = nullptr;
 		PyObject* _ppsModule = nullptr;
 		std::vector<std::vector<PyMethodDef>> _moduleMethods;
 		std::vector<std::unique_ptr<PyModuleDef>> _moduleDefinitions;
 		std::vector<plugify::Function> _moduleFunctions;
-		struct ExternalHolder {
-			plugify::Function func;
-			std::unique_ptr<PyMethodDef> def;
-			PyObject* object;
-		};
-		std::vector<ExternalHolder> _externalFunctions;
-		std::vector<PythonMethodData> _internalFunctions;
+		static constexpr size_t kExternalCacheCapacity = 1024;
+		static constexpr size_t kExternalEvictScan = 16; // entries checked per insert once at capacity
+		std::unordered_map<std::string, std::unique_ptr<ExternalThunk>> _externalThunks;
+		std::unordered_map<const void*, const ExternalThunk*> _externalThunkRefs; // by method descriptor, skips building the signature
+		std::list<ExternalEntry> _externalFunctions; // most recently used first
+		std::unordered_map<ExternalKey, std::list<ExternalEntry>::iterator, ExternalKeyHash> _externalCache;
+		std::vector<std::unique_ptr<PythonMethodData>> _internalFunctions;
 		std::unordered_map<void*, PyObject*> _externalMap;
 		std::unordered_map<PyObject*, void*> _internalMap;
+		GilStats _gilStats;
+		Py3lmLoadStats _loadStats{};
+		RefAudit _refAudit;
+		Admission _admission;
+		PyThreadState* _mainThreadState = nullptr;
+		WorkerPool _workerPool{ WorkerPool::DefaultThreadCount() };
 	};
 }
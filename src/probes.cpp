@@ -0,0 +1,103 @@
+#include "probes.h"
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#if PY3LM_USDT
+// Written by the tracer on attach, placed where tools look for USDT semaphores
+extern "C" {
+#define PY3LM_DEFINE_SEMAPHORE(name) __attribute__((section(".probes"))) volatile unsigned short py3lm_##name##_semaphore = 0;
+PY3LM_PROBES(PY3LM_DEFINE_SEMAPHORE)
+#undef PY3LM_DEFINE_SEMAPHORE
+}
+#endif
+
+namespace py3lm {
+#if PY3LM_USDT
+	namespace {
+		PyObject* s_gcCallback = nullptr;
+
+		long ReadInfo(PyObject* info, const char* key) {
+			PyObject* const value = PyDict_GetItemString(info, key);
+			if (!value) {
+				return -1;
+			}
+			const long result = PyLong_AsLong(value);
+			if (result == -1 && PyErr_Occurred()) {
+				PyErr_Clear();
+			}
+			return result;
+		}
+
+		// gc.callbacks entry, called with (phase, info) around every collection and must not raise
+		PyObject* GcCallback(PyObject*, PyObject* const* args, Py_ssize_t nargs) {
+			if (nargs != 2 || !PyUnicode_Check(args[0]) || !PyDict_Check(args[1])) {
+				Py_RETURN_NONE;
+			}
+			if (!PY3LM_PROBE_ENABLED(gc__start) && !PY3LM_PROBE_ENABLED(gc__done)) {
+				Py_RETURN_NONE;
+			}
+			const long generation = ReadInfo(args[1], "generation");
+			if (PyUnicode_CompareWithASCIIString(args[0], "start") == 0) {
+				PY3LM_PROBE(gc__start, generation);
+			}
+			else {
+				PY3LM_PROBE(gc__done, generation, ReadInfo(args[1], "collected"), ReadInfo(args[1], "uncollectable"));
+			}
+			Py_RETURN_NONE;
+		}
+
+		PyMethodDef s_gcCallbackDef = {
+			"_py3lm_gc_probe",
+			reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(GcCallback)),
+			METH_FASTCALL,
+			nullptr
+		};
+
+		PyObject* GetGcCallbacks() {
+			PyObject* const gc = PyImport_ImportModule("gc");
+			if (!gc) {
+				return nullptr;
+			}
+			PyObject* const callbacks = PyObject_GetAttrString(gc, "callbacks");
+			Py_DECREF(gc);
+			return callbacks;
+		}
+	}
+
+	bool RegisterGcProbes() {
+		PyObject* const callbacks = GetGcCallbacks();
+		if (!callbacks) {
+			return false;
+		}
+		s_gcCallback = PyCFunction_New(&s_gcCallbackDef, nullptr);
+		const bool result = s_gcCallback && PyList_Append(callbacks, s_gcCallback) == 0;
+		Py_DECREF(callbacks);
+		return result;
+	}
+
+	void UnregisterGcProbes() {
+		if (!s_gcCallback) {
+			return;
+		}
+		if (PyObject* const callbacks = GetGcCallbacks()) {
+			const Py_ssize_t index = PySequence_Index(callbacks, s_gcCallback);
+			if (index < 0 || PySequence_DelItem(callbacks, index) != 0) {
+				PyErr_Clear();
+			}
+			Py_DECREF(callbacks);
+		}
+		else {
+			PyErr_Clear();
+		}
+		Py_CLEAR(s_gcCallback);
+	}
+#else
+	bool RegisterGcProbes() {
+		return true;
+	}
+
+	void UnregisterGcProbes() {
+	}
+#endif
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+// USDT tracepoints of provider 'py3lm', built in with -DPY3LM_ENABLE_USDT=ON on Linux.
+// A probe is a single nop until bpftrace/perf attaches; arguments that are not free to compute
+// are guarded by PY3LM_PROBE_ENABLED, which reads the probe semaphore set by the tracer.
+// Without USDT both macros compile to nothing.
+
+#if PY3LM_USDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define PY3LM_PROBES(X) \
+	X(internal_call__entry) \
+	X(internal_call__return) \
+	X(internal_call__shed) \
+	X(external_call__entry) \
+	X(external_call__return) \
+	X(plugin_load__entry) \
+	X(plugin_load__return) \
+	X(plugin_start__entry) \
+	X(plugin_start__return) \
+	X(plugin_end__entry) \
+	X(plugin_end__return) \
+	X(jit_thunk__entry) \
+	X(jit_thunk__return) \
+	X(gc__start) \
+	X(gc__done) \
+	X(timers_tick__entry) \
+	X(timers_tick__return) \
+	X(batch__entry) \
+	X(batch__return)
+
+// Semaphores are referenced by name from the probe notes, so they keep C linkage
+#define PY3LM_DECLARE_SEMAPHORE(name) extern "C" volatile unsigned short py3lm_##name##_semaphore;
+PY3LM_PROBES(PY3LM_DECLARE_SEMAPHORE)
+#undef PY3LM_DECLARE_SEMAPHORE
+
+#define PY3LM_PROBE_ENABLED(name) __builtin_expect(py3lm_##name##_semaphore != 0, 0)
+#define PY3LM_PROBE(name, ...) STAP_PROBEV(py3lm, name, __VA_ARGS__)
+
+#else
+
+#define PY3LM_PROBE_ENABLED(name) false
+// Arguments stay referenced but are never evaluated
+#define PY3LM_PROBE(name, ...) ((void)sizeof((__VA_ARGS__, 0)))
+
+#endif
+
+namespace py3lm {
+	// Reports collections through gc__start/gc__done, no-op without USDT
+	bool RegisterGcProbes();
+	void UnregisterGcProbes();
+}
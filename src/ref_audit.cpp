@@ -0,0 +1,216 @@
+#include "ref_audit.h"
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace py3lm {
+	namespace {
+		// Hook is process-wide, interpreters with their own GIL allocate concurrently
+		std::atomic<uint64_t> s_allocations{};
+		std::atomic<uint64_t> s_frees{};
+		PyMemAllocatorEx s_objectAllocator{};
+		bool s_hooked = false;
+
+		void* AuditMalloc(void* /*ctx*/, size_t size) {
+			s_allocations.fetch_add(1, std::memory_order_relaxed);
+			return s_objectAllocator.malloc(s_objectAllocator.ctx, size);
+		}
+
+		void* AuditCalloc(void* /*ctx*/, size_t count, size_t size) {
+			s_allocations.fetch_add(1, std::memory_order_relaxed);
+			return s_objectAllocator.calloc(s_objectAllocator.ctx, count, size);
+		}
+
+		void* AuditRealloc(void* /*ctx*/, void* ptr, size_t size) {
+			if (!ptr) {
+				s_allocations.fetch_add(1, std::memory_order_relaxed);
+			}
+			return s_objectAllocator.realloc(s_objectAllocator.ctx, ptr, size);
+		}
+
+		void AuditFree(void* /*ctx*/, void* ptr) {
+			if (ptr) {
+				s_frees.fetch_add(1, std::memory_order_relaxed);
+			}
+			s_objectAllocator.free(s_objectAllocator.ctx, ptr);
+		}
+
+		// Hook only forwards to the wrapped allocator, so it can be removed while memory is still in use
+		void InstallHook(bool install) {
+			if (install == s_hooked) {
+				return;
+			}
+			if (install) {
+				PyMem_GetAllocator(PYMEM_DOMAIN_OBJ, &s_objectAllocator);
+				PyMemAllocatorEx hook{ nullptr, &AuditMalloc, &AuditCalloc, &AuditRealloc, &AuditFree };
+				PyMem_SetAllocator(PYMEM_DOMAIN_OBJ, &hook);
+			}
+			else {
+				PyMem_SetAllocator(PYMEM_DOMAIN_OBJ, &s_objectAllocator);
+			}
+			s_hooked = install;
+		}
+	}
+
+	void RefAudit::Enable(bool enable) {
+		InstallHook(enable);
+		_enabled = enable;
+	}
+
+	uint64_t RefAudit::Allocations() {
+		return s_allocations.load(std::memory_order_relaxed);
+	}
+
+	uint64_t RefAudit::Frees() {
+		return s_frees.load(std::memory_order_relaxed);
+	}
+
+	void RefAudit::Record(std::string_view direction, std::string_view name, uint64_t created, uint64_t released) {
+		std::string path;
+		path.reserve(direction.size() + 1 + name.size());
+		path.append(direction).append(1, ' ').append(name);
+		bool leaked = false;
+		{
+			std::lock_guard lock(_mutex);
+			auto it = _index.find(path);
+			if (it == _index.end()) {
+				Entry& entry = _entries.emplace_back();
+				entry.path = path;
+				it = _index.emplace(std::move(path), &entry).first;
+			}
+			Entry& entry = *it->second;
+			++entry.calls;
+			entry.created += created;
+			entry.released += released;
+			if (entry.calls <= kWarmupCalls) {
+				return;
+			}
+			entry.windowNet += static_cast<int64_t>(created) - static_cast<int64_t>(released);
+			if (++entry.windowCalls == kWindowCalls) {
+				entry.growingWindows = entry.windowNet > 0 ? entry.growingWindows + 1 : 0;
+				entry.windowNet = 0;
+				entry.windowCalls = 0;
+				if (entry.growingWindows >= kLeakWindows && !entry.leaking) {
+					entry.leaking = true;
+					leaked = true;
+				}
+			}
+			if (leaked) {
+				path = entry.path;
+			}
+		}
+		if (leaked && _leakHandler) {
+			_leakHandler(path);
+		}
+	}
+
+	size_t RefAudit::Snapshot(Py3lmRefAuditStats* stats, size_t count) const {
+		std::lock_guard lock(_mutex);
+		if (!stats) {
+			return _entries.size();
+		}
+		const size_t size = std::min(count, _entries.size());
+		for (size_t i = 0; i < size; ++i) {
+			const Entry& entry = _entries[i];
+			Py3lmRefAuditStats& out = stats[i];
+			out.path = entry.path.c_str();
+			out.calls = entry.calls;
+			out.created = entry.created;
+			out.released = entry.released;
+			out.growingWindows = entry.growingWindows;
+			out.leaking = entry.leaking;
+		}
+		return size;
+	}
+
+	void RefAudit::Reset() {
+		std::lock_guard lock(_mutex);
+		for (auto& entry : _entries) {
+			entry = Entry{ std::move(entry.path) };
+		}
+	}
+
+	void RefAudit::Clear() {
+		std::lock_guard lock(_mutex);
+		_index.clear();
+		_entries.clear();
+	}
+
+	RefAuditScope::RefAuditScope(RefAudit& audit, std::string_view direction, std::string_view name) : _audit{audit}, _direction{direction}, _name{name}, _allocations{RefAudit::Allocations()}, _frees{RefAudit::Frees()}, _active{audit.IsEnabled()} {
+	}
+
+	RefAuditScope::~RefAuditScope() {
+		if (_active && _audit.IsEnabled()) {
+			_audit.Record(_direction, _name, RefAudit::Allocations() - _allocations, RefAudit::Frees() - _frees);
+		}
+	}
+
+	namespace {
+		RefAudit* s_audit = nullptr;
+
+		PyObject* RefAudit_enable(PyObject* /*self*/, PyObject* /*args*/) {
+			s_audit->Enable(true);
+			Py_RETURN_NONE;
+		}
+
+		PyObject* RefAudit_disable(PyObject* /*self*/, PyObject* /*args*/) {
+			s_audit->Enable(false);
+			Py_RETURN_NONE;
+		}
+
+		PyObject* RefAudit_reset(PyObject* /*self*/, PyObject* /*args*/) {
+			s_audit->Reset();
+			Py_RETURN_NONE;
+		}
+
+		PyObject* RefAudit_stats(PyObject* /*self*/, PyObject* /*args*/) {
+			std::vector<Py3lmRefAuditStats> stats(s_audit->Snapshot(nullptr, 0));
+			stats.resize(s_audit->Snapshot(stats.data(), stats.size()));
+			PyObject* const result = PyDict_New();
+			if (!result) {
+				return nullptr;
+			}
+			for (const auto& entry : stats) {
+				PyObject* const value = Py_BuildValue("(KKKO)", entry.calls, entry.created, entry.released, entry.leaking ? Py_True : Py_False);
+				if (!value || PyDict_SetItemString(result, entry.path, value) != 0) {
+					Py_XDECREF(value);
+					Py_DECREF(result);
+					return nullptr;
+				}
+				Py_DECREF(value);
+			}
+			return result;
+		}
+
+		PyMethodDef s_refAuditMethods[] = {
+			{ "enable", RefAudit_enable, METH_NOARGS, "enable() - start counting object allocations per call path" },
+			{ "disable", RefAudit_disable, METH_NOARGS, "disable() - stop counting, collected stats stay available" },
+			{ "reset", RefAudit_reset, METH_NOARGS, "reset() - zero all counters" },
+			{ "stats", RefAudit_stats, METH_NOARGS, "stats() - {path: (calls, created, released, leaking)}" },
+			{ nullptr, nullptr, 0, nullptr }
+		};
+
+		PyModuleDef s_refAuditModule = {
+			PyModuleDef_HEAD_INIT,
+			"plugify.refaudit",
+			"Python object allocation audit of cross-language call paths",
+			-1,
+			s_refAuditMethods,
+			nullptr,
+			nullptr,
+			nullptr,
+			nullptr
+		};
+	}
+
+	PyObject* CreateRefAuditModule(RefAudit& audit) {
+		s_audit = &audit;
+		PyObject* const module = PyModule_Create(&s_refAuditModule);
+		if (!module) {
+			return nullptr;
+		}
+		PyModule_AddIntConstant(module, "WARMUP_CALLS", static_cast<long>(RefAudit::kWarmupCalls));
+		PyModule_AddIntConstant(module, "WINDOW_CALLS", static_cast<long>(RefAudit::kWindowCalls));
+		return module;
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+extern "C" {
+	struct Py3lmRefAuditStats {
+		const char* path; // "<direction> <method name>"
+		uint64_t calls;
+		uint64_t created; // Python object allocations made inside the path
+		uint64_t released; // Python object frees made inside the path
+		uint32_t growingWindows; // consecutive windows that ended with more objects than they started with
+		bool leaking;
+	};
+}
+
+namespace py3lm {
+	// Debug mode counting Python objects created and released by each conversion/call path.
+	// Allocations are counted through a hook on the object allocator, installed only while enabled
+	class RefAudit {
+	public:
+		// First calls fill caches and are not checked
+		static constexpr uint64_t kWarmupCalls = 100;
+		static constexpr uint64_t kWindowCalls = 1000;
+		// Growth of that many windows in a row is reported as a leak
+		static constexpr uint32_t kLeakWindows = 3;
+
+		using LeakHandler = std::function<void(const std::string& path)>;
+
+		// Must be called with the GIL held
+		void Enable(bool enable);
+		bool IsEnabled() const { return _enabled; }
+		void SetLeakHandler(LeakHandler handler) { _leakHandler = std::move(handler); }
+		void Record(std::string_view direction, std::string_view name, uint64_t created, uint64_t released);
+		size_t Snapshot(Py3lmRefAuditStats* stats, size_t count) const;
+		void Reset();
+		void Clear();
+
+		static uint64_t Allocations();
+		static uint64_t Frees();
+
+	private:
+		struct Entry {
+			std::string path;
+			uint64_t calls = 0;
+			uint64_t created = 0;
+			uint64_t released = 0;
+			int64_t windowNet = 0;
+			uint64_t windowCalls = 0;
+			uint32_t growingWindows = 0;
+			bool leaking = false;
+		};
+
+		mutable std::mutex _mutex;
+		std::deque<Entry> _entries;
+		std::unordered_map<std::string, Entry*> _index;
+		LeakHandler _leakHandler;
+		bool _enabled = false;
+	};
+
+	// Counts allocations between construction and destruction, no-op when audit is disabled.
+	// The GIL must be held for the whole scope, allocations of other threads are counted too
+	class RefAuditScope {
+	public:
+		RefAuditScope(RefAudit& audit, std::string_view direction, std::string_view name);
+		~RefAuditScope();
+		RefAuditScope(const RefAuditScope&) = delete;
+		RefAuditScope& operator=(const RefAuditScope&) = delete;
+
+	private:
+		RefAudit& _audit;
+		std::string_view _direction;
+		std::string_view _name;
+		uint64_t _allocations;
+		uint64_t _frees;
+		bool _active;
+	};
+
+	// Creates 'plugify.refaudit' module:
+	//   enable() / disable() - toggle counting
+	//   stats()              - {path: (calls, created, released, leaking)}
+	//   reset()              - zero counters
+	PyObject* CreateRefAuditModule(RefAudit& audit);
+}
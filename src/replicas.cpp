@@ -0,0 +1,236 @@
+#include "replicas.h"
+#include <plugify/compat_format.h>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdlib>
+#include <string_view>
+#include <utility>
+
+namespace py3lm {
+	namespace {
+		constexpr uint32_t kMaxReplicas = 64;
+
+		// Thread states of the calling thread, by replica serial
+		thread_local std::vector<std::pair<uint64_t, PyThreadState*>> t_threadStates;
+		std::atomic<uint64_t> s_nextSerial{ 1 };
+
+		// Main interpreter thread states made by GetThreadState, each is deleted by its thread on exit
+		// or by ReleaseMainThreadStates, whichever takes it out of the list first
+		std::mutex s_mainStatesMutex;
+		std::vector<PyThreadState*> s_mainStates;
+
+		void DeleteMainThreadState(PyThreadState* state) {
+			PyEval_RestoreThread(state);
+			PyThreadState_Clear(state);
+			PyThreadState_DeleteCurrent();
+		}
+
+		struct MainThreadState {
+			PyThreadState* state = nullptr;
+
+			~MainThreadState() {
+				if (!state) {
+					return;
+				}
+				// Held until deleted, so shutdown cannot finalize the interpreter in between
+				std::lock_guard lock(s_mainStatesMutex);
+				const auto it = std::find(s_mainStates.begin(), s_mainStates.end(), state);
+				if (it != s_mainStates.end()) {
+					s_mainStates.erase(it);
+					DeleteMainThreadState(state);
+				}
+			}
+		};
+
+		thread_local MainThreadState t_mainThreadState;
+
+		bool ParseNumber(std::string_view text, uint32_t& value) {
+			const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+			return ec == std::errc{} && end == text.data() + text.size();
+		}
+	}
+
+	thread_local const PluginTypes* ReplicaScope::t_types = nullptr;
+
+	std::string ImportPluginTypes(PluginTypes& types) {
+		PyObject* const module = PyImport_ImportModule("plugify.plugin");
+		if (!module) {
+			return "Failed to import plugify.plugin python module";
+		}
+		const std::pair<PyObject* PluginTypes::*, const char*> kTypes[] = {
+			{ &PluginTypes::plugin, "Plugin" },
+			{ &PluginTypes::pluginInfo, "PluginInfo" },
+			{ &PluginTypes::vector2, "Vector2" },
+			{ &PluginTypes::vector3, "Vector3" },
+			{ &PluginTypes::vector4, "Vector4" },
+			{ &PluginTypes::matrix4x4, "Matrix4x4" }
+		};
+		for (const auto& [member, name] : kTypes) {
+			types.*member = PyObject_GetAttrString(module, name);
+			if (!(types.*member)) {
+				Py_DECREF(module);
+				return std::format("Failed to find plugify.plugin.{} type", name);
+			}
+		}
+		Py_DECREF(module);
+		return {};
+	}
+
+	void ClearPluginTypes(PluginTypes& types) {
+		Py_CLEAR(types.plugin);
+		Py_CLEAR(types.pluginInfo);
+		Py_CLEAR(types.vector2);
+		Py_CLEAR(types.vector3);
+		Py_CLEAR(types.vector4);
+		Py_CLEAR(types.matrix4x4);
+	}
+
+	std::vector<ReplicaConfig> ReadReplicaConfig() {
+		std::vector<ReplicaConfig> configs;
+		const char* const env = std::getenv("PY3LM_REPLICAS");
+		std::string_view list = env ? env : "";
+		while (!list.empty()) {
+			const auto pos = list.find(',');
+			const std::string_view entry = list.substr(0, pos);
+			list = pos == std::string_view::npos ? std::string_view{} : list.substr(pos + 1);
+
+			const auto countPos = entry.find(':');
+			if (countPos == 0 || countPos == std::string_view::npos) {
+				continue;
+			}
+			ReplicaConfig config{ std::string(entry.substr(0, countPos)), 0, -1 };
+			const std::string_view rest = entry.substr(countPos + 1);
+			const auto keyPos = rest.find(':');
+			if (!ParseNumber(rest.substr(0, keyPos), config.count) || config.count == 0 || config.count > kMaxReplicas) {
+				continue;
+			}
+			if (keyPos != std::string_view::npos) {
+				uint32_t key;
+				if (!ParseNumber(rest.substr(keyPos + 1), key) || key > UINT8_MAX) {
+					continue;
+				}
+				config.keyParam = static_cast<int>(key);
+			}
+			configs.push_back(std::move(config));
+		}
+		return configs;
+	}
+
+	Replica::Replica(PyThreadState* home) : _home{home}, _serial{s_nextSerial.fetch_add(1, std::memory_order_relaxed)} {
+		t_threadStates.emplace_back(_serial, home);
+	}
+
+	std::unique_ptr<Replica> Replica::Create(std::string& error) {
+		// Extensions without multi-phase init would share state between GILs, importing them fails instead
+		PyInterpreterConfig config{};
+		config.use_main_obmalloc = 0;
+		config.allow_fork = 0;
+		config.allow_exec = 0;
+		config.allow_threads = 1;
+		config.allow_daemon_threads = 0;
+		config.check_multi_interp_extensions = 1;
+		config.gil = PyInterpreterConfig_OWN_GIL;
+
+		// Creation needs an attached thread state, it releases the main GIL and returns holding the new one
+		const PyGILState_STATE gil = PyGILState_Ensure();
+		PyThreadState* const main = PyThreadState_Get();
+		PyThreadState* home = nullptr;
+		const PyStatus status = Py_NewInterpreterFromConfig(&home, &config);
+		if (PyStatus_Exception(status)) {
+			// Failure restores the main thread state
+			PyGILState_Release(gil);
+			error = std::format("Failed to create interpreter: {}", status.err_msg ? status.err_msg : "unknown error");
+			return nullptr;
+		}
+		PyEval_SaveThread();
+		PyEval_RestoreThread(main);
+		PyGILState_Release(gil);
+		return std::unique_ptr<Replica>(new Replica(home));
+	}
+
+	PyThreadState* Replica::GetThreadState() {
+		for (const auto& [serial, state] : t_threadStates) {
+			if (serial == _serial) {
+				return state;
+			}
+		}
+		// PyGILState_Ensure uses the first thread state a thread gets, it has to be one of the main interpreter
+		if (!PyGILState_GetThisThreadState()) {
+			PyThreadState* const main = PyThreadState_New(PyInterpreterState_Main());
+			std::lock_guard lock(s_mainStatesMutex);
+			s_mainStates.push_back(main);
+			t_mainThreadState.state = main;
+		}
+		PyThreadState* const state = PyThreadState_New(PyThreadState_GetInterpreter(_home));
+		{
+			std::lock_guard lock(_mutex);
+			_threadStates.push_back(state);
+		}
+		t_threadStates.emplace_back(_serial, state);
+		return state;
+	}
+
+	void Replica::End() {
+		PyEval_RestoreThread(_home);
+		for (PyObject* const function : functions) {
+			Py_DECREF(function);
+		}
+		functions.clear();
+		Py_CLEAR(instance);
+		Py_CLEAR(module);
+		ClearPluginTypes(types);
+		{
+			// Py_EndInterpreter wants the ending thread state to be the last one
+			std::lock_guard lock(_mutex);
+			for (PyThreadState* const state : _threadStates) {
+				PyThreadState_Clear(state);
+				PyThreadState_Delete(state);
+			}
+			_threadStates.clear();
+		}
+		Py_EndInterpreter(_home);
+		_home = nullptr;
+	}
+
+	void ReleaseMainThreadStates() {
+		std::lock_guard lock(s_mainStatesMutex);
+		for (PyThreadState* const state : s_mainStates) {
+			DeleteMainThreadState(state);
+		}
+		s_mainStates.clear();
+	}
+
+	ReplicaScope::ReplicaScope(Replica& replica) : _previousTypes{t_types} {
+		PyThreadState* const state = replica.GetThreadState();
+		PyThreadState* const current = _PyThreadState_UncheckedGet();
+		_nested = current == state;
+		_previous = _nested || !current ? nullptr : PyEval_SaveThread();
+		if (!_nested) {
+			PyEval_RestoreThread(state);
+		}
+		t_types = &replica.types;
+	}
+
+	ReplicaScope::~ReplicaScope() {
+		t_types = _previousTypes;
+		if (_nested) {
+			return;
+		}
+		PyEval_SaveThread();
+		if (_previous) {
+			PyEval_RestoreThread(_previous);
+		}
+	}
+
+	Replica& ReplicaSet::ForThread() {
+		static std::atomic<uint64_t> s_nextThread{};
+		thread_local const uint64_t t_thread = s_nextThread.fetch_add(1, std::memory_order_relaxed);
+		return *replicas[t_thread % replicas.size()];
+	}
+
+	Replica& ReplicaSet::ForKey(uint64_t key) {
+		// Spreads sequential ids and aligned pointers
+		return *replicas[((key * 0x9E3779B97F4A7C15ull) >> 32) % replicas.size()];
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace py3lm {
+	// Classes of plugify.plugin, every interpreter has its own
+	struct PluginTypes {
+		PyObject* plugin = nullptr;
+		PyObject* pluginInfo = nullptr;
+		PyObject* vector2 = nullptr;
+		PyObject* vector3 = nullptr;
+		PyObject* vector4 = nullptr;
+		PyObject* matrix4x4 = nullptr;
+	};
+
+	// Imports plugify.plugin into the current interpreter, GIL must be held. Returns error, Python exception stays set
+	std::string ImportPluginTypes(PluginTypes& types);
+	void ClearPluginTypes(PluginTypes& types);
+
+	// PY3LM_REPLICAS=name:count[:key],... loads count copies of a plugin, each in an interpreter with its own GIL.
+	// key is the index of the parameter calls are routed by, without it each calling thread sticks to one replica
+	struct ReplicaConfig {
+		std::string plugin;
+		uint32_t count;
+		int keyParam; // -1 routes by thread
+	};
+
+	std::vector<ReplicaConfig> ReadReplicaConfig();
+
+	// Isolated interpreter running one copy of a replicated plugin
+	class Replica {
+	public:
+		// No thread state may be attached, none is on return. The main interpreter GIL is taken meanwhile.
+		// Null with error set on failure
+		static std::unique_ptr<Replica> Create(std::string& error);
+
+		// Thread state of the calling thread in this interpreter, created on first use
+		PyThreadState* GetThreadState();
+
+		// Drops the objects below and destroys the interpreter, no thread state may be attached
+		void End();
+
+		PluginTypes types;
+		PyObject* module = nullptr;
+		PyObject* instance = nullptr;
+		std::vector<PyObject*> functions; // by exported method
+
+	private:
+		explicit Replica(PyThreadState* home);
+
+		PyThreadState* _home;
+		uint64_t _serial; // never reused, keys per-thread state caches
+		std::mutex _mutex;
+		std::vector<PyThreadState*> _threadStates; // of other threads, deleted before the interpreter ends
+	};
+
+	// Attaches the calling thread to a replica with its GIL. A thread state attached before is detached meanwhile
+	class ReplicaScope {
+	public:
+		explicit ReplicaScope(Replica& replica);
+		~ReplicaScope();
+		ReplicaScope(const ReplicaScope&) = delete;
+		ReplicaScope& operator=(const ReplicaScope&) = delete;
+
+		// Classes of the attached replica, null outside of a scope
+		static const PluginTypes* CurrentTypes() { return t_types; }
+
+	private:
+		PyThreadState* _previous;
+		const PluginTypes* _previousTypes;
+		bool _nested;
+
+		static thread_local const PluginTypes* t_types;
+	};
+
+	// Deletes main interpreter thread states made for host threads that entered a replica first.
+	// Threads still running release theirs on exit, no thread state may be attached
+	void ReleaseMainThreadStates();
+
+	// Replicas of one plugin and how calls pick one
+	struct ReplicaSet {
+		std::vector<std::unique_ptr<Replica>> replicas;
+		int keyParam = -1;
+
+		// Threads get replicas round-robin in order of their first call
+		Replica& ForThread();
+		Replica& ForKey(uint64_t key);
+	};
+}
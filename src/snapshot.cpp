@@ -0,0 +1,1018 @@
+#include "snapshot.h"
+#include "module.h"
+#include <plugify/compat_format.h>
+#include <plugify/math.h>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#if PY3LM_PLATFORM_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace plugify;
+namespace fs = std::filesystem;
+
+namespace py3lm {
+	extern Python3LanguageModule g_py3lm;
+
+	namespace {
+		// File layout:
+		//   [magic u32][version u32][payload size u64][root value]
+		// Value layout:
+		//   [tag u8][payload]
+		//   containers: [tag u8][count u32][offset table][children], offsets are relative to container start
+		//   dict table entries are (key hash u32, key offset u32, value offset u32) in insertion order, value follows its key
+		//   dict: [tag u8][count u32][entry table][hash index][children], hash index holds entry indices u32 sorted by key hash
+		constexpr uint32_t kSnapshotMagic = 0x4E535950; // 'PYSN'
+		constexpr uint32_t kSnapshotVersion = 2;
+		constexpr size_t kHeaderSize = sizeof(uint32_t) * 2 + sizeof(uint64_t);
+		constexpr size_t kContainerHeaderSize = sizeof(uint8_t) + sizeof(uint32_t);
+		constexpr size_t kDictEntrySize = sizeof(uint32_t) * 3;
+		constexpr size_t kDictIndexSize = sizeof(uint32_t);
+
+		enum class Tag : uint8_t {
+			None,
+			False,
+			True,
+			Int,
+			BigInt,
+			Float,
+			String,
+			Bytes,
+			List,
+			Tuple,
+			Dict,
+			Vector2,
+			Vector3,
+			Vector4,
+			Matrix4x4,
+		};
+
+		uint32_t HashBytes(const uint8_t* data, size_t size) {
+			// FNV-1a
+			uint32_t hash = 2166136261u;
+			for (size_t i = 0; i < size; ++i) {
+				hash ^= data[i];
+				hash *= 16777619u;
+			}
+			return hash;
+		}
+
+		class MappedFile {
+		public:
+			MappedFile() = default;
+			~MappedFile() { Close(); }
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+
+			bool Open(const fs::path& path, size_t createSize = 0) {
+				const bool create = createSize != 0;
+#if PY3LM_PLATFORM_WINDOWS
+				_file = CreateFileW(path.c_str(), create ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ, FILE_SHARE_READ, nullptr, create ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+				if (_file == INVALID_HANDLE_VALUE) {
+					return Fail();
+				}
+				LARGE_INTEGER fileSize{};
+				if (create) {
+					fileSize.QuadPart = static_cast<LONGLONG>(createSize);
+				}
+				else if (!GetFileSizeEx(_file, &fileSize)) {
+					return Fail();
+				}
+				_size = static_cast<size_t>(fileSize.QuadPart);
+				if (_size == 0) {
+					return false; // empty file, no error code
+				}
+				_mapping = CreateFileMappingW(_file, nullptr, create ? PAGE_READWRITE : PAGE_READONLY, static_cast<DWORD>(fileSize.HighPart), static_cast<DWORD>(fileSize.LowPart), nullptr);
+				if (!_mapping) {
+					return Fail();
+				}
+				_data = static_cast<uint8_t*>(MapViewOfFile(_mapping, create ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, _size));
+				return _data || Fail();
+#else
+				_fd = create ? open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644) : open(path.c_str(), O_RDONLY);
+				if (_fd == -1) {
+					return Fail();
+				}
+				if (create) {
+					if (ftruncate(_fd, static_cast<off_t>(createSize)) != 0) {
+						return Fail();
+					}
+					_size = createSize;
+				}
+				else {
+					struct stat st{};
+					if (fstat(_fd, &st) != 0) {
+						return Fail();
+					}
+					_size = static_cast<size_t>(st.st_size);
+				}
+				if (_size == 0) {
+					return false; // empty file, no error code
+				}
+				void* const data = mmap(nullptr, _size, create ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, _fd, 0);
+				if (data == MAP_FAILED) {
+					return Fail();
+				}
+				_data = static_cast<uint8_t*>(data);
+				return true;
+#endif
+			}
+
+			bool Flush() {
+#if PY3LM_PLATFORM_WINDOWS
+				return (FlushViewOfFile(_data, _size) && FlushFileBuffers(_file)) || Fail();
+#else
+				return msync(_data, _size, MS_SYNC) == 0 || Fail();
+#endif
+			}
+
+			void Close() {
+#if PY3LM_PLATFORM_WINDOWS
+				if (_data) {
+					UnmapViewOfFile(_data);
+				}
+				if (_mapping) {
+					CloseHandle(_mapping);
+				}
+				if (_file != INVALID_HANDLE_VALUE) {
+					CloseHandle(_file);
+				}
+				_mapping = nullptr;
+				_file = INVALID_HANDLE_VALUE;
+#else
+				if (_data) {
+					munmap(_data, _size);
+				}
+				if (_fd != -1) {
+					close(_fd);
+				}
+				_fd = -1;
+#endif
+				_data = nullptr;
+				_size = 0;
+			}
+
+			uint8_t* GetData() const { return _data; }
+			size_t GetSize() const { return _size; }
+			// Error of the failed Open or Flush, saved before cleanup calls overwrite errno. Empty when the file is empty
+			const std::error_code& GetError() const { return _error; }
+
+		private:
+			bool Fail() {
+#if PY3LM_PLATFORM_WINDOWS
+				_error = std::error_code(static_cast<int>(GetLastError()), std::system_category());
+#else
+				_error = std::error_code(errno, std::generic_category());
+#endif
+				return false;
+			}
+
+#if PY3LM_PLATFORM_WINDOWS
+			HANDLE _file = INVALID_HANDLE_VALUE;
+			HANDLE _mapping = nullptr;
+#else
+			int _fd = -1;
+#endif
+			uint8_t* _data = nullptr;
+			size_t _size = 0;
+			std::error_code _error;
+		};
+
+		void SetOSError(const std::error_code& ec, PyObject* filename) {
+#if PY3LM_PLATFORM_WINDOWS
+			PyErr_SetExcFromWindowsErrWithFilenameObject(PyExc_OSError, ec.value(), filename);
+#else
+			errno = ec.value();
+			PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, filename);
+#endif
+		}
+
+		class Encoder {
+		public:
+			bool Encode(PyObject* object) {
+				if (Py_EnterRecursiveCall(" while encoding snapshot")) {
+					return false;
+				}
+				const bool result = EncodeValue(object);
+				Py_LeaveRecursiveCall();
+				return result;
+			}
+
+			std::vector<uint8_t>& GetBuffer() { return _buffer; }
+
+		private:
+			template<typename T>
+			void Write(const T& value) {
+				const auto* const bytes = reinterpret_cast<const uint8_t*>(&value);
+				_buffer.insert(_buffer.end(), bytes, bytes + sizeof(T));
+			}
+
+			template<typename T>
+			void WriteAt(size_t offset, const T& value) {
+				std::memcpy(_buffer.data() + offset, &value, sizeof(T));
+			}
+
+			void WriteTag(Tag tag) {
+				_buffer.push_back(static_cast<uint8_t>(tag));
+			}
+
+			bool WriteBlob(Tag tag, const char* data, Py_ssize_t size) {
+				if (static_cast<uint64_t>(size) > UINT32_MAX) {
+					PyErr_SetString(PyExc_OverflowError, "Snapshot blob exceeds 4 GiB");
+					return false;
+				}
+				WriteTag(tag);
+				Write(static_cast<uint32_t>(size));
+				_buffer.insert(_buffer.end(), data, data + size);
+				return true;
+			}
+
+			std::optional<uint32_t> RelativeOffset(size_t start) {
+				const size_t offset = _buffer.size() - start;
+				if (offset > UINT32_MAX) {
+					PyErr_SetString(PyExc_OverflowError, "Snapshot container exceeds 4 GiB");
+					return std::nullopt;
+				}
+				return static_cast<uint32_t>(offset);
+			}
+
+			bool EncodeSequence(Tag tag, PyObject* sequence) {
+				const Py_ssize_t count = PySequence_Fast_GET_SIZE(sequence);
+				PyObject** const items = PySequence_Fast_ITEMS(sequence);
+				const size_t start = _buffer.size();
+				WriteTag(tag);
+				Write(static_cast<uint32_t>(count));
+				const size_t table = _buffer.size();
+				_buffer.resize(table + static_cast<size_t>(count) * sizeof(uint32_t));
+				for (Py_ssize_t i = 0; i < count; ++i) {
+					const auto offset = RelativeOffset(start);
+					if (!offset || !Encode(items[i])) {
+						return false;
+					}
+					WriteAt(table + static_cast<size_t>(i) * sizeof(uint32_t), *offset);
+				}
+				return true;
+			}
+
+			bool EncodeDict(PyObject* dict) {
+				const size_t start = _buffer.size();
+				const auto count = static_cast<size_t>(PyDict_Size(dict));
+				WriteTag(Tag::Dict);
+				Write(static_cast<uint32_t>(count));
+				size_t entry = _buffer.size();
+				const size_t index = entry + count * kDictEntrySize;
+				_buffer.resize(index + count * kDictIndexSize);
+				std::vector<std::pair<uint32_t, uint32_t>> hashes;
+				hashes.reserve(count);
+				Py_ssize_t pos = 0;
+				PyObject* key;
+				PyObject* value;
+				while (PyDict_Next(dict, &pos, &key, &value)) {
+					const auto keyOffset = RelativeOffset(start);
+					if (!keyOffset || !Encode(key)) {
+						return false;
+					}
+					const auto valueOffset = RelativeOffset(start);
+					if (!valueOffset || !Encode(value)) {
+						return false;
+					}
+					const uint32_t hash = HashBytes(_buffer.data() + start + *keyOffset, *valueOffset - *keyOffset);
+					WriteAt(entry, hash);
+					WriteAt(entry + sizeof(uint32_t), *keyOffset);
+					WriteAt(entry + sizeof(uint32_t) * 2, *valueOffset);
+					entry += kDictEntrySize;
+					hashes.emplace_back(hash, static_cast<uint32_t>(hashes.size()));
+				}
+				std::sort(hashes.begin(), hashes.end());
+				for (size_t i = 0; i < hashes.size(); ++i) {
+					WriteAt(index + i * kDictIndexSize, hashes[i].second);
+				}
+				return true;
+			}
+
+			template<typename T>
+			bool EncodeFloats(Tag tag, std::optional<T> value) {
+				if (!value) {
+					return false;
+				}
+				WriteTag(tag);
+				Write(*value);
+				return true;
+			}
+
+			bool EncodeValue(PyObject* object) {
+				if (object == Py_None) {
+					WriteTag(Tag::None);
+					return true;
+				}
+				if (PyBool_Check(object)) {
+					WriteTag(object == Py_True ? Tag::True : Tag::False);
+					return true;
+				}
+				if (PyLong_Check(object)) {
+					int overflow = 0;
+					const long long value = PyLong_AsLongLongAndOverflow(object, &overflow);
+					if (value == -1 && PyErr_Occurred()) {
+						return false;
+					}
+					if (overflow == 0) {
+						WriteTag(Tag::Int);
+						Write(static_cast<int64_t>(value));
+						return true;
+					}
+					PyObject* const text = PyObject_Str(object);
+					if (!text) {
+						return false;
+					}
+					Py_ssize_t size{};
+					const char* const buffer = PyUnicode_AsUTF8AndSize(text, &size);
+					const bool result = buffer && WriteBlob(Tag::BigInt, buffer, size);
+					Py_DECREF(text);
+					return result;
+				}
+				if (PyFloat_Check(object)) {
+					WriteTag(Tag::Float);
+					Write(PyFloat_AS_DOUBLE(object));
+					return true;
+				}
+				if (PyUnicode_Check(object)) {
+					Py_ssize_t size{};
+					const char* const buffer = PyUnicode_AsUTF8AndSize(object, &size);
+					return buffer && WriteBlob(Tag::String, buffer, size);
+				}
+				if (PyBytes_Check(object)) {
+					return WriteBlob(Tag::Bytes, PyBytes_AS_STRING(object), PyBytes_GET_SIZE(object));
+				}
+				if (PyList_Check(object) || PyTuple_Check(object)) {
+					return EncodeSequence(PyList_Check(object) ? Tag::List : Tag::Tuple, object);
+				}
+				if (PyDict_Check(object)) {
+					return EncodeDict(object);
+				}
+				switch (g_py3lm.GetMathObjectType(object)) {
+				case ValueType::Vector2:
+					return EncodeFloats(Tag::Vector2, g_py3lm.Vector2ValueFromObject(object));
+				case ValueType::Vector3:
+					return EncodeFloats(Tag::Vector3, g_py3lm.Vector3ValueFromObject(object));
+				case ValueType::Vector4:
+					return EncodeFloats(Tag::Vector4, g_py3lm.Vector4ValueFromObject(object));
+				case ValueType::Matrix4x4:
+					return EncodeFloats(Tag::Matrix4x4, g_py3lm.Matrix4x4ValueFromObject(object));
+				default:
+					break;
+				}
+				PyErr_Format(PyExc_TypeError, "Type '%.200s' not supported by snapshot", Py_TYPE(object)->tp_name);
+				return false;
+			}
+
+			std::vector<uint8_t> _buffer;
+		};
+
+		// Owns mapping, every view keeps a reference to it
+		struct SnapshotFileObject {
+			PyObject_HEAD
+			MappedFile* file;
+		};
+
+		struct SnapshotViewObject {
+			PyObject_HEAD
+			PyObject* owner;
+			const uint8_t* data;
+			size_t size;
+			size_t offset;
+			Tag tag;
+			uint32_t count;
+		};
+
+		PyTypeObject* s_fileType = nullptr;
+		PyTypeObject* s_viewType = nullptr;
+
+		class Decoder {
+		public:
+			Decoder(PyObject* owner, const uint8_t* data, size_t size) : _owner{owner}, _data{data}, _size{size} {}
+
+			template<typename T>
+			bool Read(size_t offset, T& value) const {
+				if (offset > _size || _size - offset < sizeof(T)) {
+					PyErr_SetString(PyExc_ValueError, "Corrupted snapshot: read out of bounds");
+					return false;
+				}
+				std::memcpy(&value, _data + offset, sizeof(T));
+				return true;
+			}
+
+			PyObject* Decode(size_t offset, bool lazy) const {
+				uint8_t rawTag{};
+				if (!Read(offset, rawTag)) {
+					return nullptr;
+				}
+				const Tag tag = static_cast<Tag>(rawTag);
+				const size_t payload = offset + sizeof(uint8_t);
+				switch (tag) {
+				case Tag::None:
+					Py_RETURN_NONE;
+				case Tag::False:
+					Py_RETURN_FALSE;
+				case Tag::True:
+					Py_RETURN_TRUE;
+				case Tag::Int: {
+					int64_t value{};
+					return Read(payload, value) ? PyLong_FromLongLong(value) : nullptr;
+				}
+				case Tag::Float: {
+					double value{};
+					return Read(payload, value) ? PyFloat_FromDouble(value) : nullptr;
+				}
+				case Tag::BigInt:
+				case Tag::String:
+				case Tag::Bytes: {
+					uint32_t size{};
+					if (!Read(payload, size) || _size - payload - sizeof(uint32_t) < size) {
+						if (!PyErr_Occurred()) {
+							PyErr_SetString(PyExc_ValueError, "Corrupted snapshot: blob out of bounds");
+						}
+						return nullptr;
+					}
+					const auto* const blob = reinterpret_cast<const char*>(_data + payload + sizeof(uint32_t));
+					if (tag == Tag::Bytes) {
+						return PyBytes_FromStringAndSize(blob, static_cast<Py_ssize_t>(size));
+					}
+					PyObject* const text = PyUnicode_DecodeUTF8(blob, static_cast<Py_ssize_t>(size), nullptr);
+					if (!text || tag == Tag::String) {
+						return text;
+					}
+					PyObject* const value = PyLong_FromUnicodeObject(text, 10);
+					Py_DECREF(text);
+					return value;
+				}
+				case Tag::Vector2: {
+					Vector2 value{};
+					return Read(payload, value) ? g_py3lm.CreateVector2Object(value) : nullptr;
+				}
+				case Tag::Vector3: {
+					Vector3 value{};
+					return Read(payload, value) ? g_py3lm.CreateVector3Object(value) : nullptr;
+				}
+				case Tag::Vector4: {
+					Vector4 value{};
+					return Read(payload, value) ? g_py3lm.CreateVector4Object(value) : nullptr;
+				}
+				case Tag::Matrix4x4: {
+					Matrix4x4 value{};
+					return Read(payload, value) ? g_py3lm.CreateMatrix4x4Object(value) : nullptr;
+				}
+				case Tag::List:
+				case Tag::Tuple:
+				case Tag::Dict: {
+					uint32_t count{};
+					if (!Read(payload, count)) {
+						return nullptr;
+					}
+					const size_t entrySize = tag == Tag::Dict ? kDictEntrySize + kDictIndexSize : sizeof(uint32_t);
+					if ((_size - offset - kContainerHeaderSize) / entrySize < count) {
+						PyErr_SetString(PyExc_ValueError, "Corrupted snapshot: container out of bounds");
+						return nullptr;
+					}
+					return lazy ? CreateView(offset, tag, count) : DecodeContainer(offset, tag, count);
+				}
+				}
+				PyErr_Format(PyExc_ValueError, "Corrupted snapshot: unknown tag %d", static_cast<int>(rawTag));
+				return nullptr;
+			}
+
+			bool ItemOffset(size_t start, uint32_t index, size_t& offset) const {
+				uint32_t relative{};
+				if (!Read(start + kContainerHeaderSize + static_cast<size_t>(index) * sizeof(uint32_t), relative)) {
+					return false;
+				}
+				offset = start + relative;
+				return true;
+			}
+
+			bool EntryOffsets(size_t start, uint32_t index, uint32_t& hash, size_t& key, size_t& value) const {
+				const size_t entry = start + kContainerHeaderSize + static_cast<size_t>(index) * kDictEntrySize;
+				uint32_t keyRelative{}, valueRelative{};
+				if (!Read(entry, hash) || !Read(entry + sizeof(uint32_t), keyRelative) || !Read(entry + sizeof(uint32_t) * 2, valueRelative)) {
+					return false;
+				}
+				if (valueRelative < keyRelative || start + valueRelative > _size) {
+					PyErr_SetString(PyExc_ValueError, "Corrupted snapshot: bad dict entry");
+					return false;
+				}
+				key = start + keyRelative;
+				value = start + valueRelative;
+				return true;
+			}
+
+			// Entry at position of the hash index
+			bool IndexedEntry(size_t start, uint32_t count, uint32_t position, uint32_t& entry, uint32_t& hash) const {
+				const size_t offset = start + kContainerHeaderSize + static_cast<size_t>(count) * kDictEntrySize + static_cast<size_t>(position) * kDictIndexSize;
+				if (!Read(offset, entry)) {
+					return false;
+				}
+				if (entry >= count) {
+					PyErr_SetString(PyExc_ValueError, "Corrupted snapshot: bad dict index");
+					return false;
+				}
+				return Read(start + kContainerHeaderSize + static_cast<size_t>(entry) * kDictEntrySize, hash);
+			}
+
+			// Binary search over the hash index, reads O(log count) entries. Returns value offset, 0 when not found, nullopt on error
+			std::optional<size_t> FindKey(size_t start, uint32_t count, const std::vector<uint8_t>& encodedKey) const {
+				const uint32_t keyHash = HashBytes(encodedKey.data(), encodedKey.size());
+				uint32_t low = 0;
+				uint32_t high = count;
+				while (low < high) {
+					const uint32_t middle = low + (high - low) / 2;
+					uint32_t entry{}, hash{};
+					if (!IndexedEntry(start, count, middle, entry, hash)) {
+						return std::nullopt;
+					}
+					if (hash < keyHash) {
+						low = middle + 1;
+					}
+					else {
+						high = middle;
+					}
+				}
+				// Keys with equal hashes are adjacent
+				for (uint32_t position = low; position < count; ++position) {
+					uint32_t entry{}, hash{};
+					if (!IndexedEntry(start, count, position, entry, hash)) {
+						return std::nullopt;
+					}
+					if (hash != keyHash) {
+						break;
+					}
+					size_t key{}, value{};
+					if (!EntryOffsets(start, entry, hash, key, value)) {
+						return std::nullopt;
+					}
+					if (value - key == encodedKey.size() && std::memcmp(_data + key, encodedKey.data(), encodedKey.size()) == 0) {
+						return value;
+					}
+				}
+				return size_t{ 0 };
+			}
+
+		private:
+			PyObject* CreateView(size_t offset, Tag tag, uint32_t count) const {
+				auto* const view = PyObject_New(SnapshotViewObject, s_viewType);
+				if (!view) {
+					return nullptr;
+				}
+				Py_INCREF(_owner);
+				view->owner = _owner;
+				view->data = _data;
+				view->size = _size;
+				view->offset = offset;
+				view->tag = tag;
+				view->count = count;
+				return reinterpret_cast<PyObject*>(view);
+			}
+
+			PyObject* DecodeContainer(size_t offset, Tag tag, uint32_t count) const {
+				if (Py_EnterRecursiveCall(" while decoding snapshot")) {
+					return nullptr;
+				}
+				PyObject* result = nullptr;
+				if (tag == Tag::Dict) {
+					result = PyDict_New();
+					for (uint32_t i = 0; result && i < count; ++i) {
+						uint32_t hash{};
+						size_t key{}, value{};
+						PyObject* keyObject = nullptr;
+						PyObject* valueObject = nullptr;
+						if (!EntryOffsets(offset, i, hash, key, value) || !(keyObject = Decode(key, false)) || !(valueObject = Decode(value, false)) || PyDict_SetItem(result, keyObject, valueObject) != 0) {
+							Py_CLEAR(result);
+						}
+						Py_XDECREF(keyObject);
+						Py_XDECREF(valueObject);
+					}
+				}
+				else {
+					result = tag == Tag::List ? PyList_New(count) : PyTuple_New(count);
+					for (uint32_t i = 0; result && i < count; ++i) {
+						size_t item{};
+						PyObject* const itemObject = ItemOffset(offset, i, item) ? Decode(item, false) : nullptr;
+						if (!itemObject) {
+							Py_CLEAR(result);
+							break;
+						}
+						if (tag == Tag::List) {
+							PyList_SET_ITEM(result, i, itemObject); // itemObject ref taken by list
+						}
+						else {
+							PyTuple_SET_ITEM(result, i, itemObject); // itemObject ref taken by tuple
+						}
+					}
+				}
+				Py_LeaveRecursiveCall();
+				return result;
+			}
+
+			PyObject* _owner;
+			const uint8_t* _data;
+			size_t _size;
+		};
+
+		Decoder GetDecoder(SnapshotViewObject* self) {
+			return { self->owner, self->data, self->size };
+		}
+
+		void SnapshotFile_dealloc(PyObject* self) {
+			PyTypeObject* const type = Py_TYPE(self);
+			delete reinterpret_cast<SnapshotFileObject*>(self)->file;
+			type->tp_free(self);
+			Py_DECREF(type);
+		}
+
+		void SnapshotView_dealloc(PyObject* self) {
+			PyTypeObject* const type = Py_TYPE(self);
+			Py_XDECREF(reinterpret_cast<SnapshotViewObject*>(self)->owner);
+			type->tp_free(self);
+			Py_DECREF(type);
+		}
+
+		Py_ssize_t SnapshotView_length(PyObject* self) {
+			return static_cast<Py_ssize_t>(reinterpret_cast<SnapshotViewObject*>(self)->count);
+		}
+
+		PyObject* SnapshotView_item(PyObject* object, Py_ssize_t index) {
+			auto* const self = reinterpret_cast<SnapshotViewObject*>(object);
+			if (self->tag == Tag::Dict) {
+				PyErr_SetString(PyExc_TypeError, "Dict view is not indexable by position");
+				return nullptr;
+			}
+			if (index < 0 || index >= static_cast<Py_ssize_t>(self->count)) {
+				PyErr_SetString(PyExc_IndexError, "Snapshot index out of range");
+				return nullptr;
+			}
+			const Decoder decoder = GetDecoder(self);
+			size_t offset{};
+			if (!decoder.ItemOffset(self->offset, static_cast<uint32_t>(index), offset)) {
+				return nullptr;
+			}
+			return decoder.Decode(offset, true);
+		}
+
+		// Returns new reference to value, nullptr with KeyError when missing
+		PyObject* LookupKey(SnapshotViewObject* self, PyObject* key) {
+			Encoder encoder;
+			if (!encoder.Encode(key)) {
+				return nullptr;
+			}
+			const Decoder decoder = GetDecoder(self);
+			const auto offset = decoder.FindKey(self->offset, self->count, encoder.GetBuffer());
+			if (!offset) {
+				return nullptr;
+			}
+			if (*offset == 0) {
+				PyErr_SetObject(PyExc_KeyError, key);
+				return nullptr;
+			}
+			return decoder.Decode(*offset, true);
+		}
+
+		PyObject* SnapshotView_subscript(PyObject* object, PyObject* key) {
+			auto* const self = reinterpret_cast<SnapshotViewObject*>(object);
+			if (self->tag == Tag::Dict) {
+				return LookupKey(self, key);
+			}
+			Py_ssize_t index = PyNumber_AsSsize_t(key, PyExc_IndexError);
+			if (index == -1 && PyErr_Occurred()) {
+				return nullptr;
+			}
+			if (index < 0) {
+				index += static_cast<Py_ssize_t>(self->count);
+			}
+			return SnapshotView_item(object, index);
+		}
+
+		PyObject* CollectEntries(SnapshotViewObject* self, bool keys, bool values) {
+			const Decoder decoder = GetDecoder(self);
+			PyObject* const list = PyList_New(self->count);
+			for (uint32_t i = 0; list && i < self->count; ++i) {
+				PyObject* item = nullptr;
+				if (self->tag != Tag::Dict) {
+					size_t offset{};
+					item = decoder.ItemOffset(self->offset, i, offset) ? decoder.Decode(offset, true) : nullptr;
+				}
+				else {
+					uint32_t hash{};
+					size_t key{}, value{};
+					if (decoder.EntryOffsets(self->offset, i, hash, key, value)) {
+						PyObject* const keyObject = keys ? decoder.Decode(key, false) : nullptr;
+						PyObject* const valueObject = values ? decoder.Decode(value, true) : nullptr;
+						if ((keys && !keyObject) || (values && !valueObject)) {
+							Py_XDECREF(keyObject);
+							Py_XDECREF(valueObject);
+						}
+						else if (keys && values) {
+							item = PyTuple_Pack(2, keyObject, valueObject);
+							Py_DECREF(keyObject);
+							Py_DECREF(valueObject);
+						}
+						else {
+							item = keys ? keyObject : valueObject;
+						}
+					}
+				}
+				if (!item) {
+					Py_DECREF(list);
+					return nullptr;
+				}
+				PyList_SET_ITEM(list, i, item); // item ref taken by list
+			}
+			return list;
+		}
+
+		PyObject* SnapshotView_iter(PyObject* object) {
+			auto* const self = reinterpret_cast<SnapshotViewObject*>(object);
+			if (self->tag != Tag::Dict) {
+				return PySeqIter_New(object);
+			}
+			PyObject* const keys = CollectEntries(self, true, false);
+			if (!keys) {
+				return nullptr;
+			}
+			PyObject* const iter = PyObject_GetIter(keys);
+			Py_DECREF(keys);
+			return iter;
+		}
+
+		int SnapshotView_contains(PyObject* object, PyObject* key) {
+			auto* const self = reinterpret_cast<SnapshotViewObject*>(object);
+			if (self->tag != Tag::Dict) {
+				PyObject* const list = CollectEntries(self, false, true);
+				if (!list) {
+					return -1;
+				}
+				const int result = PySequence_Contains(list, key);
+				Py_DECREF(list);
+				return result;
+			}
+			Encoder encoder;
+			if (!encoder.Encode(key)) {
+				return -1;
+			}
+			const auto offset = GetDecoder(self).FindKey(self->offset, self->count, encoder.GetBuffer());
+			if (!offset) {
+				return -1;
+			}
+			return *offset != 0 ? 1 : 0;
+		}
+
+		PyObject* SnapshotView_keys(PyObject* self, PyObject* /*args*/) {
+			auto* const view = reinterpret_cast<SnapshotViewObject*>(self);
+			if (view->tag != Tag::Dict) {
+				PyErr_SetString(PyExc_TypeError, "keys() requires dict view");
+				return nullptr;
+			}
+			return CollectEntries(view, true, false);
+		}
+
+		PyObject* SnapshotView_values(PyObject* self, PyObject* /*args*/) {
+			return CollectEntries(reinterpret_cast<SnapshotViewObject*>(self), false, true);
+		}
+
+		PyObject* SnapshotView_items(PyObject* self, PyObject* /*args*/) {
+			auto* const view = reinterpret_cast<SnapshotViewObject*>(self);
+			if (view->tag != Tag::Dict) {
+				PyErr_SetString(PyExc_TypeError, "items() requires dict view");
+				return nullptr;
+			}
+			return CollectEntries(view, true, true);
+		}
+
+		PyObject* SnapshotView_get(PyObject* self, PyObject* const* args, Py_ssize_t nargs) {
+			if (nargs < 1 || nargs > 2) {
+				PyErr_SetString(PyExc_TypeError, "get() takes key and optional default");
+				return nullptr;
+			}
+			auto* const view = reinterpret_cast<SnapshotViewObject*>(self);
+			if (view->tag != Tag::Dict) {
+				PyErr_SetString(PyExc_TypeError, "get() requires dict view");
+				return nullptr;
+			}
+			PyObject* const value = LookupKey(view, args[0]);
+			if (!value && PyErr_ExceptionMatches(PyExc_KeyError)) {
+				PyErr_Clear();
+				PyObject* const defaultValue = nargs == 2 ? args[1] : Py_None;
+				Py_INCREF(defaultValue);
+				return defaultValue;
+			}
+			return value;
+		}
+
+		PyObject* SnapshotView_decode(PyObject* self, PyObject* /*args*/) {
+			auto* const view = reinterpret_cast<SnapshotViewObject*>(self);
+			return GetDecoder(view).Decode(view->offset, false);
+		}
+
+		PyObject* SnapshotView_repr(PyObject* self) {
+			auto* const view = reinterpret_cast<SnapshotViewObject*>(self);
+			const char* const kind = view->tag == Tag::Dict ? "dict" : view->tag == Tag::List ? "list" : "tuple";
+			return PyUnicode_FromFormat("<snapshot %s view, %u items>", kind, view->count);
+		}
+
+		PyMethodDef s_viewMethods[] = {
+			{ "keys", SnapshotView_keys, METH_NOARGS, "Decoded keys of dict view" },
+			{ "values", SnapshotView_values, METH_NOARGS, "Lazily decoded values" },
+			{ "items", SnapshotView_items, METH_NOARGS, "Decoded keys with lazily decoded values" },
+			{ "get", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(SnapshotView_get)), METH_FASTCALL, "Value for key or default" },
+			{ "decode", SnapshotView_decode, METH_NOARGS, "Fully decode view into plain Python objects" },
+			{ nullptr, nullptr, 0, nullptr }
+		};
+
+		PyType_Slot s_viewSlots[] = {
+			{ Py_tp_dealloc, reinterpret_cast<void*>(SnapshotView_dealloc) },
+			{ Py_tp_repr, reinterpret_cast<void*>(SnapshotView_repr) },
+			{ Py_tp_iter, reinterpret_cast<void*>(SnapshotView_iter) },
+			{ Py_tp_methods, s_viewMethods },
+			{ Py_mp_length, reinterpret_cast<void*>(SnapshotView_length) },
+			{ Py_mp_subscript, reinterpret_cast<void*>(SnapshotView_subscript) },
+			{ Py_sq_length, reinterpret_cast<void*>(SnapshotView_length) },
+			{ Py_sq_item, reinterpret_cast<void*>(SnapshotView_item) },
+			{ Py_sq_contains, reinterpret_cast<void*>(SnapshotView_contains) },
+			{ 0, nullptr }
+		};
+
+		PyType_Spec s_viewSpec = {
+			"plugify.snapshot.SnapshotView",
+			sizeof(SnapshotViewObject),
+			0,
+			Py_TPFLAGS_DEFAULT | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+			s_viewSlots
+		};
+
+		PyType_Slot s_fileSlots[] = {
+			{ Py_tp_dealloc, reinterpret_cast<void*>(SnapshotFile_dealloc) },
+			{ 0, nullptr }
+		};
+
+		PyType_Spec s_fileSpec = {
+			"plugify.snapshot.SnapshotFile",
+			sizeof(SnapshotFileObject),
+			0,
+			Py_TPFLAGS_DEFAULT | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+			s_fileSlots
+		};
+
+		std::optional<fs::path> PathFromObject(PyObject* object) {
+			PyObject* bytes = nullptr;
+			if (!PyUnicode_FSConverter(object, &bytes)) {
+				return std::nullopt;
+			}
+			fs::path path(PyBytes_AS_STRING(bytes));
+			Py_DECREF(bytes);
+			return path;
+		}
+
+		PyObject* Snapshot_save(PyObject* /*module*/, PyObject* const* args, Py_ssize_t nargs) {
+			if (nargs != 2) {
+				PyErr_SetString(PyExc_TypeError, "save() takes path and object");
+				return nullptr;
+			}
+			const auto path = PathFromObject(args[0]);
+			if (!path) {
+				return nullptr;
+			}
+
+			Encoder encoder;
+			auto& buffer = encoder.GetBuffer();
+			buffer.resize(kHeaderSize);
+			if (!encoder.Encode(args[1])) {
+				return nullptr;
+			}
+			std::memcpy(buffer.data(), &kSnapshotMagic, sizeof(uint32_t));
+			std::memcpy(buffer.data() + sizeof(uint32_t), &kSnapshotVersion, sizeof(uint32_t));
+			const uint64_t payloadSize = buffer.size() - kHeaderSize;
+			std::memcpy(buffer.data() + sizeof(uint32_t) * 2, &payloadSize, sizeof(uint64_t));
+
+			// Write to temporary file and swap, so crash mid-write keeps previous snapshot intact
+			fs::path tempPath = *path;
+			tempPath += ".tmp";
+			std::error_code ec;
+			Py_BEGIN_ALLOW_THREADS
+			{
+				MappedFile file;
+				if (file.Open(tempPath, buffer.size())) {
+					std::memcpy(file.GetData(), buffer.data(), buffer.size());
+					file.Flush();
+				}
+				ec = file.GetError();
+			}
+			if (!ec) {
+				fs::rename(tempPath, *path, ec);
+			}
+			if (ec) {
+				std::error_code removeError;
+				fs::remove(tempPath, removeError);
+			}
+			Py_END_ALLOW_THREADS
+			if (ec) {
+				SetOSError(ec, args[0]);
+				return nullptr;
+			}
+			Py_RETURN_NONE;
+		}
+
+		PyObject* Snapshot_load(PyObject* /*module*/, PyObject* arg) {
+			const auto path = PathFromObject(arg);
+			if (!path) {
+				return nullptr;
+			}
+
+			auto* const owner = PyObject_New(SnapshotFileObject, s_fileType);
+			if (!owner) {
+				return nullptr;
+			}
+			owner->file = new MappedFile();
+			if (!owner->file->Open(*path)) {
+				const std::error_code ec = owner->file->GetError();
+				Py_DECREF(owner);
+				if (ec) {
+					SetOSError(ec, arg);
+				}
+				else {
+					PyErr_SetString(PyExc_ValueError, "Corrupted snapshot: empty file");
+				}
+				return nullptr;
+			}
+			if (owner->file->GetSize() < kHeaderSize) {
+				Py_DECREF(owner);
+				PyErr_SetString(PyExc_ValueError, "Corrupted snapshot: truncated header");
+				return nullptr;
+			}
+
+			PyObject* const ownerObject = reinterpret_cast<PyObject*>(owner);
+			const Decoder decoder(ownerObject, owner->file->GetData(), owner->file->GetSize());
+			uint32_t magic{}, version{};
+			uint64_t payloadSize{};
+			PyObject* result = nullptr;
+			if (decoder.Read(0, magic) && decoder.Read(sizeof(uint32_t), version) && decoder.Read(sizeof(uint32_t) * 2, payloadSize)) {
+				if (magic != kSnapshotMagic) {
+					PyErr_SetString(PyExc_ValueError, "Not a snapshot file");
+				}
+				else if (version != kSnapshotVersion) {
+					PyErr_Format(PyExc_ValueError, "Unsupported snapshot version %u, expected %u", version, kSnapshotVersion);
+				}
+				else if (payloadSize != owner->file->GetSize() - kHeaderSize) {
+					PyErr_SetString(PyExc_ValueError, "Corrupted snapshot: truncated or oversized payload");
+				}
+				else {
+					result = decoder.Decode(kHeaderSize, true);
+				}
+			}
+			Py_DECREF(owner);
+			return result;
+		}
+
+		PyMethodDef s_snapshotMethods[] = {
+			{ "save", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(Snapshot_save)), METH_FASTCALL, "save(path, obj) - write object to binary snapshot file" },
+			{ "load", Snapshot_load, METH_O, "load(path) - map snapshot file and return lazily decoded view" },
+			{ nullptr, nullptr, 0, nullptr }
+		};
+
+		PyModuleDef s_snapshotModule = {
+			PyModuleDef_HEAD_INIT,
+			"plugify.snapshot",
+			"Versioned binary snapshots of plugin state with lazy decoding",
+			-1,
+			s_snapshotMethods,
+			nullptr,
+			nullptr,
+			nullptr,
+			nullptr
+		};
+	}
+
+	PyObject* CreateSnapshotModule() {
+		PyObject* const module = PyModule_Create(&s_snapshotModule);
+		if (!module) {
+			return nullptr;
+		}
+		s_fileType = reinterpret_cast<PyTypeObject*>(PyType_FromSpec(&s_fileSpec));
+		s_viewType = reinterpret_cast<PyTypeObject*>(PyType_FromSpec(&s_viewSpec));
+		if (!s_fileType || !s_viewType || PyModule_AddObjectRef(module, "SnapshotView", reinterpret_cast<PyObject*>(s_viewType)) != 0) {
+			Py_DECREF(module);
+			return nullptr;
+		}
+		PyModule_AddIntConstant(module, "VERSION", kSnapshotVersion);
+		return module;
+	}
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+namespace py3lm {
+	// Creates 'plugify.snapshot' module:
+	//   save(path, obj) - encode obj into versioned binary snapshot file
+	//   load(path)      - memory-map snapshot and return lazily decoded view of it
+	PyObject* CreateSnapshotModule();
+}
@@ -0,0 +1,738 @@
+#include "spatial.h"
+#include "buffer_arg.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace py3lm {
+	namespace {
+		// Uniform grid over hashed cell coordinates, so the world needs no bounds.
+		// Coordinates wrap after 2^21 cells per axis; wrapped cells only add candidates, every hit is tested exactly
+		class SpatialGrid {
+		public:
+			explicit SpatialGrid(float cellSize) : _cellSize{cellSize}, _inverseCellSize{1.0f / cellSize} {}
+
+			size_t Size() const { return _entries.size(); }
+
+			void Update(const int32_t* ids, const float* positions, size_t count) {
+				_entries.reserve(_entries.size() + count);
+				_index.reserve(_entries.size() + count);
+				_cells.reserve(_entries.size() + count);
+				for (size_t i = 0; i < count; ++i) {
+					const float* const p = positions + i * 3;
+					const uint64_t cell = CellKey(CellOf(p[0]), CellOf(p[1]), CellOf(p[2]));
+					const auto [it, inserted] = _index.try_emplace(ids[i], static_cast<uint32_t>(_entries.size()));
+					if (inserted) {
+						_entries.push_back({ p[0], p[1], p[2], ids[i], cell, kNone, kNone });
+						AddToCell(it->second);
+						continue;
+					}
+					Entry& entry = _entries[it->second];
+					entry.x = p[0];
+					entry.y = p[1];
+					entry.z = p[2];
+					if (entry.cell != cell) {
+						RemoveFromCell(it->second);
+						entry.cell = cell;
+						AddToCell(it->second);
+					}
+				}
+			}
+
+			size_t Remove(const int32_t* ids, size_t count) {
+				size_t removed = 0;
+				for (size_t i = 0; i < count; ++i) {
+					const auto it = _index.find(ids[i]);
+					if (it == _index.end()) {
+						continue;
+					}
+					const uint32_t index = it->second;
+					_index.erase(it);
+					RemoveFromCell(index);
+					// Last entry fills the hole
+					const auto last = static_cast<uint32_t>(_entries.size() - 1);
+					if (index != last) {
+						Entry& moved = _entries[index];
+						moved = _entries[last];
+						Relink(index);
+						_index[moved.id] = index;
+					}
+					_entries.pop_back();
+					++removed;
+				}
+				return removed;
+			}
+
+			void Clear() {
+				_entries.clear();
+				_cells.clear();
+				_index.clear();
+			}
+
+			void QueryRadius(const float* center, float radius, std::vector<int32_t>& out) const {
+				const float r2 = radius * radius;
+				const float min[3] = { center[0] - radius, center[1] - radius, center[2] - radius };
+				const float max[3] = { center[0] + radius, center[1] + radius, center[2] + radius };
+				ForEachCandidate(min, max, [&](const Entry& entry) {
+					if (DistanceSquared(entry, center) <= r2) {
+						out.push_back(entry.id);
+					}
+				});
+			}
+
+			void QueryBox(const float* min, const float* max, std::vector<int32_t>& out) const {
+				ForEachCandidate(min, max, [&](const Entry& entry) {
+					if (entry.x >= min[0] && entry.x <= max[0] && entry.y >= min[1] && entry.y <= max[1] && entry.z >= min[2] && entry.z <= max[2]) {
+						out.push_back(entry.id);
+					}
+				});
+			}
+
+			// Appends up to k ids ordered by distance
+			void QueryNearest(const float* center, size_t k, std::vector<int32_t>& out) const {
+				if (k == 0 || _entries.empty()) {
+					return;
+				}
+				k = std::min(k, _entries.size());
+				// Max-heap of the k best candidates so far
+				std::vector<std::pair<float, int32_t>> best;
+				best.reserve(k + 1);
+				const auto consider = [&](const Entry& entry) {
+					const float d2 = DistanceSquared(entry, center);
+					if (best.size() < k || d2 < best.front().first) {
+						best.emplace_back(d2, entry.id);
+						std::push_heap(best.begin(), best.end());
+						if (best.size() > k) {
+							std::pop_heap(best.begin(), best.end());
+							best.pop_back();
+						}
+					}
+				};
+
+				const int32_t cx = CellOf(center[0]);
+				const int32_t cy = CellOf(center[1]);
+				const int32_t cz = CellOf(center[2]);
+				// Cells of ring d + 1 are at least d cells away from the center
+				for (int32_t d = 0;; ++d) {
+					const uint64_t side = 2 * static_cast<uint64_t>(d) + 1;
+					if (side * side * side > kScanFactor * _entries.size()) {
+						// Sparse neighbourhood, scanning everything is cheaper than more rings
+						best.clear();
+						for (const Entry& entry : _entries) {
+							consider(entry);
+						}
+						break;
+					}
+					ForEachRingCell(cx, cy, cz, d, [&](uint64_t key) {
+						VisitCell(key, consider);
+					});
+					const float reach = static_cast<float>(d) * _cellSize;
+					if (best.size() == k && best.front().first <= reach * reach) {
+						break;
+					}
+				}
+				std::sort_heap(best.begin(), best.end());
+				for (const auto& [distance, id] : best) {
+					out.push_back(id);
+				}
+			}
+
+		private:
+			struct Entry {
+				float x, y, z;
+				int32_t id;
+				uint64_t cell;
+				// Entries of a cell form a doubly linked list, so moving between cells never allocates
+				uint32_t prev;
+				uint32_t next;
+			};
+
+			static constexpr uint32_t kNone = UINT32_MAX;
+
+			// Full scan once cell visits exceed this many per entry
+			static constexpr uint64_t kScanFactor = 4;
+
+			// Callers reject non-finite coordinates, compared so that NaN still maps to a valid cell
+			int32_t CellOf(float value) const {
+				const float cell = std::floor(value * _inverseCellSize);
+				constexpr int32_t kLimit = 1 << 30;
+				if (cell < static_cast<float>(kLimit)) {
+					return cell > static_cast<float>(-kLimit) ? static_cast<int32_t>(cell) : -kLimit;
+				}
+				return kLimit;
+			}
+
+			static uint64_t CellKey(int32_t x, int32_t y, int32_t z) {
+				constexpr uint64_t kMask = (uint64_t{ 1 } << 21) - 1;
+				return ((static_cast<uint64_t>(x) & kMask) << 42) | ((static_cast<uint64_t>(y) & kMask) << 21) | (static_cast<uint64_t>(z) & kMask);
+			}
+
+			static float DistanceSquared(const Entry& entry, const float* p) {
+				const float dx = entry.x - p[0];
+				const float dy = entry.y - p[1];
+				const float dz = entry.z - p[2];
+				return dx * dx + dy * dy + dz * dz;
+			}
+
+			void AddToCell(uint32_t index) {
+				Entry& entry = _entries[index];
+				const auto [it, inserted] = _cells.try_emplace(entry.cell, index);
+				entry.prev = kNone;
+				entry.next = inserted ? kNone : it->second;
+				if (!inserted) {
+					_entries[it->second].prev = index;
+					it->second = index;
+				}
+			}
+
+			void RemoveFromCell(uint32_t index) {
+				const Entry& entry = _entries[index];
+				if (entry.next != kNone) {
+					_entries[entry.next].prev = entry.prev;
+				}
+				if (entry.prev != kNone) {
+					_entries[entry.prev].next = entry.next;
+				}
+				else if (entry.next != kNone) {
+					_cells[entry.cell] = entry.next;
+				}
+				else {
+					_cells.erase(entry.cell);
+				}
+			}
+
+			// Entry was copied to index, its neighbours and cell head must point there
+			void Relink(uint32_t index) {
+				const Entry& entry = _entries[index];
+				if (entry.next != kNone) {
+					_entries[entry.next].prev = index;
+				}
+				if (entry.prev != kNone) {
+					_entries[entry.prev].next = index;
+				}
+				else {
+					_cells[entry.cell] = index;
+				}
+			}
+
+			template<typename Visit>
+			void VisitCell(uint64_t key, Visit& visit) const {
+				const auto it = _cells.find(key);
+				if (it == _cells.end()) {
+					return;
+				}
+				for (uint32_t index = it->second; index != kNone; index = _entries[index].next) {
+					visit(_entries[index]);
+				}
+			}
+
+			template<typename Visit>
+			void ForEachCandidate(const float* min, const float* max, Visit&& visit) const {
+				int32_t low[3];
+				int32_t high[3];
+				uint64_t cellCount = 1;
+				bool scan = false;
+				for (int axis = 0; axis < 3; ++axis) {
+					low[axis] = CellOf(min[axis]);
+					high[axis] = CellOf(max[axis]);
+					if (high[axis] < low[axis]) {
+						return;
+					}
+					// Checked per axis, so the product cannot overflow
+					cellCount *= static_cast<uint64_t>(high[axis] - low[axis]) + 1;
+					scan = scan || cellCount > _cells.size();
+				}
+				if (scan) {
+					// Query covers more cells than are occupied
+					for (const Entry& entry : _entries) {
+						visit(entry);
+					}
+					return;
+				}
+				for (int32_t x = low[0]; x <= high[0]; ++x) {
+					for (int32_t y = low[1]; y <= high[1]; ++y) {
+						for (int32_t z = low[2]; z <= high[2]; ++z) {
+							VisitCell(CellKey(x, y, z), visit);
+						}
+					}
+				}
+			}
+
+			// Cells whose Chebyshev distance from (cx, cy, cz) is exactly d
+			template<typename Visit>
+			static void ForEachRingCell(int32_t cx, int32_t cy, int32_t cz, int32_t d, Visit&& visit) {
+				for (int32_t x = -d; x <= d; ++x) {
+					for (int32_t y = -d; y <= d; ++y) {
+						const bool edge = x == -d || x == d || y == -d || y == d;
+						const int32_t step = edge || d == 0 ? 1 : 2 * d;
+						for (int32_t z = -d; z <= d; z += step) {
+							visit(CellKey(cx + x, cy + y, cz + z));
+						}
+					}
+				}
+			}
+
+			float _cellSize;
+			float _inverseCellSize;
+			std::vector<Entry> _entries;
+			// Cell key -> first entry of the cell
+			std::unordered_map<uint64_t, uint32_t> _cells;
+			std::unordered_map<int32_t, uint32_t> _index;
+		};
+
+		GilStats* s_gilStats = nullptr;
+		PyTypeObject* s_gridType = nullptr;
+		PyTypeObject* s_idsType = nullptr;
+
+		// Updates larger than this release the GIL while the grid is rebuilt
+		constexpr size_t kReleaseGilCount = 16384;
+		constexpr size_t kPointSize = sizeof(float) * 3;
+
+		struct GridObject {
+			PyObject_HEAD
+			SpatialGrid* grid;
+			// Queries running without the GIL share it, changes are exclusive
+			std::shared_mutex* mutex;
+		};
+
+		// Owns query results and exports them as an int32 buffer
+		struct IdsObject {
+			PyObject_HEAD
+			std::vector<int32_t>* ids;
+			Py_ssize_t shape[2];
+			int ndim;
+		};
+
+		int Ids_getbuffer(PyObject* self, Py_buffer* view, int flags) {
+			auto* const ids = reinterpret_cast<IdsObject*>(self);
+			if (flags & PyBUF_WRITABLE) {
+				PyErr_SetString(PyExc_BufferError, "Query results are read-only");
+				return -1;
+			}
+			// Memoryview needs a non-null buffer even for an empty result
+			static int32_t empty = 0;
+			view->buf = ids->ids->empty() ? &empty : ids->ids->data();
+			view->obj = Py_NewRef(self);
+			view->len = static_cast<Py_ssize_t>(ids->ids->size() * sizeof(int32_t));
+			view->itemsize = sizeof(int32_t);
+			view->readonly = 1;
+			view->ndim = ids->ndim;
+			view->format = (flags & PyBUF_FORMAT) ? const_cast<char*>("i") : nullptr;
+			view->shape = (flags & PyBUF_ND) ? ids->shape : nullptr;
+			view->strides = nullptr;
+			view->suboffsets = nullptr;
+			view->internal = nullptr;
+			return 0;
+		}
+
+		void Ids_dealloc(PyObject* self) {
+			PyTypeObject* const type = Py_TYPE(self);
+			delete reinterpret_cast<IdsObject*>(self)->ids;
+			type->tp_free(self);
+			Py_DECREF(type);
+		}
+
+		PyType_Slot s_idsSlots[] = {
+			{ Py_tp_dealloc, reinterpret_cast<void*>(Ids_dealloc) },
+			{ Py_bf_getbuffer, reinterpret_cast<void*>(Ids_getbuffer) },
+			{ 0, nullptr }
+		};
+
+		PyType_Spec s_idsSpec = {
+			"plugify.spatial.Ids",
+			sizeof(IdsObject),
+			0,
+			Py_TPFLAGS_DEFAULT | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+			s_idsSlots
+		};
+
+		// Takes over ids and returns a memoryview of them, columns > 0 makes it rows x columns
+		PyObject* CreateIdsView(std::vector<int32_t>&& values, Py_ssize_t columns = 0) {
+			auto* const ids = PyObject_New(IdsObject, s_idsType);
+			if (!ids) {
+				return nullptr;
+			}
+			ids->ids = new std::vector<int32_t>(std::move(values));
+			const auto size = static_cast<Py_ssize_t>(ids->ids->size());
+			ids->ndim = columns > 0 ? 2 : 1;
+			ids->shape[0] = columns > 0 ? size / columns : size;
+			ids->shape[1] = columns;
+			PyObject* const view = PyMemoryView_FromObject(reinterpret_cast<PyObject*>(ids));
+			Py_DECREF(ids);
+			return view;
+		}
+
+		// Accepts Vector3 or any sequence of 3 numbers
+		bool PointArg(PyObject* object, float (&point)[3]) {
+			static constexpr const char* kAxes[] = { "x", "y", "z" };
+			const bool sequence = PySequence_Check(object) != 0;
+			for (Py_ssize_t i = 0; i < 3; ++i) {
+				PyObject* const item = sequence ? PySequence_GetItem(object, i) : PyObject_GetAttrString(object, kAxes[i]);
+				if (!item) {
+					PyErr_SetString(PyExc_TypeError, "Point must be Vector3 or a sequence of 3 numbers");
+					return false;
+				}
+				const double value = PyFloat_AsDouble(item);
+				Py_DECREF(item);
+				if (value == -1.0 && PyErr_Occurred()) {
+					return false;
+				}
+				point[i] = static_cast<float>(value);
+				if (!std::isfinite(point[i])) {
+					PyErr_SetString(PyExc_ValueError, "Point coordinates must be finite");
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// Packed xyz coordinates must be finite, NaN and infinity have no cell
+		bool FinitePoints(const BufferArg& points, const char* name) {
+			const float* const values = points.Data<const float>();
+			for (size_t i = 0; i < points.Count() * 3; ++i) {
+				if (!std::isfinite(values[i])) {
+					PyErr_Format(PyExc_ValueError, "%s has a non-finite coordinate at point %zu", name, i / 3);
+					return false;
+				}
+			}
+			return true;
+		}
+
+		bool FloatArg(PyObject* object, float& value, const char* name, bool allowZero) {
+			const double number = PyFloat_AsDouble(object);
+			if (number == -1.0 && PyErr_Occurred()) {
+				return false;
+			}
+			if (!std::isfinite(number) || number < 0.0 || (!allowZero && number == 0.0)) {
+				PyErr_Format(PyExc_ValueError, "%s must be a finite %s number", name, allowZero ? "non-negative" : "positive");
+				return false;
+			}
+			value = static_cast<float>(number);
+			return true;
+		}
+
+		bool CountArg(PyObject* object, size_t& value) {
+			value = PyLong_AsSize_t(object);
+			return !(value == static_cast<size_t>(-1) && PyErr_Occurred());
+		}
+
+		int Grid_init(PyObject* self, PyObject* args, PyObject* kwargs) {
+			static const char* const names[] = { "cell_size", nullptr };
+			PyObject* cellSizeObject;
+			// PyArg_ParseTupleAndKeywords takes char** before 3.13
+			if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O:Grid", const_cast<char**>(names), &cellSizeObject)) {
+				return -1;
+			}
+			float cellSize;
+			if (!FloatArg(cellSizeObject, cellSize, "cell_size", false)) {
+				return -1;
+			}
+			auto* const grid = reinterpret_cast<GridObject*>(self);
+			// Queries running without the GIL may still use the grid
+			if (grid->grid) {
+				PyErr_SetString(PyExc_RuntimeError, "Grid is already initialized, create a new one or call clear()");
+				return -1;
+			}
+			grid->grid = new SpatialGrid(cellSize);
+			grid->mutex = new std::shared_mutex();
+			return 0;
+		}
+
+		SpatialGrid* CheckGrid(PyObject* self) {
+			auto* const grid = reinterpret_cast<GridObject*>(self)->grid;
+			if (!grid) {
+				PyErr_SetString(PyExc_RuntimeError, "Grid is not initialized");
+			}
+			return grid;
+		}
+
+		std::shared_mutex& GridMutex(PyObject* self) {
+			return *reinterpret_cast<GridObject*>(self)->mutex;
+		}
+
+		PyObject* Grid_update(PyObject* self, PyObject* const* args, Py_ssize_t nargs) {
+			SpatialGrid* const grid = CheckGrid(self);
+			if (!grid) {
+				return nullptr;
+			}
+			if (nargs != 2) {
+				PyErr_SetString(PyExc_TypeError, "update(ids, positions) takes 2 arguments");
+				return nullptr;
+			}
+			BufferArg ids;
+			BufferArg positions;
+			if (!ids.Acquire(args[0], false, BufferFormat::Int32, sizeof(int32_t), "ids") || !positions.Acquire(args[1], false, BufferFormat::Float32, kPointSize, "positions")) {
+				return nullptr;
+			}
+			if (ids.Count() != positions.Count()) {
+				PyErr_Format(PyExc_ValueError, "Got %zu ids for %zu positions", ids.Count(), positions.Count());
+				return nullptr;
+			}
+			if (!FinitePoints(positions, "positions")) {
+				return nullptr;
+			}
+			{
+				std::optional<GilReleaseScope> gil;
+				if (ids.Count() >= kReleaseGilCount) {
+					gil.emplace(*s_gilStats);
+				}
+				std::unique_lock lock(GridMutex(self));
+				grid->Update(ids.Data<const int32_t>(), positions.Data<const float>(), ids.Count());
+			}
+			Py_RETURN_NONE;
+		}
+
+		PyObject* Grid_remove(PyObject* self, PyObject* idsObject) {
+			SpatialGrid* const grid = CheckGrid(self);
+			if (!grid) {
+				return nullptr;
+			}
+			BufferArg ids;
+			if (!ids.Acquire(idsObject, false, BufferFormat::Int32, sizeof(int32_t), "ids")) {
+				return nullptr;
+			}
+			std::unique_lock lock(GridMutex(self));
+			return PyLong_FromSize_t(grid->Remove(ids.Data<const int32_t>(), ids.Count()));
+		}
+
+		PyObject* Grid_clear(PyObject* self, PyObject* /*args*/) {
+			SpatialGrid* const grid = CheckGrid(self);
+			if (!grid) {
+				return nullptr;
+			}
+			std::unique_lock lock(GridMutex(self));
+			grid->Clear();
+			Py_RETURN_NONE;
+		}
+
+		PyObject* Grid_radius(PyObject* self, PyObject* const* args, Py_ssize_t nargs) {
+			SpatialGrid* const grid = CheckGrid(self);
+			if (!grid) {
+				return nullptr;
+			}
+			float center[3];
+			float radius;
+			if (nargs != 2) {
+				PyErr_SetString(PyExc_TypeError, "radius(center, r) takes 2 arguments");
+				return nullptr;
+			}
+			if (!PointArg(args[0], center) || !FloatArg(args[1], radius, "r", true)) {
+				return nullptr;
+			}
+			std::vector<int32_t> result;
+			{
+				std::shared_lock lock(GridMutex(self));
+				grid->QueryRadius(center, radius, result);
+			}
+			return CreateIdsView(std::move(result));
+		}
+
+		PyObject* Grid_box(PyObject* self, PyObject* const* args, Py_ssize_t nargs) {
+			SpatialGrid* const grid = CheckGrid(self);
+			if (!grid) {
+				return nullptr;
+			}
+			float min[3];
+			float max[3];
+			if (nargs != 2) {
+				PyErr_SetString(PyExc_TypeError, "box(min, max) takes 2 arguments");
+				return nullptr;
+			}
+			if (!PointArg(args[0], min) || !PointArg(args[1], max)) {
+				return nullptr;
+			}
+			std::vector<int32_t> result;
+			{
+				std::shared_lock lock(GridMutex(self));
+				grid->QueryBox(min, max, result);
+			}
+			return CreateIdsView(std::move(result));
+		}
+
+		PyObject* Grid_nearest(PyObject* self, PyObject* const* args, Py_ssize_t nargs) {
+			SpatialGrid* const grid = CheckGrid(self);
+			if (!grid) {
+				return nullptr;
+			}
+			float center[3];
+			size_t k;
+			if (nargs != 2) {
+				PyErr_SetString(PyExc_TypeError, "nearest(center, k) takes 2 arguments");
+				return nullptr;
+			}
+			if (!PointArg(args[0], center) || !CountArg(args[1], k)) {
+				return nullptr;
+			}
+			std::vector<int32_t> result;
+			{
+				std::shared_lock lock(GridMutex(self));
+				grid->QueryNearest(center, k, result);
+			}
+			return CreateIdsView(std::move(result));
+		}
+
+		PyObject* Grid_radius_batch(PyObject* self, PyObject* const* args, Py_ssize_t nargs) {
+			SpatialGrid* const grid = CheckGrid(self);
+			if (!grid) {
+				return nullptr;
+			}
+			if (nargs != 2) {
+				PyErr_SetString(PyExc_TypeError, "radius_batch(centers, r) takes 2 arguments");
+				return nullptr;
+			}
+			BufferArg centers;
+			float radius;
+			if (!centers.Acquire(args[0], false, BufferFormat::Float32, kPointSize, "centers") || !FloatArg(args[1], radius, "r", true) || !FinitePoints(centers, "centers")) {
+				return nullptr;
+			}
+			std::vector<int32_t> offsets(centers.Count() + 1);
+			std::vector<int32_t> ids;
+			bool overflow = false;
+			{
+				GilReleaseScope gil(*s_gilStats);
+				std::shared_lock lock(GridMutex(self));
+				const float* const points = centers.Data<const float>();
+				for (size_t i = 0; i < centers.Count(); ++i) {
+					grid->QueryRadius(points + i * 3, radius, ids);
+					if (ids.size() > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+						overflow = true;
+						break;
+					}
+					offsets[i + 1] = static_cast<int32_t>(ids.size());
+				}
+			}
+			if (overflow) {
+				PyErr_SetString(PyExc_OverflowError, "Batch result exceeds 2^31 ids");
+				return nullptr;
+			}
+			PyObject* const offsetsView = CreateIdsView(std::move(offsets));
+			if (!offsetsView) {
+				return nullptr;
+			}
+			PyObject* const idsView = CreateIdsView(std::move(ids));
+			if (!idsView) {
+				Py_DECREF(offsetsView);
+				return nullptr;
+			}
+			PyObject* const result = PyTuple_Pack(2, offsetsView, idsView);
+			Py_DECREF(offsetsView);
+			Py_DECREF(idsView);
+			return result;
+		}
+
+		PyObject* Grid_nearest_batch(PyObject* self, PyObject* const* args, Py_ssize_t nargs) {
+			SpatialGrid* const grid = CheckGrid(self);
+			if (!grid) {
+				return nullptr;
+			}
+			if (nargs != 2) {
+				PyErr_SetString(PyExc_TypeError, "nearest_batch(centers, k) takes 2 arguments");
+				return nullptr;
+			}
+			BufferArg centers;
+			size_t k;
+			if (!centers.Acquire(args[0], false, BufferFormat::Float32, kPointSize, "centers") || !CountArg(args[1], k) || !FinitePoints(centers, "centers")) {
+				return nullptr;
+			}
+			if (k == 0 || k > static_cast<size_t>(std::numeric_limits<int32_t>::max()) / std::max<size_t>(centers.Count(), 1)) {
+				PyErr_SetString(PyExc_ValueError, "k must be positive and the result must fit 2^31 ids");
+				return nullptr;
+			}
+			std::vector<int32_t> ids(centers.Count() * k, -1);
+			{
+				GilReleaseScope gil(*s_gilStats);
+				std::shared_lock lock(GridMutex(self));
+				const float* const points = centers.Data<const float>();
+				std::vector<int32_t> row;
+				row.reserve(k);
+				for (size_t i = 0; i < centers.Count(); ++i) {
+					row.clear();
+					grid->QueryNearest(points + i * 3, k, row);
+					std::copy(row.begin(), row.end(), ids.begin() + static_cast<std::ptrdiff_t>(i * k));
+				}
+			}
+			return CreateIdsView(std::move(ids), static_cast<Py_ssize_t>(k));
+		}
+
+		Py_ssize_t Grid_length(PyObject* self) {
+			SpatialGrid* const grid = CheckGrid(self);
+			if (!grid) {
+				return -1;
+			}
+			std::shared_lock lock(GridMutex(self));
+			return static_cast<Py_ssize_t>(grid->Size());
+		}
+
+		void Grid_dealloc(PyObject* self) {
+			PyTypeObject* const type = Py_TYPE(self);
+			auto* const grid = reinterpret_cast<GridObject*>(self);
+			delete grid->grid;
+			delete grid->mutex;
+			type->tp_free(self);
+			Py_DECREF(type);
+		}
+
+		PyMethodDef s_gridMethods[] = {
+			{ "update", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(Grid_update)), METH_FASTCALL, "update(ids, positions) - insert or move int32 ids to packed float32 xyz positions" },
+			{ "remove", Grid_remove, METH_O, "remove(ids) - remove ids, returns number removed" },
+			{ "clear", Grid_clear, METH_NOARGS, "clear() - remove everything" },
+			{ "radius", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(Grid_radius)), METH_FASTCALL, "radius(center, r) - ids within distance r" },
+			{ "box", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(Grid_box)), METH_FASTCALL, "box(min, max) - ids inside the box" },
+			{ "nearest", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(Grid_nearest)), METH_FASTCALL, "nearest(center, k) - up to k closest ids, nearest first" },
+			{ "radius_batch", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(Grid_radius_batch)), METH_FASTCALL, "radius_batch(centers, r) - (offsets, ids), ids of query i are ids[offsets[i]:offsets[i + 1]]" },
+			{ "nearest_batch", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(Grid_nearest_batch)), METH_FASTCALL, "nearest_batch(centers, k) - queries x k ids, missing ones are -1" },
+			{ nullptr, nullptr, 0, nullptr }
+		};
+
+		PyType_Slot s_gridSlots[] = {
+			{ Py_tp_init, reinterpret_cast<void*>(Grid_init) },
+			{ Py_tp_dealloc, reinterpret_cast<void*>(Grid_dealloc) },
+			{ Py_mp_length, reinterpret_cast<void*>(Grid_length) },
+			{ Py_tp_methods, s_gridMethods },
+			{ Py_tp_doc, const_cast<char*>("Grid(cell_size) - uniform hash grid of int32 ids, pick cell_size close to the usual query radius") },
+			{ 0, nullptr }
+		};
+
+		PyType_Spec s_gridSpec = {
+			"plugify.spatial.Grid",
+			sizeof(GridObject),
+			0,
+			Py_TPFLAGS_DEFAULT,
+			s_gridSlots
+		};
+
+		PyModuleDef s_spatialModule = {
+			PyModuleDef_HEAD_INIT,
+			"plugify.spatial",
+			"Spatial index over packed positions",
+			-1,
+			nullptr,
+			nullptr,
+			nullptr,
+			nullptr,
+			nullptr
+		};
+	}
+
+	PyObject* CreateSpatialModule(GilStats& stats) {
+		s_gilStats = &stats;
+		PyObject* const module = PyModule_Create(&s_spatialModule);
+		if (!module) {
+			return nullptr;
+		}
+		s_gridType = reinterpret_cast<PyTypeObject*>(PyType_FromSpec(&s_gridSpec));
+		s_idsType = reinterpret_cast<PyTypeObject*>(PyType_FromSpec(&s_idsSpec));
+		if (!s_gridType || !s_idsType || PyModule_AddObjectRef(module, "Grid", reinterpret_cast<PyObject*>(s_gridType)) != 0) {
+			Py_DECREF(module);
+			return nullptr;
+		}
+		return module;
+	}
+}
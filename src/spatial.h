@@ -0,0 +1,14 @@
+#pragma once
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "gil.h"
+
+namespace py3lm {
+	// Creates 'plugify.spatial' module with Grid(cell_size), a uniform hash grid of int32 ids:
+	//   update(ids, positions), remove(ids), clear()
+	//   radius(center, r), box(min, max), nearest(center, k)      - int32 id buffers
+	//   radius_batch(centers, r), nearest_batch(centers, k)        - run with the GIL released
+	// Batch queries and large updates release the GIL and are accounted in stats
+	PyObject* CreateSpatialModule(GilStats& stats);
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace py3lm {
+	struct TimerNode {
+		TimerNode* prev = nullptr;
+		TimerNode* next = nullptr;
+		uint64_t expiry = 0;
+
+		bool IsLinked() const { return next != nullptr; }
+
+		void Unlink() {
+			prev->next = next;
+			next->prev = prev;
+			prev = nullptr;
+			next = nullptr;
+		}
+	};
+
+	// Circular list with sentinel head
+	struct TimerList {
+		TimerNode head;
+
+		TimerList() { head.prev = head.next = &head; }
+		TimerList(const TimerList&) = delete;
+		TimerList& operator=(const TimerList&) = delete;
+
+		bool IsEmpty() const { return head.next == &head; }
+
+		void PushBack(TimerNode* node) {
+			node->prev = head.prev;
+			node->next = &head;
+			head.prev->next = node;
+			head.prev = node;
+		}
+
+		TimerNode* PopFront() {
+			TimerNode* const node = head.next;
+			node->Unlink();
+			return node;
+		}
+
+		void Splice(TimerList& other) {
+			if (other.IsEmpty()) {
+				return;
+			}
+			other.head.next->prev = head.prev;
+			other.head.prev->next = &head;
+			head.prev->next = other.head.next;
+			head.prev = other.head.prev;
+			other.head.prev = other.head.next = &other.head;
+		}
+	};
+
+	// Hierarchical timing wheel with 1 ms ticks. Level L holds timers whose expiry shares all bits above
+	// level L + 1 with the current tick, slot is picked by expiry bits of level L. Insert and cancel are O(1),
+	// a timer is moved down at most once per level
+	class TimerWheel {
+	public:
+		static constexpr int kSlotBits = 8;
+		static constexpr size_t kSlots = size_t{ 1 } << kSlotBits;
+		static constexpr int kLevels = 4;
+
+		uint64_t Now() const { return _now; }
+		size_t Size() const { return _size; }
+
+		void Schedule(TimerNode* node, uint64_t expiry) {
+			node->expiry = expiry > _now ? expiry : _now + 1;
+			Place(node);
+			++_size;
+		}
+
+		void Cancel(TimerNode* node) {
+			node->Unlink();
+			--_size;
+		}
+
+		// Moves timers due up to the given tick into expired, they stay counted until taken from the list
+		void Advance(uint64_t to, TimerList& expired) {
+			if (_size == 0) {
+				_now = std::max(_now, to);
+				return;
+			}
+			while (_now < to) {
+				++_now;
+				Cascade();
+				expired.Splice(_slots[0][_now & (kSlots - 1)]);
+			}
+		}
+
+		void Taken() {
+			--_size;
+		}
+
+		void Clear(TimerList& removed) {
+			for (auto& level : _slots) {
+				for (auto& slot : level) {
+					removed.Splice(slot);
+				}
+			}
+			_size = 0;
+		}
+
+	private:
+		void Place(TimerNode* node) {
+			for (int level = 0; level < kLevels; ++level) {
+				const int shift = kSlotBits * (level + 1);
+				if (shift >= 64 || (node->expiry >> shift) == (_now >> shift)) {
+					_slots[level][(node->expiry >> (kSlotBits * level)) & (kSlots - 1)].PushBack(node);
+					return;
+				}
+			}
+			// Beyond wheel range: top level slot 0 is cascaded at the start of every wheel rotation
+			// and never holds in-range timers, placed again from there until in range
+			_slots[kLevels - 1][0].PushBack(node);
+		}
+
+		// Higher levels first, their timers may land in a lower level slot cascaded in the same tick
+		void Cascade() {
+			int top = 0;
+			while (top + 1 < kLevels && (_now & ((uint64_t{ 1 } << (kSlotBits * (top + 1))) - 1)) == 0) {
+				++top;
+			}
+			for (int level = top; level > 0; --level) {
+				TimerList moved;
+				moved.Splice(_slots[level][(_now >> (kSlotBits * level)) & (kSlots - 1)]);
+				while (!moved.IsEmpty()) {
+					Place(moved.PopFront());
+				}
+			}
+		}
+
+		std::array<std::array<TimerList, kSlots>, kLevels> _slots;
+		uint64_t _now = 0;
+		size_t _size = 0;
+	};
+}
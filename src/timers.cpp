@@ -0,0 +1,258 @@
+#include "timers.h"
+#include "timer_wheel.h"
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+namespace py3lm {
+	namespace {
+		using TimerClock = std::chrono::steady_clock;
+
+		struct TimerObject {
+			PyObject_HEAD
+			TimerNode node; // first non-header member, see FromNode
+			PyObject* callback;
+			uint64_t interval; // ticks, 0 for one-shot timers
+		};
+
+		TimerObject* FromNode(TimerNode* node) {
+			return reinterpret_cast<TimerObject*>(reinterpret_cast<char*>(node) - offsetof(TimerObject, node));
+		}
+
+		TimerWheel* s_wheel = nullptr;
+		TimerClock::time_point s_start;
+		PyTypeObject* s_timerType = nullptr;
+		// Timers taken from the wheel and waiting to fire in the current batch
+		TimerList* s_firing = nullptr;
+
+		uint64_t CurrentTick() {
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(TimerClock::now() - s_start).count());
+		}
+
+		bool IsPending(const TimerObject* timer) {
+			return timer->node.IsLinked();
+		}
+
+		// Wheel keeps a reference while timer is pending
+		void Unschedule(TimerObject* timer) {
+			s_wheel->Cancel(&timer->node);
+			Py_DECREF(timer);
+		}
+
+		PyObject* Timer_cancel(PyObject* self, PyObject* /*args*/) {
+			auto* const timer = reinterpret_cast<TimerObject*>(self);
+			if (!IsPending(timer)) {
+				Py_RETURN_FALSE;
+			}
+			Unschedule(timer);
+			Py_RETURN_TRUE;
+		}
+
+		PyObject* Timer_active(PyObject* self, void* /*closure*/) {
+			return PyBool_FromLong(IsPending(reinterpret_cast<TimerObject*>(self)));
+		}
+
+		PyObject* Timer_repr(PyObject* self) {
+			const auto* const timer = reinterpret_cast<TimerObject*>(self);
+			return PyUnicode_FromFormat("<plugify.timers.Timer %s %R>", IsPending(timer) ? "pending" : "done", timer->callback);
+		}
+
+		int Timer_traverse(PyObject* self, visitproc visit, void* arg) {
+			Py_VISIT(reinterpret_cast<TimerObject*>(self)->callback);
+			Py_VISIT(Py_TYPE(self));
+			return 0;
+		}
+
+		int Timer_clear(PyObject* self) {
+			Py_CLEAR(reinterpret_cast<TimerObject*>(self)->callback);
+			return 0;
+		}
+
+		void Timer_dealloc(PyObject* self) {
+			PyTypeObject* const type = Py_TYPE(self);
+			PyObject_GC_UnTrack(self);
+			Timer_clear(self);
+			type->tp_free(self);
+			Py_DECREF(type);
+		}
+
+		PyMethodDef s_timerMethods[] = {
+			{ "cancel", Timer_cancel, METH_NOARGS, "cancel() - stop timer, returns False if it was not pending" },
+			{ nullptr, nullptr, 0, nullptr }
+		};
+
+		PyGetSetDef s_timerGetSet[] = {
+			{ "active", Timer_active, nullptr, "True while timer is pending", nullptr },
+			{ nullptr, nullptr, nullptr, nullptr, nullptr }
+		};
+
+		PyType_Slot s_timerSlots[] = {
+			{ Py_tp_dealloc, reinterpret_cast<void*>(Timer_dealloc) },
+			{ Py_tp_traverse, reinterpret_cast<void*>(Timer_traverse) },
+			{ Py_tp_clear, reinterpret_cast<void*>(Timer_clear) },
+			{ Py_tp_repr, reinterpret_cast<void*>(Timer_repr) },
+			{ Py_tp_methods, s_timerMethods },
+			{ Py_tp_getset, s_timerGetSet },
+			{ 0, nullptr }
+		};
+
+		PyType_Spec s_timerSpec = {
+			"plugify.timers.Timer",
+			sizeof(TimerObject),
+			0,
+			Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+			s_timerSlots
+		};
+
+		bool SecondsToTicks(PyObject* value, uint64_t& ticks) {
+			const double seconds = PyFloat_AsDouble(value);
+			if (seconds == -1.0 && PyErr_Occurred()) {
+				return false;
+			}
+			// Upper bound keeps tick math far from overflow, about 31 years
+			if (!std::isfinite(seconds) || seconds < 0.0 || seconds > 1e9) {
+				PyErr_SetString(PyExc_ValueError, "Delay must be a non-negative number of seconds, at most 1e9");
+				return false;
+			}
+			ticks = static_cast<uint64_t>(std::ceil(seconds * 1000.0));
+			return true;
+		}
+
+		PyObject* Schedule(PyObject* const* args, Py_ssize_t nargs, bool repeat) {
+			if (nargs != 2) {
+				PyErr_SetString(PyExc_TypeError, repeat ? "every(interval, fn) takes 2 arguments" : "after(delay, fn) takes 2 arguments");
+				return nullptr;
+			}
+			uint64_t ticks;
+			if (!SecondsToTicks(args[0], ticks)) {
+				return nullptr;
+			}
+			if (!PyCallable_Check(args[1])) {
+				PyErr_SetString(PyExc_TypeError, "Timer callback must be callable");
+				return nullptr;
+			}
+			if (repeat && ticks == 0) {
+				// Once per tick
+				ticks = 1;
+			}
+			auto* const timer = PyObject_GC_New(TimerObject, s_timerType);
+			if (!timer) {
+				return nullptr;
+			}
+			timer->node = TimerNode{};
+			timer->callback = Py_NewRef(args[1]);
+			timer->interval = repeat ? ticks : 0;
+			PyObject_GC_Track(timer);
+
+			// Delay counts from now, not from the last tick
+			s_wheel->Schedule(&timer->node, CurrentTick() + ticks);
+			Py_INCREF(timer);
+			return reinterpret_cast<PyObject*>(timer);
+		}
+
+		PyObject* Timers_after(PyObject* /*self*/, PyObject* const* args, Py_ssize_t nargs) {
+			return Schedule(args, nargs, false);
+		}
+
+		PyObject* Timers_every(PyObject* /*self*/, PyObject* const* args, Py_ssize_t nargs) {
+			return Schedule(args, nargs, true);
+		}
+
+		PyObject* Timers_tick(PyObject* /*self*/, PyObject* /*args*/) {
+			FireTimers();
+			Py_RETURN_NONE;
+		}
+
+		PyObject* Timers_pending(PyObject* /*self*/, PyObject* /*args*/) {
+			return PyLong_FromSize_t(s_wheel->Size());
+		}
+
+		PyMethodDef s_timersMethods[] = {
+			{ "after", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(Timers_after)), METH_FASTCALL, "after(delay, fn) - call fn() once after delay seconds" },
+			{ "every", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(Timers_every)), METH_FASTCALL, "every(interval, fn) - call fn() every interval seconds until cancelled" },
+			{ "tick", Timers_tick, METH_NOARGS, "tick() - fire due timers now" },
+			{ "pending", Timers_pending, METH_NOARGS, "pending() - number of pending timers" },
+			{ nullptr, nullptr, 0, nullptr }
+		};
+
+		PyModuleDef s_timersModule = {
+			PyModuleDef_HEAD_INIT,
+			"plugify.timers",
+			"Delayed and repeating callbacks fired in batches on host tick",
+			-1,
+			s_timersMethods,
+			nullptr,
+			nullptr,
+			nullptr,
+			nullptr
+		};
+	}
+
+	PyObject* CreateTimersModule() {
+		PyObject* const module = PyModule_Create(&s_timersModule);
+		if (!module) {
+			return nullptr;
+		}
+		s_timerType = reinterpret_cast<PyTypeObject*>(PyType_FromSpec(&s_timerSpec));
+		if (!s_timerType || PyModule_AddObjectRef(module, "Timer", reinterpret_cast<PyObject*>(s_timerType)) != 0) {
+			Py_DECREF(module);
+			return nullptr;
+		}
+		s_wheel = new TimerWheel();
+		s_firing = new TimerList();
+		s_start = TimerClock::now();
+		return module;
+	}
+
+	size_t FireTimers() {
+		if (!s_wheel) {
+			return 0;
+		}
+		const uint64_t now = CurrentTick();
+		s_wheel->Advance(now, *s_firing);
+		size_t fired = 0;
+		while (!s_firing->IsEmpty()) {
+			++fired;
+			auto* const timer = FromNode(s_firing->PopFront());
+			s_wheel->Taken();
+			// Reference taken over from the wheel
+			PyObject* const callback = Py_NewRef(timer->callback);
+			if (timer->interval) {
+				// Rescheduled before the call, so the callback may cancel it
+				s_wheel->Schedule(&timer->node, now + timer->interval);
+				Py_INCREF(timer);
+			}
+			PyObject* const result = PyObject_CallNoArgs(callback);
+			if (result) {
+				Py_DECREF(result);
+			}
+			else {
+				PyErr_Print();
+			}
+			Py_DECREF(callback);
+			Py_DECREF(timer);
+		}
+		return fired;
+	}
+
+	size_t PendingTimers() {
+		return s_wheel ? s_wheel->Size() : 0;
+	}
+
+	void ClearTimers() {
+		if (!s_wheel) {
+			return;
+		}
+		TimerList removed;
+		s_wheel->Clear(removed);
+		removed.Splice(*s_firing);
+		while (!removed.IsEmpty()) {
+			Py_DECREF(FromNode(removed.PopFront()));
+		}
+		delete s_wheel;
+		delete s_firing;
+		s_wheel = nullptr;
+		s_firing = nullptr;
+		Py_CLEAR(s_timerType);
+	}
+}
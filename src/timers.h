@@ -0,0 +1,21 @@
+#pragma once
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+namespace py3lm {
+	// Creates 'plugify.timers' module:
+	//   after(delay, fn)    - call fn() once after delay seconds, returns Timer with cancel()
+	//   every(interval, fn) - call fn() every interval seconds until cancelled
+	//   tick()              - fire due timers now, for hosts driving the loop from Python
+	PyObject* CreateTimersModule();
+
+	// Fires all due timers in one batch on the calling thread, GIL must be held. Returns number of callbacks called
+	size_t FireTimers();
+
+	// Number of scheduled timers
+	size_t PendingTimers();
+
+	// Drops pending timers, GIL must be held
+	void ClearTimers();
+}
@@ -0,0 +1,279 @@
+#include "vector_kernels_impl.h"
+#include "buffer_arg.h"
+#include "module.h"
+#include <plugify/math.h>
+#include <cstdlib>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+
+#if PY3LM_ARCH_X86 && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+using namespace plugify;
+
+namespace py3lm {
+	extern Python3LanguageModule g_py3lm;
+
+	namespace {
+		// Below this many vectors a call is faster than the GIL round trip
+		constexpr size_t kReleaseGilCount = 16384;
+
+		bool CpuHasAvx2() {
+#if PY3LM_ARCH_X86 && defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 1);
+			const bool osxsave = (info[2] & (1 << 27)) != 0;
+			const bool avx = (info[2] & (1 << 28)) != 0;
+			// OS must save ymm registers on context switch
+			if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+				return false;
+			}
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+#elif PY3LM_ARCH_X86
+			return __builtin_cpu_supports("avx2");
+#else
+			return false;
+#endif
+		}
+
+		const VectorKernels& SelectVectorKernels() {
+			static constexpr VectorKernels kScalar = MakeVectorKernels<ScalarOps>("scalar");
+#if PY3LM_ARCH_X86
+			static constexpr VectorKernels kSse = MakeVectorKernels<SseOps>("sse2");
+			// PY3LM_VECTOR_ISA=scalar|sse2 caps the instruction set, e.g. to compare paths
+			const char* const env = std::getenv("PY3LM_VECTOR_ISA");
+			const std::string_view cap = env ? env : "";
+			if (cap == "scalar") {
+				return kScalar;
+			}
+			if (cap != "sse2" && CpuHasAvx2()) {
+				return GetAvx2VectorKernels();
+			}
+			return kSse;
+#else
+			return kScalar;
+#endif
+		}
+	}
+
+	const VectorKernels& GetVectorKernels() {
+		static const VectorKernels& kernels = SelectVectorKernels();
+		return kernels;
+	}
+
+	namespace {
+		constexpr size_t kVectorSize = sizeof(float) * 3;
+
+		// out=None writes in place for vector results and allocates for per-vector results
+		PyObject* NewOutput(size_t count, size_t itemSize, const char* format) {
+			PyObject* const bytes = PyByteArray_FromStringAndSize(nullptr, static_cast<Py_ssize_t>(count * itemSize));
+			if (!bytes) {
+				return nullptr;
+			}
+			PyObject* const view = PyMemoryView_FromObject(bytes);
+			Py_DECREF(bytes);
+			if (!view) {
+				return nullptr;
+			}
+			PyObject* const cast = PyObject_CallMethod(view, "cast", "s", format);
+			Py_DECREF(view);
+			return cast;
+		}
+
+		bool Vector3Arg(PyObject* object, float (&value)[3]) {
+			auto vector = g_py3lm.Vector3ValueFromObject(object);
+			if (!vector) {
+				return false;
+			}
+			value[0] = vector->x;
+			value[1] = vector->y;
+			value[2] = vector->z;
+			return true;
+		}
+
+		// Parses positional and keyword arguments into slots, names ends with nullptr
+		bool ParseArgs(PyObject* args, PyObject* kwargs, const char* format, const char* const* names, PyObject** slots) {
+			// PyArg_ParseTupleAndKeywords takes char** before 3.13
+			return PyArg_ParseTupleAndKeywords(args, kwargs, format, const_cast<char**>(names), &slots[0], &slots[1], &slots[2], &slots[3]) != 0;
+		}
+
+		// Runs kernel on src into dst, with the GIL released for large batches
+		template<typename Kernel>
+		void RunKernel(size_t count, Kernel&& kernel) {
+			std::optional<GilReleaseScope> gil;
+			if (count >= kReleaseGilCount) {
+				gil.emplace(g_py3lm.GetGilStats());
+			}
+			kernel();
+		}
+
+		// Vector -> vector kernels: transform, normalize, cross
+		template<typename Kernel>
+		PyObject* MapVectors(PyObject* source, PyObject* out, Kernel&& kernel) {
+			const bool inPlace = !out || out == Py_None;
+			BufferArg src;
+			if (!src.Acquire(source, inPlace, BufferFormat::Float32, kVectorSize, "vectors")) {
+				return nullptr;
+			}
+			BufferArg dst;
+			if (!inPlace) {
+				if (!dst.Acquire(out, true, BufferFormat::Float32, kVectorSize, "out")) {
+					return nullptr;
+				}
+				if (dst.Count() != src.Count()) {
+					PyErr_Format(PyExc_ValueError, "out holds %zu vectors, expected %zu", dst.Count(), src.Count());
+					return nullptr;
+				}
+			}
+			float* const dstData = inPlace ? src.Data<float>() : dst.Data<float>();
+			RunKernel(src.Count(), [&] { kernel(src.Data<const float>(), dstData, src.Count()); });
+			return Py_NewRef(inPlace ? source : out);
+		}
+
+		// Vector -> scalar kernels: dot, distance, inside
+		template<typename T, typename Kernel>
+		PyObject* ReduceVectors(PyObject* source, PyObject* out, Kernel&& kernel) {
+			constexpr bool floats = std::is_same_v<T, float>;
+			BufferArg src;
+			if (!src.Acquire(source, false, BufferFormat::Float32, kVectorSize, "vectors")) {
+				return nullptr;
+			}
+			PyObject* result = out && out != Py_None ? Py_NewRef(out) : NewOutput(src.Count(), sizeof(T), floats ? "f" : "B");
+			if (!result) {
+				return nullptr;
+			}
+			BufferArg dst;
+			if (!dst.Acquire(result, true, floats ? BufferFormat::Float32 : BufferFormat::UInt8, sizeof(T), "out")) {
+				Py_DECREF(result);
+				return nullptr;
+			}
+			if (dst.Count() != src.Count()) {
+				PyErr_Format(PyExc_ValueError, "out holds %zu values, expected %zu", dst.Count(), src.Count());
+				Py_DECREF(result);
+				return nullptr;
+			}
+			RunKernel(src.Count(), [&] { kernel(src.Data<const float>(), dst.Data<T>(), src.Count()); });
+			return result;
+		}
+
+		PyObject* VecBatch_transform(PyObject* /*self*/, PyObject* args, PyObject* kwargs) {
+			static const char* const names[] = { "points", "matrix", "w", "out", nullptr };
+			PyObject* slots[4]{};
+			if (!ParseArgs(args, kwargs, "OO|OO:transform", names, slots)) {
+				return nullptr;
+			}
+			auto matrix = g_py3lm.Matrix4x4ValueFromObject(slots[1]);
+			if (!matrix) {
+				return nullptr;
+			}
+			float w = 1.0f;
+			if (slots[2]) {
+				w = static_cast<float>(PyFloat_AsDouble(slots[2]));
+				if (w == -1.0f && PyErr_Occurred()) {
+					return nullptr;
+				}
+			}
+			const float* const m = matrix->data;
+			return MapVectors(slots[0], slots[3], [m, w](const float* src, float* dst, size_t count) {
+				GetVectorKernels().transform(src, dst, count, m, w);
+			});
+		}
+
+		PyObject* VecBatch_normalize(PyObject* /*self*/, PyObject* args, PyObject* kwargs) {
+			static const char* const names[] = { "vectors", "out", nullptr };
+			PyObject* slots[4]{};
+			if (!ParseArgs(args, kwargs, "O|O:normalize", names, slots)) {
+				return nullptr;
+			}
+			return MapVectors(slots[0], slots[1], [](const float* src, float* dst, size_t count) {
+				GetVectorKernels().normalize(src, dst, count);
+			});
+		}
+
+		PyObject* VecBatch_cross(PyObject* /*self*/, PyObject* args, PyObject* kwargs) {
+			static const char* const names[] = { "vectors", "v", "out", nullptr };
+			PyObject* slots[4]{};
+			float v[3];
+			if (!ParseArgs(args, kwargs, "OO|O:cross", names, slots) || !Vector3Arg(slots[1], v)) {
+				return nullptr;
+			}
+			return MapVectors(slots[0], slots[2], [&v](const float* src, float* dst, size_t count) {
+				GetVectorKernels().cross(src, dst, count, v);
+			});
+		}
+
+		PyObject* VecBatch_dot(PyObject* /*self*/, PyObject* args, PyObject* kwargs) {
+			static const char* const names[] = { "vectors", "v", "out", nullptr };
+			PyObject* slots[4]{};
+			float v[3];
+			if (!ParseArgs(args, kwargs, "OO|O:dot", names, slots) || !Vector3Arg(slots[1], v)) {
+				return nullptr;
+			}
+			return ReduceVectors<float>(slots[0], slots[2], [&v](const float* src, float* out, size_t count) {
+				GetVectorKernels().dot(src, out, count, v);
+			});
+		}
+
+		PyObject* VecBatch_distance(PyObject* /*self*/, PyObject* args, PyObject* kwargs) {
+			static const char* const names[] = { "points", "p", "out", nullptr };
+			PyObject* slots[4]{};
+			float p[3];
+			if (!ParseArgs(args, kwargs, "OO|O:distance", names, slots) || !Vector3Arg(slots[1], p)) {
+				return nullptr;
+			}
+			return ReduceVectors<float>(slots[0], slots[2], [&p](const float* src, float* out, size_t count) {
+				GetVectorKernels().distance(src, out, count, p);
+			});
+		}
+
+		PyObject* VecBatch_inside(PyObject* /*self*/, PyObject* args, PyObject* kwargs) {
+			static const char* const names[] = { "points", "min", "max", "out", nullptr };
+			PyObject* slots[4]{};
+			float min[3];
+			float max[3];
+			if (!ParseArgs(args, kwargs, "OOO|O:inside", names, slots) || !Vector3Arg(slots[1], min) || !Vector3Arg(slots[2], max)) {
+				return nullptr;
+			}
+			return ReduceVectors<uint8_t>(slots[0], slots[3], [&min, &max](const float* src, uint8_t* out, size_t count) {
+				GetVectorKernels().inside(src, out, count, min, max);
+			});
+		}
+
+		PyMethodDef s_vecBatchMethods[] = {
+			{ "transform", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(VecBatch_transform)), METH_VARARGS | METH_KEYWORDS, "transform(points, matrix, w=1.0, out=None) - (matrix * (x, y, z, w)).xyz for every vector, w=0 for directions" },
+			{ "normalize", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(VecBatch_normalize)), METH_VARARGS | METH_KEYWORDS, "normalize(vectors, out=None) - scale to unit length, zero vectors stay zero" },
+			{ "cross", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(VecBatch_cross)), METH_VARARGS | METH_KEYWORDS, "cross(vectors, v, out=None) - cross product of every vector with v" },
+			{ "dot", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(VecBatch_dot)), METH_VARARGS | METH_KEYWORDS, "dot(vectors, v, out=None) - float per vector" },
+			{ "distance", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(VecBatch_distance)), METH_VARARGS | METH_KEYWORDS, "distance(points, p, out=None) - float per point" },
+			{ "inside", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(VecBatch_inside)), METH_VARARGS | METH_KEYWORDS, "inside(points, min, max, out=None) - uint8 per point, 1 when inside the box" },
+			{ nullptr, nullptr, 0, nullptr }
+		};
+
+		PyModuleDef s_vecBatchModule = {
+			PyModuleDef_HEAD_INIT,
+			"plugify.vecbatch",
+			"SIMD kernels over packed float32 xyz buffers",
+			-1,
+			s_vecBatchMethods,
+			nullptr,
+			nullptr,
+			nullptr,
+			nullptr
+		};
+	}
+
+	PyObject* CreateVectorBatchModule() {
+		PyObject* const module = PyModule_Create(&s_vecBatchModule);
+		if (!module) {
+			return nullptr;
+		}
+		if (PyModule_AddStringConstant(module, "ISA", GetVectorKernels().isa) != 0) {
+			Py_DECREF(module);
+			return nullptr;
+		}
+		return module;
+	}
+}
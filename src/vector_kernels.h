@@ -0,0 +1,40 @@
+#pragma once
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PY3LM_ARCH_X86 1
+#else
+#define PY3LM_ARCH_X86 0
+#endif
+
+namespace py3lm {
+	// Kernels over packed xyz float triples, dst may alias src
+	struct VectorKernels {
+		const char* isa;
+		// dst = (m * (x, y, z, w)).xyz with row-major m
+		void (*transform)(const float* src, float* dst, size_t count, const float* m, float w);
+		void (*normalize)(const float* src, float* dst, size_t count);
+		void (*cross)(const float* src, float* dst, size_t count, const float* v);
+		void (*dot)(const float* src, float* out, size_t count, const float* v);
+		void (*distance)(const float* src, float* out, size_t count, const float* p);
+		// out[i] = 1 when point is inside [min, max] inclusive
+		void (*inside)(const float* src, uint8_t* out, size_t count, const float* min, const float* max);
+	};
+
+	// Best kernel set for the running CPU, picked on first call
+	const VectorKernels& GetVectorKernels();
+
+#if PY3LM_ARCH_X86
+	// Defined in vector_kernels_avx2.cpp, which is the only file built with AVX2 enabled
+	const VectorKernels& GetAvx2VectorKernels();
+#endif
+
+	// Creates 'plugify.vecbatch' module with the kernels over any contiguous float buffer:
+	//   transform(points, matrix, w=1.0, out=None), normalize(vectors, out=None), cross(vectors, v, out=None)
+	//   dot(vectors, v, out=None), distance(points, p, out=None), inside(points, min, max, out=None)
+	PyObject* CreateVectorBatchModule();
+}
@@ -0,0 +1,15 @@
+#include "vector_kernels_impl.h"
+
+#if PY3LM_ARCH_X86
+namespace py3lm {
+	const VectorKernels& GetAvx2VectorKernels() {
+#if defined(__AVX2__)
+		static constexpr VectorKernels kernels = MakeVectorKernels<Avx2Ops>("avx2");
+#else
+		// File was built without AVX2 enabled
+		static constexpr VectorKernels kernels = MakeVectorKernels<SseOps>("sse2");
+#endif
+		return kernels;
+	}
+}
+#endif
@@ -0,0 +1,233 @@
+#pragma once
+
+// Kernel bodies shared by vector_kernels.cpp and vector_kernels_avx2.cpp.
+// Everything is in an anonymous namespace, so the copies built with different instruction sets never merge at link time
+
+#include "vector_kernels.h"
+#include <cmath>
+
+#if PY3LM_ARCH_X86
+#include <immintrin.h>
+#endif
+
+namespace py3lm {
+	namespace {
+		struct ScalarOps {
+			using V = float;
+			static constexpr size_t kWidth = 1;
+
+			static V Splat(float value) { return value; }
+			static void Load3(const float* p, V& x, V& y, V& z) { x = p[0]; y = p[1]; z = p[2]; }
+			static void Store3(float* p, V x, V y, V z) { p[0] = x; p[1] = y; p[2] = z; }
+			static void Store(float* p, V value) { *p = value; }
+			static V Add(V a, V b) { return a + b; }
+			static V Sub(V a, V b) { return a - b; }
+			static V Mul(V a, V b) { return a * b; }
+			static V Sqrt(V a) { return std::sqrt(a); }
+			static V SafeInverse(V a) { return a > 0.0f ? 1.0f / a : 0.0f; }
+			static void StoreInside(uint8_t* out, V x, V y, V z, const V* min, const V* max) {
+				*out = x >= min[0] && x <= max[0] && y >= min[1] && y <= max[1] && z >= min[2] && z <= max[2];
+			}
+		};
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+		struct SseOps {
+			using V = __m128;
+			static constexpr size_t kWidth = 4;
+
+			static V Splat(float value) { return _mm_set1_ps(value); }
+
+			// x0y0z0x1 y1z1x2y2 z2x3y3z3 -> xxxx yyyy zzzz
+			static void Load3(const float* p, V& x, V& y, V& z) {
+				const V m0 = _mm_loadu_ps(p);
+				const V m1 = _mm_loadu_ps(p + 4);
+				const V m2 = _mm_loadu_ps(p + 8);
+				const V xy = _mm_shuffle_ps(m1, m2, _MM_SHUFFLE(2, 1, 3, 2));
+				const V yz = _mm_shuffle_ps(m0, m1, _MM_SHUFFLE(1, 0, 2, 1));
+				x = _mm_shuffle_ps(m0, xy, _MM_SHUFFLE(2, 0, 3, 0));
+				y = _mm_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+				z = _mm_shuffle_ps(yz, m2, _MM_SHUFFLE(3, 0, 3, 1));
+			}
+
+			static void Store3(float* p, V x, V y, V z) {
+				const V xy = _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0));
+				const V yz = _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 1, 3, 1));
+				const V zx = _mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 1, 2, 0));
+				_mm_storeu_ps(p, _mm_shuffle_ps(xy, zx, _MM_SHUFFLE(2, 0, 2, 0)));
+				_mm_storeu_ps(p + 4, _mm_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0)));
+				_mm_storeu_ps(p + 8, _mm_shuffle_ps(zx, yz, _MM_SHUFFLE(3, 1, 3, 1)));
+			}
+
+			static void Store(float* p, V value) { _mm_storeu_ps(p, value); }
+			static V Add(V a, V b) { return _mm_add_ps(a, b); }
+			static V Sub(V a, V b) { return _mm_sub_ps(a, b); }
+			static V Mul(V a, V b) { return _mm_mul_ps(a, b); }
+			static V Sqrt(V a) { return _mm_sqrt_ps(a); }
+			// 1 / 0 is masked out, so zero-length vectors stay zero
+			static V SafeInverse(V a) { return _mm_and_ps(_mm_cmpgt_ps(a, _mm_setzero_ps()), _mm_div_ps(_mm_set1_ps(1.0f), a)); }
+
+			static void StoreInside(uint8_t* out, V x, V y, V z, const V* min, const V* max) {
+				V mask = _mm_and_ps(_mm_cmpge_ps(x, min[0]), _mm_cmple_ps(x, max[0]));
+				mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(y, min[1]), _mm_cmple_ps(y, max[1])));
+				mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(z, min[2]), _mm_cmple_ps(z, max[2])));
+				const int bits = _mm_movemask_ps(mask);
+				for (size_t i = 0; i < kWidth; ++i) {
+					out[i] = static_cast<uint8_t>((bits >> i) & 1);
+				}
+			}
+		};
+#endif
+
+#if defined(__AVX2__)
+		struct Avx2Ops {
+			using V = __m256;
+			static constexpr size_t kWidth = 8;
+
+			static V Splat(float value) { return _mm256_set1_ps(value); }
+
+			// Same shuffles as SseOps, the upper lane holds vectors 4-7
+			static void Load3(const float* p, V& x, V& y, V& z) {
+				const V m03 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p)), _mm_loadu_ps(p + 12), 1);
+				const V m14 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 4)), _mm_loadu_ps(p + 16), 1);
+				const V m25 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 8)), _mm_loadu_ps(p + 20), 1);
+				const V xy = _mm256_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2));
+				const V yz = _mm256_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1));
+				x = _mm256_shuffle_ps(m03, xy, _MM_SHUFFLE(2, 0, 3, 0));
+				y = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+				z = _mm256_shuffle_ps(yz, m25, _MM_SHUFFLE(3, 0, 3, 1));
+			}
+
+			static void Store3(float* p, V x, V y, V z) {
+				const V xy = _mm256_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0));
+				const V yz = _mm256_shuffle_ps(y, z, _MM_SHUFFLE(3, 1, 3, 1));
+				const V zx = _mm256_shuffle_ps(z, x, _MM_SHUFFLE(3, 1, 2, 0));
+				const V r03 = _mm256_shuffle_ps(xy, zx, _MM_SHUFFLE(2, 0, 2, 0));
+				const V r14 = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+				const V r25 = _mm256_shuffle_ps(zx, yz, _MM_SHUFFLE(3, 1, 3, 1));
+				_mm_storeu_ps(p, _mm256_castps256_ps128(r03));
+				_mm_storeu_ps(p + 4, _mm256_castps256_ps128(r14));
+				_mm_storeu_ps(p + 8, _mm256_castps256_ps128(r25));
+				_mm_storeu_ps(p + 12, _mm256_extractf128_ps(r03, 1));
+				_mm_storeu_ps(p + 16, _mm256_extractf128_ps(r14, 1));
+				_mm_storeu_ps(p + 20, _mm256_extractf128_ps(r25, 1));
+			}
+
+			static void Store(float* p, V value) { _mm256_storeu_ps(p, value); }
+			static V Add(V a, V b) { return _mm256_add_ps(a, b); }
+			static V Sub(V a, V b) { return _mm256_sub_ps(a, b); }
+			static V Mul(V a, V b) { return _mm256_mul_ps(a, b); }
+			static V Sqrt(V a) { return _mm256_sqrt_ps(a); }
+			static V SafeInverse(V a) { return _mm256_and_ps(_mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GT_OQ), _mm256_div_ps(_mm256_set1_ps(1.0f), a)); }
+
+			static void StoreInside(uint8_t* out, V x, V y, V z, const V* min, const V* max) {
+				V mask = _mm256_and_ps(_mm256_cmp_ps(x, min[0], _CMP_GE_OQ), _mm256_cmp_ps(x, max[0], _CMP_LE_OQ));
+				mask = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(y, min[1], _CMP_GE_OQ), _mm256_cmp_ps(y, max[1], _CMP_LE_OQ)));
+				mask = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(z, min[2], _CMP_GE_OQ), _mm256_cmp_ps(z, max[2], _CMP_LE_OQ)));
+				const int bits = _mm256_movemask_ps(mask);
+				for (size_t i = 0; i < kWidth; ++i) {
+					out[i] = static_cast<uint8_t>((bits >> i) & 1);
+				}
+			}
+		};
+#endif
+
+		// Full blocks go through Ops, the remainder through ScalarOps
+		template<typename Ops, typename Block>
+		void ForEachBlock(size_t count, Block&& block) {
+			size_t i = 0;
+			for (; i + Ops::kWidth <= count; i += Ops::kWidth) {
+				block(Ops{}, i);
+			}
+			for (; i < count; ++i) {
+				block(ScalarOps{}, i);
+			}
+		}
+
+		template<typename Ops>
+		void TransformKernel(const float* src, float* dst, size_t count, const float* m, float w) {
+			ForEachBlock<Ops>(count, [&](auto ops, size_t i) {
+				using O = decltype(ops);
+				typename O::V x, y, z;
+				O::Load3(src + i * 3, x, y, z);
+				typename O::V r[3];
+				for (size_t row = 0; row < 3; ++row) {
+					const float* const e = m + row * 4;
+					r[row] = O::Add(O::Add(O::Mul(x, O::Splat(e[0])), O::Mul(y, O::Splat(e[1]))), O::Add(O::Mul(z, O::Splat(e[2])), O::Splat(e[3] * w)));
+				}
+				O::Store3(dst + i * 3, r[0], r[1], r[2]);
+			});
+		}
+
+		template<typename Ops>
+		void NormalizeKernel(const float* src, float* dst, size_t count) {
+			ForEachBlock<Ops>(count, [&](auto ops, size_t i) {
+				using O = decltype(ops);
+				typename O::V x, y, z;
+				O::Load3(src + i * 3, x, y, z);
+				const auto inverse = O::SafeInverse(O::Sqrt(O::Add(O::Add(O::Mul(x, x), O::Mul(y, y)), O::Mul(z, z))));
+				O::Store3(dst + i * 3, O::Mul(x, inverse), O::Mul(y, inverse), O::Mul(z, inverse));
+			});
+		}
+
+		template<typename Ops>
+		void CrossKernel(const float* src, float* dst, size_t count, const float* v) {
+			ForEachBlock<Ops>(count, [&](auto ops, size_t i) {
+				using O = decltype(ops);
+				typename O::V x, y, z;
+				O::Load3(src + i * 3, x, y, z);
+				const auto vx = O::Splat(v[0]);
+				const auto vy = O::Splat(v[1]);
+				const auto vz = O::Splat(v[2]);
+				O::Store3(dst + i * 3, O::Sub(O::Mul(y, vz), O::Mul(z, vy)), O::Sub(O::Mul(z, vx), O::Mul(x, vz)), O::Sub(O::Mul(x, vy), O::Mul(y, vx)));
+			});
+		}
+
+		template<typename Ops>
+		void DotKernel(const float* src, float* out, size_t count, const float* v) {
+			ForEachBlock<Ops>(count, [&](auto ops, size_t i) {
+				using O = decltype(ops);
+				typename O::V x, y, z;
+				O::Load3(src + i * 3, x, y, z);
+				O::Store(out + i, O::Add(O::Add(O::Mul(x, O::Splat(v[0])), O::Mul(y, O::Splat(v[1]))), O::Mul(z, O::Splat(v[2]))));
+			});
+		}
+
+		template<typename Ops>
+		void DistanceKernel(const float* src, float* out, size_t count, const float* p) {
+			ForEachBlock<Ops>(count, [&](auto ops, size_t i) {
+				using O = decltype(ops);
+				typename O::V x, y, z;
+				O::Load3(src + i * 3, x, y, z);
+				const auto dx = O::Sub(x, O::Splat(p[0]));
+				const auto dy = O::Sub(y, O::Splat(p[1]));
+				const auto dz = O::Sub(z, O::Splat(p[2]));
+				O::Store(out + i, O::Sqrt(O::Add(O::Add(O::Mul(dx, dx), O::Mul(dy, dy)), O::Mul(dz, dz))));
+			});
+		}
+
+		template<typename Ops>
+		void InsideKernel(const float* src, uint8_t* out, size_t count, const float* min, const float* max) {
+			ForEachBlock<Ops>(count, [&](auto ops, size_t i) {
+				using O = decltype(ops);
+				typename O::V x, y, z;
+				O::Load3(src + i * 3, x, y, z);
+				const typename O::V low[3] = { O::Splat(min[0]), O::Splat(min[1]), O::Splat(min[2]) };
+				const typename O::V high[3] = { O::Splat(max[0]), O::Splat(max[1]), O::Splat(max[2]) };
+				O::StoreInside(out + i, x, y, z, low, high);
+			});
+		}
+
+		template<typename Ops>
+		constexpr VectorKernels MakeVectorKernels(const char* isa) {
+			return {
+				isa,
+				&TransformKernel<Ops>,
+				&NormalizeKernel<Ops>,
+				&CrossKernel<Ops>,
+				&DotKernel<Ops>,
+				&DistanceKernel<Ops>,
+				&InsideKernel<Ops>
+			};
+		}
+	}
+}
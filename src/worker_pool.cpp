@@ -0,0 +1,71 @@
+#include "worker_pool.h"
+#include <algorithm>
+
+namespace py3lm {
+	WorkerPool::WorkerPool(size_t threadCount) : _threadCount{threadCount} {
+	}
+
+	WorkerPool::~WorkerPool() {
+		Stop();
+	}
+
+	size_t WorkerPool::DefaultThreadCount() {
+		return std::clamp<size_t>(std::thread::hardware_concurrency(), 2, 8);
+	}
+
+	void WorkerPool::Submit(Job job) {
+		{
+			std::lock_guard lock(_mutex);
+			_jobs.emplace_back(std::move(job));
+			// Stop owns the thread list while joining, jobs queued meanwhile run there
+			if (!_stopping && _threads.size() < _threadCount && _idle < _jobs.size()) {
+				_threads.emplace_back(&WorkerPool::Run, this);
+			}
+		}
+		_condition.notify_one();
+	}
+
+	void WorkerPool::Stop() {
+		std::vector<std::thread> threads;
+		{
+			std::lock_guard lock(_mutex);
+			_stopping = true;
+			threads.swap(_threads);
+		}
+		_condition.notify_all();
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		for (;;) {
+			Job job;
+			{
+				std::lock_guard lock(_mutex);
+				if (_jobs.empty()) {
+					_stopping = false;
+					return;
+				}
+				job = std::move(_jobs.front());
+				_jobs.pop_front();
+			}
+			job();
+		}
+	}
+
+	void WorkerPool::Run() {
+		for (;;) {
+			Job job;
+			{
+				std::unique_lock lock(_mutex);
+				++_idle;
+				_condition.wait(lock, [this] { return _stopping || !_jobs.empty(); });
+				--_idle;
+				if (_jobs.empty()) {
+					return;
+				}
+				job = std::move(_jobs.front());
+				_jobs.pop_front();
+			}
+			job();
+		}
+	}
+}
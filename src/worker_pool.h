@@ -0,0 +1,40 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace py3lm {
+	// Native threads for blocking calls, started on first use
+	class WorkerPool {
+	public:
+		using Job = std::function<void()>;
+
+		explicit WorkerPool(size_t threadCount);
+		~WorkerPool();
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		// Hardware concurrency clamped to [2, 8]
+		static size_t DefaultThreadCount();
+
+		void Submit(Job job);
+		// Runs jobs still in queue, then joins threads. Jobs submitted meanwhile run on the calling thread.
+		// Must not be called with the GIL held
+		void Stop();
+
+	private:
+		void Run();
+
+		std::mutex _mutex;
+		std::condition_variable _condition;
+		std::deque<Job> _jobs;
+		std::vector<std::thread> _threads;
+		size_t _threadCount;
+		size_t _idle = 0;
+		bool _stopping = false;
+	};
+}
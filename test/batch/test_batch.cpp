@@ -0,0 +1,129 @@
+// Column lease of plugify.batch: the release callback runs exactly once, right after the handlers when
+// nothing escaped, after the last escaped view otherwise, and also for batches that never reach a handler.
+// Usage: py3lm-test-batch  (PYTHONHOME must point to the stdlib)
+
+#include <batch.h>
+#include <cstdio>
+#include <vector>
+
+namespace {
+	int s_failures = 0;
+
+	void Check(bool condition, const char* what) {
+		if (!condition) {
+			std::fprintf(stderr, "FAIL: %s\n", what);
+			++s_failures;
+		}
+	}
+
+	struct Published {
+		int released = 0;
+		std::vector<uint32_t> committed;
+	};
+
+	void OnCommit(void* user, const uint32_t* columns, size_t count) {
+		auto& published = *static_cast<Published*>(user);
+		published.committed.assign(columns, columns + count);
+	}
+
+	void OnRelease(void* user) {
+		++static_cast<Published*>(user)->released;
+	}
+
+	bool Run(PyObject* globals, const char* code) {
+		PyObject* const result = PyRun_String(code, Py_file_input, globals, globals);
+		if (!result) {
+			PyErr_Print();
+			return false;
+		}
+		Py_DECREF(result);
+		return true;
+	}
+
+	constexpr const char* kHandlers =
+		"kept = []\n"
+		"def read(b):\n"
+		"    ids = b['id']\n"
+		"    pos = b['position']\n"
+		"    assert b.rows == 3 and ids.tolist() == [1, 2, 3]\n"
+		"    assert pos.shape == (3, 3) and pos[2, 0] == 6.0\n"
+		"    assert b.string('tag', 1) == 'bb'\n"
+		"    ids[0] = 10\n"
+		"    b.commit()\n"
+		"def keep(b):\n"
+		"    kept.append(b['id'][1:])\n"
+		"    kept.append(b)\n"
+		"def fail(b):\n"
+		"    raise ValueError('expected')\n";
+}
+
+int main() {
+	Py_Initialize();
+	PyObject* const module = py3lm::CreateBatchModule();
+	if (!module) {
+		PyErr_Print();
+		return 1;
+	}
+	PyObject* const globals = PyDict_New();
+	PyDict_SetItemString(globals, "__builtins__", PyEval_GetBuiltins());
+	PyDict_SetItemString(globals, "batch", module);
+	if (!Run(globals, kHandlers)) {
+		return 1;
+	}
+
+	int32_t ids[] = { 1, 2, 3 };
+	float positions[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8 };
+	uint32_t offsets[] = { 0, 1, 3, 6 };
+	const char text[] = "abbccc";
+	const Py3lmBatchColumn columns[] = {
+		{ "id", kPy3lmColumnInt32, 1, ids, nullptr },
+		{ "position", kPy3lmColumnVector3, 0, positions, nullptr },
+		{ "tag", kPy3lmColumnString, 0, offsets, text },
+	};
+
+	{
+		Published published;
+		Check(py3lm::DispatchBatch("none", columns, 3, 3, OnCommit, OnRelease, &published) == 0, "no handlers");
+		Check(published.released == 1, "release without handlers");
+	}
+	{
+		Published published;
+		const Py3lmBatchColumn malformed[] = { { "id", kPy3lmColumnString, 0, ids, nullptr } };
+		Run(globals, "batch.subscribe('bad', read)\n");
+		Check(py3lm::DispatchBatch("bad", malformed, 1, 3, OnCommit, OnRelease, &published) == 0, "malformed column");
+		Check(published.released == 1, "release of malformed batch");
+	}
+	{
+		Published published;
+		Run(globals, "batch.subscribe('read', read)\nbatch.subscribe('read', fail)\n");
+		Check(py3lm::DispatchBatch("read", columns, 3, 3, OnCommit, OnRelease, &published) == 2, "handlers called");
+		Check(published.released == 1, "release right after handlers");
+		Check(ids[0] == 10, "write through view");
+		Check(published.committed == std::vector<uint32_t>{ 0 }, "commit of writable columns");
+	}
+	{
+		Published published;
+		Run(globals, "batch.subscribe('keep', keep)\n");
+		Check(py3lm::DispatchBatch("keep", columns, 3, 3, OnCommit, OnRelease, &published) == 1, "keeping handler called");
+		Check(published.released == 0, "release deferred while a view escaped");
+		Check(Run(globals,
+			"assert kept[0].tolist() == [2, 3]\n"
+			"try:\n"
+			"    kept[1]['id']\n"
+			"    raise AssertionError('lookup after handler')\n"
+			"except RuntimeError:\n"
+			"    pass\n"), "escaped view stays readable, batch does not");
+		Check(published.released == 0, "release deferred until the view is dropped");
+		Run(globals, "kept.clear()\n");
+		Check(published.released == 1, "release once the last view is dropped");
+	}
+
+	py3lm::ClearBatchHandlers();
+	Py_DECREF(globals);
+	Py_DECREF(module);
+	if (Py_FinalizeEx() < 0) {
+		return 1;
+	}
+	std::printf("%s\n", s_failures ? "FAILED" : "OK");
+	return s_failures ? 1 : 0;
+}
@@ -1,10 +1,21 @@
+import os
 import sys
 from plugify.plugin import Plugin, Vector2, Vector3, Vector4, Matrix4x4
 from plugify import pps
 
 
 class CrossCallWorker(Plugin):
-    pass
+    def plugin_start(self):
+        iterations = os.environ.get('PY3LM_STRESS_ITERATIONS')
+        if iterations:
+            from . import stress
+            tests = os.environ.get('PY3LM_STRESS_TESTS')
+            stress.run(int(iterations), tests.split(',') if tests else None)
+        suites = os.environ.get('PY3LM_UNIT_TESTS')
+        if suites:
+            import unittest
+            for folder in suites.split(','):
+                unittest.TextTestRunner().run(unittest.defaultTestLoader.discover(folder))
 
 
 def no_param_return_void():
@@ -0,0 +1,76 @@
+"""Reference leak stress run over every cross_call_worker signature.
+
+Each reverse test calls into cross_call_master and back, so both conversion
+directions are exercised. After a warm-up, RSS, the number of GC tracked
+objects and allocated blocks are sampled per batch and must stay flat.
+Enabled with PY3LM_STRESS_ITERATIONS=<calls per signature> when the plugin starts.
+"""
+import gc
+import os
+import sys
+import time
+
+from plugify import refaudit
+
+WARMUP_CALLS = 1000
+BATCHES = 10
+# Allowed growth of any batch sample over the one taken before the first batch
+MAX_BLOCKS_GROWTH = 64
+MAX_OBJECTS_GROWTH = 64
+MAX_RSS_GROWTH = 1 << 20
+
+
+def _rss():
+    try:
+        with open('/proc/self/statm') as statm:
+            return int(statm.read().split()[1]) * os.sysconf('SC_PAGE_SIZE')
+    except (OSError, ValueError):
+        return 0
+
+
+def _sample():
+    gc.collect()
+    return sys.getallocatedblocks(), len(gc.get_objects()), _rss()
+
+
+def run_one(name, test, iterations):
+    for _ in range(WARMUP_CALLS):
+        test()
+    batch = max(iterations // BATCHES, 1)
+    first = _sample()
+    peak = (0, 0, 0)
+    for _ in range(BATCHES):
+        for _ in range(batch):
+            test()
+        growth = tuple(b - a for a, b in zip(first, _sample()))
+        peak = tuple(max(p, g) for p, g in zip(peak, growth))
+    blocks, objects, rss = peak
+    ok = blocks <= MAX_BLOCKS_GROWTH and objects <= MAX_OBJECTS_GROWTH and rss <= MAX_RSS_GROWTH
+    return ok, f'{name}: {batch * BATCHES} calls, peak growth blocks {blocks:+}, objects {objects:+}, rss {rss:+} B'
+
+
+def run(iterations, tests=None):
+    from .cross_call_worker import reverse_test
+
+    refaudit.reset()
+    refaudit.enable()
+    failed = []
+    start = time.perf_counter()
+    try:
+        for name, test in reverse_test.items():
+            if tests and name not in tests:
+                continue
+            ok, line = run_one(name, test, iterations)
+            print(('ok   ' if ok else 'FAIL ') + line)
+            if not ok:
+                failed.append(name)
+    finally:
+        refaudit.disable()
+
+    for path, (calls, created, released, leaking) in sorted(refaudit.stats().items()):
+        if leaking:
+            print(f'FAIL {path}: {calls} calls, {created} created, {released} released')
+            failed.append(path)
+
+    print(f'stress: {len(failed)} failure(s) in {time.perf_counter() - start:.1f}s')
+    return failed
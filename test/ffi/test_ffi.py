@@ -0,0 +1,79 @@
+"""Tests of plugify.ffi. It is a native module, so they run inside the language module:
+start cross_call_worker with PY3LM_UNIT_TESTS=test/ffi"""
+import ctypes
+import unittest
+
+from plugify import ffi
+
+
+def _add(a, b):
+    return a + b
+
+
+def _scale(a, b):
+    return a * b
+
+
+def _increment(text, value):
+    value[0] += 1
+    return True
+
+
+# Targets are ctypes callbacks, strings are passed by pointer and not read
+_add_func = ctypes.CFUNCTYPE(ctypes.c_int64, ctypes.c_int64, ctypes.c_int64)(_add)
+_scale_func = ctypes.CFUNCTYPE(ctypes.c_double, ctypes.c_float, ctypes.c_double)(_scale)
+_increment_func = ctypes.CFUNCTYPE(ctypes.c_bool, ctypes.c_void_p, ctypes.POINTER(ctypes.c_int32))(_increment)
+
+
+def _address(function):
+    return ctypes.cast(function, ctypes.c_void_p).value
+
+
+class FfiTest(unittest.TestCase):
+    def test_scalar_call(self):
+        for release_gil in (True, False):
+            with self.subTest(release_gil=release_gil):
+                add = ffi.function(_address(_add_func), 'int64(int64, int64)', release_gil=release_gil)
+                self.assertEqual(add(40, 2), 42)
+                self.assertEqual(add(-(2 ** 40), 1), 1 - 2 ** 40)
+        scale = ffi.function(_address(_scale_func), 'double(float, double)')
+        self.assertEqual(scale(0.5, 3.0), 1.5)
+
+    def test_reference_parameter(self):
+        parse = ffi.function(_address(_increment_func), 'bool(string, int32&)', release_gil=False)
+        self.assertEqual(parse('42'), (True, 1))  # trailing reference parameter left out starts at 0
+        self.assertEqual(parse('42', 41), (True, 42))
+
+    def test_argument_count(self):
+        parse = ffi.function(_address(_increment_func), 'bool(string, int32&)')
+        with self.assertRaisesRegex(TypeError, "1 to 2 required"):
+            parse()
+        with self.assertRaises(TypeError):
+            parse('42', 1, 2)
+        with self.assertRaises(TypeError):
+            parse(text='42')
+        add = ffi.function(_address(_add_func), 'int64(int64, int64)')
+        with self.assertRaisesRegex(TypeError, "2 required"):
+            add(1)
+
+    def test_signature_spellings(self):
+        address = _address(_add_func)
+        function = ffi.function(address, ' void ( int32* , string[] ) ')
+        self.assertEqual(function.signature, 'void(int32*,string[])')
+        self.assertEqual(function.address, address)
+        self.assertIn('void(int32*,string[])', repr(function))
+
+    def test_invalid_signature(self):
+        address = _address(_add_func)
+        for text in ('int32', 'nope()', 'void(void)', 'void(int32,)', 'void(int32&&)'):
+            with self.subTest(signature=text):
+                with self.assertRaises(ValueError):
+                    ffi.function(address, text)
+
+    def test_null_address(self):
+        with self.assertRaisesRegex(ValueError, "null"):
+            ffi.function(0, 'void()')
+
+
+if __name__ == "__main__":
+    unittest.main()
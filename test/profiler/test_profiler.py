@@ -0,0 +1,130 @@
+"""Tests of plugify.profiler, run with: python3 -m unittest discover -s test/profiler"""
+import cProfile
+import os
+import pstats
+import sys
+import tempfile
+import types
+import unittest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), "..", "..", "lib"))
+
+from plugify import profiler  # noqa: E402
+
+PLUGIN_SOURCE = """
+def leaf(n):
+    return n + 1
+
+def outer(n):
+    total = 0
+    for i in range(n):
+        total += leaf(i)
+    return total
+
+def fail():
+    raise ValueError("expected")
+
+def catches():
+    try:
+        fail()
+    except ValueError:
+        pass
+    return leaf(0)
+
+def gen(n):
+    for i in range(n):
+        yield leaf(i)
+"""
+
+
+def _load(name):
+    module = types.ModuleType(name)
+    exec(compile(PLUGIN_SOURCE, f"<{name}>", "exec"), module.__dict__)
+    sys.modules[name] = module
+    return module
+
+
+def _calls(prof, name):
+    prof.create_stats()
+    for (_, _, qualname), (cc, nc, tt, ct, callers) in prof.stats.items():
+        if qualname == name:
+            return cc, nc, callers
+    return 0, 0, {}
+
+
+class ProfilerTest(unittest.TestCase):
+    def setUp(self):
+        self.plugin = _load("profiled_plugin")
+        self.other = _load("other_plugin")
+
+    def tearDown(self):
+        profiler.disable()
+        sys.modules.pop("profiled_plugin", None)
+        sys.modules.pop("other_plugin", None)
+
+    def test_counts_only_selected_package(self):
+        prof = profiler.enable("profiled_plugin")
+        self.plugin.outer(5)
+        self.other.outer(5)
+        profiler.disable()
+        self.assertEqual(_calls(prof, "outer")[:2], (1, 1))
+        cc, nc, callers = _calls(prof, "leaf")
+        self.assertEqual((cc, nc), (5, 5))
+        self.assertEqual([label[2] for label in callers], ["outer"])
+        self.assertTrue(all(filename == "<profiled_plugin>" for filename, _, _ in prof.stats))
+
+    def test_exception_unwinds_frame(self):
+        prof = profiler.enable("profiled_plugin")
+        self.plugin.catches()
+        profiler.disable()
+        self.assertEqual(_calls(prof, "fail")[:2], (1, 1))
+        _, _, callers = _calls(prof, "leaf")
+        self.assertEqual([label[2] for label in callers], ["catches"])
+
+    def test_generator_counts_one_call(self):
+        prof = profiler.enable("profiled_plugin")
+        self.assertEqual(sum(self.plugin.gen(3)), 6)
+        profiler.disable()
+        self.assertEqual(_calls(prof, "gen")[:2], (1, 1))
+        self.assertEqual(_calls(prof, "leaf")[:2], (3, 3))
+
+    def test_runs_next_to_cprofile(self):
+        other = cProfile.Profile()
+        other.enable()
+        try:
+            prof = profiler.enable("profiled_plugin")
+            self.plugin.outer(2)
+            profiler.disable()
+        finally:
+            other.disable()
+        self.assertEqual(_calls(prof, "outer")[:2], (1, 1))
+
+    def test_taken_tool_id_is_reported(self):
+        tool_id = sys.monitoring.PROFILER_ID
+        sys.monitoring.use_tool_id(tool_id, "test holder")
+        try:
+            with self.assertRaisesRegex(RuntimeError, "test holder"):
+                profiler.enable("profiled_plugin", tool_id=tool_id)
+            self.assertIsNone(profiler.current())
+        finally:
+            sys.monitoring.free_tool_id(tool_id)
+
+    def test_dump_stats_reads_with_pstats(self):
+        prof = profiler.enable("profiled_plugin")
+        self.plugin.outer(3)
+        profiler.disable()
+        with tempfile.TemporaryDirectory() as folder:
+            path = os.path.join(folder, "plugin.prof")
+            prof.dump_stats(path)
+            stats = pstats.Stats(path)
+        self.assertEqual(stats.total_calls, 4)
+
+    def test_line_hits(self):
+        prof = profiler.enable("profiled_plugin", lines=True)
+        self.plugin.leaf(1)
+        profiler.disable()
+        self.assertEqual(prof.line_stats(), {("<profiled_plugin>", 3): 1})
+
+
+if __name__ == "__main__":
+    unittest.main()
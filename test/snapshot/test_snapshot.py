@@ -0,0 +1,156 @@
+"""Tests of plugify.snapshot. It is a native module, so they run inside the language module:
+start cross_call_worker with PY3LM_UNIT_TESTS=test/snapshot"""
+import os
+import struct
+import tempfile
+import unittest
+
+from plugify import snapshot
+from plugify.plugin import Vector2, Vector3, Vector4, Matrix4x4
+
+HEADER = struct.Struct("<IIQ")
+ROOT = HEADER.size
+
+STATE = {
+    "none": None,
+    "flags": (False, True),
+    "int": -(2 ** 63),
+    "big": [2 ** 100, -(2 ** 80)],
+    "float": 0.25,
+    "text": "café",
+    "bytes": b"\x00\xff",
+    "nested": {1: {"deep": [1, 2, 3]}, (1, "a"): "tuple key", b"k": "bytes key"},
+    "empty": ([], (), {}),
+}
+
+
+class SnapshotTest(unittest.TestCase):
+    def setUp(self):
+        self.folder = tempfile.TemporaryDirectory()
+        self.path = os.path.join(self.folder.name, "state.bin")
+
+    def tearDown(self):
+        self.folder.cleanup()
+
+    def roundtrip(self, value):
+        snapshot.save(self.path, value)
+        return snapshot.load(self.path)
+
+    def patch(self, offset, data):
+        with open(self.path, "r+b") as file:
+            file.seek(offset)
+            file.write(data)
+
+    def test_every_tag_round_trips(self):
+        view = self.roundtrip(STATE)
+        self.assertIsInstance(view, snapshot.SnapshotView)
+        self.assertEqual(view.decode(), STATE)
+        self.assertEqual(view["big"][0], 2 ** 100)
+        self.assertEqual(view["nested"][(1, "a")], "tuple key")
+        self.assertIsInstance(view["flags"].decode(), tuple)
+
+    def test_math_types_round_trip(self):
+        matrix = Matrix4x4([float(i) for i in range(16)])
+        view = self.roundtrip([Vector2(1, 2), Vector3(1, 2, 3), Vector4(1, 2, 3, 4), matrix])
+        v2, v3, v4, m = view.decode()
+        self.assertEqual((v2.x, v2.y), (1, 2))
+        self.assertEqual((v3.x, v3.y, v3.z), (1, 2, 3))
+        self.assertEqual((v4.x, v4.y, v4.z, v4.w), (1, 2, 3, 4))
+        self.assertEqual(m.elements, matrix.elements)
+
+    def test_views_decode_lazily(self):
+        view = self.roundtrip(STATE)
+        nested = view["nested"]
+        self.assertIsInstance(nested, snapshot.SnapshotView)
+        self.assertIsInstance(nested[1], snapshot.SnapshotView)
+        self.assertEqual(nested[1]["deep"][-1], 3)
+        self.assertEqual(len(view), len(STATE))
+        self.assertEqual(view.keys(), list(STATE))
+        self.assertEqual(list(view), list(STATE))
+        self.assertIn("text", view)
+        self.assertNotIn("missing", view)
+        self.assertNotIn(b"text", view)
+        self.assertIsNone(view.get("missing"))
+        self.assertEqual(view.get("missing", 7), 7)
+        with self.assertRaises(KeyError):
+            view["missing"]
+        with self.assertRaises(IndexError):
+            view["big"][2]
+
+    def test_large_dict_lookup(self):
+        state = {f"key{i}": i for i in range(20000)}
+        state.update({i: -i for i in range(20000)})
+        view = self.roundtrip(state)
+        for key in ("key0", "key19999", 0, 12345, 19999):
+            self.assertEqual(view[key], state[key])
+        self.assertNotIn("key20000", view)
+        self.assertNotIn(20000, view)
+        self.assertEqual(view.keys()[:3], ["key0", "key1", "key2"])
+
+    def test_view_outlives_file(self):
+        view = self.roundtrip({"list": [1, 2]})
+        items = view["list"]
+        del view
+        os.remove(self.path)
+        self.assertEqual(items.decode(), [1, 2])
+
+    def test_unsupported_type(self):
+        with self.assertRaises(TypeError):
+            snapshot.save(self.path, {"set": {1}})
+        self.assertFalse(os.path.exists(self.path))
+
+    def test_missing_and_empty_file(self):
+        with self.assertRaises(FileNotFoundError):
+            snapshot.load(self.path)
+        open(self.path, "wb").close()
+        with self.assertRaisesRegex(ValueError, "empty file"):
+            snapshot.load(self.path)
+
+    def test_corrupted_header(self):
+        snapshot.save(self.path, [1])
+        with open(self.path, "rb") as file:
+            data = file.read()
+        magic, version, size = HEADER.unpack_from(data)
+        self.assertEqual(version, snapshot.VERSION)
+        cases = (
+            (HEADER.pack(0, version, size) + data[ROOT:], "Not a snapshot"),
+            (HEADER.pack(magic, version + 1, size) + data[ROOT:], "Unsupported snapshot version"),
+            (HEADER.pack(magic, version, size + 1) + data[ROOT:], "truncated or oversized"),
+            (data[:ROOT - 1], "truncated header"),
+        )
+        for content, message in cases:
+            with self.subTest(message=message):
+                with open(self.path, "wb") as file:
+                    file.write(content)
+                with self.assertRaisesRegex(ValueError, message):
+                    snapshot.load(self.path)
+
+    def test_corrupted_payload(self):
+        snapshot.save(self.path, ["text"])
+        self.patch(ROOT, b"\xee")
+        with self.assertRaisesRegex(ValueError, "unknown tag"):
+            snapshot.load(self.path)
+
+        snapshot.save(self.path, ["text"])
+        # Blob size of the string past the end of the file
+        self.patch(ROOT + 1 + 4 + 4 + 1, struct.pack("<I", 1000))
+        view = snapshot.load(self.path)
+        with self.assertRaisesRegex(ValueError, "blob out of bounds"):
+            view[0]
+
+        snapshot.save(self.path, [1, 2])
+        self.patch(ROOT + 1, struct.pack("<I", 1000))
+        with self.assertRaisesRegex(ValueError, "container out of bounds"):
+            snapshot.load(self.path)
+
+    def test_corrupted_dict_index(self):
+        snapshot.save(self.path, {"a": 1})
+        # Hash index follows the single 12 byte entry
+        self.patch(ROOT + 1 + 4 + 12, struct.pack("<I", 5))
+        view = snapshot.load(self.path)
+        with self.assertRaisesRegex(ValueError, "bad dict index"):
+            view["a"]
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,179 @@
+// Timer wheel in simulated time: 300k timers over every level and beyond the wheel range, a third cancelled,
+// including timers already moved to the expired list. Every timer must fire exactly once, never early and
+// not later than the tick it was advanced past. Then plugify.timers cancels a timer due in the same batch.
+// Usage: py3lm-test-timers  (PYTHONHOME must point to the stdlib)
+
+#include <timer_wheel.h>
+#include <timers.h>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+	int s_failures = 0;
+
+	void Check(bool condition, const char* what) {
+		if (!condition) {
+			std::fprintf(stderr, "FAIL: %s\n", what);
+			++s_failures;
+		}
+	}
+
+	struct SimTimer {
+		py3lm::TimerNode node; // first member, nodes are cast back
+		uint64_t expiry = 0;
+		int fired = 0;
+		bool cancelled = false;
+	};
+
+	void SimulateWheel() {
+		constexpr size_t kTimers = 300000;
+		// Starts just below a top level boundary so beyond-range timers come into range within the run
+		constexpr uint64_t kStart = (uint64_t{ 1 } << 32) - (uint64_t{ 1 } << 22);
+		constexpr uint64_t kEnd = kStart + (uint64_t{ 1 } << 25) + (uint64_t{ 1 } << 22);
+		// Delay ranges of level 0, 1, 2, 3 or past the boundary, and beyond the whole run
+		constexpr uint64_t kRanges[][2] = {
+			{ 1, 1 << 8 },
+			{ 1 << 8, 1 << 16 },
+			{ 1 << 16, 1 << 24 },
+			{ 1 << 24, (uint64_t{ 1 } << 25) + (uint64_t{ 1 } << 22) },
+			{ uint64_t{ 1 } << 33, uint64_t{ 1 } << 34 },
+		};
+
+		std::mt19937_64 random(88);
+		py3lm::TimerWheel wheel;
+		py3lm::TimerList expired;
+		wheel.Advance(kStart, expired); // empty wheel jumps
+		Check(wheel.Now() == kStart, "empty wheel jumps to the target tick");
+
+		std::vector<SimTimer> timers(kTimers);
+		for (size_t i = 0; i < kTimers; ++i) {
+			const auto& range = kRanges[i % std::size(kRanges)];
+			timers[i].expiry = kStart + std::uniform_int_distribution<uint64_t>(range[0], range[1] - 1)(random);
+			wheel.Schedule(&timers[i].node, timers[i].expiry);
+		}
+		Check(wheel.Size() == kTimers, "all timers counted");
+
+		size_t cancelled = 0;
+		const auto cancel = [&](SimTimer& timer) {
+			if (!timer.cancelled && !timer.fired && timer.node.IsLinked()) {
+				wheel.Cancel(&timer.node);
+				timer.cancelled = true;
+				++cancelled;
+			}
+		};
+		for (size_t i = 0; i < kTimers; i += 6) {
+			cancel(timers[i]);
+		}
+
+		uint64_t now = kStart;
+		bool early = false;
+		bool late = false;
+		while (now < kEnd) {
+			const uint64_t to = std::min(kEnd, now + std::uniform_int_distribution<uint64_t>(1, 4096)(random));
+			for (int i = 0; i < 8; ++i) {
+				cancel(timers[std::uniform_int_distribution<size_t>(0, kTimers - 1)(random)]);
+			}
+			wheel.Advance(to, expired);
+			// Cancel while waiting in the expired list, like a callback cancelling a timer of the same batch
+			if (!expired.IsEmpty()) {
+				cancel(*reinterpret_cast<SimTimer*>(expired.head.prev));
+			}
+			while (!expired.IsEmpty()) {
+				auto& timer = *reinterpret_cast<SimTimer*>(expired.PopFront());
+				wheel.Taken();
+				early |= timer.expiry <= now;
+				late |= timer.expiry > to;
+				++timer.fired;
+			}
+			now = to;
+		}
+		Check(!early, "no timer fires before its expiry");
+		Check(!late, "no timer fires after the tick it was advanced past");
+		Check(cancelled * 3 >= kTimers, "a third of the timers cancelled");
+
+		size_t pending = 0;
+		bool missed = false;
+		bool twice = false;
+		bool cancelledFired = false;
+		for (const auto& timer : timers) {
+			twice |= timer.fired > 1;
+			cancelledFired |= timer.cancelled && timer.fired;
+			if (!timer.cancelled && timer.expiry <= kEnd) {
+				missed |= timer.fired != 1;
+			}
+			if (timer.node.IsLinked()) {
+				++pending;
+				missed |= timer.expiry <= kEnd;
+			}
+		}
+		Check(!missed, "every due timer fires");
+		Check(!twice, "no timer fires twice");
+		Check(!cancelledFired, "cancelled timers do not fire");
+		Check(wheel.Size() == pending, "size matches timers left beyond the run");
+
+		py3lm::TimerList removed;
+		wheel.Clear(removed);
+		size_t cleared = 0;
+		while (!removed.IsEmpty()) {
+			removed.PopFront();
+			++cleared;
+		}
+		Check(cleared == pending && wheel.Size() == 0, "clear returns every pending timer");
+	}
+
+	constexpr const char* kCancelInBatch =
+		"import time\n"
+		"fired = []\n"
+		"def first():\n"
+		"    fired.append('first')\n"
+		"    assert second.cancel()\n"
+		"    assert repeat.cancel()\n"
+		"def stop():\n"
+		"    fired.append('repeat')\n"
+		"first_timer = timers.after(0, first)\n"
+		"second = timers.after(0, lambda: fired.append('second'))\n"
+		"repeat = timers.every(0, stop)\n"
+		"time.sleep(0.005)\n"
+		"timers.tick()\n"
+		"assert fired == ['first'], fired\n"
+		"assert timers.pending() == 0 and not second.active and not repeat.active\n"
+		"again = timers.every(0, lambda: fired.append('again'))\n"
+		"time.sleep(0.005)\n"
+		"timers.tick()\n"
+		"assert fired.count('again') == 1 and again.active and timers.pending() == 1\n"
+		"late = timers.after(1000, lambda: None)\n";
+}
+
+int main() {
+	SimulateWheel();
+
+	Py_Initialize();
+	PyObject* const module = py3lm::CreateTimersModule();
+	if (!module) {
+		PyErr_Print();
+		return 1;
+	}
+	PyObject* const globals = PyDict_New();
+	PyDict_SetItemString(globals, "__builtins__", PyEval_GetBuiltins());
+	PyDict_SetItemString(globals, "timers", module);
+	PyObject* const result = PyRun_String(kCancelInBatch, Py_file_input, globals, globals);
+	Check(result != nullptr, "cancel of a timer due in the same batch");
+	if (result) {
+		Py_DECREF(result);
+	}
+	else {
+		PyErr_Print();
+	}
+	Check(py3lm::PendingTimers() == 2, "repeating and late timers pending");
+	py3lm::ClearTimers();
+	Check(py3lm::PendingTimers() == 0, "clear drops pending timers");
+
+	Py_DECREF(globals);
+	Py_DECREF(module);
+	if (Py_FinalizeEx() < 0) {
+		return 1;
+	}
+	std::printf("%s\n", s_failures ? "FAILED" : "OK");
+	return s_failures ? 1 : 0;
+}